@@ -0,0 +1,139 @@
+#include "marlin/asyncio/udp/UdpTransportFactory.hpp"
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+// UDP ping-pong round trip times with the loop blocking in poll and busy polling.
+// Both ends run in their own process, so every round trip includes two wakeups.
+// Busy polling needs a free core per process, with fewer the spinning processes take turns on a core.
+
+struct Delegate {
+	bool pinger = false;
+	size_t warmup = 0;
+	size_t rounds = 0;
+	std::vector<uint64_t> rtts;
+
+	void ping(UdpTransport<Delegate> &transport) {
+		Buffer packet(8);
+		packet.write_uint64_le_unsafe(0, EventLoop::now_us());
+		transport.send(std::move(packet));
+	}
+
+	void did_recv_packet(UdpTransport<Delegate> &transport, Buffer &&packet) {
+		if(!pinger) {
+			transport.send(std::move(packet));
+			return;
+		}
+
+		if(warmup > 0) {
+			warmup--;
+		} else {
+			rtts.push_back(EventLoop::now_us() - packet.read_uint64_le_unsafe(0));
+		}
+
+		if(rtts.size() == rounds) {
+			uv_stop(uv_default_loop());
+			return;
+		}
+
+		ping(transport);
+	}
+
+	void did_send_packet(UdpTransport<Delegate> &, Buffer &&) {}
+
+	void did_dial(UdpTransport<Delegate> &transport) {
+		ping(transport);
+	}
+
+	void did_close(UdpTransport<Delegate> &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(UdpTransport<Delegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+static int run(bool busy_poll) {
+	return busy_poll ? EventLoop::run_busy_poll() : EventLoop::run();
+}
+
+static void echo(bool busy_poll) {
+	UdpTransportFactory<Delegate, Delegate> f;
+	f.bind(SocketAddress::loopback_ipv4(8000));
+	if(busy_poll) {
+		f.enable_busy_poll();
+	}
+
+	Delegate d;
+	f.listen(d);
+
+	run(busy_poll);
+}
+
+static void ping(bool busy_poll, size_t rounds) {
+	UdpTransportFactory<Delegate, Delegate> f;
+	f.bind(SocketAddress::loopback_ipv4(0));
+	if(busy_poll) {
+		f.enable_busy_poll();
+	}
+
+	Delegate d;
+	d.pinger = true;
+	d.warmup = rounds / 10;
+	d.rounds = rounds;
+	d.rtts.reserve(rounds);
+
+	// Give the echo process time to bind
+	usleep(100000);
+	f.dial(SocketAddress::loopback_ipv4(8000), d);
+
+	run(busy_poll);
+
+	std::sort(d.rtts.begin(), d.rtts.end());
+	SPDLOG_INFO(
+		"{:<10} rtt p50 {:>5} us, p99 {:>5} us, p99.9 {:>5} us, max {:>6} us",
+		busy_poll ? "busy poll" : "blocking",
+		d.rtts[d.rtts.size() / 2],
+		d.rtts[d.rtts.size() * 99 / 100],
+		d.rtts[d.rtts.size() * 999 / 1000],
+		d.rtts.back()
+	);
+}
+
+// Each process sets up its own default loop, so the parent stays clear of libuv
+int main(int argc, char **argv) {
+	size_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+
+	for(bool busy_poll : {false, true}) {
+		auto echo_pid = fork();
+		if(echo_pid == 0) {
+			echo(busy_poll);
+			return 0;
+		}
+
+		auto ping_pid = fork();
+		if(ping_pid == 0) {
+			ping(busy_poll, rounds);
+			return 0;
+		}
+
+		waitpid(ping_pid, nullptr, 0);
+		kill(echo_pid, SIGTERM);
+		waitpid(echo_pid, nullptr, 0);
+	}
+
+	return 0;
+}
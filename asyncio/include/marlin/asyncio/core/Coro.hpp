@@ -0,0 +1,621 @@
+/*! \file Coro.hpp
+	\brief C++20 coroutine API over the asyncio loop, transports and timers
+
+	Features:
+	\li Task, a lazily started coroutine that can be awaited, or spawned to run detached on the loop
+	\li sleep, resumes after a timeout, all sleepers share one libuv timer
+	\li Factory and Connection, delegates that turn UDP and TCP factories and transports into awaitables: co_await factory.dial(addr), co_await factory.accept(), co_await connection.recv()
+	\li coroutine frames are recycled through a pool, awaiters live in the frames, so awaiting never allocates
+	\li opt in, needs C++20 in the including translation unit, the rest of the tree stays on C++17
+	\li libuv loop only, not available under MARLIN_ASYNCIO_SIMULATOR
+*/
+
+#ifndef MARLIN_ASYNCIO_CORO_HPP
+#define MARLIN_ASYNCIO_CORO_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#error "marlin/asyncio/core/Coro.hpp needs C++20 coroutines"
+#endif
+
+#include <marlin/core/Buffer.hpp>
+#include <marlin/core/SocketAddress.hpp>
+#include "EventLoop.hpp"
+#include <uv.h>
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <list>
+#include <new>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace marlin {
+namespace asyncio {
+namespace coro {
+
+//! Size classes of recycled coroutine frames, frames larger than the largest class use the heap
+#define CORO_FRAME_CLASS_SIZE 64
+#define CORO_FRAME_CLASSES 64
+
+//! Free lists of coroutine frames by size class
+class FramePool {
+private:
+	struct FreeFrame {
+		FreeFrame *next;
+	};
+
+	std::array<FreeFrame *, CORO_FRAME_CLASSES> free_lists = {};
+
+	static size_t size_class(size_t size) {
+		return (size + CORO_FRAME_CLASS_SIZE - 1) / CORO_FRAME_CLASS_SIZE - 1;
+	}
+public:
+	//! Frames taken from the heap, stays flat once the pool has warmed up
+	uint64_t allocations = 0;
+
+	FramePool() = default;
+	FramePool(FramePool const&) = delete;
+
+	~FramePool() {
+		for(auto *head : free_lists) {
+			while(head != nullptr) {
+				auto *next = head->next;
+				::operator delete(head);
+				head = next;
+			}
+		}
+	}
+
+	//! Pool of the thread
+	static FramePool &loop() {
+		thread_local FramePool pool;
+		return pool;
+	}
+
+	void *allocate(size_t size) {
+		auto cls = size_class(size);
+		if(cls >= CORO_FRAME_CLASSES) {
+			return ::operator new(size);
+		}
+
+		if(free_lists[cls] != nullptr) {
+			auto *frame = free_lists[cls];
+			free_lists[cls] = frame->next;
+			return frame;
+		}
+
+		allocations++;
+		return ::operator new((cls + 1) * CORO_FRAME_CLASS_SIZE);
+	}
+
+	void deallocate(void *ptr, size_t size) {
+		auto cls = size_class(size);
+		if(cls >= CORO_FRAME_CLASSES) {
+			::operator delete(ptr);
+			return;
+		}
+
+		auto *frame = (FreeFrame *)ptr;
+		frame->next = free_lists[cls];
+		free_lists[cls] = frame;
+	}
+};
+
+template<typename T>
+class Task;
+
+//! Parts of the promise shared by all result types
+struct PromiseBase {
+	//! Awaiting coroutine, resumed once this one is done
+	std::coroutine_handle<> continuation;
+	//! Spawned, nobody awaits the result and the frame frees itself
+	bool detached = false;
+
+	static void *operator new(size_t size) {
+		return FramePool::loop().allocate(size);
+	}
+
+	static void operator delete(void *ptr, size_t size) {
+		FramePool::loop().deallocate(ptr, size);
+	}
+
+	struct FinalAwaiter {
+		bool await_ready() noexcept {
+			return false;
+		}
+
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+			auto &promise = handle.promise();
+			if(promise.detached) {
+				handle.destroy();
+				return std::noop_coroutine();
+			}
+
+			return promise.continuation ? promise.continuation : std::noop_coroutine();
+		}
+
+		void await_resume() noexcept {}
+	};
+
+	std::suspend_always initial_suspend() noexcept {
+		return {};
+	}
+
+	FinalAwaiter final_suspend() noexcept {
+		return {};
+	}
+
+	//! Exceptions are not used across the loop
+	void unhandled_exception() noexcept {
+		std::terminate();
+	}
+};
+
+template<typename T>
+struct Promise : PromiseBase {
+	std::optional<T> value;
+
+	Task<T> get_return_object();
+
+	template<typename U>
+	void return_value(U &&value) {
+		this->value.emplace(std::forward<U>(value));
+	}
+};
+
+template<>
+struct Promise<void> : PromiseBase {
+	Task<void> get_return_object();
+
+	void return_void() {}
+};
+
+//! Coroutine which starts when awaited, or when spawned
+template<typename T = void>
+class Task {
+public:
+	using promise_type = Promise<T>;
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	template<typename U>
+	friend void spawn(Task<U> &&task);
+public:
+	explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task(Task const&) = delete;
+
+	~Task() {
+		if(handle) {
+			handle.destroy();
+		}
+	}
+
+	bool await_ready() {
+		return false;
+	}
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) {
+		handle.promise().continuation = continuation;
+		return handle;
+	}
+
+	T await_resume() {
+		if constexpr (!std::is_void_v<T>) {
+			return std::move(*handle.promise().value);
+		}
+	}
+};
+
+template<typename T>
+Task<T> Promise<T>::get_return_object() {
+	return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() {
+	return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+//! starts a task on the loop without awaiting it, its frame is freed when it completes
+/*!
+	\li runs synchronously up to its first suspension
+*/
+template<typename T>
+void spawn(Task<T> &&task) {
+	auto handle = std::exchange(task.handle, nullptr);
+	handle.promise().detached = true;
+	handle.resume();
+}
+
+//! Timeouts of all sleeping coroutines on one libuv timer
+class Sleeper {
+private:
+	struct Entry {
+		uint64_t deadline;
+		uint64_t seq;
+		std::coroutine_handle<> handle;
+
+		// Min heap on deadline, FIFO for equal deadlines
+		bool operator<(Entry const &other) const {
+			return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+		}
+	};
+
+	uv_timer_t *timer = nullptr;
+	std::vector<Entry> entries;
+	uint64_t next_seq = 0;
+
+	static void timer_cb(uv_timer_t *handle) {
+		auto &sleeper = *(Sleeper *)handle->data;
+		auto now = EventLoop::now();
+		auto end_seq = sleeper.next_seq;
+
+		// Resumed coroutines can sleep again, those wait for the next round even if already due
+		while(sleeper.entries.size() > 0 && sleeper.entries.front().deadline <= now && sleeper.entries.front().seq < end_seq) {
+			std::pop_heap(sleeper.entries.begin(), sleeper.entries.end());
+			auto handle = sleeper.entries.back().handle;
+			sleeper.entries.pop_back();
+
+			handle.resume();
+		}
+
+		sleeper.arm();
+	}
+
+	void arm() {
+		if(entries.size() == 0) {
+			uv_timer_stop(timer);
+			return;
+		}
+
+		auto now = EventLoop::now();
+		auto deadline = entries.front().deadline;
+		uv_timer_start(timer, timer_cb, deadline > now ? deadline - now : 0, 0);
+	}
+public:
+	Sleeper() {
+		entries.reserve(64);
+	}
+
+	Sleeper(Sleeper const&) = delete;
+
+	//! Sleeper of the default loop
+	static Sleeper &loop() {
+		thread_local Sleeper sleeper;
+		return sleeper;
+	}
+
+	void add(uint64_t timeout, std::coroutine_handle<> handle) {
+		if(timer == nullptr) {
+			timer = new uv_timer_t();
+			uv_timer_init(uv_default_loop(), timer);
+			timer->data = this;
+		}
+
+		entries.push_back({EventLoop::now() + timeout, next_seq++, handle});
+		std::push_heap(entries.begin(), entries.end());
+
+		if(entries.front().handle == handle) {
+			arm();
+		}
+	}
+};
+
+//! Awaiter of sleep
+struct SleepAwaiter {
+	uint64_t timeout;
+
+	bool await_ready() {
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		Sleeper::loop().add(timeout, handle);
+	}
+
+	void await_resume() {}
+};
+
+//! resumes the awaiting coroutine after the given timeout in ms, with the resolution of EventLoop::now
+inline SleepAwaiter sleep(uint64_t timeout) {
+	return {timeout};
+}
+
+//! Transport delegate which queues received data for coroutines
+/*!
+	\li works with transports delivering did_recv_packet (UDP) or did_recv_bytes (TCP)
+	\li data received while a coroutine waits is handed straight to it, otherwise it queues up until the next recv
+	\li owned by the Factory it was created by
+*/
+template<template<typename> class TransportTemplate>
+class Connection {
+public:
+	using TransportType = TransportTemplate<Connection<TransportTemplate>>;
+
+	//! Awaiter of recv, yields nullopt once the connection is closed
+	struct RecvAwaiter {
+		Connection &connection;
+		std::optional<core::Buffer> result;
+		std::coroutine_handle<> handle;
+
+		bool await_ready() {
+			if(connection.inbox.size() > 0) {
+				result.emplace(std::move(connection.inbox.front()));
+				connection.inbox.pop_front();
+				return true;
+			}
+
+			return connection.closed;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			this->handle = handle;
+			connection.recv_waiter = this;
+		}
+
+		std::optional<core::Buffer> await_resume() {
+			return std::move(result);
+		}
+	};
+private:
+	TransportType *transport = nullptr;
+	std::deque<core::Buffer> inbox;
+	RecvAwaiter *recv_waiter = nullptr;
+	bool closed = false;
+
+	// Set by the factory, tells it about completed dials
+	void (*dialled)(void *factory, Connection &connection) = nullptr;
+	void *factory = nullptr;
+
+	template<template<typename, typename> class, template<typename> class>
+	friend class Factory;
+
+	void deliver(core::Buffer &&bytes) {
+		if(recv_waiter == nullptr) {
+			inbox.push_back(std::move(bytes));
+			return;
+		}
+
+		auto *waiter = std::exchange(recv_waiter, nullptr);
+		waiter->result.emplace(std::move(bytes));
+		waiter->handle.resume();
+	}
+public:
+	Connection(TransportType &transport) : transport(&transport) {}
+	Connection(Connection const&) = delete;
+
+	//! receives the next packet or chunk of bytes, nullopt if the connection is closed
+	RecvAwaiter recv() {
+		return {*this, std::nullopt, nullptr};
+	}
+
+	int send(core::Buffer &&bytes) {
+		if(closed) {
+			return -1;
+		}
+		return transport->send(std::move(bytes));
+	}
+
+	void close() {
+		if(!closed) {
+			transport->close();
+		}
+	}
+
+	bool is_closed() const {
+		return closed;
+	}
+
+	//! Underlying transport, only valid until the connection is closed
+	TransportType &get_transport() {
+		return *transport;
+	}
+
+	// Delegate interface
+
+	void did_recv_packet(TransportType &, core::Buffer &&packet) {
+		deliver(std::move(packet));
+	}
+
+	void did_recv_bytes(TransportType &, core::Buffer &&bytes) {
+		deliver(std::move(bytes));
+	}
+
+	void did_send_packet(TransportType &, core::Buffer &&) {}
+
+	void did_send_bytes(TransportType &, core::Buffer &&) {}
+
+	void did_dial(TransportType &) {
+		if(dialled != nullptr) {
+			dialled(factory, *this);
+		}
+	}
+
+	void did_close(TransportType &, uint16_t = 0) {
+		closed = true;
+		transport = nullptr;
+
+		if(recv_waiter != nullptr) {
+			std::exchange(recv_waiter, nullptr)->handle.resume();
+		}
+	}
+};
+
+//! Listen delegate wrapping a transport factory, creates a Connection for every transport
+/*!
+	\li co_await dial(addr) resolves to the dialled connection, or nullptr if dialling failed right away.
+		TCP connect errors are only logged by the factory, a coroutine dialling an unreachable address stays suspended.
+	\li co_await accept() resolves to the next incoming connection, after listen
+	\li connections live until the factory is destroyed or they are released after closing
+*/
+template<template<typename, typename> class FactoryTemplate, template<typename> class TransportTemplate>
+class Factory {
+public:
+	using ConnectionType = Connection<TransportTemplate>;
+	using TransportType = typename ConnectionType::TransportType;
+	using FactoryType = FactoryTemplate<Factory<FactoryTemplate, TransportTemplate>, ConnectionType>;
+
+	//! Awaiter of dial, waiters form an intrusive list so that dialling doesn't allocate
+	struct DialAwaiter {
+		Factory &factory;
+		core::SocketAddress addr;
+		ConnectionType *result = nullptr;
+		std::coroutine_handle<> handle;
+		DialAwaiter *next = nullptr;
+
+		bool await_ready() {
+			return false;
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) {
+			next = factory.dial_waiters;
+			factory.dial_waiters = this;
+
+			// UDP dials complete right away
+			if(factory.transport_factory.dial(addr, factory) < 0 || result != nullptr) {
+				factory.remove_dial_waiter(this);
+				return false;
+			}
+
+			this->handle = handle;
+			return true;
+		}
+
+		ConnectionType *await_resume() {
+			return result;
+		}
+	};
+
+	//! Awaiter of accept
+	struct AcceptAwaiter {
+		Factory &factory;
+		ConnectionType *result = nullptr;
+		std::coroutine_handle<> handle;
+
+		bool await_ready() {
+			if(factory.backlog.size() > 0) {
+				result = factory.backlog.front();
+				factory.backlog.pop_front();
+				return true;
+			}
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) {
+			this->handle = handle;
+			factory.accept_waiter = this;
+		}
+
+		ConnectionType *await_resume() {
+			return result;
+		}
+	};
+private:
+	FactoryType transport_factory;
+	std::list<ConnectionType> connections;
+
+	bool listening = false;
+	std::deque<ConnectionType *> backlog;
+	AcceptAwaiter *accept_waiter = nullptr;
+	DialAwaiter *dial_waiters = nullptr;
+
+	void remove_dial_waiter(DialAwaiter *waiter) {
+		for(auto **iter = &dial_waiters; *iter != nullptr; iter = &(*iter)->next) {
+			if(*iter == waiter) {
+				*iter = waiter->next;
+				return;
+			}
+		}
+	}
+
+	static void dialled(void *data, ConnectionType &connection) {
+		auto &self = *(Factory *)data;
+		auto &addr = connection.get_transport().dst_addr;
+
+		for(auto *waiter = self.dial_waiters; waiter != nullptr; waiter = waiter->next) {
+			if(waiter->addr == addr && waiter->result == nullptr) {
+				waiter->result = &connection;
+				// Suspended waiters are resumed here, ones still in await_suspend pick the result up there
+				if(waiter->handle) {
+					self.remove_dial_waiter(waiter);
+					waiter->handle.resume();
+				}
+				return;
+			}
+		}
+	}
+public:
+	Factory() = default;
+	Factory(Factory const&) = delete;
+
+	int bind(core::SocketAddress const &addr) {
+		return transport_factory.bind(addr);
+	}
+
+	//! accepts incoming connections from here on, to be picked up with accept
+	int listen() {
+		listening = true;
+		return transport_factory.listen(*this);
+	}
+
+	DialAwaiter dial(core::SocketAddress const &addr) {
+		return {*this, addr, nullptr, nullptr, nullptr};
+	}
+
+	AcceptAwaiter accept() {
+		return {*this, nullptr, nullptr};
+	}
+
+	//! frees a closed connection before the factory is destroyed
+	void release(ConnectionType &connection) {
+		connections.remove_if([&](ConnectionType const &c) {
+			return &c == &connection && c.is_closed();
+		});
+	}
+
+	//! Underlying factory, for factory specific options
+	FactoryType &get_factory() {
+		return transport_factory;
+	}
+
+	// Listen delegate interface
+
+	bool should_accept(core::SocketAddress const &) {
+		return listening;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		auto &connection = connections.emplace_back(transport);
+		connection.dialled = dialled;
+		connection.factory = this;
+		transport.setup(&connection);
+
+		// Dialled transports are reported through did_dial
+		for(auto *waiter = dial_waiters; waiter != nullptr; waiter = waiter->next) {
+			if(waiter->addr == transport.dst_addr) {
+				return;
+			}
+		}
+
+		if(accept_waiter != nullptr) {
+			auto *waiter = std::exchange(accept_waiter, nullptr);
+			waiter->result = &connection;
+			waiter->handle.resume();
+			return;
+		}
+
+		backlog.push_back(&connection);
+	}
+};
+
+} // namespace coro
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_CORO_HPP
@@ -6,11 +6,23 @@
 
 #include <uv.h>
 #include <marlin/simulator/core/Simulator.hpp>
+#include "LoopStats.hpp"
+
+#include <vector>
 
 
 namespace marlin {
 namespace asyncio {
 
+/// Time the busy poll loop keeps spinning without receiving anything before it blocks in poll, in us
+#define DEFAULT_BUSY_POLL_SPIN_US 50000
+
+/// Reads a source directly while the loop spins, returns the number of events handled
+struct BusyPoller {
+	int (*poll)(void *data);
+	void *data;
+};
+
 #ifdef MARLIN_ASYNCIO_SIMULATOR
 
 struct EventLoop {
@@ -22,11 +34,78 @@ struct EventLoop {
 	static uint64_t now() {
 		return simulator::Simulator::default_instance.current_tick();
 	}
+
+	static uint64_t now_us() {
+		return simulator::Simulator::default_instance.current_tick() * 1000;
+	}
+
+	/// Only callback durations are profiled, simulated time has no loop lag
+	static int enable_stats(uint64_t = 0) {
+		LoopStats::loop().enabled = true;
+		return 0;
+	}
+
+	static LoopStats& stats() {
+		return LoopStats::loop();
+	}
+
+	/// Simulated time never blocks
+	static int run_busy_poll(uint64_t = DEFAULT_BUSY_POLL_SPIN_US) {
+		return run();
+	}
+
+	static void add_busy_poller(BusyPoller) {}
+	static void remove_busy_poller(void *) {}
 };
 
 #else
 
 class EventLoop {
+private:
+	struct BusyPollState {
+		uv_idle_t *idle = nullptr;
+		uv_check_t *check = nullptr;
+		uint64_t spin_us = 0;
+		uint64_t last_event_us = 0;
+		bool spinning = false;
+		std::vector<BusyPoller> pollers;
+	};
+
+	/// Pollers belong to the loop running on this thread
+	static BusyPollState& busy_poll_state() {
+		thread_local BusyPollState state;
+		return state;
+	}
+
+	static void busy_poll_idle_cb(uv_idle_t *handle) {
+		auto &state = *(BusyPollState *)handle->data;
+		auto now = now_us();
+
+		int events = 0;
+		// Pollers can be removed by callbacks of the ones before them
+		for(size_t i = 0; i < state.pollers.size(); i++) {
+			events += state.pollers[i].poll(state.pollers[i].data);
+		}
+
+		if(events > 0) {
+			state.last_event_us = now;
+		} else if(now - state.last_event_us > state.spin_us) {
+			// Idle, poll blocks from this iteration on
+			uv_idle_stop(handle);
+			state.spinning = false;
+		}
+	}
+
+	static void busy_poll_check_cb(uv_check_t *handle) {
+		auto &state = *(BusyPollState *)handle->data;
+
+		// Woken up from a blocking poll, spin again
+		if(!state.spinning) {
+			state.spinning = true;
+			state.last_event_us = now_us();
+			uv_idle_start(state.idle, busy_poll_idle_cb);
+		}
+	}
 public:
 	static int run() {
 		return uv_run(uv_default_loop(), UV_RUN_DEFAULT);
@@ -35,6 +114,72 @@ public:
 	static uint64_t now() {
 		return uv_now(uv_default_loop());
 	}
+
+	/// Monotonic time in microseconds, unlike now() it is not cached per loop iteration
+	static uint64_t now_us() {
+		return uv_hrtime() / 1000;
+	}
+
+	/// Start measuring loop lag and profiling callback sites, logged every dump_interval_ms if set
+	static int enable_stats(uint64_t dump_interval_ms = 0) {
+		return LoopStats::loop().start(uv_default_loop(), dump_interval_ms);
+	}
+
+	static LoopStats& stats() {
+		return LoopStats::loop();
+	}
+
+	/// Like run, but spins instead of sleeping in poll and reads busy pollers directly on every spin.
+	/// Falls back to blocking in poll after spin_us without anything received and resumes spinning on the next wakeup.
+	/// Trades a core for wakeup latency, meant for latency critical relays.
+	static int run_busy_poll(uint64_t spin_us = DEFAULT_BUSY_POLL_SPIN_US) {
+		auto &state = busy_poll_state();
+		auto *loop = uv_default_loop();
+
+		if(state.idle == nullptr) {
+			// Active idle handles make poll return immediately, unreferenced they don't keep the loop alive
+			state.idle = new uv_idle_t();
+			uv_idle_init(loop, state.idle);
+			state.idle->data = &state;
+			uv_unref((uv_handle_t *)state.idle);
+
+			state.check = new uv_check_t();
+			uv_check_init(loop, state.check);
+			state.check->data = &state;
+			uv_unref((uv_handle_t *)state.check);
+		}
+
+		state.spin_us = spin_us;
+		state.spinning = true;
+		state.last_event_us = now_us();
+		uv_idle_start(state.idle, busy_poll_idle_cb);
+		uv_check_start(state.check, busy_poll_check_cb);
+
+		int res = uv_run(loop, UV_RUN_DEFAULT);
+
+		uv_idle_stop(state.idle);
+		uv_check_stop(state.check);
+		state.spinning = false;
+
+		return res;
+	}
+
+	/// Registers a source read on every spin of run_busy_poll
+	static void add_busy_poller(BusyPoller poller) {
+		busy_poll_state().pollers.push_back(poller);
+	}
+
+	/// Unregisters the pollers with the given data
+	static void remove_busy_poller(void *data) {
+		auto &pollers = busy_poll_state().pollers;
+		for(auto iter = pollers.begin(); iter != pollers.end();) {
+			if(iter->data == data) {
+				iter = pollers.erase(iter);
+			} else {
+				iter++;
+			}
+		}
+	}
 };
 
 #endif
@@ -0,0 +1,381 @@
+/*! \file IoUring.hpp
+	\brief io_uring instance driven by the libuv loop
+
+	Features:
+	\li submissions are queued and submitted together once per loop iteration
+	\li completions are reaped when libuv reports the ring readable
+	\li received data lands in a ring of provided buffers shared by all sockets on the thread
+	\li built with MARLIN_ASYNCIO_IO_URING on Linux 6.0+, transports fall back to libuv if the ring can't be set up
+*/
+
+#ifndef MARLIN_ASYNCIO_IOURING_HPP
+#define MARLIN_ASYNCIO_IOURING_HPP
+
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+namespace marlin {
+namespace asyncio {
+
+//! Submission queue entries, the completion queue is twice as large
+#define DEFAULT_IO_URING_ENTRIES 1024
+//! Number of provided receive buffers, power of two
+#define DEFAULT_IO_URING_BUFFER_COUNT 64
+//! Room for the recvmsg header, address and ancillary data in front of the datagram
+#define IO_URING_BUFFER_HEADROOM 256
+//! Size of a provided receive buffer, holds the headroom and the largest possible datagram
+#define DEFAULT_IO_URING_BUFFER_SIZE (IO_URING_BUFFER_HEADROOM + 65536)
+//! Group id of the provided receive buffers
+#define IO_URING_BUFFER_GROUP 0
+
+//! Target of a submission, user_data of the entry points to it
+struct IoUringRequest {
+	//! Called with the result and flags of every completion of the submission
+	void (*cb)(IoUringRequest *request, int res, uint32_t flags);
+};
+
+//! io_uring instance hosted inside a libuv loop
+class IoUring {
+private:
+	int fd = -1;
+
+	// Submission queue
+	uint32_t *sq_head = nullptr;
+	uint32_t *sq_tail = nullptr;
+	uint32_t *sq_flags = nullptr;
+	uint32_t sq_mask = 0;
+	uint32_t sq_entries = 0;
+	uint32_t sq_local_tail = 0;
+	io_uring_sqe *sqes = nullptr;
+
+	// Completion queue
+	uint32_t *cq_head = nullptr;
+	uint32_t *cq_tail = nullptr;
+	uint32_t cq_mask = 0;
+	io_uring_cqe *cqes = nullptr;
+
+	void *sq_ring = MAP_FAILED;
+	size_t sq_ring_size = 0;
+	void *cq_ring = MAP_FAILED;
+	size_t cq_ring_size = 0;
+	size_t sqes_size = 0;
+
+	// Provided buffers
+	io_uring_buf *buf_ring = nullptr;
+	size_t buf_ring_size = 0;
+	uint16_t buf_tail = 0;
+	std::unique_ptr<uint8_t[]> buffers;
+
+	uv_poll_t *poll = nullptr;
+	uv_prepare_t *prepare = nullptr;
+	/// Submissions waiting for completions, the loop is kept alive while there are any
+	uint64_t active = 0;
+
+	static void poll_cb(uv_poll_t *handle, int status, int events);
+	static void prepare_cb(uv_prepare_t *handle);
+
+	int enter(uint32_t to_submit, uint32_t flags);
+	void reap();
+	void add_buffer(uint16_t id);
+public:
+	IoUring() = default;
+	IoUring(IoUring const&) = delete;
+	~IoUring();
+
+	//! Ring for the default loop of the thread, set up on first use
+	static IoUring &loop();
+
+	int init(uv_loop_t *loop);
+	bool is_ready() const;
+
+	io_uring_sqe *get_sqe();
+	int submit();
+
+	void ref();
+	void unref();
+
+	uint8_t *buffer(uint16_t id);
+	void recycle_buffer(uint16_t id);
+};
+
+
+// Impl
+
+inline IoUring::~IoUring() {
+	// Handles belong to the loop and are released with it
+	if(sqes != nullptr) {
+		munmap(sqes, sqes_size);
+	}
+	if(cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+		munmap(cq_ring, cq_ring_size);
+	}
+	if(sq_ring != MAP_FAILED) {
+		munmap(sq_ring, sq_ring_size);
+	}
+	if(buf_ring != nullptr) {
+		munmap(buf_ring, buf_ring_size);
+	}
+	if(fd >= 0) {
+		::close(fd);
+	}
+}
+
+inline IoUring &IoUring::loop() {
+	thread_local IoUring ring;
+	thread_local bool initialized = false;
+
+	if(!initialized) {
+		initialized = true;
+		int res = ring.init(uv_default_loop());
+		if(res < 0) {
+			SPDLOG_ERROR("Asyncio: io_uring init error: {}, falling back to libuv", res);
+		}
+	}
+
+	return ring;
+}
+
+//! sets up the rings and provided buffers and hooks them into the given loop
+/*!
+	\return integer, 0 for success, negative errno otherwise
+*/
+inline int IoUring::init(uv_loop_t *loop) {
+	io_uring_params params;
+	std::memset(&params, 0, sizeof(params));
+
+	fd = syscall(__NR_io_uring_setup, DEFAULT_IO_URING_ENTRIES, &params);
+	if(fd < 0) {
+		return -errno;
+	}
+
+	sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+	}
+
+	sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(sq_ring == MAP_FAILED) {
+		return -errno;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ring = sq_ring;
+	} else {
+		cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if(cq_ring == MAP_FAILED) {
+			return -errno;
+		}
+	}
+
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	auto *sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(sqes_map == MAP_FAILED) {
+		return -errno;
+	}
+	sqes = (io_uring_sqe *)sqes_map;
+
+	auto *sq = (uint8_t *)sq_ring;
+	sq_head = (uint32_t *)(sq + params.sq_off.head);
+	sq_tail = (uint32_t *)(sq + params.sq_off.tail);
+	sq_flags = (uint32_t *)(sq + params.sq_off.flags);
+	sq_mask = *(uint32_t *)(sq + params.sq_off.ring_mask);
+	sq_entries = params.sq_entries;
+	sq_local_tail = *sq_tail;
+
+	// Entries are used in order, so the index array maps each slot to itself
+	auto *sq_array = (uint32_t *)(sq + params.sq_off.array);
+	for(uint32_t i = 0; i < sq_entries; i++) {
+		sq_array[i] = i;
+	}
+
+	auto *cq = (uint8_t *)cq_ring;
+	cq_head = (uint32_t *)(cq + params.cq_off.head);
+	cq_tail = (uint32_t *)(cq + params.cq_off.tail);
+	cq_mask = *(uint32_t *)(cq + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// Provided buffer ring, the kernel picks a buffer for every received datagram
+	buf_ring_size = DEFAULT_IO_URING_BUFFER_COUNT * sizeof(io_uring_buf);
+	auto *buf_ring_map = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if(buf_ring_map == MAP_FAILED) {
+		return -errno;
+	}
+	buf_ring = (io_uring_buf *)buf_ring_map;
+
+	io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64_t)buf_ring;
+	reg.ring_entries = DEFAULT_IO_URING_BUFFER_COUNT;
+	reg.bgid = IO_URING_BUFFER_GROUP;
+	if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		return -errno;
+	}
+
+	buffers.reset(new uint8_t[DEFAULT_IO_URING_BUFFER_COUNT * DEFAULT_IO_URING_BUFFER_SIZE]);
+	for(uint16_t id = 0; id < DEFAULT_IO_URING_BUFFER_COUNT; id++) {
+		add_buffer(id);
+	}
+	// Ring tail overlays the reserved field of the first entry
+	__atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+
+	poll = new uv_poll_t();
+	uv_poll_init(loop, poll, fd);
+	poll->data = this;
+	uv_poll_start(poll, UV_READABLE, poll_cb);
+	// Only keeps the loop alive while there is work for it
+	uv_unref((uv_handle_t *)poll);
+
+	prepare = new uv_prepare_t();
+	uv_prepare_init(loop, prepare);
+	prepare->data = this;
+	uv_prepare_start(prepare, prepare_cb);
+	uv_unref((uv_handle_t *)prepare);
+
+	return 0;
+}
+
+inline bool IoUring::is_ready() const {
+	return prepare != nullptr;
+}
+
+//! next free submission entry, zeroed. Submits queued entries first if the queue is full, nullptr if that fails
+inline io_uring_sqe *IoUring::get_sqe() {
+	if(sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+		submit();
+		if(sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+			return nullptr;
+		}
+	}
+
+	auto *sqe = &sqes[sq_local_tail & sq_mask];
+	std::memset(sqe, 0, sizeof(io_uring_sqe));
+	sq_local_tail++;
+
+	return sqe;
+}
+
+//! submits all queued entries with one syscall
+/*!
+	\return integer, number of entries submitted, negative errno otherwise
+*/
+inline int IoUring::submit() {
+	uint32_t to_submit = sq_local_tail - *sq_tail;
+	if(to_submit == 0) {
+		return 0;
+	}
+
+	__atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+	return enter(to_submit, 0);
+}
+
+inline int IoUring::enter(uint32_t to_submit, uint32_t flags) {
+	int res;
+	do {
+		res = syscall(__NR_io_uring_enter, fd, to_submit, 0, flags, nullptr, 0);
+	} while(res < 0 && errno == EINTR);
+
+	if(res < 0) {
+		// Completion queue is backed up, entries stay queued and go out once it is reaped
+		if(errno != EAGAIN && errno != EBUSY) {
+			SPDLOG_ERROR("Asyncio: io_uring enter error: {}", errno);
+		}
+		return -errno;
+	}
+
+	return res;
+}
+
+//! runs completion callbacks for everything in the completion queue
+inline void IoUring::reap() {
+	while(true) {
+		uint32_t head = *cq_head;
+		uint32_t tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+		while(head != tail) {
+			auto &cqe = cqes[head & cq_mask];
+			auto *request = (IoUringRequest *)cqe.user_data;
+			int res = cqe.res;
+			uint32_t flags = cqe.flags;
+
+			// Free the slot before the callback, it may queue more work
+			head++;
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+			if(request != nullptr) {
+				request->cb(request, res, flags);
+			}
+		}
+
+		// Completions that did not fit are held by the kernel until asked for
+		if(!(__atomic_load_n(sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)) {
+			break;
+		}
+		enter(0, IORING_ENTER_GETEVENTS);
+	}
+}
+
+inline void IoUring::poll_cb(uv_poll_t *handle, int status, int) {
+	auto &ring = *(IoUring *)handle->data;
+
+	if(status < 0) {
+		SPDLOG_ERROR("Asyncio: io_uring poll error: {}", status);
+		return;
+	}
+
+	ring.reap();
+	// Callbacks queue follow up work like re-armed receives and sends
+	ring.submit();
+}
+
+inline void IoUring::prepare_cb(uv_prepare_t *handle) {
+	auto &ring = *(IoUring *)handle->data;
+	ring.submit();
+}
+
+//! marks a submission as in flight, keeps the loop alive until the matching unref
+inline void IoUring::ref() {
+	if(active++ == 0) {
+		uv_ref((uv_handle_t *)poll);
+	}
+}
+
+inline void IoUring::unref() {
+	if(--active == 0) {
+		uv_unref((uv_handle_t *)poll);
+	}
+}
+
+//! memory of the provided buffer with the given id
+inline uint8_t *IoUring::buffer(uint16_t id) {
+	return buffers.get() + (size_t)id * DEFAULT_IO_URING_BUFFER_SIZE;
+}
+
+inline void IoUring::add_buffer(uint16_t id) {
+	auto &entry = buf_ring[buf_tail & (DEFAULT_IO_URING_BUFFER_COUNT - 1)];
+	entry.addr = (uint64_t)buffer(id);
+	entry.len = DEFAULT_IO_URING_BUFFER_SIZE;
+	entry.bid = id;
+	buf_tail++;
+}
+
+//! hands a provided buffer back to the kernel once its contents are consumed
+inline void IoUring::recycle_buffer(uint16_t id) {
+	add_buffer(id);
+	__atomic_store_n(&buf_ring[0].resv, buf_tail, __ATOMIC_RELEASE);
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_IOURING_HPP
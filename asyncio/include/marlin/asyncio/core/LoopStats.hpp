@@ -0,0 +1,299 @@
+/*! \file LoopStats.hpp
+	\brief Event loop latency and callback profiling
+
+	Features:
+	\li loop lag, the time each loop iteration spends running callbacks, which is how long a newly ready event can wait
+	\li number of callbacks run per loop iteration
+	\li duration of callbacks per call site, sites are registered by name once and timed with ProfileScope
+	\li off until enabled, a disabled ProfileScope costs a branch
+*/
+
+#ifndef MARLIN_ASYNCIO_LOOPSTATS_HPP
+#define MARLIN_ASYNCIO_LOOPSTATS_HPP
+
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+
+namespace marlin {
+namespace asyncio {
+
+//! Histogram with power of two buckets, cheap enough to record on every callback
+struct Histogram {
+	//! Bucket i holds values in [2^(i-1), 2^i), bucket 0 holds zeros
+	std::array<uint64_t, 65> buckets = {};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	void record(uint64_t value) {
+		buckets[value == 0 ? 0 : 64 - __builtin_clzll(value)]++;
+		count++;
+		sum += value;
+		if(value > max) {
+			max = value;
+		}
+	}
+
+	//! upper bound of the bucket holding the given percentile, capped at the max
+	uint64_t percentile(double p) const {
+		if(count == 0) {
+			return 0;
+		}
+
+		uint64_t rank = p * (count - 1);
+		uint64_t seen = 0;
+		for(size_t i = 0; i < buckets.size(); i++) {
+			seen += buckets[i];
+			if(seen > rank) {
+				uint64_t upper = i == 0 ? 0 : i == 64 ? UINT64_MAX : (1ull << i) - 1;
+				return upper < max ? upper : max;
+			}
+		}
+
+		return max;
+	}
+
+	uint64_t mean() const {
+		return count == 0 ? 0 : sum / count;
+	}
+
+	void reset() {
+		*this = Histogram();
+	}
+};
+
+//! Latency stats of the event loop, see EventLoop::enable_stats
+class LoopStats {
+public:
+	//! Named call site, durations are inclusive of nested sites
+	struct Site {
+		char const* name;
+		Histogram duration_ns;
+	};
+
+private:
+	std::deque<Site> site_list;
+
+	uv_prepare_t *prepare = nullptr;
+	uv_check_t *check = nullptr;
+	uv_timer_t *dump_timer = nullptr;
+
+	// Current iteration
+	uint32_t depth = 0;
+	bool in_poll = false;
+	uint64_t check_time_ns = 0;
+	uint64_t poll_busy_ns = 0;
+	uint64_t iteration_events = 0;
+
+	static void prepare_cb(uv_prepare_t *handle);
+	static void check_cb(uv_check_t *handle);
+	static void dump_timer_cb(uv_timer_t *handle);
+
+	friend class ProfileScope;
+public:
+	//! Is profiling enabled?
+	bool enabled = false;
+	//! Time spent running callbacks per loop iteration in ns
+	Histogram lag_ns;
+	//! Top level profiled callbacks per loop iteration
+	Histogram events;
+
+	//! Stats of the loop running on this thread
+	static LoopStats &loop();
+
+	int start(uv_loop_t *loop, uint64_t dump_interval_ms = 0);
+	Site &site(char const* name);
+	std::deque<Site> const &sites() const;
+
+	void reset();
+	void log() const;
+};
+
+//! Times the enclosing scope against a call site while the stats are enabled
+/*!
+	\li usage: thread_local auto &site = LoopStats::loop().site("udp.recv"); ProfileScope profile(site);
+	\li outermost scopes also count as loop events and towards loop lag
+*/
+class ProfileScope {
+private:
+	LoopStats::Site *site = nullptr;
+	uint64_t start_ns = 0;
+public:
+	ProfileScope(LoopStats::Site &site);
+	ProfileScope(ProfileScope const&) = delete;
+	~ProfileScope();
+};
+
+
+// Impl
+
+inline LoopStats &LoopStats::loop() {
+	thread_local LoopStats stats;
+	return stats;
+}
+
+//! enables profiling and starts measuring loop lag on the given loop
+/*!
+	\li a prepare and check handle pair brackets the poll phase of every iteration, neither keeps the loop alive
+	\li profiled callbacks running during the poll phase count towards lag, outside it the whole time between check and prepare does
+	\li must be called once
+
+	/param loop loop to measure
+	/param dump_interval_ms log and reset the stats at this interval, 0 to disable
+	/return an integer 0 if successful, negative otherwise
+*/
+inline int LoopStats::start(uv_loop_t *loop, uint64_t dump_interval_ms) {
+	if(prepare != nullptr) {
+		return UV_EALREADY;
+	}
+
+	enabled = true;
+
+	prepare = new uv_prepare_t();
+	uv_prepare_init(loop, prepare);
+	prepare->data = this;
+	uv_prepare_start(prepare, prepare_cb);
+	uv_unref((uv_handle_t *)prepare);
+
+	check = new uv_check_t();
+	uv_check_init(loop, check);
+	check->data = this;
+	uv_check_start(check, check_cb);
+	uv_unref((uv_handle_t *)check);
+
+	if(dump_interval_ms > 0) {
+		dump_timer = new uv_timer_t();
+		uv_timer_init(loop, dump_timer);
+		dump_timer->data = this;
+		uv_timer_start(dump_timer, dump_timer_cb, dump_interval_ms, dump_interval_ms);
+		uv_unref((uv_handle_t *)dump_timer);
+	}
+
+	return 0;
+}
+
+//! registers a call site, or returns the existing one with the same name
+/*!
+	\li sites are never removed so references stay valid, cache them in a thread_local so every loop gets its own
+*/
+inline LoopStats::Site &LoopStats::site(char const* name) {
+	for(auto &site : site_list) {
+		if(std::strcmp(site.name, name) == 0) {
+			return site;
+		}
+	}
+
+	site_list.push_back({name, Histogram()});
+	return site_list.back();
+}
+
+inline std::deque<LoopStats::Site> const &LoopStats::sites() const {
+	return site_list;
+}
+
+//! end of an iteration, poll is about to block
+inline void LoopStats::prepare_cb(uv_prepare_t *handle) {
+	auto &stats = *(LoopStats *)handle->data;
+
+	// Nothing to attribute on the first iteration
+	if(stats.check_time_ns != 0) {
+		stats.lag_ns.record(uv_hrtime() - stats.check_time_ns + stats.poll_busy_ns);
+		stats.events.record(stats.iteration_events);
+	}
+
+	stats.in_poll = true;
+	stats.poll_busy_ns = 0;
+	stats.iteration_events = 0;
+}
+
+//! poll phase is done, everything up to the next prepare runs back to back
+inline void LoopStats::check_cb(uv_check_t *handle) {
+	auto &stats = *(LoopStats *)handle->data;
+
+	stats.in_poll = false;
+	stats.check_time_ns = uv_hrtime();
+}
+
+inline void LoopStats::dump_timer_cb(uv_timer_t *handle) {
+	auto &stats = *(LoopStats *)handle->data;
+
+	stats.log();
+	stats.reset();
+}
+
+//! clears all histograms, sites stay registered
+inline void LoopStats::reset() {
+	lag_ns.reset();
+	events.reset();
+	for(auto &site : site_list) {
+		site.duration_ns.reset();
+	}
+}
+
+//! logs loop lag, events per iteration and every site that was hit
+inline void LoopStats::log() const {
+	SPDLOG_INFO(
+		"Loop: {} iterations, lag p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us, events p50 {}, p99 {}, max {}",
+		lag_ns.count,
+		lag_ns.percentile(0.5) / 1000.0,
+		lag_ns.percentile(0.99) / 1000.0,
+		lag_ns.max / 1000.0,
+		events.percentile(0.5),
+		events.percentile(0.99),
+		events.max
+	);
+
+	for(auto &site : site_list) {
+		if(site.duration_ns.count == 0) {
+			continue;
+		}
+
+		SPDLOG_INFO(
+			"Loop site {:<20} calls {:>9}, mean {:.1f} us, p99 {:.1f} us, max {:.1f} us, total {:.1f} ms",
+			site.name,
+			site.duration_ns.count,
+			site.duration_ns.mean() / 1000.0,
+			site.duration_ns.percentile(0.99) / 1000.0,
+			site.duration_ns.max / 1000.0,
+			site.duration_ns.sum / 1000000.0
+		);
+	}
+}
+
+inline ProfileScope::ProfileScope(LoopStats::Site &site) {
+	auto &stats = LoopStats::loop();
+	if(!stats.enabled) {
+		return;
+	}
+
+	this->site = &site;
+	stats.depth++;
+	start_ns = uv_hrtime();
+}
+
+inline ProfileScope::~ProfileScope() {
+	if(site == nullptr) {
+		return;
+	}
+
+	auto &stats = LoopStats::loop();
+	auto duration_ns = uv_hrtime() - start_ns;
+	site->duration_ns.record(duration_ns);
+
+	if(--stats.depth == 0) {
+		stats.iteration_events++;
+		if(stats.in_poll) {
+			stats.poll_busy_ns += duration_ns;
+		}
+	}
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_LOOPSTATS_HPP
@@ -7,6 +7,7 @@
 #include <uv.h>
 #include <type_traits>
 #include <marlin/simulator/timer/Timer.hpp>
+#include "LoopStats.hpp"
 
 
 namespace marlin {
@@ -31,12 +32,18 @@ private:
 
 	template<typename DelegateType, void (DelegateType::*callback)()>
 	static void timer_cb(uv_timer_t* handle) {
+		thread_local auto &site = LoopStats::loop().site("timer");
+		ProfileScope profile(site);
+
 		auto& timer = *(Self*)handle->data;
 		(((DelegateType*)(timer.delegate))->*callback)();
 	}
 
 	template<typename DelegateType, typename DataType, void (DelegateType::*callback)(DataType&)>
 	static void timer_cb(uv_timer_t* handle) {
+		thread_local auto &site = LoopStats::loop().site("timer");
+		ProfileScope profile(site);
+
 		auto& timer = *(Self*)handle->data;
 		(((DelegateType*)(timer.delegate))->*callback)(*(DataType*)timer.data);
 	}
@@ -0,0 +1,350 @@
+/*! \file ShmTransport.hpp
+	\brief Marlin shared memory transport connection implementation
+
+	Features:
+	\li drop in replacement for TcpTransport between processes on the same host
+	\li bytes go through a pair of SpscRing in shared memory, no syscalls while both sides are busy
+	\li a side is only woken up through its eventfd when it may be idle, waiting for data or space
+	\li the unix socket the connection was set up over stays open to detect the peer going away
+*/
+
+#ifndef MARLIN_ASYNCIO_SHMTRANSPORT_HPP
+#define MARLIN_ASYNCIO_SHMTRANSPORT_HPP
+
+#ifndef __linux__
+#error "Shared memory transports need Linux, they use memfd and eventfd"
+#endif
+
+#include "marlin/core/Buffer.hpp"
+#include "marlin/core/SocketAddress.hpp"
+#include "marlin/core/TransportManager.hpp"
+#include "marlin/asyncio/core/LoopStats.hpp"
+#include "marlin/asyncio/tcp/TcpTransport.hpp"
+#include "SpscRing.hpp"
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace marlin {
+namespace asyncio {
+
+//! Capacity of the ring in each direction
+#define DEFAULT_SHM_RING_SIZE 1048576
+
+//! Shared memory and descriptors of one connection, owned by the transport once created
+struct ShmChannel {
+	//! Mapping holding both rings
+	void *mapping;
+	size_t mapping_size;
+	uint64_t capacity;
+	//! Index of the ring this side writes, the peer writes the other one
+	int send_ring;
+	//! Unix socket the connection was set up over, closed by either side to end the connection
+	int control_fd;
+	//! Signalled by the peer when data or space is available
+	int event_fd;
+	//! Signalled by this side when data or space is available
+	int peer_event_fd;
+};
+
+//! Wrapper transport class around a pair of shared memory rings
+template<typename DelegateType>
+class ShmTransport {
+private:
+	ShmChannel channel;
+	SpscRing send_ring;
+	SpscRing recv_ring;
+	core::TransportManager<ShmTransport<DelegateType>> &transport_manager;
+
+	uv_poll_t *event_poll;
+	uv_poll_t *control_poll;
+
+	static void event_cb(uv_poll_t *handle, int status, int events);
+	static void control_cb(uv_poll_t *handle, int status, int events);
+	static void close_cb(uv_handle_t *handle);
+	static void flush_cb(uv_prepare_t *handle);
+
+	static void signal(int fd);
+
+	//! Buffers waiting for the next flush, in order
+	std::deque<core::Buffer> send_queue;
+	//! Bytes of the front buffer already in the ring
+	size_t send_offset = 0;
+	//! Flushes the send queue once per loop iteration, active while the queue is not empty and the ring has space
+	uv_prepare_t *flush_handle;
+	bool closing = false;
+
+	void flush();
+	void recv();
+public:
+	core::SocketAddress src_addr;
+	core::SocketAddress dst_addr;
+
+	DelegateType *delegate = nullptr;
+
+	ShmTransport(
+		core::SocketAddress const &src_addr,
+		core::SocketAddress const &dst_addr,
+		ShmChannel const &channel,
+		core::TransportManager<ShmTransport<DelegateType>> &transport_manager
+	);
+
+	ShmTransport(ShmTransport const&) = delete;
+
+	void setup(DelegateType *delegate);
+	void did_recv_bytes(core::Buffer &&bytes);
+	int send(core::Buffer &&bytes);
+	uint16_t close_reason = 0;
+	void close(uint16_t reason = 0);
+};
+
+
+// Impl
+
+template<typename DelegateType>
+ShmTransport<DelegateType>::ShmTransport(
+	core::SocketAddress const &_src_addr,
+	core::SocketAddress const &_dst_addr,
+	ShmChannel const &_channel,
+	core::TransportManager<ShmTransport<DelegateType>> &transport_manager
+) : channel(_channel), transport_manager(transport_manager),
+	src_addr(_src_addr), dst_addr(_dst_addr) {
+	auto ring_size = SpscRing::mapping_size(channel.capacity);
+	send_ring = SpscRing((uint8_t *)channel.mapping + channel.send_ring * ring_size, channel.capacity);
+	recv_ring = SpscRing((uint8_t *)channel.mapping + (1 - channel.send_ring) * ring_size, channel.capacity);
+
+	auto *loop = uv_default_loop();
+
+	event_poll = new uv_poll_t();
+	uv_poll_init(loop, event_poll, channel.event_fd);
+	event_poll->data = this;
+
+	control_poll = new uv_poll_t();
+	uv_poll_init_socket(loop, control_poll, channel.control_fd);
+	control_poll->data = this;
+
+	flush_handle = new uv_prepare_t();
+	uv_prepare_init(loop, flush_handle);
+	flush_handle->data = this;
+}
+
+template<typename DelegateType>
+void ShmTransport<DelegateType>::signal(int fd) {
+	uint64_t one = 1;
+	// Fails only if the counter is about to overflow, the peer has a wakeup pending then anyway
+	(void)!::write(fd, &one, sizeof(one));
+}
+
+//! callback on the peer signalling data or space
+template<typename DelegateType>
+void ShmTransport<DelegateType>::event_cb(uv_poll_t *handle, int status, int) {
+	thread_local auto &site = LoopStats::loop().site("shm.recv");
+	ProfileScope profile(site);
+
+	auto &transport = *(ShmTransport<DelegateType> *)handle->data;
+
+	if(status < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Event callback error: {}",
+			transport.src_addr.to_string(),
+			status
+		);
+		return;
+	}
+
+	uint64_t count;
+	(void)!::read(transport.channel.event_fd, &count, sizeof(count));
+
+	transport.recv();
+	if(!transport.closing && transport.send_queue.size() > 0) {
+		transport.flush();
+	}
+}
+
+//! callback on the control socket, which only ever becomes readable when the peer goes away
+template<typename DelegateType>
+void ShmTransport<DelegateType>::control_cb(uv_poll_t *handle, int, int) {
+	auto &transport = *(ShmTransport<DelegateType> *)handle->data;
+
+	char byte;
+	auto res = ::recv(transport.channel.control_fd, &byte, 1, MSG_DONTWAIT);
+	if(res < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	}
+
+	// Deliver what the peer wrote before leaving
+	transport.recv();
+	transport.close();
+}
+
+//! reads everything in the receive ring and wakes up the peer if it waits for space
+template<typename DelegateType>
+void ShmTransport<DelegateType>::recv() {
+	// Bounded so a fast peer can't keep the loop here, the rest is read on the next iteration
+	uint64_t budget = 2 * channel.capacity;
+	while(budget > 0 && !closing) {
+		auto res = recv_ring.read([&](uint8_t *bytes, size_t size) {
+			if constexpr (HasDidRecvBytesView<DelegateType, ShmTransport<DelegateType>>::value) {
+				// Parsed in place, straight out of shared memory
+				delegate->did_recv_bytes_view(*this, core::WeakBuffer(bytes, size));
+			} else {
+				core::Buffer buffer(size);
+				std::memcpy(buffer.data(), bytes, size);
+				did_recv_bytes(std::move(buffer));
+			}
+		});
+
+		if(res < 0) {
+			SPDLOG_ERROR(
+				"Asyncio: Shm {}: Corrupt ring, From: {}",
+				src_addr.to_string(),
+				dst_addr.to_string()
+			);
+			close();
+			return;
+		}
+		if(res == 0) {
+			break;
+		}
+		budget -= std::min<uint64_t>(budget, res);
+	}
+
+	if(budget == 0) {
+		signal(channel.event_fd);
+	}
+
+	if(recv_ring.take_waiting_producer()) {
+		signal(channel.peer_event_fd);
+	}
+}
+
+//! sets up the delegate when building an application or Higher Order Transport (Transport) over this transport
+/*!
+	\param delegate a DelegateType pointer to the application class instance which uses this transport
+*/
+template<typename DelegateType>
+void ShmTransport<DelegateType>::setup(DelegateType *delegate) {
+	this->delegate = delegate;
+
+	// Anything written before setup has signalled the eventfd already
+	uv_poll_start(event_poll, UV_READABLE, event_cb);
+	uv_poll_start(control_poll, UV_READABLE | UV_DISCONNECT, control_cb);
+}
+
+//! sends the incoming bytes to the application/HOT delegate
+template<typename DelegateType>
+void ShmTransport<DelegateType>::did_recv_bytes(core::Buffer &&bytes) {
+	if constexpr (HasDidRecvBytesView<DelegateType, ShmTransport<DelegateType>>::value) {
+		delegate->did_recv_bytes_view(*this, core::WeakBuffer(bytes.data(), bytes.size()));
+	} else {
+		delegate->did_recv_bytes(*this, std::move(bytes));
+	}
+}
+
+template<typename DelegateType>
+void ShmTransport<DelegateType>::close_cb(uv_handle_t *handle) {
+	auto &transport = *(ShmTransport<DelegateType> *)handle->data;
+
+	munmap(transport.channel.mapping, transport.channel.mapping_size);
+	::close(transport.channel.control_fd);
+	::close(transport.channel.event_fd);
+	::close(transport.channel.peer_event_fd);
+
+	transport.delegate->did_close(transport, transport.close_reason);
+	transport.transport_manager.erase(transport.dst_addr);
+	delete (uv_poll_t *)handle;
+}
+
+template<typename DelegateType>
+void ShmTransport<DelegateType>::flush_cb(uv_prepare_t *handle) {
+	((ShmTransport<DelegateType> *)handle->data)->flush();
+}
+
+//! copies queued buffers into the send ring and wakes up the peer once if it may be idle
+/*!
+	If the ring fills up, the rest waits for the peer to signal space
+*/
+template<typename DelegateType>
+void ShmTransport<DelegateType>::flush() {
+	uv_prepare_stop(flush_handle);
+
+	auto position = send_ring.write_position();
+
+	std::vector<core::Buffer> sent;
+	while(send_queue.size() > 0) {
+		auto &bytes = send_queue.front();
+		send_offset += send_ring.write(bytes.data() + send_offset, bytes.size() - send_offset);
+
+		if(send_offset == bytes.size()) {
+			send_offset = 0;
+			sent.push_back(std::move(bytes));
+			send_queue.pop_front();
+		} else if(!send_ring.wait_for_space()) {
+			break;
+		}
+	}
+
+	if(send_ring.write_position() != position && send_ring.was_drained(position)) {
+		signal(channel.peer_event_fd);
+	}
+
+	for(auto &bytes : sent) {
+		delegate->did_send_bytes(*this, std::move(bytes));
+	}
+}
+
+//! called by higher level to send data
+/*!
+	Buffers are queued and copied into the ring together once per event loop iteration
+
+	\param bytes Marlin::core::Buffer type of packet
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType>
+int ShmTransport<DelegateType>::send(core::Buffer &&bytes) {
+	if(closing) {
+		return UV_EPIPE;
+	}
+
+	send_queue.push_back(std::move(bytes));
+	if(send_queue.size() == 1) {
+		uv_prepare_start(flush_handle, flush_cb);
+	}
+
+	return 0;
+}
+
+//! closes the connection after copying whatever fits of queued data. calls the close callback which erases self entry from the transport manager, which in turn destroys this instance
+template<typename DelegateType>
+void ShmTransport<DelegateType>::close(uint16_t reason) {
+	if(closing) {
+		return;
+	}
+
+	flush();
+
+	closing = true;
+	close_reason = reason;
+
+	// Peer sees the control socket close and reads out what is left in the ring
+	shutdown(channel.control_fd, SHUT_RDWR);
+	uv_close((uv_handle_t *)flush_handle, [](uv_handle_t *handle) {
+		delete (uv_prepare_t *)handle;
+	});
+	uv_close((uv_handle_t *)event_poll, [](uv_handle_t *handle) {
+		delete (uv_poll_t *)handle;
+	});
+	uv_close((uv_handle_t *)control_poll, close_cb);
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_SHMTRANSPORT_HPP
@@ -0,0 +1,489 @@
+/*! \file ShmTransportFactory.hpp
+	\brief Factory class to create and manage instances of marlin ShmTransport connections
+
+	Same interface as TcpTransportFactory, so it can be swapped in for peers on the same host.
+	Connections are set up over unix seqpacket sockets named after the addresses, see UnixSocket.hpp:
+	\li the dialer creates the shared memory and both eventfds and passes them over the socket
+	\li the listener maps the memory, after which bytes only go through the rings
+*/
+
+#ifndef MARLIN_ASYNCIO_SHMTRANSPORTFACTORY_HPP
+#define MARLIN_ASYNCIO_SHMTRANSPORTFACTORY_HPP
+
+#include <uv.h>
+#include "marlin/core/Buffer.hpp"
+#include "marlin/core/SocketAddress.hpp"
+#include "marlin/asyncio/unix/UnixSocket.hpp"
+#include "ShmTransport.hpp"
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace marlin {
+namespace asyncio {
+
+//! factory class to create instances of ShmTransport connections by either explicitly dialling or listening to incoming requests
+/*!
+	\li client mode: dial() method, connects immediately
+	\li server mode: listen(), accept_cb(), handshake_cb() methods
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+class ShmTransportFactory {
+private:
+	int fd = -1;
+	uv_poll_t *poll = nullptr;
+	core::TransportManager<ShmTransport<TransportDelegate>> transport_manager;
+
+	static void close_cb(uv_handle_t *handle);
+	static void accept_cb(uv_poll_t *handle, int status, int events);
+	static void handshake_cb(uv_poll_t *handle, int status, int events);
+
+	struct ConnPayload {
+		ShmTransportFactory<ListenDelegate, TransportDelegate> *factory;
+		ListenDelegate *delegate;
+	};
+
+	//! Accepted connection waiting for the shared memory of the dialer
+	struct HandshakePayload {
+		ShmTransportFactory<ListenDelegate, TransportDelegate> *factory;
+		ListenDelegate *delegate;
+		int fd;
+	};
+	std::vector<uv_poll_t *> handshakes;
+
+	void end_handshake(uv_poll_t *handle, bool close_fd);
+	int create_channel(int fd, ShmChannel &channel, int &memfd);
+public:
+	core::SocketAddress addr;
+
+	ShmTransportFactory() = default;
+	~ShmTransportFactory();
+
+	ShmTransportFactory(ShmTransportFactory const&) = delete;
+
+	int bind(core::SocketAddress const &addr);
+	int listen(ListenDelegate &delegate);
+	int dial(core::SocketAddress const &addr, ListenDelegate &delegate);
+	ShmTransport<TransportDelegate> *get_transport(
+		core::SocketAddress const &addr
+	);
+};
+
+
+// Impl
+
+template<typename ListenDelegate, typename TransportDelegate>
+void
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+close_cb(uv_handle_t *handle) {
+	delete static_cast<
+		ConnPayload *
+	>(handle->data);
+	delete (uv_poll_t *)handle;
+}
+
+//! Destructor, closes the socket and drops connections still in their handshake
+template<typename ListenDelegate, typename TransportDelegate>
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+~ShmTransportFactory() {
+	while(handshakes.size() > 0) {
+		end_handshake(handshakes.back(), true);
+	}
+
+	if(fd < 0) {
+		return;
+	}
+
+	sockaddr_un name;
+	unix_socket_name(name, "shm", addr);
+	unix_socket_unlink(name);
+
+	// Closing stops polling right away, the socket can go before the close callback
+	uv_close(
+		(uv_handle_t *)poll,
+		close_cb
+	);
+	::close(fd);
+}
+
+//! binds the socket to the name of the given address
+/*!
+	/param addr address to bind the socket to, port 0 picks a free one
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+bind(core::SocketAddress const &addr) {
+	this->addr = addr;
+
+	int fd = unix_socket_open(SOCK_SEQPACKET);
+	if (fd < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Socket error: {}",
+			this->addr.to_string(),
+			fd
+		);
+		return fd;
+	}
+
+	int res = unix_socket_bind(fd, "shm", this->addr);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Bind error: {}",
+			this->addr.to_string(),
+			res
+		);
+		::close(fd);
+		return res;
+	}
+
+	poll = new uv_poll_t();
+	uv_poll_init_socket(uv_default_loop(), poll, fd);
+	poll->data = nullptr;
+
+	this->fd = fd;
+
+	return 0;
+}
+
+//! callback on incoming connection requests, waits for the handshake of each
+template<typename ListenDelegate, typename TransportDelegate>
+void
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+accept_cb(uv_poll_t *handle, int status, int) {
+	auto payload = static_cast<
+		ConnPayload *
+	>(handle->data);
+
+	auto &factory = *(payload->factory);
+
+	if (status < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Connection callback error: {}",
+			factory.addr.to_string(),
+			status
+		);
+
+		return;
+	}
+
+	while(true) {
+		int fd = ::accept(factory.fd, nullptr, nullptr);
+		if(fd < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				SPDLOG_ERROR(
+					"Asyncio: Shm {}: Connection accept error: {}",
+					factory.addr.to_string(),
+					-errno
+				);
+			}
+			return;
+		}
+
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		// Dialer sends the handshake right after connecting, it is usually here already
+		auto *handshake = new uv_poll_t();
+		uv_poll_init_socket(uv_default_loop(), handshake, fd);
+		handshake->data = new HandshakePayload {
+			&factory,
+			payload->delegate,
+			fd
+		};
+		factory.handshakes.push_back(handshake);
+		uv_poll_start(handshake, UV_READABLE, handshake_cb);
+	}
+}
+
+//! stops waiting for a handshake, keeping the socket open if a transport took it over
+template<typename ListenDelegate, typename TransportDelegate>
+void
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+end_handshake(uv_poll_t *handle, bool close_fd) {
+	auto *payload = (HandshakePayload *)handle->data;
+
+	handshakes.erase(std::find(handshakes.begin(), handshakes.end(), handle));
+
+	uv_close((uv_handle_t *)handle, [](uv_handle_t *handle) {
+		delete (HandshakePayload *)handle->data;
+		delete (uv_poll_t *)handle;
+	});
+	if(close_fd) {
+		::close(payload->fd);
+	}
+}
+
+//! callback on the handshake of an accepted connection
+/*!
+	\li receives the capacity of the rings along with the shared memory and eventfds
+	\li creates a ShmTransport instance named after the address the peer dialed from
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+void
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+handshake_cb(uv_poll_t *handle, int, int) {
+	auto *payload = (HandshakePayload *)handle->data;
+	auto &factory = *(payload->factory);
+	auto &delegate = *(payload->delegate);
+	int fd = payload->fd;
+
+	uint64_t capacity = 0;
+	iovec iov = {&capacity, sizeof(capacity)};
+	alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+	msghdr msg = {};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	auto res = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+	if(res < 0 && (errno == EAGAIN || errno == EINTR)) {
+		return;
+	}
+
+	int fds[3] = {-1, -1, -1};
+	auto *cmsg = CMSG_FIRSTHDR(&msg);
+	if(cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+		cmsg->cmsg_len == CMSG_LEN(3 * sizeof(int))) {
+		std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	}
+
+	sockaddr_un name;
+	socklen_t len = sizeof(name);
+	getpeername(fd, reinterpret_cast<sockaddr *>(&name), &len);
+	auto addr = unix_socket_address(name, len, "shm");
+
+	auto mapping_size = 2 * SpscRing::mapping_size(capacity);
+	struct stat st;
+	void *mapping = MAP_FAILED;
+	if(
+		res == sizeof(capacity) && fds[2] >= 0 && addr.has_value() &&
+		SpscRing::is_valid_capacity(capacity) && capacity <= (1ull << 32) &&
+		fstat(fds[0], &st) == 0 && (uint64_t)st.st_size >= mapping_size
+	) {
+		mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+	}
+	if(fds[0] >= 0) {
+		::close(fds[0]);
+	}
+
+	if(mapping == MAP_FAILED) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Handshake error",
+			factory.addr.to_string()
+		);
+		for(int i = 1; i < 3; i++) {
+			if(fds[i] >= 0) {
+				::close(fds[i]);
+			}
+		}
+		factory.end_handshake(handle, true);
+		return;
+	}
+
+	factory.end_handshake(handle, false);
+
+	ShmChannel channel = {mapping, mapping_size, capacity, 1, fd, fds[2], fds[1]};
+	if(!delegate.should_accept(*addr)) {
+		munmap(mapping, mapping_size);
+		for(int fd : {channel.control_fd, channel.event_fd, channel.peer_event_fd}) {
+			::close(fd);
+		}
+		return;
+	}
+
+	auto [transport, created] = factory.transport_manager.get_or_create(
+		*addr,
+		factory.addr,
+		*addr,
+		channel,
+		factory.transport_manager
+	);
+	if(!created) {
+		// Peer already has a connection to us
+		munmap(mapping, mapping_size);
+		for(int fd : {channel.control_fd, channel.event_fd, channel.peer_event_fd}) {
+			::close(fd);
+		}
+		return;
+	}
+
+	delegate.did_create_transport(*transport);
+}
+
+//! starts listening for incoming connection requests on the socket
+template<typename ListenDelegate, typename TransportDelegate>
+int
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+listen(ListenDelegate &delegate) {
+	if(poll == nullptr) {
+		return UV_EBADF;
+	}
+
+	delete static_cast<
+		ConnPayload *
+	>(poll->data);
+	poll->data = new ConnPayload {
+		this,
+		&delegate
+	};
+
+	int res = ::listen(fd, 100);
+	if (res == 0) {
+		res = uv_poll_start(poll, UV_READABLE, accept_cb);
+	} else {
+		res = -errno;
+	}
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Listen error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	return 0;
+}
+
+//! creates the shared memory and eventfds of a connection dialed over the given socket
+/*!
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+create_channel(int fd, ShmChannel &channel, int &memfd) {
+	channel = {MAP_FAILED, 2 * SpscRing::mapping_size(DEFAULT_SHM_RING_SIZE), DEFAULT_SHM_RING_SIZE, 0, fd, -1, -1};
+
+	memfd = memfd_create("marlin-shm", MFD_CLOEXEC);
+	if(memfd < 0 || ftruncate(memfd, channel.mapping_size) < 0) {
+		return -errno;
+	}
+
+	channel.mapping = mmap(nullptr, channel.mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if(channel.mapping == MAP_FAILED) {
+		return -errno;
+	}
+	SpscRing::init(channel.mapping);
+	SpscRing::init((uint8_t *)channel.mapping + SpscRing::mapping_size(DEFAULT_SHM_RING_SIZE));
+
+	channel.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	channel.peer_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(channel.event_fd < 0 || channel.peer_event_fd < 0) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+//! client mode function that connects to the socket bound to the given address and hands it the shared memory
+/*!
+	unix sockets connect without a round trip, so unlike tcp the transport is created and dialed before returning
+
+	/param addr address to dial to
+	/delegate the listen delegate object
+	/return 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+dial(core::SocketAddress const &addr, ListenDelegate &delegate) {
+	auto *transport = transport_manager.get(addr);
+	if(transport != nullptr) {
+		transport->delegate->did_dial(*transport);
+		return 0;
+	}
+
+	int fd = unix_socket_connect(SOCK_SEQPACKET, "shm", this->addr, addr);
+	if (fd < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Connect error: {}",
+			this->addr.to_string(),
+			fd
+		);
+		return fd;
+	}
+
+	ShmChannel channel;
+	int memfd;
+	int res = create_channel(fd, channel, memfd);
+	if (res == 0) {
+		uint64_t capacity = channel.capacity;
+		iovec iov = {&capacity, sizeof(capacity)};
+		alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))] = {};
+		msghdr msg = {};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		auto *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+		// Listener waits on the second eventfd and signals the first
+		int fds[3] = {memfd, channel.event_fd, channel.peer_event_fd};
+		std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+		if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+			res = -errno;
+		}
+	}
+
+	if (memfd >= 0) {
+		::close(memfd);
+	}
+
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Shm {}: Handshake error: {}",
+			this->addr.to_string(),
+			res
+		);
+		if (channel.mapping != MAP_FAILED) {
+			munmap(channel.mapping, channel.mapping_size);
+		}
+		for(int fd : {channel.control_fd, channel.event_fd, channel.peer_event_fd}) {
+			if(fd >= 0) {
+				::close(fd);
+			}
+		}
+		return res;
+	}
+
+	transport = transport_manager.get_or_create(
+		addr,
+		this->addr,
+		addr,
+		channel,
+		transport_manager
+	).first;
+
+	delegate.did_create_transport(*transport);
+	transport->delegate->did_dial(*transport);
+
+	return 0;
+}
+
+template<typename ListenDelegate, typename TransportDelegate>
+ShmTransport<TransportDelegate> *
+ShmTransportFactory<ListenDelegate, TransportDelegate>::
+get_transport(
+	core::SocketAddress const &addr
+) {
+	return transport_manager.get(addr);
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_SHMTRANSPORTFACTORY_HPP
@@ -0,0 +1,178 @@
+/*! \file SpscRing.hpp
+	\brief Single producer single consumer byte ring in memory shared between two processes
+*/
+
+#ifndef MARLIN_ASYNCIO_SPSCRING_HPP
+#define MARLIN_ASYNCIO_SPSCRING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+namespace marlin {
+namespace asyncio {
+
+//! Positions of a ring, at the start of its shared memory
+/*!
+	Each position is written by one side only and sits on its own cache line,
+	so the two sides never contend on a line they both write.
+*/
+struct SpscRingHeader {
+	//! Total bytes written, only written by the producer
+	alignas(64) std::atomic<uint64_t> head;
+	//! Total bytes read, only written by the consumer
+	alignas(64) std::atomic<uint64_t> tail;
+	//! Set by the producer when it ran out of space and needs a wakeup once the consumer frees some
+	alignas(64) std::atomic<uint32_t> producer_waiting;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory rings need lock free atomics");
+
+//! Byte ring with one producer and one consumer, possibly in different processes
+/*!
+	\li carries a byte stream, writes can be partial and reads see whatever has been written
+	\li lock free, the only synchronization is on the head and tail positions
+	\li the ring does not wake anyone up, it tells each side when the other needs a wakeup
+
+	Wakeup protocol:
+	\li producer: after writing, was_drained(position before writing) says if the consumer may be idle
+	\li consumer: after reading, take_waiting_producer() says if the producer is waiting for space
+*/
+class SpscRing {
+private:
+	SpscRingHeader *header = nullptr;
+	uint8_t *data = nullptr;
+	uint64_t capacity = 0;
+
+	//! Last seen tail on the producer side, saves reading the consumer cache line on every write
+	uint64_t cached_tail = 0;
+public:
+	SpscRing() = default;
+	SpscRing(void *memory, uint64_t capacity) :
+		header((SpscRingHeader *)memory),
+		data((uint8_t *)memory + sizeof(SpscRingHeader)),
+		capacity(capacity),
+		cached_tail(header->tail.load(std::memory_order_acquire)) {}
+
+	//! size of the shared memory needed for a ring of the given capacity
+	static constexpr size_t mapping_size(uint64_t capacity) {
+		return sizeof(SpscRingHeader) + capacity;
+	}
+
+	//! is the capacity usable for a ring, it has to be a power of two for cheap wraparound
+	static constexpr bool is_valid_capacity(uint64_t capacity) {
+		return capacity >= 64 && (capacity & (capacity - 1)) == 0;
+	}
+
+	//! initializes an empty ring in fresh shared memory, done by one side before handing it over
+	static void init(void *memory) {
+		new (memory) SpscRingHeader{{0}, {0}, {0}};
+	}
+
+	//! position of the producer, pass to was_drained after writing
+	uint64_t write_position() const {
+		return header->head.load(std::memory_order_relaxed);
+	}
+
+	//! copies as many bytes as fit and makes them visible to the consumer
+	/*!
+		/return number of bytes written, less than size if the ring is full
+	*/
+	size_t write(uint8_t const *bytes, size_t size) {
+		auto head = header->head.load(std::memory_order_relaxed);
+		if(capacity - (head - cached_tail) < size) {
+			cached_tail = header->tail.load(std::memory_order_acquire);
+		}
+
+		// Corrupt positions look like a full ring
+		if(head - cached_tail > capacity) {
+			return 0;
+		}
+
+		size_t count = std::min<uint64_t>(size, capacity - (head - cached_tail));
+		if(count == 0) {
+			return 0;
+		}
+
+		size_t offset = head & (capacity - 1);
+		size_t first = std::min<size_t>(count, capacity - offset);
+		std::memcpy(data + offset, bytes, first);
+		std::memcpy(data, bytes + first, count - first);
+
+		header->head.store(head + count, std::memory_order_release);
+
+		return count;
+	}
+
+	//! did the consumer read everything up to the given position, in which case it may be waiting for a wakeup
+	bool was_drained(uint64_t position) {
+		// Pairs with the fence in read, one of the two sides sees the position the other stored
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		cached_tail = header->tail.load(std::memory_order_acquire);
+		return cached_tail == position;
+	}
+
+	//! asks the consumer for a wakeup once it frees space
+	/*!
+		/return true if space was freed in the meantime and the write can be retried right away
+	*/
+	bool wait_for_space() {
+		header->producer_waiting.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		cached_tail = header->tail.load(std::memory_order_acquire);
+		return header->head.load(std::memory_order_relaxed) - cached_tail < capacity;
+	}
+
+	//! hands the readable bytes to the given function in at most two contiguous chunks and frees them
+	/*!
+		Bytes are only valid during the call, the producer can overwrite them right after.
+
+		/return number of bytes read, or a negative number if the positions are corrupt
+	*/
+	template<typename F>
+	int64_t read(F &&f) {
+		auto tail = header->tail.load(std::memory_order_relaxed);
+		auto head = header->head.load(std::memory_order_acquire);
+
+		// Other side is not trusted to keep the positions sane
+		if(head - tail > capacity) {
+			return -1;
+		}
+		if(head == tail) {
+			return 0;
+		}
+
+		size_t count = head - tail;
+		size_t offset = tail & (capacity - 1);
+		size_t first = std::min<size_t>(count, capacity - offset);
+		f(data + offset, first);
+		if(count > first) {
+			f(data, count - first);
+		}
+
+		header->tail.store(head, std::memory_order_release);
+		// Pairs with the fence in was_drained and wait_for_space
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		return count;
+	}
+
+	//! clears the wakeup request of the producer
+	/*!
+		/return true if the producer was waiting for space and needs a wakeup
+	*/
+	bool take_waiting_producer() {
+		if(header->producer_waiting.load(std::memory_order_relaxed) == 0) {
+			return false;
+		}
+
+		return header->producer_waiting.exchange(0, std::memory_order_relaxed) != 0;
+	}
+};
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_SPSCRING_HPP
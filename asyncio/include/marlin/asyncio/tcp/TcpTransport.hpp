@@ -1,27 +1,224 @@
 /*! \file UdpTransport.hpp
 	\brief Marlin TCP Transport connection implementation
+
+	The transport is written against libuv streams, UnixTransport is the same template over unix stream sockets
 */
 
 
 #ifndef MARLIN_ASYNCIO_TCPTRANSPORT_HPP
 #define MARLIN_ASYNCIO_TCPTRANSPORT_HPP
 
+#include "marlin/core/Buffer.hpp"
 #include "marlin/core/SocketAddress.hpp"
 #include "marlin/core/TransportManager.hpp"
+#include "marlin/asyncio/core/LoopStats.hpp"
 #include <uv.h>
 #include <spdlog/spdlog.h>
 
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__) && defined(SO_ZEROCOPY)
+#include <linux/errqueue.h>
+#define MARLIN_ASYNCIO_TCP_ZEROCOPY
+#endif
+
 namespace marlin {
 namespace asyncio {
 
-//! Wrapper transport class around libuv tcp functionality
-template<typename DelegateType>
-class TcpTransport {
+//! Max bytes gathered into one write
+#define DEFAULT_TCP_WRITE_BATCH_BYTES 262144
+//! Max buffers gathered into one write
+#define DEFAULT_TCP_WRITE_BATCH_BUFFERS 64
+//! Size of the read buffer shared by all tcp connections on a thread
+#define DEFAULT_TCP_READ_BUFFER_SIZE 65536
+//! Reads at least this large take over the shared read buffer instead of being copied out
+#define DEFAULT_TCP_READ_HANDOFF_SIZE 16384
+//! Buffers at least this large are sent zero copy if enabled, smaller ones are cheaper to copy
+#define DEFAULT_TCP_ZEROCOPY_THRESHOLD 65536
+//! Interval in ms to poll for zero copy completions of closed connections
+#define DEFAULT_TCP_ZEROCOPY_DRAIN_INTERVAL 10
+//! Time in ms after which a closed connection still waiting on zero copy completions is reset
+#define DEFAULT_TCP_ZEROCOPY_DRAIN_TIMEOUT 10000
+
+//! Detects if the delegate parses reads in place from a view valid only during the call
+template<typename DelegateType, typename TransportType, typename = void>
+struct HasDidRecvBytesView : std::false_type {};
+
+template<typename DelegateType, typename TransportType>
+struct HasDidRecvBytesView<DelegateType, TransportType, std::void_t<decltype(
+	std::declval<DelegateType&>().did_recv_bytes_view(std::declval<TransportType&>(), std::declval<core::WeakBuffer>())
+)>> : std::true_type {};
+
+//! Read buffer shared by all tcp and unix stream connections on the thread
+/*!
+	libuv reads into it and runs the read callback before allocating for the next read,
+	so connections never hold it across reads unless a large read takes it over.
+	Idle connections hold no read memory.
+*/
+inline std::unique_ptr<uint8_t[]> &tcp_read_buffer() {
+	thread_local std::unique_ptr<uint8_t[]> buffer;
+	return buffer;
+}
+
+//! reads zero copy completions off the error queue of the socket
+/*!
+	\param done_seq advanced past the last completed send
+	\return true if the kernel reported it had to copy
+*/
+inline bool read_zerocopy_completions(int fd, uint32_t &done_seq) {
+	bool copied = false;
+#ifdef MARLIN_ASYNCIO_TCP_ZEROCOPY
+	while(true) {
+		char control[128];
+		msghdr msg = {};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			break;
+		}
+
+		for(auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if(!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+				!(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)
+			) {
+				continue;
+			}
+
+			sock_extended_err err;
+			std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+			if(err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+
+			if(err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				copied = true;
+			}
+
+			// Completions cover the range [ee_info, ee_data] and arrive in order on tcp
+			if((int32_t)(err.ee_data + 1 - done_seq) > 0) {
+				done_seq = err.ee_data + 1;
+			}
+		}
+	}
+#endif
+	return copied;
+}
+
+//! Zero copy buffers of a closed tcp connection, freed once the kernel is done with them
+/*!
+	Holds a duplicate of the socket since completions can only be read off the socket,
+	which also keeps the connection open until the last completion, so the write side is shut down instead.
+	Frees itself along with the buffers and the duplicate once every send has completed.
+	A peer which stops acking would hold the pages until tcp gives up, so past a deadline the connection
+	is reset instead, the kernel drops the unacked sends and the buffers are freed right away.
+*/
+class TcpZeroCopyDrain {
+	uv_timer_t timer;
+	int fd;
+	std::vector<core::Buffer> buffers;
+	uint32_t done_seq;
+	uint32_t end_seq;
+	uint64_t deadline;
+
+	TcpZeroCopyDrain(int fd, std::vector<core::Buffer> &&buffers, uint32_t done_seq, uint32_t end_seq, uint64_t deadline) :
+		fd(fd), buffers(std::move(buffers)), done_seq(done_seq), end_seq(end_seq), deadline(deadline) {}
+
+	static void timer_cb(uv_timer_t *handle) {
+		auto *drain = (TcpZeroCopyDrain *)handle->data;
+		read_zerocopy_completions(drain->fd, drain->done_seq);
+		if((int32_t)(drain->end_seq - drain->done_seq) > 0) {
+			if(uv_now(handle->loop) < drain->deadline) {
+				return;
+			}
+
+			SPDLOG_WARN(
+				"Asyncio: Zero copy drain: {} sends incomplete after timeout, resetting connection",
+				drain->end_seq - drain->done_seq
+			);
+
+			// Closing with a zero linger time sends a RST and discards the send queue
+			linger abort = {1, 0};
+			setsockopt(drain->fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+		}
+
+		::close(drain->fd);
+		uv_close((uv_handle_t *)handle, [](uv_handle_t *handle) {
+			delete (TcpZeroCopyDrain *)handle->data;
+		});
+	}
+public:
+	//! takes over the duplicate socket and buffers of sends up to end_seq, those before done_seq are complete
+	/*!
+		\param timeout_ms reset the connection if sends are still incomplete after this long
+	*/
+	static void start(
+		uv_loop_t *loop,
+		int fd,
+		std::vector<core::Buffer> &&buffers,
+		uint32_t done_seq,
+		uint32_t end_seq,
+		uint64_t timeout_ms = DEFAULT_TCP_ZEROCOPY_DRAIN_TIMEOUT
+	) {
+		shutdown(fd, SHUT_WR);
+
+		auto *drain = new TcpZeroCopyDrain(fd, std::move(buffers), done_seq, end_seq, uv_now(loop) + timeout_ms);
+		uv_timer_init(loop, &drain->timer);
+		drain->timer.data = drain;
+		uv_timer_start(&drain->timer, timer_cb, 0, DEFAULT_TCP_ZEROCOPY_DRAIN_INTERVAL);
+	}
+};
+
+//! What the stream transport and factory need to know about a libuv stream handle type
+/*!
+	\li name, prefix of log lines
+	\li recv_site, LoopStats site of the read callback
+	\li init(), initializes a handle for an accepted connection
+	\li peer_address(), address the transport to an accepted connection is keyed by
+*/
+template<typename HandleType>
+struct UvStreamTraits;
+
+template<>
+struct UvStreamTraits<uv_tcp_t> {
+	static constexpr char const *name = "Socket";
+	static constexpr char const *recv_site = "tcp.recv";
+
+	static int init(uv_loop_t *loop, uv_tcp_t *handle) {
+		return uv_tcp_init(loop, handle);
+	}
+
+	static std::optional<core::SocketAddress> peer_address(uv_tcp_t *handle) {
+		core::SocketAddress addr;
+		int len = sizeof(addr);
+		if(uv_tcp_getpeername(handle, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+			return std::nullopt;
+		}
+		return addr;
+	}
+};
+
+//! Wrapper transport class around libuv stream functionality, see TcpTransport and UnixTransport
+/*!
+	Queued sends are gathered into pooled writes once per loop iteration and
+	reads land in the read buffer shared by all connections on the thread.
+*/
+template<typename DelegateType, typename HandleType>
+class UvStreamTransport {
 private:
-	uv_tcp_t *socket;
-	core::TransportManager<TcpTransport<DelegateType>> &transport_manager;
+	HandleType *socket;
+	core::TransportManager<UvStreamTransport<DelegateType, HandleType>> &transport_manager;
 
-	static void naive_alloc_cb(
+	static void read_alloc_cb(
 		uv_handle_t *,
 		size_t suggested_size,
 		uv_buf_t *buf
@@ -40,28 +237,73 @@ private:
 
 	static void close_cb(uv_handle_t *handle);
 
-	struct SendPayload {
+	static void flush_cb(uv_prepare_t *handle);
+
+	//! Buffer sent zero copy, owned until the kernel releases its pages
+	struct ZeroCopySend {
 		core::Buffer bytes;
-		TcpTransport<DelegateType> &transport;
+		//! Sequence number of the last zero copy send covering the buffer
+		uint32_t seq;
+		//! Rest of the buffer is being written through libuv
+		bool writing;
+	};
+
+	//! Pooled write of several queued buffers
+	struct WriteRequest {
+		uv_write_t req;
+		UvStreamTransport<DelegateType, HandleType> *transport;
+		std::vector<core::Buffer> buffers;
+		std::vector<uv_buf_t> bufs;
+		//! Set when writing the rest of a buffer partly sent zero copy
+		ZeroCopySend *zerocopy = nullptr;
 	};
+	std::vector<std::unique_ptr<WriteRequest>> free_requests;
+
+	//! Zero copy sends waiting for completion, in order
+	std::deque<ZeroCopySend> zerocopy_sends;
+	bool zerocopy_enabled = false;
+	//! Sequence number of the next zero copy send
+	uint32_t zerocopy_next_seq = 0;
+	//! Sends before this sequence number are complete
+	uint32_t zerocopy_done_seq = 0;
+	//! Duplicate of the socket taken on close while zero copy sends are pending, -1 if none
+	int zerocopy_fd = -1;
+
+	bool send_zerocopy();
+	void recv_zerocopy_completions();
+	void release_zerocopy_sends();
+
+	//! Buffers waiting for the next flush, in order
+	std::deque<core::Buffer> send_queue;
+	//! Bytes of the front buffer already written by the fast path
+	size_t send_offset = 0;
+	//! Flushes the send queue once per loop iteration, active while the queue is not empty
+	uv_prepare_t *flush_handle;
+	bool closing = false;
+
+	WriteRequest *acquire_request();
+	void release_request(WriteRequest *request);
+	void flush();
+	void write_queued();
 public:
 	core::SocketAddress src_addr;
 	core::SocketAddress dst_addr;
 
 	DelegateType *delegate;
 
-	TcpTransport(
+	UvStreamTransport(
 		core::SocketAddress const &src_addr,
 		core::SocketAddress const &dst_addr,
-		uv_tcp_t *socket,
-		core::TransportManager<TcpTransport<DelegateType>> &transport_manager
+		HandleType *socket,
+		core::TransportManager<UvStreamTransport<DelegateType, HandleType>> &transport_manager
 	);
 
-	TcpTransport(TcpTransport const&) = delete;
+	UvStreamTransport(UvStreamTransport const&) = delete;
 
 	void setup(DelegateType *delegate);
 	void did_recv_bytes(core::Buffer &&bytes);
 	int send(core::Buffer &&bytes);
+	int enable_zerocopy();
 	uint16_t close_reason = 0;
 	void close(uint16_t reason = 0);
 };
@@ -69,82 +311,106 @@ public:
 
 // Impl
 
-template<typename DelegateType>
-TcpTransport<DelegateType>::TcpTransport(
+template<typename DelegateType, typename HandleType>
+UvStreamTransport<DelegateType, HandleType>::UvStreamTransport(
 	core::SocketAddress const &_src_addr,
 	core::SocketAddress const &_dst_addr,
-	uv_tcp_t *_socket,
-	core::TransportManager<TcpTransport<DelegateType>> &transport_manager
+	HandleType *_socket,
+	core::TransportManager<UvStreamTransport<DelegateType, HandleType>> &transport_manager
 ) : socket(_socket), transport_manager(transport_manager),
-	src_addr(_src_addr), dst_addr(_dst_addr) {}
+	src_addr(_src_addr), dst_addr(_dst_addr) {
+	flush_handle = new uv_prepare_t();
+	uv_prepare_init(socket->loop, flush_handle);
+	flush_handle->data = this;
+}
 
-template<typename DelegateType>
-void TcpTransport<DelegateType>::naive_alloc_cb(
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::read_alloc_cb(
 	uv_handle_t *,
-	size_t suggested_size,
+	size_t,
 	uv_buf_t *buf
 ) {
-	buf->base = new char[suggested_size];
-	buf->len = suggested_size;
+	auto &buffer = tcp_read_buffer();
+	if(!buffer) {
+		buffer.reset(new uint8_t[DEFAULT_TCP_READ_BUFFER_SIZE]);
+	}
+
+	buf->base = (char *)buffer.get();
+	buf->len = DEFAULT_TCP_READ_BUFFER_SIZE;
 }
 
 //! callback function on receipt of any message on this TCP connection instance
-template<typename DelegateType>
-void TcpTransport<DelegateType>::recv_cb(
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::recv_cb(
 	uv_stream_t *handle,
 	ssize_t nread,
 	uv_buf_t const *buf
 ) {
-	auto transport = (TcpTransport<DelegateType> *)handle->data;
+	thread_local auto &site = LoopStats::loop().site(UvStreamTraits<HandleType>::recv_site);
+	ProfileScope profile(site);
+
+	auto transport = (UvStreamTransport<DelegateType, HandleType> *)handle->data;
+
+	// Completions are signalled as socket errors, libuv reports them as empty reads
+	if(transport->zerocopy_sends.size() > 0) {
+		transport->recv_zerocopy_completions();
+	}
 
 	// EOF
-	if(nread == -4095) {
+	if(nread == UV_EOF) {
 		transport->close();
-		delete[] buf->base;
 		return;
 	}
 
 	// Error
 	if(nread < 0) {
-		sockaddr saddr;
-		int len = sizeof(sockaddr);
-
-		uv_tcp_getsockname((uv_tcp_t *)handle, &saddr, &len);
-
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Recv callback error: {}",
-			reinterpret_cast<core::SocketAddress const *>(&saddr)->to_string(),
+			"Asyncio: {} {}: Recv callback error: {}",
+			UvStreamTraits<HandleType>::name,
+			transport->src_addr.to_string(),
 			nread
 		);
 
-		delete[] buf->base;
 		return;
 	}
 
 	if(nread == 0) {
-		delete[] buf->base;
 		return;
 	}
 
-	transport->did_recv_bytes(
-		core::Buffer((uint8_t*)buf->base, nread)
-	);
+	if constexpr (HasDidRecvBytesView<DelegateType, UvStreamTransport<DelegateType, HandleType>>::value) {
+		// Parsed in place, buffer is reused for the next read
+		transport->delegate->did_recv_bytes_view(
+			*transport,
+			core::WeakBuffer((uint8_t *)buf->base, nread)
+		);
+	} else if(nread >= DEFAULT_TCP_READ_HANDOFF_SIZE) {
+		// Large read, hand the buffer over and allocate another for the next read
+		transport->did_recv_bytes(
+			core::Buffer(tcp_read_buffer().release(), nread)
+		);
+	} else {
+		core::Buffer bytes(nread);
+		std::memcpy(bytes.data(), buf->base, nread);
+		transport->did_recv_bytes(std::move(bytes));
+	}
 }
 
 //! sets up the delegate when building an application or Higher Order Transport (Transport) over this transport
 /*!
 	\param delegate a DelegateType pointer to the application class instance which uses this transport
 */
-template<typename DelegateType>
-void TcpTransport<DelegateType>::setup(DelegateType *delegate) {
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::setup(DelegateType *delegate) {
 	this->delegate = delegate;
 
 	socket->data = this;
-	auto res = uv_read_start((uv_stream_t *)socket, naive_alloc_cb, recv_cb);
+	auto res = uv_read_start((uv_stream_t *)socket, read_alloc_cb, recv_cb);
 
 	if (res < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Read start error: {}",
+			"Asyncio: {} {}: Read start error: {}",
+			UvStreamTraits<HandleType>::name,
 			src_addr.to_string(),
 			res
 		);
@@ -152,83 +418,404 @@ void TcpTransport<DelegateType>::setup(DelegateType *delegate) {
 }
 
 //! sends the incoming bytes to the application/HOT delegate
-template<typename DelegateType>
-void TcpTransport<DelegateType>::did_recv_bytes(core::Buffer &&bytes) {
-	delegate->did_recv_bytes(*this, std::move(bytes));
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::did_recv_bytes(core::Buffer &&bytes) {
+	if constexpr (HasDidRecvBytesView<DelegateType, UvStreamTransport<DelegateType, HandleType>>::value) {
+		delegate->did_recv_bytes_view(*this, core::WeakBuffer(bytes.data(), bytes.size()));
+	} else {
+		delegate->did_recv_bytes(*this, std::move(bytes));
+	}
 }
 
-template<typename DelegateType>
-void TcpTransport<DelegateType>::send_cb(
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::send_cb(
 	uv_write_t *req,
 	int status
 ) {
-	auto *data = (SendPayload *)req->data;
+	auto *request = (WriteRequest *)req->data;
+	auto &transport = *request->transport;
 
 	if(status < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Send callback error: {}",
-			data->transport.dst_addr.to_string(),
+			"Asyncio: {} {}: Send callback error: {}",
+			UvStreamTraits<HandleType>::name,
+			transport.dst_addr.to_string(),
 			status
 		);
 	} else {
-		data->transport.delegate->did_send_bytes(
-			data->transport,
-			std::move(data->bytes)
-		);
+		for(auto &bytes : request->buffers) {
+			transport.delegate->did_send_bytes(
+				transport,
+				std::move(bytes)
+			);
+		}
 	}
 
-	delete data;
-	delete req;
+	if(request->zerocopy != nullptr) {
+		request->zerocopy->writing = false;
+		transport.release_request(request);
+		transport.release_zerocopy_sends();
+		return;
+	}
+
+	transport.release_request(request);
 }
 
-template<typename DelegateType>
-void TcpTransport<DelegateType>::close_cb(uv_handle_t *handle) {
-	auto &transport = *(TcpTransport<DelegateType> *)handle->data;
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::close_cb(uv_handle_t *handle) {
+	auto &transport = *(UvStreamTransport<DelegateType, HandleType> *)handle->data;
+
+	// Cancelled writes have called back by now, the remaining buffers only wait on the kernel
+	if(transport.zerocopy_fd >= 0) {
+		if(transport.zerocopy_sends.size() > 0) {
+			std::vector<core::Buffer> buffers;
+			for(auto &send : transport.zerocopy_sends) {
+				buffers.push_back(std::move(send.bytes));
+			}
+			transport.zerocopy_sends.clear();
+			TcpZeroCopyDrain::start(
+				handle->loop,
+				transport.zerocopy_fd,
+				std::move(buffers),
+				transport.zerocopy_done_seq,
+				transport.zerocopy_next_seq
+			);
+		} else {
+			::close(transport.zerocopy_fd);
+		}
+		transport.zerocopy_fd = -1;
+	}
+
 	transport.delegate->did_close(transport, transport.close_reason);
 	transport.transport_manager.erase(transport.dst_addr);
-	delete handle;
+	delete (HandleType *)handle;
 }
 
-//! called by higher level to send data
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::flush_cb(uv_prepare_t *handle) {
+	((UvStreamTransport<DelegateType, HandleType> *)handle->data)->flush();
+}
+
+template<typename DelegateType, typename HandleType>
+typename UvStreamTransport<DelegateType, HandleType>::WriteRequest *
+UvStreamTransport<DelegateType, HandleType>::acquire_request() {
+	if(free_requests.size() == 0) {
+		auto *request = new WriteRequest();
+		request->req.data = request;
+		request->transport = this;
+		return request;
+	}
+
+	auto *request = free_requests.back().release();
+	free_requests.pop_back();
+	return request;
+}
+
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::release_request(WriteRequest *request) {
+	request->buffers.clear();
+	request->bufs.clear();
+	request->zerocopy = nullptr;
+	free_requests.emplace_back(request);
+}
+
+//! writes out everything queued since the last flush and notifies the delegate of buffers written synchronously
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::flush() {
+	uv_prepare_stop(flush_handle);
+
+	// Fast path, write directly while libuv has nothing queued on the socket
+	std::vector<core::Buffer> sent;
+	while(send_queue.size() > 0 && uv_stream_get_write_queue_size((uv_stream_t *)socket) == 0) {
+		if(zerocopy_enabled && send_queue.front().size() - send_offset >= DEFAULT_TCP_ZEROCOPY_THRESHOLD) {
+			if(send_zerocopy()) {
+				continue;
+			}
+			if(uv_stream_get_write_queue_size((uv_stream_t *)socket) != 0) {
+				break;
+			}
+		}
+
+		uv_buf_t bufs[DEFAULT_TCP_WRITE_BATCH_BUFFERS];
+		unsigned int count = 0;
+		size_t bytes = 0;
+		for(
+			auto iter = send_queue.begin();
+			iter != send_queue.end() && count < DEFAULT_TCP_WRITE_BATCH_BUFFERS && bytes < DEFAULT_TCP_WRITE_BATCH_BYTES;
+			iter++
+		) {
+			size_t offset = count == 0 ? send_offset : 0;
+			bufs[count++] = uv_buf_init((char *)iter->data() + offset, iter->size() - offset);
+			bytes += iter->size() - offset;
+		}
+
+		int res = uv_try_write((uv_stream_t *)socket, bufs, count);
+		if(res <= 0) {
+			// Socket buffer full or error, queued writes take over and report errors
+			break;
+		}
+
+		size_t written = res;
+		while(send_queue.size() > 0 && send_queue.front().size() - send_offset <= written) {
+			written -= send_queue.front().size() - send_offset;
+			send_offset = 0;
+			sent.push_back(std::move(send_queue.front()));
+			send_queue.pop_front();
+		}
+		send_offset += written;
+
+		if((size_t)res < bytes) {
+			break;
+		}
+	}
+
+	write_queued();
+
+	for(auto &bytes : sent) {
+		delegate->did_send_bytes(*this, std::move(bytes));
+	}
+}
+
+//! issues pooled writes for everything in the send queue, each gathering many buffers
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::write_queued() {
+	while(send_queue.size() > 0) {
+		auto *request = acquire_request();
+
+		size_t bytes = 0;
+		while(
+			send_queue.size() > 0 &&
+			request->buffers.size() < DEFAULT_TCP_WRITE_BATCH_BUFFERS &&
+			bytes < DEFAULT_TCP_WRITE_BATCH_BYTES
+		) {
+			bytes += send_queue.front().size();
+			request->buffers.push_back(std::move(send_queue.front()));
+			send_queue.pop_front();
+		}
+		for(auto &buffer : request->buffers) {
+			size_t offset = request->bufs.size() == 0 ? send_offset : 0;
+			request->bufs.push_back(uv_buf_init((char *)buffer.data() + offset, buffer.size() - offset));
+		}
+		send_offset = 0;
+
+		int res = uv_write(
+			&request->req,
+			(uv_stream_t *)socket,
+			request->bufs.data(),
+			request->bufs.size(),
+			send_cb
+		);
+
+		if (res < 0) {
+			SPDLOG_ERROR(
+				"Asyncio: {} {}: Send error: {}, To: {}",
+				UvStreamTraits<HandleType>::name,
+				src_addr.to_string(),
+				res,
+				dst_addr.to_string()
+			);
+			release_request(request);
+			send_queue.clear();
+			return;
+		}
+	}
+}
+
+//! opts in to zero copy sends of buffers above DEFAULT_TCP_ZEROCOPY_THRESHOLD
 /*!
-	\param bytes Marlin::core::Buffer type of packet
-	\return integer, 0 for success, failure otherwise
+	did_send_bytes for such buffers fires once the kernel releases their pages instead of when they are written,
+	so it can come after did_send_bytes of smaller buffers sent later.
+	Zero copy is turned off again if the kernel reports it had to copy, like on loopback.
+
+	\return integer, 0 for success, negative if the platform, kernel or socket type does not support it, unix sockets do not
 */
-template<typename DelegateType>
-int TcpTransport<DelegateType>::send(core::Buffer &&bytes) {
-	auto *req = new uv_write_t();
-	auto req_data = new SendPayload { std::move(bytes), *this };
-	req->data = req_data;
+template<typename DelegateType, typename HandleType>
+int UvStreamTransport<DelegateType, HandleType>::enable_zerocopy() {
+#ifdef MARLIN_ASYNCIO_TCP_ZEROCOPY
+	uv_os_fd_t fd;
+	int res = uv_fileno((uv_handle_t *)socket, &fd);
+	if(res < 0) {
+		return res;
+	}
+
+	int on = 1;
+	if(setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: {} {}: Zero copy error: {}",
+			UvStreamTraits<HandleType>::name,
+			src_addr.to_string(),
+			std::strerror(errno)
+		);
+		return -errno;
+	}
+
+	zerocopy_enabled = true;
+	return 0;
+#else
+	return UV_ENOTSUP;
+#endif
+}
+
+//! sends the front of the send queue zero copy, true if all of it was taken by the kernel
+/*!
+	If the socket fills up part way, the rest is written through libuv and the buffer is kept until both complete.
+	Nothing is sent if the kernel is out of socket buffer or option memory, the caller falls back to copying.
+*/
+template<typename DelegateType, typename HandleType>
+bool UvStreamTransport<DelegateType, HandleType>::send_zerocopy() {
+#ifdef MARLIN_ASYNCIO_TCP_ZEROCOPY
+	uv_os_fd_t fd;
+	if(uv_fileno((uv_handle_t *)socket, &fd) < 0) {
+		return false;
+	}
+
+	auto &bytes = send_queue.front();
+	size_t sent = 0;
+	while(send_offset < bytes.size()) {
+		iovec iov = {bytes.data() + send_offset, bytes.size() - send_offset};
+		msghdr msg = {};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		auto res = sendmsg(fd, &msg, MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL);
+		if(res < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			// Full or out of option memory, other errors surface from the libuv write
+			break;
+		}
+
+		zerocopy_next_seq++;
+		sent += res;
+		send_offset += res;
+	}
+
+	if(sent == 0) {
+		return false;
+	}
+
+	bool done = send_offset == bytes.size();
+	size_t offset = send_offset;
+	zerocopy_sends.push_back({std::move(bytes), zerocopy_next_seq - 1, !done});
+	send_queue.pop_front();
+	send_offset = 0;
+
+	if(done) {
+		return true;
+	}
+
+	auto &send = zerocopy_sends.back();
+	auto *request = acquire_request();
+	request->zerocopy = &send;
+	request->bufs.push_back(uv_buf_init((char *)send.bytes.data() + offset, send.bytes.size() - offset));
 
-	auto buf = uv_buf_init((char*)req_data->bytes.data(), req_data->bytes.size());
 	int res = uv_write(
-		req,
+		&request->req,
 		(uv_stream_t *)socket,
-		&buf,
-		1,
+		request->bufs.data(),
+		request->bufs.size(),
 		send_cb
 	);
 
 	if (res < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Send error: {}, To: {}",
+			"Asyncio: {} {}: Send error: {}, To: {}",
+			UvStreamTraits<HandleType>::name,
 			src_addr.to_string(),
 			res,
 			dst_addr.to_string()
 		);
-		return res;
+		send.writing = false;
+		release_request(request);
+	}
+
+	return false;
+#else
+	return false;
+#endif
+}
+
+//! reads zero copy completions off the socket error queue and releases buffers the kernel is done with
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::recv_zerocopy_completions() {
+#ifdef MARLIN_ASYNCIO_TCP_ZEROCOPY
+	uv_os_fd_t fd;
+	if(uv_fileno((uv_handle_t *)socket, &fd) < 0) {
+		return;
+	}
+
+	// Kernel copied anyway, zero copy only adds overhead on this path
+	if(read_zerocopy_completions(fd, zerocopy_done_seq)) {
+		zerocopy_enabled = false;
+	}
+
+	release_zerocopy_sends();
+#endif
+}
+
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::release_zerocopy_sends() {
+	while(
+		zerocopy_sends.size() > 0 &&
+		!zerocopy_sends.front().writing &&
+		(int32_t)(zerocopy_done_seq - zerocopy_sends.front().seq) > 0
+	) {
+		auto bytes = std::move(zerocopy_sends.front().bytes);
+		zerocopy_sends.pop_front();
+		delegate->did_send_bytes(*this, std::move(bytes));
+	}
+}
+
+//! called by higher level to send data
+/*!
+	Buffers are queued and written together once per event loop iteration, write errors are logged when flushing
+
+	\param bytes Marlin::core::Buffer type of packet
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType, typename HandleType>
+int UvStreamTransport<DelegateType, HandleType>::send(core::Buffer &&bytes) {
+	if(closing) {
+		return UV_EPIPE;
+	}
+
+	send_queue.push_back(std::move(bytes));
+	if(send_queue.size() == 1) {
+		uv_prepare_start(flush_handle, flush_cb);
 	}
 
 	return 0;
 }
 
-//! closes the underlying tcp socket. calls the close callback which erases self entry from the transport manager, which in turn destroys this instance
-template<typename DelegateType>
-void TcpTransport<DelegateType>::close(uint16_t reason) {
+//! closes the underlying tcp socket after writing out queued data. calls the close callback which erases self entry from the transport manager, which in turn destroys this instance
+template<typename DelegateType, typename HandleType>
+void UvStreamTransport<DelegateType, HandleType>::close(uint16_t reason) {
+	if(closing) {
+		return;
+	}
+	closing = true;
 	close_reason = reason;
+
+	write_queued();
+	if(zerocopy_sends.size() > 0) {
+		recv_zerocopy_completions();
+	}
+	// Keep the socket around to learn when the kernel releases buffers it still references
+	uv_os_fd_t fd;
+	if(zerocopy_sends.size() > 0 && uv_fileno((uv_handle_t *)socket, &fd) == 0) {
+		zerocopy_fd = dup(fd);
+	}
+	uv_close((uv_handle_t *)flush_handle, [](uv_handle_t *handle) {
+		delete (uv_prepare_t *)handle;
+	});
 	uv_close((uv_handle_t *)socket, close_cb);
 }
 
+//! Wrapper transport class around libuv tcp functionality
+template<typename DelegateType>
+using TcpTransport = UvStreamTransport<DelegateType, uv_tcp_t>;
+
 } // namespace asyncio
 } // namespace marlin
 
@@ -17,27 +17,49 @@
 namespace marlin {
 namespace asyncio {
 
-//! factory class to create instances of TCPTransport connections by either explicitly dialling or listening to incoming requests
+//! listening half shared by the factories of stream transports, see TcpTransportFactory and UnixTransportFactory
 /*!
-	\li client mode: dial(), dial_cb() methods
 	\li server mode: listen(), connection_cb() methods
+	\li binding and dialling depend on the socket type and are left to the factories
 */
-template<typename ListenDelegate, typename TransportDelegate>
-class TcpTransportFactory {
-private:
-	uv_tcp_t *socket;
-	core::TransportManager<TcpTransport<TransportDelegate>> transport_manager;
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
+class UvStreamTransportFactory {
+protected:
+	HandleType *socket;
+	core::TransportManager<UvStreamTransport<TransportDelegate, HandleType>> transport_manager;
 
 	static void close_cb(uv_handle_t *handle);
 	static void client_close_cb(uv_handle_t *handle);
 
 	static void connection_cb(uv_stream_t *handle, int status);
-	static void dial_cb(uv_connect_t *req, int status);
 
 	struct ConnPayload {
-		TcpTransportFactory<ListenDelegate, TransportDelegate> *factory;
+		UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType> *factory;
 		ListenDelegate *delegate;
 	};
+public:
+	core::SocketAddress addr;
+
+	UvStreamTransportFactory();
+	~UvStreamTransportFactory();
+
+	UvStreamTransportFactory(UvStreamTransportFactory const&) = delete;
+
+	int listen(ListenDelegate &delegate);
+	UvStreamTransport<TransportDelegate, HandleType> *get_transport(
+		core::SocketAddress const &addr
+	);
+};
+
+//! factory class to create instances of TCPTransport connections by either explicitly dialling or listening to incoming requests
+/*!
+	\li client mode: dial(), dial_cb() methods
+	\li server mode: listen(), connection_cb() methods
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+class TcpTransportFactory : public UvStreamTransportFactory<ListenDelegate, TransportDelegate, uv_tcp_t> {
+private:
+	static void dial_cb(uv_connect_t *req, int status);
 
 	struct DialPayload {
 		TcpTransportFactory<ListenDelegate, TransportDelegate> *factory;
@@ -46,105 +68,54 @@ private:
 		uv_tcp_t* socket;
 	};
 public:
-	core::SocketAddress addr;
-
-	TcpTransportFactory();
-	~TcpTransportFactory();
-
-	TcpTransportFactory(TcpTransportFactory const&) = delete;
-
 	int bind(core::SocketAddress const &addr);
-	int listen(ListenDelegate &delegate);
 	int dial(core::SocketAddress const &addr, ListenDelegate &delegate);
-	TcpTransport<TransportDelegate> *get_transport(
-		core::SocketAddress const &addr
-	);
 };
 
 
 // Impl
 
-template<typename ListenDelegate, typename TransportDelegate>
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
-TcpTransportFactory() {
-	socket = new uv_tcp_t();
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
+UvStreamTransportFactory() {
+	socket = new HandleType();
 }
 
-template<typename ListenDelegate, typename TransportDelegate>
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
 void
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
 close_cb(uv_handle_t *handle) {
 	delete static_cast<
 		ConnPayload *
 	>(handle->data);
-	delete handle;
+	delete (HandleType *)handle;
 }
 
 //! Destructor, closes socket
-template<typename ListenDelegate, typename TransportDelegate>
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
-~TcpTransportFactory() {
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
+~UvStreamTransportFactory() {
 	uv_close(
 		(uv_handle_t *)socket,
 		close_cb
 	);
 }
 
-//! binds the socket to given arg address
-/*!
-	/param addr address to bind the socket to
-	/return an integer 0 if successful, negative otherwise
-*/
-template<typename ListenDelegate, typename TransportDelegate>
-int
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
-bind(core::SocketAddress const &addr) {
-	this->addr = addr;
-
-	uv_loop_t *loop = uv_default_loop();
-
-	int res = uv_tcp_init(loop, socket);
-	if (res < 0) {
-		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Init error: {}",
-			this->addr.to_string(),
-			res
-		);
-		return res;
-	}
-
-	res = uv_tcp_bind(
-		socket,
-		reinterpret_cast<sockaddr const *>(&this->addr),
-		0
-	);
-	if (res < 0) {
-		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Bind error: {}",
-			this->addr.to_string(),
-			res
-		);
-		return res;
-	}
-
-	return 0;
-}
-
-template<typename ListenDelegate, typename TransportDelegate>
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
 void
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
 client_close_cb(uv_handle_t *handle) {
-	delete handle;
+	delete (HandleType *)handle;
 }
 
 //! callback on receipt of new connection request
 /*!
-	\li accepts the incoming tcp connection
-	\li creates a TCPTransport instance to handle any further communication on this TCP connection
+	\li accepts the incoming connection
+	\li creates a transport instance to handle any further communication on this connection
 */
-template<typename ListenDelegate, typename TransportDelegate>
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
 void
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
 connection_cb(uv_stream_t *handle, int status) {
 	auto payload = static_cast<
 		ConnPayload *
@@ -155,7 +126,8 @@ connection_cb(uv_stream_t *handle, int status) {
 
 	if (status < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Connection callback error: {}",
+			"Asyncio: {} {}: Connection callback error: {}",
+			UvStreamTraits<HandleType>::name,
 			factory.addr.to_string(),
 			status
 		);
@@ -163,11 +135,12 @@ connection_cb(uv_stream_t *handle, int status) {
 		return;
 	}
 
-	auto *client = new uv_tcp_t();
-	status = uv_tcp_init(uv_default_loop(), client);
+	auto *client = new HandleType();
+	status = UvStreamTraits<HandleType>::init(uv_default_loop(), client);
 	if (status < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: TCP init error: {}",
+			"Asyncio: {} {}: Init error: {}",
+			UvStreamTraits<HandleType>::name,
 			factory.addr.to_string(),
 			status
 		);
@@ -180,42 +153,43 @@ connection_cb(uv_stream_t *handle, int status) {
 	status = uv_accept(handle, (uv_stream_t *)client);
 	if (status < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Connection accept error: {}",
+			"Asyncio: {} {}: Connection accept error: {}",
+			UvStreamTraits<HandleType>::name,
 			factory.addr.to_string(),
 			status
 		);
 
-		delete client;
+		uv_close((uv_handle_t *)client, client_close_cb);
 
 		return;
 	}
 
-	sockaddr saddr;
-	int len = sizeof(sockaddr);
-
-	status = uv_tcp_getpeername(client, &saddr, &len);
-	if (status < 0) {
+	auto addr = UvStreamTraits<HandleType>::peer_address(client);
+	if (!addr.has_value()) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Getpeername error: {}",
-			factory.addr.to_string(),
-			status
+			"Asyncio: {} {}: Peer address error",
+			UvStreamTraits<HandleType>::name,
+			factory.addr.to_string()
 		);
 
-		delete client;
+		uv_close((uv_handle_t *)client, client_close_cb);
 
 		return;
 	}
 
-	auto &addr = *reinterpret_cast<core::SocketAddress const *>(&saddr);
-
-	if(delegate.should_accept(addr)) {
-		auto *transport = factory.transport_manager.get_or_create(
-			addr,
+	if(delegate.should_accept(*addr)) {
+		auto [transport, res] = factory.transport_manager.get_or_create(
+			*addr,
 			factory.addr,
-			addr,
+			*addr,
 			client,
 			factory.transport_manager
-		).first;
+		);
+		if(!res) {
+			// Peer already has a connection to us
+			uv_close((uv_handle_t *)client, client_close_cb);
+			return;
+		}
 		delegate.did_create_transport(*transport);
 	} else {
 		uv_close((uv_handle_t *)client, client_close_cb);
@@ -223,9 +197,9 @@ connection_cb(uv_stream_t *handle, int status) {
 }
 
 //! starts listening for incoming connection requests on the socket address
-template<typename ListenDelegate, typename TransportDelegate>
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
 int
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
 listen(ListenDelegate &delegate) {
 	delete static_cast<
 		ConnPayload *
@@ -238,7 +212,57 @@ listen(ListenDelegate &delegate) {
 	int res = uv_listen((uv_stream_t *)socket, 100, connection_cb);
 	if (res < 0) {
 		SPDLOG_ERROR(
-			"Asyncio: Socket {}: Listen error: {}",
+			"Asyncio: {} {}: Listen error: {}",
+			UvStreamTraits<HandleType>::name,
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	return 0;
+}
+
+template<typename ListenDelegate, typename TransportDelegate, typename HandleType>
+UvStreamTransport<TransportDelegate, HandleType> *
+UvStreamTransportFactory<ListenDelegate, TransportDelegate, HandleType>::
+get_transport(
+	core::SocketAddress const &addr
+) {
+	return transport_manager.get(addr);
+}
+
+//! binds the socket to given arg address
+/*!
+	/param addr address to bind the socket to
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+TcpTransportFactory<ListenDelegate, TransportDelegate>::
+bind(core::SocketAddress const &addr) {
+	this->addr = addr;
+
+	uv_loop_t *loop = uv_default_loop();
+
+	int res = uv_tcp_init(loop, this->socket);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Init error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	res = uv_tcp_bind(
+		this->socket,
+		reinterpret_cast<sockaddr const *>(&this->addr),
+		0
+	);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Bind error: {}",
 			this->addr.to_string(),
 			res
 		);
@@ -307,31 +331,22 @@ dial(core::SocketAddress const &addr, ListenDelegate &delegate) {
 		this,
 		&delegate,
 		addr,
-		socket
+		this->socket
 	};
 
 	uv_tcp_connect(
 		req,
-		socket,
+		this->socket,
 		reinterpret_cast<sockaddr const *>(&addr),
 		dial_cb
 	);
 
-	socket = new uv_tcp_t();
+	this->socket = new uv_tcp_t();
 	bind(this->addr);
 
 	return 0;
 }
 
-template<typename ListenDelegate, typename TransportDelegate>
-TcpTransport<TransportDelegate> *
-TcpTransportFactory<ListenDelegate, TransportDelegate>::
-get_transport(
-	core::SocketAddress const &addr
-) {
-	return transport_manager.get(addr);
-}
-
 } // namespace asyncio
 } // namespace marlin
 
@@ -13,6 +13,10 @@
 #include <marlin/core/messages/BaseMessage.hpp>
 #include <marlin/core/SocketAddress.hpp>
 #include <marlin/core/TransportManager.hpp>
+#include <marlin/asyncio/core/EventLoop.hpp>
+#ifdef MARLIN_ASYNCIO_IO_URING
+#include <marlin/asyncio/core/IoUring.hpp>
+#endif
 #include <uv.h>
 #include <spdlog/spdlog.h>
 
@@ -40,6 +44,32 @@ private:
 
 	std::list<uv_udp_send_t *> pending_req;
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+	struct RingSendPayload : IoUringRequest {
+		core::Buffer packet;
+		UdpTransport<DelegateType> *transport;
+		core::SocketAddress addr;
+		iovec iov;
+		msghdr msg;
+	};
+
+	std::list<RingSendPayload *> pending_ring_req;
+
+	static void ring_send_cb(IoUringRequest *request, int res, uint32_t flags);
+	int ring_send(core::Buffer &&packet, uv_os_fd_t fd, sockaddr const *send_addr);
+#endif
+
+	/// Socket is read by polling it directly, for ancillary data like ECN and timestamps
+	bool polled = false;
+
+	/// Socket connected to the destination, sharing the local port with the factory socket
+	uv_udp_t *connected_socket = nullptr;
+	/// Poll handle for reading the connected socket if polled
+	uv_poll_t *connected_poll = nullptr;
+
+	static void connected_close_cb(uv_handle_t *handle);
+	static void connected_poll_close_cb(uv_handle_t *handle);
+
 public:
 	using MessageType = core::BaseMessage;
 
@@ -48,19 +78,34 @@ public:
 
 	DelegateType *delegate = nullptr;
 
+	/// Number of received packets marked ECT(0) or ECT(1), only counted on ECN enabled sockets
+	uint64_t ecn_ect_count = 0;
+	/// Number of received packets marked CE, only counted on ECN enabled sockets
+	uint64_t ecn_ce_count = 0;
+	/// Receive time of the packet being delivered in microseconds on the EventLoop::now_us clock.
+	/// Taken from kernel timestamps on sockets with timestamps enabled, excludes time spent queued in the process.
+	uint64_t last_recv_time_us = 0;
+
 	UdpTransport(
 		core::SocketAddress const &src_addr,
 		core::SocketAddress const &dst_addr,
 		uv_udp_t *socket,
-		core::TransportManager<UdpTransport<DelegateType>> &transport_manager
+		core::TransportManager<UdpTransport<DelegateType>> &transport_manager,
+		bool polled = false
 	);
 	UdpTransport(UdpTransport const&) = delete;
+	~UdpTransport();
 
 	void setup(DelegateType *delegate);
-	void did_recv_packet(core::Buffer &&packet);
+	void did_recv_packet(core::Buffer &&packet, uint8_t ecn_codepoint = 0, uint64_t recv_time_us = 0);
 	int send(core::Buffer &&packet);
 	int send(MessageType &&packet);
 	void close(uint16_t reason = 0);
+
+	/// Send and receive through the given socket connected to the destination, takes ownership of the handles
+	void set_connected_socket(uv_udp_t *socket, uv_poll_t *poll);
+	/// Does the transport have its own connected socket?
+	bool is_connected() const;
 };
 
 
@@ -71,10 +116,42 @@ UdpTransport<DelegateType>::UdpTransport(
 	core::SocketAddress const &_src_addr,
 	core::SocketAddress const &_dst_addr,
 	uv_udp_t *_socket,
-	core::TransportManager<UdpTransport<DelegateType>> &transport_manager
-) : socket(_socket), transport_manager(transport_manager),
+	core::TransportManager<UdpTransport<DelegateType>> &transport_manager,
+	bool polled
+) : socket(_socket), transport_manager(transport_manager), polled(polled),
 	src_addr(_src_addr), dst_addr(_dst_addr), delegate(nullptr) {}
 
+template<typename DelegateType>
+void UdpTransport<DelegateType>::connected_close_cb(uv_handle_t *handle) {
+	delete (uv_udp_t*)handle;
+}
+
+template<typename DelegateType>
+void UdpTransport<DelegateType>::connected_poll_close_cb(uv_handle_t *handle) {
+	delete (uv_poll_t*)handle;
+}
+
+//! Destructor, closes the connected socket if any
+template<typename DelegateType>
+UdpTransport<DelegateType>::~UdpTransport() {
+	for (auto *req : pending_req) {
+		auto *data = (SendPayload *)req->data;
+		data->transport = nullptr;
+	}
+#ifdef MARLIN_ASYNCIO_IO_URING
+	for (auto *req : pending_ring_req) {
+		req->transport = nullptr;
+	}
+#endif
+
+	if(connected_poll != nullptr) {
+		uv_close((uv_handle_t *)connected_poll, connected_poll_close_cb);
+	}
+	if(connected_socket != nullptr) {
+		uv_close((uv_handle_t *)connected_socket, connected_close_cb);
+	}
+}
+
 
 //! sets up the delegate when building an application or Higher Order Transport (Transport) over this transport
 /*!
@@ -86,8 +163,20 @@ void UdpTransport<DelegateType>::setup(DelegateType *delegate) {
 }
 
 //! sends the incoming bytes to the application/HOT delegate
+/*!
+	\param ecn_codepoint ECN bits from the IP header of the packet, 0 if unknown
+	\param recv_time_us receive time on the EventLoop::now_us clock, 0 if unknown
+*/
 template<typename DelegateType>
-void UdpTransport<DelegateType>::did_recv_packet(core::Buffer &&packet) {
+void UdpTransport<DelegateType>::did_recv_packet(core::Buffer &&packet, uint8_t ecn_codepoint, uint64_t recv_time_us) {
+	last_recv_time_us = recv_time_us != 0 ? recv_time_us : EventLoop::now_us();
+
+	if(ecn_codepoint == 3) {
+		ecn_ce_count++;
+	} else if(ecn_codepoint != 0) {
+		ecn_ect_count++;
+	}
+
 	delegate->did_recv_packet(*this, std::move(packet));
 }
 
@@ -103,7 +192,13 @@ void UdpTransport<DelegateType>::send_cb(
 		delete req;
 		return;
 	}
-	data->transport->pending_req.pop_front();
+	// Sends complete in order per socket, but not across the factory and connected socket
+	auto &pending_req = data->transport->pending_req;
+	if(pending_req.front() == req) {
+		pending_req.pop_front();
+	} else {
+		pending_req.remove(req);
+	}
 
 	if(status < 0) {
 		SPDLOG_ERROR(
@@ -129,6 +224,44 @@ void UdpTransport<DelegateType>::send_cb(
 */
 template<typename DelegateType>
 int UdpTransport<DelegateType>::send(core::Buffer &&packet) {
+	// Connected sockets route and filter in the kernel, no destination needed
+	auto *send_socket = connected_socket != nullptr ? connected_socket : socket;
+	auto *send_addr = connected_socket != nullptr ? nullptr : reinterpret_cast<const sockaddr *>(&dst_addr);
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	uv_os_fd_t fd;
+	// libuv opens sockets lazily, ones it hasn't opened yet are left to it
+	if(IoUring::loop().is_ready() && uv_fileno((uv_handle_t *)send_socket, &fd) == 0) {
+		return ring_send(std::move(packet), fd, send_addr);
+	}
+#endif
+
+	if(polled) {
+		// Socket is polled directly by the factory, libuv send queue can't be used
+		auto buf = uv_buf_init((char*)packet.data(), packet.size());
+		int res = uv_udp_try_send(
+			send_socket,
+			&buf,
+			1,
+			send_addr
+		);
+
+		// Full socket buffer drops the packet just like a full queue on the path would
+		if (res < 0) {
+			SPDLOG_DEBUG(
+				"Asyncio: Socket {}: Send error: {}, To: {}",
+				src_addr.to_string(),
+				res,
+				dst_addr.to_string()
+			);
+			return res;
+		}
+
+		delegate->did_send_packet(*this, std::move(packet));
+
+		return 0;
+	}
+
 	uv_udp_send_t *req = new uv_udp_send_t();
 	auto req_data = new SendPayload{std::move(packet), this};
 	req->data = req_data;
@@ -138,10 +271,10 @@ int UdpTransport<DelegateType>::send(core::Buffer &&packet) {
 	auto buf = uv_buf_init((char*)req_data->packet.data(), req_data->packet.size());
 	int res = uv_udp_send(
 		req,
-		socket,
+		send_socket,
 		&buf,
 		1,
-		reinterpret_cast<const sockaddr *>(&dst_addr),
+		send_addr,
 		UdpTransport<DelegateType>::send_cb
 	);
 
@@ -158,6 +291,82 @@ int UdpTransport<DelegateType>::send(core::Buffer &&packet) {
 	return 0;
 }
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+template<typename DelegateType>
+void UdpTransport<DelegateType>::ring_send_cb(
+	IoUringRequest *request,
+	int res,
+	uint32_t
+) {
+	auto *data = (RingSendPayload *)request;
+	IoUring::loop().unref();
+
+	if(data->transport == nullptr) {
+		delete data;
+		return;
+	}
+	auto &pending_ring_req = data->transport->pending_ring_req;
+	if(pending_ring_req.front() == data) {
+		pending_ring_req.pop_front();
+	} else {
+		pending_ring_req.remove(data);
+	}
+
+	if(res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Send callback error: {}",
+			data->transport->dst_addr.to_string(),
+			res
+		);
+	} else {
+		data->transport->delegate->did_send_packet(
+			*data->transport,
+			std::move(data->packet)
+		);
+	}
+
+	delete data;
+}
+
+//! queues a sendmsg on the io_uring of the loop, submitted along with everything else queued in this loop iteration
+template<typename DelegateType>
+int UdpTransport<DelegateType>::ring_send(core::Buffer &&packet, uv_os_fd_t fd, sockaddr const *send_addr) {
+	auto &ring = IoUring::loop();
+
+	auto *sqe = ring.get_sqe();
+	if(sqe == nullptr) {
+		SPDLOG_DEBUG(
+			"Asyncio: Socket {}: Send error: {}, To: {}",
+			src_addr.to_string(),
+			UV_ENOBUFS,
+			dst_addr.to_string()
+		);
+		return UV_ENOBUFS;
+	}
+
+	auto *data = new RingSendPayload{{ring_send_cb}, std::move(packet), this, {}, {}, {}};
+	data->iov = {data->packet.data(), data->packet.size()};
+	if(send_addr != nullptr) {
+		data->addr = dst_addr;
+		data->msg.msg_name = &data->addr;
+		data->msg.msg_namelen = sizeof(data->addr);
+	}
+	data->msg.msg_iov = &data->iov;
+	data->msg.msg_iovlen = 1;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)&data->msg;
+	sqe->len = 1;
+	sqe->user_data = (uint64_t)data;
+
+	pending_ring_req.push_back(data);
+	ring.ref();
+
+	return 0;
+}
+#endif
+
 template<typename DelegateType>
 int UdpTransport<DelegateType>::send(MessageType &&packet) {
 	return send(std::move(packet).payload_buffer());
@@ -171,9 +380,25 @@ void UdpTransport<DelegateType>::close(uint16_t reason) {
 		auto *data = (SendPayload *)req->data;
 		data->transport = nullptr;
 	}
+#ifdef MARLIN_ASYNCIO_IO_URING
+	for (auto *req : pending_ring_req) {
+		req->transport = nullptr;
+	}
+#endif
 	transport_manager.erase(dst_addr);
 }
 
+template<typename DelegateType>
+void UdpTransport<DelegateType>::set_connected_socket(uv_udp_t *socket, uv_poll_t *poll) {
+	connected_socket = socket;
+	connected_poll = poll;
+}
+
+template<typename DelegateType>
+bool UdpTransport<DelegateType>::is_connected() const {
+	return connected_socket != nullptr;
+}
+
 } // namespace asyncio
 } // namespace marlin
 
@@ -9,14 +9,27 @@
 
 #include <uv.h>
 #include "marlin/core/Buffer.hpp"
+#include "marlin/core/CidrTrie.hpp"
 #include "marlin/core/SocketAddress.hpp"
 #include "UdpTransport.hpp"
 
 #include <spdlog/spdlog.h>
 
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <memory>
+
 namespace marlin {
 namespace asyncio {
 
+//! Max packets read from a polled socket per syscall
+#define DEFAULT_UDP_RECV_BATCH 32
+
 //! factory class to create instances of UDPTransport connection by either explicitly dialling or listening to incoming requests and messages
 template<typename ListenDelegate, typename TransportDelegate>
 class UdpTransportFactory {
@@ -42,11 +55,71 @@ private:
 
 	bool is_listening = false;
 
+	//! Address ranges new transports may come from, checked before should_accept
+	core::CidrFilter address_filter;
+
+	bool ecn = false;
+	bool timestamps = false;
+	bool connected_sockets = false;
+	bool busy_poll = false;
+	uv_poll_t *poll = nullptr;
+
+	static int set_ecn_options(uv_os_fd_t fd, int family);
+	static int set_timestamps_options(uv_os_fd_t fd);
+
+	template<typename F>
+	static int recv_batch(uv_os_fd_t fd, core::SocketAddress const &addr, F deliver);
+	static void parse_ancillary(msghdr &msg, uint8_t &ecn_codepoint, uint64_t &recv_time_us);
+
+	static void poll_close_cb(uv_handle_t *handle);
+	static int busy_poll_cb(void *data);
+
+	static void poll_cb(
+		uv_poll_t *handle,
+		int status,
+		int events
+	);
+
 	struct RecvPayload {
 		UdpTransportFactory<ListenDelegate, TransportDelegate> *factory;
 		ListenDelegate *delegate;
 	};
 
+	static void connected_recv_cb(
+		uv_udp_t *handle,
+		ssize_t nread,
+		uv_buf_t const *buf,
+		sockaddr const *addr,
+		unsigned flags
+	);
+
+	static void connected_poll_cb(
+		uv_poll_t *handle,
+		int status,
+		int events
+	);
+
+	static void dispatch(
+		RecvPayload *payload,
+		core::SocketAddress const &addr,
+		core::Buffer &&packet,
+		uint8_t ecn_codepoint,
+		uint64_t recv_time_us
+	);
+
+#ifdef MARLIN_ASYNCIO_IO_URING
+	struct RingRecvPayload : IoUringRequest {
+		UdpTransportFactory<ListenDelegate, TransportDelegate> *factory;
+		msghdr msg;
+	};
+
+	/// Multishot receive armed on the io_uring of the loop, outlives the factory until cancelled
+	RingRecvPayload *ring_recv = nullptr;
+
+	int ring_recv_start();
+	static void ring_recv_cb(IoUringRequest *request, int res, uint32_t flags);
+#endif
+
 	std::pair<UdpTransport<TransportDelegate> *, int> dial_impl(core::SocketAddress const &addr, ListenDelegate &delegate);
 public:
 	core::SocketAddress addr;
@@ -56,7 +129,13 @@ public:
 
 	UdpTransportFactory(UdpTransportFactory const&) = delete;
 
+	int enable_connected_sockets();
 	int bind(core::SocketAddress const &addr);
+	int enable_ecn();
+	int enable_timestamps();
+	int enable_busy_poll(int busy_poll_us = 0);
+	int get_fd(uv_os_fd_t &fd);
+	int connect_transport(core::SocketAddress const &addr);
 	int listen(ListenDelegate &delegate);
 
 	int dial(core::SocketAddress const &addr, ListenDelegate &delegate);
@@ -68,6 +147,8 @@ public:
 	UdpTransport<TransportDelegate> *get_transport(
 		core::SocketAddress const &addr
 	);
+
+	core::CidrFilter &filter();
 };
 
 
@@ -89,16 +170,69 @@ close_cb(uv_handle_t *handle) {
 	delete (uv_udp_t*)handle;
 }
 
+template<typename ListenDelegate, typename TransportDelegate>
+void
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+poll_close_cb(uv_handle_t *handle) {
+	delete (uv_poll_t*)handle;
+}
+
 //! Destructor, closes the listening socket
 template<typename ListenDelegate, typename TransportDelegate>
 UdpTransportFactory<ListenDelegate, TransportDelegate>::
 ~UdpTransportFactory() {
+	if(busy_poll) {
+		EventLoop::remove_busy_poller(this);
+	}
+#ifdef MARLIN_ASYNCIO_IO_URING
+	if(ring_recv != nullptr) {
+		// Receive holds its own reference to the socket, cancel it so the port is released
+		ring_recv->factory = nullptr;
+
+		auto *sqe = IoUring::loop().get_sqe();
+		if(sqe == nullptr) {
+			SPDLOG_ERROR(
+				"Asyncio: Socket {}: Recv cancel error: {}",
+				this->addr.to_string(),
+				UV_ENOBUFS
+			);
+		} else {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->fd = -1;
+			sqe->addr = (uint64_t)ring_recv;
+			IoUring::loop().submit();
+		}
+	}
+#endif
+	if(poll != nullptr) {
+		uv_close(
+			(uv_handle_t *)poll,
+			poll_close_cb
+		);
+	}
 	uv_close(
 		(uv_handle_t *)socket,
 		close_cb
 	);
 }
 
+//! allows established transports to get their own connected socket on the same local port
+/*!
+	\li the factory socket is bound with SO_REUSEPORT, so other sockets of the same user can share the port
+	\li must be called before bind
+	\li see connect_transport
+
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+enable_connected_sockets() {
+	connected_sockets = true;
+
+	return 0;
+}
+
 //! binds the socket to given arg address
 /*!
 	/param addr address to bind the socket to
@@ -122,11 +256,26 @@ bind(core::SocketAddress const &addr) {
 		return res;
 	}
 
-	res = uv_udp_bind(
-		socket,
-		reinterpret_cast<sockaddr const *>(&this->addr),
-		0
-	);
+	if(connected_sockets) {
+		// Every socket sharing the port needs SO_REUSEPORT before bind, libuv can't set it
+		int fd = ::socket(this->addr.ss_family, SOCK_DGRAM, 0);
+		int on = 1;
+		if(fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0 ||
+			::bind(fd, reinterpret_cast<sockaddr const *>(&this->addr), sizeof(this->addr)) < 0) {
+			res = -errno;
+			if(fd >= 0) {
+				::close(fd);
+			}
+		} else {
+			res = uv_udp_open(socket, fd);
+		}
+	} else {
+		res = uv_udp_bind(
+			socket,
+			reinterpret_cast<sockaddr const *>(&this->addr),
+			0
+		);
+	}
 	if (res < 0) {
 		SPDLOG_ERROR(
 			"Asyncio: Socket {}: Bind error: {}",
@@ -139,6 +288,202 @@ bind(core::SocketAddress const &addr) {
 	return 0;
 }
 
+//! enables ECN on the bound socket
+/*!
+	\li outgoing packets are marked ECT(0)
+	\li the ECN codepoint of incoming packets is read from ancillary data and counted by the transports
+	\li must be called after bind and before listen or dial
+
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+enable_ecn() {
+	uv_os_fd_t fd;
+	int res = uv_fileno((uv_handle_t *)socket, &fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: ECN fileno error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	res = set_ecn_options(fd, this->addr.ss_family);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: ECN setsockopt error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	ecn = true;
+
+	return 0;
+}
+
+//! gets the file descriptor of the bound socket, for socket options the factory does not set itself
+/*!
+	\li must be called after bind
+	\li transports on connected sockets send from their own socket, see connect_transport
+
+	/param fd set to the file descriptor
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+get_fd(uv_os_fd_t &fd) {
+	return uv_fileno((uv_handle_t *)socket, &fd);
+}
+
+//! marks outgoing packets ECT(0) and requests the ECN codepoint of incoming packets
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+set_ecn_options(uv_os_fd_t fd, int family) {
+	int tos = 0x02; // ECT(0)
+	int on = 1;
+	int res;
+	if(family == AF_INET6) {
+		res = setsockopt(fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof(tos));
+		if(res == 0) {
+			res = setsockopt(fd, IPPROTO_IPV6, IPV6_RECVTCLASS, &on, sizeof(on));
+		}
+	} else {
+		res = setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+		if(res == 0) {
+			res = setsockopt(fd, IPPROTO_IP, IP_RECVTOS, &on, sizeof(on));
+		}
+	}
+
+	return res < 0 ? -errno : 0;
+}
+
+//! enables kernel receive timestamps on the bound socket
+/*!
+	\li receive times of packets are taken from SO_TIMESTAMPNS instead of when the loop gets around to reading them
+	\li exposed to the transport delegate as UdpTransport::last_recv_time_us
+	\li must be called after bind and before listen or dial
+
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+enable_timestamps() {
+	uv_os_fd_t fd;
+	int res = uv_fileno((uv_handle_t *)socket, &fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Timestamps fileno error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	res = set_timestamps_options(fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Timestamps setsockopt error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	timestamps = true;
+
+	return 0;
+}
+
+//! requests kernel receive timestamps of incoming packets
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+set_timestamps_options(uv_os_fd_t fd) {
+	int on = 1;
+	if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+//! reads the socket on every spin of EventLoop::run_busy_poll
+/*!
+	\li packets are read straight away instead of waiting for the loop to poll for readiness
+	\li reads concurrently with the regular receive path, whichever gets to a packet first delivers it
+	\li SO_BUSY_POLL additionally lets the kernel busy poll the device queue when the socket is empty, needs CAP_NET_ADMIN
+	\li must be called after bind, only takes effect while the loop is run with EventLoop::run_busy_poll
+
+	/param busy_poll_us SO_BUSY_POLL time, 0 to leave it unset
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+enable_busy_poll(int busy_poll_us) {
+	uv_os_fd_t fd;
+	int res = uv_fileno((uv_handle_t *)socket, &fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Busy poll fileno error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	if(busy_poll_us > 0 && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) < 0) {
+		res = -errno;
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Busy poll setsockopt error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	if(!busy_poll) {
+		busy_poll = true;
+		EventLoop::add_busy_poller({busy_poll_cb, this});
+	}
+
+	return 0;
+}
+
+template<typename ListenDelegate, typename TransportDelegate>
+int UdpTransportFactory<ListenDelegate, TransportDelegate>::busy_poll_cb(void *data) {
+	auto &factory = *(UdpTransportFactory<ListenDelegate, TransportDelegate> *)data;
+
+	// Nobody to deliver to yet
+	if(!factory.is_listening) {
+		return 0;
+	}
+
+	thread_local auto &site = LoopStats::loop().site("udp.recv");
+	ProfileScope profile(site);
+
+	uv_os_fd_t fd;
+	uv_fileno((uv_handle_t *)factory.socket, &fd);
+
+	auto *payload = (RecvPayload *)factory.socket->data;
+	return recv_batch(fd, factory.addr, [&](
+		core::SocketAddress const &addr,
+		core::Buffer &&packet,
+		uint8_t ecn_codepoint,
+		uint64_t recv_time_us
+	) {
+		dispatch(payload, addr, std::move(packet), ecn_codepoint, recv_time_us);
+	});
+}
+
 template<typename ListenDelegate, typename TransportDelegate>
 void UdpTransportFactory<ListenDelegate, TransportDelegate>::naive_alloc_cb(
 	uv_handle_t *,
@@ -162,12 +507,15 @@ void UdpTransportFactory<ListenDelegate, TransportDelegate>::recv_cb(
 	sockaddr const *_addr,
 	unsigned
 ) {
+	thread_local auto &site = LoopStats::loop().site("udp.recv");
+	ProfileScope profile(site);
+
 	// Error
 	if(nread < 0) {
-		sockaddr saddr;
-		int len = sizeof(sockaddr);
+		sockaddr_storage saddr;
+		int len = sizeof(saddr);
 
-		uv_udp_getsockname(handle, &saddr, &len);
+		uv_udp_getsockname(handle, reinterpret_cast<sockaddr *>(&saddr), &len);
 
 		SPDLOG_ERROR(
 			"Asyncio: Socket {}: Recv callback error: {}",
@@ -184,41 +532,267 @@ void UdpTransportFactory<ListenDelegate, TransportDelegate>::recv_cb(
 		return;
 	}
 
-	auto &addr = *reinterpret_cast<core::SocketAddress const *>(_addr);
-	auto payload = (RecvPayload *)handle->data;
+	dispatch(
+		(RecvPayload *)handle->data,
+		*reinterpret_cast<core::SocketAddress const *>(_addr),
+		core::Buffer((uint8_t*)buf->base, nread),
+		0,
+		0
+	);
+}
 
+//! redirects a received packet to the appropriate udp transport connection instance, creating one if permitted
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::dispatch(
+	RecvPayload *payload,
+	core::SocketAddress const &addr,
+	core::Buffer &&packet,
+	uint8_t ecn_codepoint,
+	uint64_t recv_time_us
+) {
 	auto &factory = *(payload->factory);
 	auto &delegate = *static_cast<ListenDelegate *>(payload->delegate);
 
 	auto *transport = factory.transport_manager.get(addr);
 	if(transport == nullptr) {
-		// Create new transport if permitted
-		if(delegate.should_accept(addr)) {
+		// Create new transport if permitted, denied ranges are dropped before the delegate sees them
+		if(factory.address_filter.is_allowed(addr) && delegate.should_accept(addr)) {
 			transport = factory.transport_manager.get_or_create(
 				addr,
 				factory.addr,
 				addr,
 				factory.socket,
-				factory.transport_manager
+				factory.transport_manager,
+				factory.ecn || factory.timestamps
 			).first;
 			delegate.did_create_transport(*transport);
 		} else {
-			delete[] buf->base;
 			return;
 		}
 	}
 
 	transport->did_recv_packet(
-		core::Buffer((uint8_t*)buf->base, nread)
+		std::move(packet),
+		ecn_codepoint,
+		recv_time_us
 	);
 }
 
+//! callback on the ECN or timestamp enabled socket being readable
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::poll_cb(
+	uv_poll_t *handle,
+	int status,
+	int
+) {
+	thread_local auto &site = LoopStats::loop().site("udp.recv");
+	ProfileScope profile(site);
+
+	auto payload = (RecvPayload *)handle->data;
+
+	if(status < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Poll callback error: {}",
+			payload->factory->addr.to_string(),
+			status
+		);
+		return;
+	}
+
+	uv_os_fd_t fd;
+	uv_fileno((uv_handle_t *)payload->factory->socket, &fd);
+
+	recv_batch(fd, payload->factory->addr, [&](
+		core::SocketAddress const &addr,
+		core::Buffer &&packet,
+		uint8_t ecn_codepoint,
+		uint64_t recv_time_us
+	) {
+		dispatch(payload, addr, std::move(packet), ecn_codepoint, recv_time_us);
+	});
+}
+
+//! reads packets along with ancillary data from a polled socket
+/*!
+	\li libuv does not expose ancillary data, so these sockets are read with recvmmsg directly
+	\li reads a bounded batch of packets with one syscall to avoid starving the loop
+
+	/return number of packets read
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+template<typename F>
+int UdpTransportFactory<ListenDelegate, TransportDelegate>::recv_batch(
+	uv_os_fd_t fd,
+	core::SocketAddress const &local_addr,
+	F deliver
+) {
+	struct Batch {
+		std::unique_ptr<uint8_t[]> data = std::unique_ptr<uint8_t[]>(new uint8_t[DEFAULT_UDP_RECV_BATCH * 65536]);
+		sockaddr_storage addrs[DEFAULT_UDP_RECV_BATCH];
+		alignas(cmsghdr) char control[DEFAULT_UDP_RECV_BATCH][CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(timespec))];
+		iovec iovs[DEFAULT_UDP_RECV_BATCH];
+		mmsghdr msgs[DEFAULT_UDP_RECV_BATCH];
+	};
+	// Shared by all sockets on the thread, packets are copied out before delivery
+	thread_local Batch batch;
+
+	for(int i = 0; i < DEFAULT_UDP_RECV_BATCH; i++) {
+		batch.iovs[i] = {batch.data.get() + i * 65536, 65536};
+
+		auto &msg = batch.msgs[i].msg_hdr;
+		msg = {};
+		msg.msg_name = &batch.addrs[i];
+		msg.msg_namelen = sizeof(sockaddr_storage);
+		msg.msg_iov = &batch.iovs[i];
+		msg.msg_iovlen = 1;
+		msg.msg_control = batch.control[i];
+		msg.msg_controllen = sizeof(batch.control[i]);
+	}
+
+	int count = recvmmsg(fd, batch.msgs, DEFAULT_UDP_RECV_BATCH, MSG_DONTWAIT, nullptr);
+	if(count < 0) {
+		if(errno != EAGAIN && errno != EWOULDBLOCK) {
+			SPDLOG_ERROR(
+				"Asyncio: Socket {}: Recv error: {}",
+				local_addr.to_string(),
+				errno
+			);
+		}
+		return 0;
+	}
+
+	for(int i = 0; i < count; i++) {
+		auto nread = batch.msgs[i].msg_len;
+		if(nread == 0) {
+			continue;
+		}
+
+		uint8_t ecn_codepoint = 0;
+		uint64_t recv_time_us = 0;
+		parse_ancillary(batch.msgs[i].msg_hdr, ecn_codepoint, recv_time_us);
+
+		core::Buffer packet(nread);
+		packet.write_unsafe(0, (uint8_t *)batch.iovs[i].iov_base, nread);
+
+		deliver(
+			*reinterpret_cast<core::SocketAddress const *>(&batch.addrs[i]),
+			std::move(packet),
+			ecn_codepoint,
+			recv_time_us
+		);
+	}
+
+	return count;
+}
+
+//! reads the ECN codepoint and kernel receive timestamp from the ancillary data of a received packet
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::parse_ancillary(
+	msghdr &msg,
+	uint8_t &ecn_codepoint,
+	uint64_t &recv_time_us
+) {
+	for(auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+			// Kernel timestamp is wall clock, carry its age over to the monotonic clock
+			timespec ts, real;
+			std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			clock_gettime(CLOCK_REALTIME, &real);
+
+			int64_t age_us = (real.tv_sec - ts.tv_sec) * 1000000ll + (real.tv_nsec - ts.tv_nsec) / 1000;
+			uint64_t now_us = EventLoop::now_us();
+			recv_time_us = age_us > 0 && (uint64_t)age_us < now_us ? now_us - age_us : now_us;
+			continue;
+		}
+
+		if((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS) ||
+			(cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_TCLASS)) {
+			// IP_TOS is a byte, IPV6_TCLASS is an int
+			uint8_t tos = cmsg->cmsg_len == CMSG_LEN(1) ? *CMSG_DATA(cmsg) : *(int *)CMSG_DATA(cmsg);
+			ecn_codepoint = tos & 0x03;
+		}
+	}
+}
+
+//! callback on receiving a message on a transport's connected socket, delivered without a lookup
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::connected_recv_cb(
+	uv_udp_t *handle,
+	ssize_t nread,
+	uv_buf_t const *buf,
+	sockaddr const *,
+	unsigned
+) {
+	thread_local auto &site = LoopStats::loop().site("udp.recv");
+	ProfileScope profile(site);
+
+	auto *transport = (UdpTransport<TransportDelegate> *)handle->data;
+
+	if(nread < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Connected recv callback error: {}",
+			transport->dst_addr.to_string(),
+			nread
+		);
+
+		delete[] buf->base;
+		return;
+	}
+
+	if(nread == 0) {
+		delete[] buf->base;
+		return;
+	}
+
+	transport->did_recv_packet(core::Buffer((uint8_t*)buf->base, nread));
+}
+
+//! callback on a polled connected socket being readable
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::connected_poll_cb(
+	uv_poll_t *handle,
+	int status,
+	int
+) {
+	thread_local auto &site = LoopStats::loop().site("udp.recv");
+	ProfileScope profile(site);
+
+	auto *transport = (UdpTransport<TransportDelegate> *)handle->data;
+
+	if(status < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Connected poll callback error: {}",
+			transport->dst_addr.to_string(),
+			status
+		);
+		return;
+	}
+
+	uv_os_fd_t fd;
+	uv_fileno((uv_handle_t *)handle, &fd);
+
+	recv_batch(fd, transport->src_addr, [&](
+		core::SocketAddress const &,
+		core::Buffer &&packet,
+		uint8_t ecn_codepoint,
+		uint64_t recv_time_us
+	) {
+		transport->did_recv_packet(std::move(packet), ecn_codepoint, recv_time_us);
+	});
+}
 
 //! starts listening for incoming messages on the socket address
 template<typename ListenDelegate, typename TransportDelegate>
 int
 UdpTransportFactory<ListenDelegate, TransportDelegate>::
 listen(ListenDelegate &delegate) {
+#ifdef MARLIN_ASYNCIO_IO_URING
+	// Payload is still in use by the armed receive
+	if(ring_recv != nullptr) {
+		static_cast<RecvPayload *>(socket->data)->delegate = &delegate;
+		return 0;
+	}
+#endif
 	delete static_cast<
 		RecvPayload *
 	>(socket->data);
@@ -226,11 +800,36 @@ listen(ListenDelegate &delegate) {
 		this,
 		&delegate
 	};
-	int res = uv_udp_recv_start(
-		socket,
-		naive_alloc_cb,
-		recv_cb
-	);
+
+	int res;
+#ifdef MARLIN_ASYNCIO_IO_URING
+	if(IoUring::loop().is_ready()) {
+		// Ancillary data comes along with every packet, ECN and timestamps need no polling
+		res = ring_recv_start();
+	} else
+#endif
+	if(ecn || timestamps) {
+		uv_os_fd_t fd;
+		uv_fileno((uv_handle_t *)socket, &fd);
+
+		if(poll == nullptr) {
+			poll = new uv_poll_t();
+			uv_poll_init_socket(uv_default_loop(), poll, fd);
+		}
+		poll->data = socket->data;
+
+		res = uv_poll_start(
+			poll,
+			UV_READABLE,
+			poll_cb
+		);
+	} else {
+		res = uv_udp_recv_start(
+			socket,
+			naive_alloc_cb,
+			recv_cb
+		);
+	}
 	if (res < 0) {
 		SPDLOG_ERROR(
 			"Asyncio: Socket {}: Start recv error: {}",
@@ -245,6 +844,137 @@ listen(ListenDelegate &delegate) {
 	return 0;
 }
 
+#ifdef MARLIN_ASYNCIO_IO_URING
+//! arms a multishot recvmsg on the io_uring of the loop
+/*!
+	\li the kernel keeps receiving into provided buffers with no rearming or readiness round trip per packet
+	\li rearmed when the kernel ends it, like when it runs out of provided buffers
+
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+ring_recv_start() {
+	auto &ring = IoUring::loop();
+
+	auto *sqe = ring.get_sqe();
+	if(sqe == nullptr) {
+		return UV_ENOBUFS;
+	}
+
+	if(ring_recv == nullptr) {
+		ring_recv = new RingRecvPayload{{ring_recv_cb}, this, {}};
+		// Only sizes matter, they fix the layout of the header, address and ancillary data in each buffer
+		ring_recv->msg.msg_namelen = sizeof(sockaddr_storage);
+		ring_recv->msg.msg_controllen = CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(timespec));
+		static_assert(
+			sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) + CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(timespec)) <= IO_URING_BUFFER_HEADROOM,
+			"provided buffers must fit a full size datagram after the header"
+		);
+		ring.ref();
+	}
+
+	uv_os_fd_t fd;
+	uv_fileno((uv_handle_t *)socket, &fd);
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = fd;
+	sqe->addr = (uint64_t)&ring_recv->msg;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = IO_URING_BUFFER_GROUP;
+	sqe->user_data = (uint64_t)ring_recv;
+
+	return 0;
+}
+
+//! callback on every packet received by the multishot recvmsg
+template<typename ListenDelegate, typename TransportDelegate>
+void UdpTransportFactory<ListenDelegate, TransportDelegate>::ring_recv_cb(
+	IoUringRequest *request,
+	int res,
+	uint32_t flags
+) {
+	thread_local auto &site = LoopStats::loop().site("udp.recv");
+	ProfileScope profile(site);
+
+	auto *data = (RingRecvPayload *)request;
+	auto &ring = IoUring::loop();
+
+	if(flags & IORING_CQE_F_BUFFER) {
+		uint16_t id = flags >> IORING_CQE_BUFFER_SHIFT;
+		auto *base = ring.buffer(id);
+
+		io_uring_recvmsg_out out;
+		std::memcpy(&out, base, sizeof(out));
+
+		if(data->factory == nullptr || res < 0 || out.payloadlen == 0) {
+			ring.recycle_buffer(id);
+		} else if(out.flags & MSG_TRUNC) {
+			// Buffers fit any datagram, so this means the headroom no longer covers the header
+			ring.recycle_buffer(id);
+			SPDLOG_ERROR(
+				"Asyncio: Socket {}: Recv error: truncated to {} bytes",
+				data->factory->addr.to_string(),
+				out.payloadlen
+			);
+		} else {
+			auto *name = base + sizeof(out);
+			auto *control = name + data->msg.msg_namelen;
+			auto *payload = control + data->msg.msg_controllen;
+
+			core::SocketAddress addr;
+			std::memcpy(static_cast<sockaddr_storage *>(&addr), name, std::min<size_t>(out.namelen, sizeof(sockaddr_storage)));
+
+			msghdr msg = {};
+			msg.msg_control = control;
+			msg.msg_controllen = out.controllen;
+
+			uint8_t ecn_codepoint = 0;
+			uint64_t recv_time_us = 0;
+			parse_ancillary(msg, ecn_codepoint, recv_time_us);
+
+			core::Buffer packet(out.payloadlen);
+			packet.write_unsafe(0, payload, out.payloadlen);
+			ring.recycle_buffer(id);
+
+			dispatch(
+				(RecvPayload *)data->factory->socket->data,
+				addr,
+				std::move(packet),
+				ecn_codepoint,
+				recv_time_us
+			);
+		}
+	}
+
+	if(flags & IORING_CQE_F_MORE) {
+		return;
+	}
+
+	// Kernel ended the receive
+	auto *factory = data->factory;
+	if(factory != nullptr && res < 0 && res != -ENOBUFS) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Recv callback error: {}",
+			factory->addr.to_string(),
+			res
+		);
+	} else if(factory != nullptr && factory->ring_recv_start() == 0) {
+		return;
+	}
+
+	if(factory != nullptr) {
+		factory->ring_recv = nullptr;
+		factory->is_listening = false;
+	}
+	delete data;
+	ring.unref();
+}
+#endif
+
 //! creates a UDP transport instance to the given address which can be used to send across messages by the delegate application or Higher order transport
 /*
 	/param addr address to dial to
@@ -267,7 +997,8 @@ dial_impl(core::SocketAddress const &addr, ListenDelegate &delegate) {
 		this->addr,
 		addr,
 		this->socket,
-		this->transport_manager
+		this->transport_manager,
+		this->ecn || this->timestamps
 	);
 
 	return {transport, res ? 1 : 0};
@@ -326,6 +1057,108 @@ dial(core::SocketAddress const &addr, ListenDelegate &delegate, MetadataType&& m
 	return status;
 }
 
+//! gives the transport to the given address its own socket connected to it
+/*!
+	\li the socket shares the local port of the factory socket, the kernel then delivers the peer's packets to it directly
+	\li sends skip the per packet route lookup and the transport skips the userspace lookup on receive
+	\li handles are created on the loop of the factory socket
+	\li needs enable_connected_sockets before bind, meant for established peers with heavy traffic
+
+	/param addr address of the transport to promote
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+connect_transport(core::SocketAddress const &addr) {
+	if(!connected_sockets) {
+		return UV_EINVAL;
+	}
+
+	auto *transport = transport_manager.get(addr);
+	if(transport == nullptr) {
+		return UV_ENOENT;
+	}
+	if(transport->is_connected()) {
+		return 0;
+	}
+
+	// Bind to the actual port, factory might have been bound to an ephemeral one
+	core::SocketAddress local_addr;
+	int len = sizeof(local_addr);
+	int res = uv_udp_getsockname(socket, reinterpret_cast<sockaddr *>(&local_addr), &len);
+	if(res < 0) {
+		return res;
+	}
+
+	int fd = ::socket(local_addr.ss_family, SOCK_DGRAM, 0);
+	int on = 1;
+	if(fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0 ||
+		::bind(fd, reinterpret_cast<sockaddr const *>(&local_addr), sizeof(local_addr)) < 0) {
+		res = -errno;
+	} else if(ecn) {
+		res = set_ecn_options(fd, local_addr.ss_family);
+	}
+	if(res == 0 && timestamps) {
+		res = set_timestamps_options(fd);
+	}
+	if(res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Connected socket error: {}, To: {}",
+			local_addr.to_string(),
+			res,
+			addr.to_string()
+		);
+		if(fd >= 0) {
+			::close(fd);
+		}
+		return res;
+	}
+
+	auto *connected_socket = new uv_udp_t();
+	uv_udp_init(socket->loop, connected_socket);
+	connected_socket->data = transport;
+
+	res = uv_udp_open(connected_socket, fd);
+	if(res < 0) {
+		::close(fd);
+	} else {
+		res = uv_udp_connect(connected_socket, reinterpret_cast<sockaddr const *>(&addr));
+	}
+
+	uv_poll_t *connected_poll = nullptr;
+	if(res == 0 && (ecn || timestamps)) {
+		connected_poll = new uv_poll_t();
+		uv_poll_init_socket(socket->loop, connected_poll, fd);
+		connected_poll->data = transport;
+		res = uv_poll_start(connected_poll, UV_READABLE, connected_poll_cb);
+	} else if(res == 0) {
+		res = uv_udp_recv_start(connected_socket, naive_alloc_cb, connected_recv_cb);
+	}
+
+	if(res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Socket {}: Connect error: {}, To: {}",
+			local_addr.to_string(),
+			res,
+			addr.to_string()
+		);
+
+		// Transport keeps using the factory socket
+		if(connected_poll != nullptr) {
+			uv_close((uv_handle_t *)connected_poll, poll_close_cb);
+		}
+		connected_socket->data = nullptr;
+		uv_close((uv_handle_t *)connected_socket, close_cb);
+		return res;
+	}
+
+	// Transport owns the handles from here on
+	transport->set_connected_socket(connected_socket, connected_poll);
+
+	return 0;
+}
+
 template<typename ListenDelegate, typename TransportDelegate>
 UdpTransport<TransportDelegate> *
 UdpTransportFactory<ListenDelegate, TransportDelegate>::
@@ -335,6 +1168,19 @@ get_transport(
 	return transport_manager.get(addr);
 }
 
+//! allow and deny rules over address ranges for incoming packets from unknown peers
+/*!
+	Packets from denied ranges are dropped without creating a transport, established transports are unaffected
+
+	/return the filter, empty by default which allows every address
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+core::CidrFilter &
+UdpTransportFactory<ListenDelegate, TransportDelegate>::
+filter() {
+	return address_filter;
+}
+
 } // namespace asyncio
 } // namespace marlin
 
@@ -0,0 +1,144 @@
+/*! \file UnixDatagramTransport.hpp
+	\brief Marlin virtual unix domain datagram transport connection implementation
+
+	Features:
+	\li drop in replacement for UdpTransport between processes on the same host, so stream can run over it
+	\li packets skip the network stack and its checksums
+*/
+
+#ifndef MARLIN_ASYNCIO_UNIXDATAGRAMTRANSPORT_HPP
+#define MARLIN_ASYNCIO_UNIXDATAGRAMTRANSPORT_HPP
+
+#include <marlin/core/Buffer.hpp>
+#include <marlin/core/messages/BaseMessage.hpp>
+#include <marlin/core/SocketAddress.hpp>
+#include <marlin/core/TransportManager.hpp>
+#include <marlin/asyncio/core/EventLoop.hpp>
+#include "UnixSocket.hpp"
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+namespace marlin {
+namespace asyncio {
+
+//! Virtual connection to one destination over the datagram socket of the factory
+template<typename DelegateType>
+class UnixDatagramTransport {
+private:
+	int fd;
+	core::TransportManager<UnixDatagramTransport<DelegateType>> &transport_manager;
+
+	sockaddr_un dst_name;
+	socklen_t dst_name_len;
+
+public:
+	using MessageType = core::BaseMessage;
+
+	core::SocketAddress src_addr;
+	core::SocketAddress dst_addr;
+
+	DelegateType *delegate = nullptr;
+
+	/// Always 0, kept for interface parity with UdpTransport as unix sockets carry no ECN marks
+	uint64_t ecn_ect_count = 0;
+	/// Always 0, kept for interface parity with UdpTransport as unix sockets carry no ECN marks
+	uint64_t ecn_ce_count = 0;
+	/// Receive time of the packet being delivered in microseconds on the EventLoop::now_us clock
+	uint64_t last_recv_time_us = 0;
+
+	UnixDatagramTransport(
+		core::SocketAddress const &src_addr,
+		core::SocketAddress const &dst_addr,
+		int fd,
+		core::TransportManager<UnixDatagramTransport<DelegateType>> &transport_manager
+	);
+	UnixDatagramTransport(UnixDatagramTransport const&) = delete;
+
+	void setup(DelegateType *delegate);
+	void did_recv_packet(core::Buffer &&packet);
+	int send(core::Buffer &&packet);
+	int send(MessageType &&packet);
+	void close(uint16_t reason = 0);
+};
+
+
+// Impl
+
+template<typename DelegateType>
+UnixDatagramTransport<DelegateType>::UnixDatagramTransport(
+	core::SocketAddress const &_src_addr,
+	core::SocketAddress const &_dst_addr,
+	int fd,
+	core::TransportManager<UnixDatagramTransport<DelegateType>> &transport_manager
+) : fd(fd), transport_manager(transport_manager),
+	src_addr(_src_addr), dst_addr(_dst_addr) {
+	dst_name_len = unix_socket_name(dst_name, "dgram", dst_addr);
+}
+
+//! sets up the delegate when building an application or Higher Order Transport (Transport) over this transport
+/*!
+	\param delegate a DelegateType pointer to the application class instance which uses this transport
+*/
+template<typename DelegateType>
+void UnixDatagramTransport<DelegateType>::setup(DelegateType *delegate) {
+	this->delegate = delegate;
+}
+
+//! sends the incoming bytes to the application/HOT delegate
+template<typename DelegateType>
+void UnixDatagramTransport<DelegateType>::did_recv_packet(core::Buffer &&packet) {
+	last_recv_time_us = EventLoop::now_us();
+
+	delegate->did_recv_packet(*this, std::move(packet));
+}
+
+//! called by higher level to send data
+/*!
+	Sent synchronously, a full receive queue at the destination drops the packet like a full queue on a network path would
+
+	\param packet Marlin::core::Buffer type of packet
+	\return integer, 0 for success, failure otherwise
+*/
+template<typename DelegateType>
+int UnixDatagramTransport<DelegateType>::send(core::Buffer &&packet) {
+	auto res = sendto(
+		fd,
+		packet.data(),
+		packet.size(),
+		0,
+		reinterpret_cast<sockaddr const *>(&dst_name),
+		dst_name_len
+	);
+
+	if (res < 0) {
+		res = -errno;
+		SPDLOG_DEBUG(
+			"Asyncio: Unix socket {}: Send error: {}, To: {}",
+			src_addr.to_string(),
+			res,
+			dst_addr.to_string()
+		);
+		return res;
+	}
+
+	delegate->did_send_packet(*this, std::move(packet));
+
+	return 0;
+}
+
+template<typename DelegateType>
+int UnixDatagramTransport<DelegateType>::send(MessageType &&packet) {
+	return send(std::move(packet).payload_buffer());
+}
+
+//! erases self entry from the transport manager which in turn destroys this instance. No other action required sinces its a virtual connection anyways
+template<typename DelegateType>
+void UnixDatagramTransport<DelegateType>::close(uint16_t reason) {
+	delegate->did_close(*this, reason);
+	transport_manager.erase(dst_addr);
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_UNIXDATAGRAMTRANSPORT_HPP
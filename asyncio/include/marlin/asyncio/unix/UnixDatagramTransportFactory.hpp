@@ -0,0 +1,361 @@
+/*! \file UnixDatagramTransportFactory.hpp
+	\brief Factory class to create and manage instances of marlin UnixDatagramTransport connections
+
+	Same interface as UdpTransportFactory, so stream and other datagram based transports can run over it
+	between peers on the same host. Addresses name unix sockets instead of network endpoints, see UnixSocket.hpp.
+
+	Unconnected unix datagram sockets queue at most net.unix.max_dgram_qlen packets at the receiver,
+	packets sent beyond that are dropped like on a congested path.
+*/
+
+#ifndef MARLIN_ASYNCIO_UNIXDATAGRAMTRANSPORTFACTORY_HPP
+#define MARLIN_ASYNCIO_UNIXDATAGRAMTRANSPORTFACTORY_HPP
+
+#include <marlin/core/Buffer.hpp>
+#include <marlin/core/CidrTrie.hpp>
+#include <marlin/core/SocketAddress.hpp>
+#include <marlin/core/TransportManager.hpp>
+#include <marlin/asyncio/core/LoopStats.hpp>
+#include "UnixSocket.hpp"
+#include "UnixDatagramTransport.hpp"
+#include <uv.h>
+#include <spdlog/spdlog.h>
+
+#include <memory>
+#include <utility>
+
+namespace marlin {
+namespace asyncio {
+
+//! Max packets read per poll callback, bounds the time spent before other events get a turn
+#define DEFAULT_UNIX_DGRAM_RECV_BATCH 32
+//! Size of the receive buffer, larger packets are truncated and dropped
+#define DEFAULT_UNIX_DGRAM_RECV_SIZE 65536
+
+//! factory class to create instances of UnixDatagramTransport connections by either explicitly dialling or listening to incoming packets
+template<typename ListenDelegate, typename TransportDelegate>
+class UnixDatagramTransportFactory {
+private:
+	int fd = -1;
+	uv_poll_t *poll = nullptr;
+	core::TransportManager<UnixDatagramTransport<TransportDelegate>> transport_manager;
+
+	bool is_listening = false;
+
+	//! Address ranges new transports may come from, checked before should_accept
+	core::CidrFilter address_filter;
+
+	static void close_cb(uv_handle_t *handle);
+
+	static void poll_cb(
+		uv_poll_t *handle,
+		int status,
+		int events
+	);
+
+	struct RecvPayload {
+		UnixDatagramTransportFactory<ListenDelegate, TransportDelegate> *factory;
+		ListenDelegate *delegate;
+	};
+
+	std::pair<UnixDatagramTransport<TransportDelegate> *, int> dial_impl(core::SocketAddress const &addr, ListenDelegate &delegate);
+public:
+	core::SocketAddress addr;
+
+	UnixDatagramTransportFactory() = default;
+	~UnixDatagramTransportFactory();
+
+	UnixDatagramTransportFactory(UnixDatagramTransportFactory const&) = delete;
+
+	int bind(core::SocketAddress const &addr);
+	int listen(ListenDelegate &delegate);
+
+	template<typename... MetadataType>
+	int dial(core::SocketAddress const &addr, ListenDelegate &delegate, MetadataType&&... metadata);
+
+	UnixDatagramTransport<TransportDelegate> *get_transport(
+		core::SocketAddress const &addr
+	);
+
+	core::CidrFilter &filter();
+};
+
+
+// Impl
+
+template<typename ListenDelegate, typename TransportDelegate>
+void
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+close_cb(uv_handle_t *handle) {
+	delete static_cast<
+		RecvPayload *
+	>(handle->data);
+	delete (uv_poll_t *)handle;
+}
+
+//! Destructor, closes the socket
+template<typename ListenDelegate, typename TransportDelegate>
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+~UnixDatagramTransportFactory() {
+	if(fd < 0) {
+		return;
+	}
+
+	sockaddr_un name;
+	unix_socket_name(name, "dgram", addr);
+	unix_socket_unlink(name);
+
+	// Closing stops polling right away, the socket can go before the close callback
+	uv_close(
+		(uv_handle_t *)poll,
+		close_cb
+	);
+	::close(fd);
+}
+
+//! binds the socket to the name of the given address
+/*!
+	/param addr address to bind the socket to, port 0 picks a free one
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+bind(core::SocketAddress const &addr) {
+	this->addr = addr;
+
+	int fd = unix_socket_open(SOCK_DGRAM);
+	if (fd < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Socket error: {}",
+			this->addr.to_string(),
+			fd
+		);
+		return fd;
+	}
+
+	int res = unix_socket_bind(fd, "dgram", this->addr);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Bind error: {}",
+			this->addr.to_string(),
+			res
+		);
+		::close(fd);
+		return res;
+	}
+
+	poll = new uv_poll_t();
+	res = uv_poll_init(uv_default_loop(), poll, fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Poll init error: {}",
+			this->addr.to_string(),
+			res
+		);
+		delete poll;
+		poll = nullptr;
+		::close(fd);
+		return res;
+	}
+	poll->data = nullptr;
+
+	this->fd = fd;
+
+	return 0;
+}
+
+//! callback on the socket being readable
+/*!
+	\li reads a bounded batch of packets to avoid starving the loop
+	\li redirects each packet to the transport of its sender, creating one if permitted
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+void
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+poll_cb(
+	uv_poll_t *handle,
+	int status,
+	int
+) {
+	thread_local auto &site = LoopStats::loop().site("unix.recv");
+	ProfileScope profile(site);
+
+	auto payload = (RecvPayload *)handle->data;
+	auto &factory = *(payload->factory);
+	auto &delegate = *static_cast<ListenDelegate *>(payload->delegate);
+
+	if(status < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Poll callback error: {}",
+			factory.addr.to_string(),
+			status
+		);
+		return;
+	}
+
+	thread_local std::unique_ptr<uint8_t[]> buffer(new uint8_t[DEFAULT_UNIX_DGRAM_RECV_SIZE]);
+
+	for(int i = 0; i < DEFAULT_UNIX_DGRAM_RECV_BATCH; i++) {
+		sockaddr_un name;
+		socklen_t len = sizeof(name);
+
+		auto nread = recvfrom(
+			factory.fd,
+			buffer.get(),
+			DEFAULT_UNIX_DGRAM_RECV_SIZE,
+			MSG_TRUNC,
+			reinterpret_cast<sockaddr *>(&name),
+			&len
+		);
+		if(nread < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				SPDLOG_ERROR(
+					"Asyncio: Unix socket {}: Recv error: {}",
+					factory.addr.to_string(),
+					-errno
+				);
+			}
+			return;
+		}
+
+		if(nread > DEFAULT_UNIX_DGRAM_RECV_SIZE) {
+			SPDLOG_DEBUG(
+				"Asyncio: Unix socket {}: Truncated packet of size {}",
+				factory.addr.to_string(),
+				nread
+			);
+			continue;
+		}
+
+		auto addr = unix_socket_address(name, len, "dgram");
+		if(!addr.has_value()) {
+			continue;
+		}
+
+		core::Buffer packet(nread);
+		std::memcpy(packet.data(), buffer.get(), nread);
+
+		auto *transport = factory.transport_manager.get(*addr);
+		if(transport == nullptr) {
+			// Create new transport if permitted
+			if(factory.address_filter.is_allowed(*addr) && delegate.should_accept(*addr)) {
+				transport = factory.transport_manager.get_or_create(
+					*addr,
+					factory.addr,
+					*addr,
+					factory.fd,
+					factory.transport_manager
+				).first;
+				delegate.did_create_transport(*transport);
+			} else {
+				continue;
+			}
+		}
+
+		transport->did_recv_packet(std::move(packet));
+	}
+}
+
+//! starts listening for incoming messages on the socket
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+listen(ListenDelegate &delegate) {
+	if(poll == nullptr) {
+		return UV_EBADF;
+	}
+
+	delete static_cast<
+		RecvPayload *
+	>(poll->data);
+	poll->data = new RecvPayload {
+		this,
+		&delegate
+	};
+
+	int res = uv_poll_start(poll, UV_READABLE, poll_cb);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Start listening error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	is_listening = true;
+
+	return 0;
+}
+
+template<typename ListenDelegate, typename TransportDelegate>
+std::pair<UnixDatagramTransport<TransportDelegate> *, int>
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+dial_impl(core::SocketAddress const &addr, ListenDelegate &delegate) {
+	if(!is_listening) {
+		auto status = listen(delegate);
+		if(status < 0) {
+			return {nullptr, status};
+		}
+	}
+
+	auto [transport, res] = this->transport_manager.get_or_create(
+		addr,
+		this->addr,
+		addr,
+		this->fd,
+		this->transport_manager
+	);
+
+	return {transport, res ? 1 : 0};
+}
+
+//! creates a transport instance to the given address which can be used to send across messages by the delegate application or Higher order transport
+/*
+	Covers the metadata overloads of UdpTransportFactory::dial, metadata is handed to did_create_transport as is
+
+	/param addr address to dial to
+	/delegate the listen delegate object
+	/metadata optional, passed along to did_create_transport of the delegate
+	/return 1 if a transport was created, 0 if it existed, negative on error
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+template<typename... MetadataType>
+int
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+dial(core::SocketAddress const &addr, ListenDelegate &delegate, MetadataType&&... metadata) {
+	auto [transport, status] = dial_impl(addr, delegate);
+
+	if(status < 0) {
+		return status;
+	} else if(status == 1) {
+		delegate.did_create_transport(*transport, std::forward<MetadataType>(metadata)...);
+	}
+
+	transport->delegate->did_dial(*transport);
+
+	return status;
+}
+
+template<typename ListenDelegate, typename TransportDelegate>
+UnixDatagramTransport<TransportDelegate> *
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+get_transport(
+	core::SocketAddress const &addr
+) {
+	return transport_manager.get(addr);
+}
+
+//! allow and deny rules over the addresses unix sockets are named after, same as UdpTransportFactory::filter
+template<typename ListenDelegate, typename TransportDelegate>
+core::CidrFilter &
+UnixDatagramTransportFactory<ListenDelegate, TransportDelegate>::
+filter() {
+	return address_filter;
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_UNIXDATAGRAMTRANSPORTFACTORY_HPP
@@ -0,0 +1,244 @@
+/*! \file UnixSocket.hpp
+	\brief Naming of unix domain sockets after the socket addresses of marlin transports
+
+	Unix transports keep the same addressing as their network counterparts, so they can replace them
+	for peers on the same host without any changes above the factory.
+	A socket bound to an address is named after it, sockets dialing from it add a suffix to the name of the address.
+*/
+
+#ifndef MARLIN_ASYNCIO_UNIXSOCKET_HPP
+#define MARLIN_ASYNCIO_UNIXSOCKET_HPP
+
+#include "marlin/core/SocketAddress.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+
+namespace marlin {
+namespace asyncio {
+
+//! Prefix of the names of all unix sockets
+#define DEFAULT_UNIX_SOCKET_PREFIX "marlin-"
+//! Directory of unix socket files on platforms without the abstract namespace
+#define DEFAULT_UNIX_SOCKET_DIR "/tmp/"
+//! Ports handed out to sockets bound to port 0
+#define DEFAULT_UNIX_EPHEMERAL_PORT_START 49152
+
+//! fills in the unix socket name of the given socket address
+/*!
+	\li Linux uses the abstract namespace, names go away with their sockets
+	\li elsewhere names are files under DEFAULT_UNIX_SOCKET_DIR
+
+	/param kind separates names of different socket types
+	/param suffix distinguishes sockets dialing from the address, empty for the socket bound to it
+	/return length of the name
+*/
+inline socklen_t unix_socket_name(
+	sockaddr_un &name,
+	char const *kind,
+	core::SocketAddress const &addr,
+	std::string const &suffix = ""
+) {
+	auto path = std::string(DEFAULT_UNIX_SOCKET_PREFIX) + kind + "-" + addr.to_string() + suffix;
+
+	std::memset(&name, 0, sizeof(name));
+	name.sun_family = AF_UNIX;
+#ifdef __linux__
+	std::memcpy(name.sun_path + 1, path.data(), path.size());
+	return offsetof(sockaddr_un, sun_path) + 1 + path.size();
+#else
+	path = DEFAULT_UNIX_SOCKET_DIR + path;
+	std::memcpy(name.sun_path, path.data(), path.size());
+	return offsetof(sockaddr_un, sun_path) + path.size() + 1;
+#endif
+}
+
+//! socket address a unix socket name was made from
+/*!
+	/return address, or nothing for unnamed sockets and names not made by unix_socket_name
+*/
+inline std::optional<core::SocketAddress> unix_socket_address(
+	sockaddr_un const &name,
+	socklen_t len,
+	char const *kind
+) {
+	if(len <= offsetof(sockaddr_un, sun_path) || name.sun_family != AF_UNIX) {
+		return std::nullopt;
+	}
+
+	size_t size = len - offsetof(sockaddr_un, sun_path);
+#ifdef __linux__
+	if(name.sun_path[0] != 0) {
+		return std::nullopt;
+	}
+	std::string path(name.sun_path + 1, size - 1);
+#else
+	std::string path(name.sun_path, strnlen(name.sun_path, size));
+	if(path.compare(0, sizeof(DEFAULT_UNIX_SOCKET_DIR) - 1, DEFAULT_UNIX_SOCKET_DIR) != 0) {
+		return std::nullopt;
+	}
+	path.erase(0, sizeof(DEFAULT_UNIX_SOCKET_DIR) - 1);
+#endif
+
+	auto prefix = std::string(DEFAULT_UNIX_SOCKET_PREFIX) + kind + "-";
+	if(path.compare(0, prefix.size(), prefix) != 0) {
+		return std::nullopt;
+	}
+	path = path.substr(prefix.size(), path.find('#') - prefix.size());
+
+	auto colon = path.rfind(':');
+	if(colon == std::string::npos || colon + 1 == path.size()) {
+		return std::nullopt;
+	}
+
+	char *end;
+	auto port = std::strtoul(path.c_str() + colon + 1, &end, 10);
+	if(*end != 0 || port > 65535) {
+		return std::nullopt;
+	}
+
+	core::SocketAddress addr;
+	auto ip = path.substr(0, colon);
+	if(ip.size() > 2 && ip.front() == '[' && ip.back() == ']') {
+		auto &in6 = reinterpret_cast<sockaddr_in6 &>(addr);
+		in6.sin6_family = AF_INET6;
+		if(inet_pton(AF_INET6, ip.substr(1, ip.size() - 2).c_str(), &in6.sin6_addr) != 1) {
+			return std::nullopt;
+		}
+	} else if(inet_pton(AF_INET, ip.c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr) != 1) {
+		return std::nullopt;
+	}
+	addr.set_port(port);
+
+	return addr;
+}
+
+//! removes the file of a unix socket name, names in the abstract namespace need no cleanup
+inline void unix_socket_unlink(sockaddr_un const &name) {
+#ifdef __linux__
+	(void)name;
+#else
+	::unlink(name.sun_path);
+#endif
+}
+
+//! opens a non blocking unix socket of the given type
+/*!
+	/return file descriptor, negative error otherwise
+*/
+inline int unix_socket_open(int type) {
+	int fd = ::socket(AF_UNIX, type, 0);
+	if(fd < 0) {
+		return -errno;
+	}
+
+	if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+		int res = -errno;
+		::close(fd);
+		return res;
+	}
+
+	return fd;
+}
+
+//! binds the socket to the name of the given address
+/*!
+	\li port 0 is replaced by the first free port from an ephemeral range, like it would for network sockets
+	\li stale socket files left behind by crashed processes are replaced
+
+	/param addr address to bind to, gets the chosen port
+	/return an integer 0 if successful, negative otherwise
+*/
+inline int unix_socket_bind(int fd, char const *kind, core::SocketAddress &addr) {
+	sockaddr_un name;
+
+	if(addr.get_port() != 0) {
+		auto len = unix_socket_name(name, kind, addr);
+		unix_socket_unlink(name);
+		return ::bind(fd, reinterpret_cast<sockaddr const *>(&name), len) < 0 ? -errno : 0;
+	}
+
+	uint32_t range = 65536 - DEFAULT_UNIX_EPHEMERAL_PORT_START;
+	// Processes start at different ports so they rarely probe the same ones
+	uint32_t start = (uint32_t)getpid() * 2654435761u;
+	for(uint32_t i = 0; i < range; i++) {
+		addr.set_port(DEFAULT_UNIX_EPHEMERAL_PORT_START + (start + i) % range);
+
+		auto len = unix_socket_name(name, kind, addr);
+		if(::bind(fd, reinterpret_cast<sockaddr const *>(&name), len) == 0) {
+			return 0;
+		}
+		if(errno != EADDRINUSE) {
+			break;
+		}
+	}
+
+	int res = -errno;
+	addr.set_port(0);
+	return res;
+}
+
+//! connects a new socket named after the source address to the socket bound to the destination address
+/*!
+	\li unix sockets connect immediately, or fail with UV_EAGAIN if the backlog of the destination is full
+	\li naming the socket lets the destination find the source address, like the peer address of network sockets
+
+	/return connected file descriptor, negative error otherwise
+*/
+inline int unix_socket_connect(
+	int type,
+	char const *kind,
+	core::SocketAddress const &src_addr,
+	core::SocketAddress const &dst_addr
+) {
+	int fd = unix_socket_open(type);
+	if(fd < 0) {
+		return fd;
+	}
+
+	// Only the process holding the source address names sockets after it, so a local counter is enough
+	static uint64_t next_id = 0;
+	sockaddr_un name;
+	socklen_t len;
+	int res;
+	do {
+		len = unix_socket_name(name, kind, src_addr, "#" + std::to_string(next_id++));
+		unix_socket_unlink(name);
+		res = ::bind(fd, reinterpret_cast<sockaddr const *>(&name), len);
+	} while(res < 0 && errno == EADDRINUSE);
+
+	if(res < 0) {
+		res = -errno;
+		::close(fd);
+		return res;
+	}
+
+	sockaddr_un dst_name;
+	auto dst_len = unix_socket_name(dst_name, kind, dst_addr);
+	res = ::connect(fd, reinterpret_cast<sockaddr const *>(&dst_name), dst_len);
+	// The peer keeps seeing the name after the file is gone
+	unix_socket_unlink(name);
+
+	if(res < 0) {
+		res = -errno;
+		::close(fd);
+		return res;
+	}
+
+	return fd;
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_UNIXSOCKET_HPP
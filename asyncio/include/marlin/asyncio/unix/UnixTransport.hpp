@@ -0,0 +1,58 @@
+/*! \file UnixTransport.hpp
+	\brief Marlin unix domain stream transport connection implementation
+
+	Drop in replacement for TcpTransport between processes on the same host,
+	bytes skip the network stack and its checksums.
+*/
+
+#ifndef MARLIN_ASYNCIO_UNIXTRANSPORT_HPP
+#define MARLIN_ASYNCIO_UNIXTRANSPORT_HPP
+
+#include "marlin/core/SocketAddress.hpp"
+#include "marlin/asyncio/tcp/TcpTransport.hpp"
+#include "UnixSocket.hpp"
+#include <uv.h>
+
+#include <optional>
+
+namespace marlin {
+namespace asyncio {
+
+template<>
+struct UvStreamTraits<uv_pipe_t> {
+	static constexpr char const *name = "Unix socket";
+	static constexpr char const *recv_site = "unix.recv";
+
+	static int init(uv_loop_t *loop, uv_pipe_t *handle) {
+		return uv_pipe_init(loop, handle, 0);
+	}
+
+	//! peers are named after the factory address they dialed from, see unix_socket_connect
+	static std::optional<core::SocketAddress> peer_address(uv_pipe_t *handle) {
+		uv_os_fd_t fd;
+		if(uv_fileno((uv_handle_t *)handle, &fd) < 0) {
+			return std::nullopt;
+		}
+
+		sockaddr_un name;
+		socklen_t len = sizeof(name);
+		if(getpeername(fd, reinterpret_cast<sockaddr *>(&name), &len) < 0) {
+			return std::nullopt;
+		}
+
+		return unix_socket_address(name, len, "stream");
+	}
+};
+
+//! Wrapper transport class around libuv pipe functionality on unix stream sockets
+/*!
+	Same implementation as TcpTransport, so send batching and the shared read buffer carry over.
+	Zero copy sends are not supported by unix sockets, enable_zerocopy fails.
+*/
+template<typename DelegateType>
+using UnixTransport = UvStreamTransport<DelegateType, uv_pipe_t>;
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_UNIXTRANSPORT_HPP
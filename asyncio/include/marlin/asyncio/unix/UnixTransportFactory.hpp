@@ -0,0 +1,167 @@
+/*! \file UnixTransportFactory.hpp
+	\brief Factory class to create and manage instances of marlin UnixTransport connections
+
+	Same interface as TcpTransportFactory, so it can be swapped in for peers on the same host.
+	Addresses name unix sockets instead of network endpoints, see UnixSocket.hpp.
+*/
+
+#ifndef MARLIN_ASYNCIO_UNIXTRANSPORTFACTORY_HPP
+#define MARLIN_ASYNCIO_UNIXTRANSPORTFACTORY_HPP
+
+#include <uv.h>
+#include "marlin/core/Buffer.hpp"
+#include "marlin/core/SocketAddress.hpp"
+#include "UnixSocket.hpp"
+#include "UnixTransport.hpp"
+#include "marlin/asyncio/tcp/TcpTransportFactory.hpp"
+
+#include <spdlog/spdlog.h>
+
+namespace marlin {
+namespace asyncio {
+
+//! factory class to create instances of UnixTransport connections by either explicitly dialling or listening to incoming requests
+/*!
+	\li client mode: dial() method, connects immediately
+	\li server mode: listen(), connection_cb() methods
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+class UnixTransportFactory : public UvStreamTransportFactory<ListenDelegate, TransportDelegate, uv_pipe_t> {
+public:
+	~UnixTransportFactory();
+
+	int bind(core::SocketAddress const &addr);
+	int dial(core::SocketAddress const &addr, ListenDelegate &delegate);
+};
+
+
+// Impl
+
+//! Destructor, removes the socket name, the socket itself is closed by UvStreamTransportFactory
+template<typename ListenDelegate, typename TransportDelegate>
+UnixTransportFactory<ListenDelegate, TransportDelegate>::
+~UnixTransportFactory() {
+	sockaddr_un name;
+	unix_socket_name(name, "stream", this->addr);
+	unix_socket_unlink(name);
+}
+
+//! binds the socket to the name of the given address
+/*!
+	/param addr address to bind the socket to, port 0 picks a free one
+	/return an integer 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UnixTransportFactory<ListenDelegate, TransportDelegate>::
+bind(core::SocketAddress const &addr) {
+	this->addr = addr;
+
+	uv_loop_t *loop = uv_default_loop();
+
+	int res = uv_pipe_init(loop, this->socket, 0);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Init error: {}",
+			this->addr.to_string(),
+			res
+		);
+		return res;
+	}
+
+	// libuv can't bind to the abstract namespace, the socket is bound before handing it over
+	int fd = unix_socket_open(SOCK_STREAM);
+	if (fd < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Socket error: {}",
+			this->addr.to_string(),
+			fd
+		);
+		return fd;
+	}
+
+	res = unix_socket_bind(fd, "stream", this->addr);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Bind error: {}",
+			this->addr.to_string(),
+			res
+		);
+		::close(fd);
+		return res;
+	}
+
+	res = uv_pipe_open(this->socket, fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Open error: {}",
+			this->addr.to_string(),
+			res
+		);
+		::close(fd);
+		return res;
+	}
+
+	return 0;
+}
+
+//! client mode function that connects to the socket bound to the given address
+/*!
+	unix sockets connect without a round trip, so unlike tcp the transport is created and dialed before returning
+
+	/param addr address to dial to
+	/delegate the listen delegate object
+	/return 0 if successful, negative otherwise
+*/
+template<typename ListenDelegate, typename TransportDelegate>
+int
+UnixTransportFactory<ListenDelegate, TransportDelegate>::
+dial(core::SocketAddress const &addr, ListenDelegate &delegate) {
+	auto *transport = this->transport_manager.get(addr);
+	if(transport != nullptr) {
+		transport->delegate->did_dial(*transport);
+		return 0;
+	}
+
+	int fd = unix_socket_connect(SOCK_STREAM, "stream", this->addr, addr);
+	if (fd < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Connect error: {}",
+			this->addr.to_string(),
+			fd
+		);
+		return fd;
+	}
+
+	auto *client = new uv_pipe_t();
+	uv_pipe_init(uv_default_loop(), client, 0);
+	int res = uv_pipe_open(client, fd);
+	if (res < 0) {
+		SPDLOG_ERROR(
+			"Asyncio: Unix socket {}: Open error: {}",
+			this->addr.to_string(),
+			res
+		);
+		::close(fd);
+		uv_close((uv_handle_t *)client, this->client_close_cb);
+		return res;
+	}
+
+	transport = this->transport_manager.get_or_create(
+		addr,
+		this->addr,
+		addr,
+		client,
+		this->transport_manager
+	).first;
+
+	delegate.did_create_transport(*transport);
+	transport->delegate->did_dial(*transport);
+
+	return 0;
+}
+
+} // namespace asyncio
+} // namespace marlin
+
+#endif // MARLIN_ASYNCIO_UNIXTRANSPORTFACTORY_HPP
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/core/Coro.hpp"
+#include "marlin/asyncio/udp/UdpTransportFactory.hpp"
+#include "marlin/asyncio/tcp/TcpTransportFactory.hpp"
+
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::asyncio::coro;
+
+static Task<int> add(int a, int b) {
+	co_await coro::sleep(1);
+	co_return a + b;
+}
+
+static Task<> sleeper(std::vector<int> &order, int id, uint64_t timeout) {
+	co_await coro::sleep(timeout);
+	order.push_back(id);
+}
+
+TEST(Coro, SleepsInDeadlineOrder) {
+	std::vector<int> order;
+
+	spawn(sleeper(order, 1, 20));
+	spawn(sleeper(order, 2, 10));
+	spawn(sleeper(order, 3, 10));
+	spawn(sleeper(order, 4, 0));
+
+	EventLoop::run();
+
+	EXPECT_EQ(order, std::vector<int>({4, 2, 3, 1}));
+}
+
+TEST(Coro, AwaitsTasks) {
+	int result = 0;
+
+	spawn([](int &result) -> Task<> {
+		result = co_await add(1, 2);
+		result += co_await add(3, 4);
+	}(result));
+
+	EventLoop::run();
+
+	EXPECT_EQ(result, 10);
+}
+
+TEST(Coro, RecyclesFrames) {
+	int result = 0;
+	auto run_once = [&]() {
+		spawn([](int &result) -> Task<> {
+			result += co_await add(1, 1);
+		}(result));
+		EventLoop::run();
+	};
+
+	run_once();
+	auto allocations = FramePool::loop().allocations;
+	for(int i = 0; i < 100; i++) {
+		run_once();
+	}
+
+	EXPECT_EQ(result, 202);
+	EXPECT_EQ(FramePool::loop().allocations, allocations);
+}
+
+template<template<typename, typename> class FactoryTemplate, template<typename> class TransportTemplate>
+static void echo_roundtrip(uint16_t port) {
+	using FactoryType = Factory<FactoryTemplate, TransportTemplate>;
+	using ConnectionType = typename FactoryType::ConnectionType;
+
+	FactoryType server, client;
+	ASSERT_EQ(server.bind(SocketAddress::loopback_ipv4(port)), 0);
+	ASSERT_EQ(server.listen(), 0);
+	ASSERT_EQ(client.bind(SocketAddress::loopback_ipv4(0)), 0);
+
+	// Echoes everything back on the first connection
+	spawn([](FactoryType &server) -> Task<> {
+		auto *connection = co_await server.accept();
+		while(auto bytes = co_await connection->recv()) {
+			connection->send(std::move(*bytes));
+		}
+	}(server));
+
+	uint32_t received = 0;
+	spawn([](FactoryType &client, uint16_t port, uint32_t &received) -> Task<> {
+		ConnectionType *connection = co_await client.dial(SocketAddress::loopback_ipv4(port));
+		EXPECT_NE(connection, nullptr);
+
+		for(uint32_t i = 0; i < 100; i++) {
+			Buffer ping(4);
+			ping.write_uint32_le_unsafe(0, i);
+			connection->send(std::move(ping));
+
+			auto pong = co_await connection->recv();
+			EXPECT_TRUE(pong.has_value());
+			// TCP can split a ping, they are small and sent one at a time so it doesn't here
+			EXPECT_EQ(pong->size(), 4u);
+			EXPECT_EQ(pong->read_uint32_le_unsafe(0), i);
+			received++;
+		}
+
+		connection->close();
+		uv_stop(uv_default_loop());
+	}(client, port, received));
+
+	EventLoop::run();
+
+	EXPECT_EQ(received, 100u);
+}
+
+TEST(Coro, UdpEcho) {
+	echo_roundtrip<UdpTransportFactory, UdpTransport>(8030);
+}
+
+TEST(Coro, TcpEcho) {
+	echo_roundtrip<TcpTransportFactory, TcpTransport>(8031);
+}
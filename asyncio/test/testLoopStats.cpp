@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/core/EventLoop.hpp"
+#include "marlin/asyncio/core/Timer.hpp"
+
+#include <thread>
+
+using namespace marlin::asyncio;
+
+TEST(Histogram, Percentiles) {
+	Histogram h;
+	EXPECT_EQ(h.percentile(0.5), 0u);
+
+	for(uint64_t i = 1; i <= 100; i++) {
+		h.record(i);
+	}
+
+	EXPECT_EQ(h.count, 100u);
+	EXPECT_EQ(h.max, 100u);
+	EXPECT_EQ(h.mean(), 50u);
+	// Upper bounds of power of two buckets
+	EXPECT_EQ(h.percentile(0.5), 63u);
+	EXPECT_EQ(h.percentile(0.99), 100u);
+	EXPECT_EQ(h.percentile(0), 1u);
+
+	h.reset();
+	EXPECT_EQ(h.count, 0u);
+}
+
+TEST(LoopStats, SitesAreShared) {
+	auto &stats = LoopStats::loop();
+	auto &a = stats.site("test.a");
+	auto &b = stats.site("test.b");
+
+	EXPECT_NE(&a, &b);
+	EXPECT_EQ(&a, &stats.site("test.a"));
+}
+
+TEST(LoopStats, EveryThreadHasItsOwn) {
+	auto &stats = LoopStats::loop();
+	auto &site = stats.site("test.thread");
+
+	LoopStats *other_stats = nullptr;
+	LoopStats::Site *other_site = nullptr;
+	std::thread([&]() {
+		other_stats = &LoopStats::loop();
+		ProfileScope profile(LoopStats::loop().site("test.thread"));
+		other_site = &LoopStats::loop().site("test.thread");
+	}).join();
+
+	EXPECT_NE(&stats, other_stats);
+	EXPECT_NE(&site, other_site);
+}
+
+static void sleep_us(uint64_t us) {
+	auto start = uv_hrtime();
+	while(uv_hrtime() - start < us * 1000) {}
+}
+
+struct Delegate {
+	int fired = 0;
+
+	void timer_cb() {
+		thread_local auto &site = LoopStats::loop().site("test.timer");
+		ProfileScope profile(site);
+
+		sleep_us(2000);
+		if(++fired == 5) {
+			uv_stop(uv_default_loop());
+		}
+	}
+};
+
+TEST(LoopStats, MeasuresCallbacksAndLag) {
+	auto &stats = EventLoop::stats();
+	auto &site = stats.site("test.timer");
+	auto &timer_site = stats.site("timer");
+
+	ProfileScope outside(site);
+	EXPECT_EQ(site.duration_ns.count, 0u);
+
+	ASSERT_EQ(EventLoop::enable_stats(), 0);
+	EXPECT_EQ(EventLoop::enable_stats(), UV_EALREADY);
+
+	Delegate delegate;
+	Timer timer(&delegate);
+	timer.start<Delegate, &Delegate::timer_cb>(1, 1);
+
+	EventLoop::run();
+
+	EXPECT_EQ(site.duration_ns.count, 5u);
+	EXPECT_GE(site.duration_ns.max, 2000000u);
+	// Nested in the timer site
+	EXPECT_EQ(timer_site.duration_ns.count, 5u);
+	EXPECT_GE(timer_site.duration_ns.sum, site.duration_ns.sum);
+
+	// Last iteration is cut short by the stop
+	EXPECT_GE(stats.lag_ns.count, 4u);
+	EXPECT_GE(stats.lag_ns.max, 2000000u);
+	EXPECT_EQ(stats.events.max, 1u);
+
+	stats.reset();
+	EXPECT_EQ(site.duration_ns.count, 0u);
+	EXPECT_EQ(stats.lag_ns.count, 0u);
+}
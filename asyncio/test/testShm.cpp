@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/shm/ShmTransportFactory.hpp"
+
+#include <functional>
+#include <vector>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+TEST(SpscRing, WrapsAroundAndReportsWakeups) {
+	constexpr size_t capacity = 64;
+	alignas(64) uint8_t memory[SpscRing::mapping_size(capacity)];
+	SpscRing::init(memory);
+	SpscRing producer(memory, capacity), consumer(memory, capacity);
+
+	std::vector<uint8_t> out;
+	auto read_all = [&]() {
+		return consumer.read([&](uint8_t *bytes, size_t size) {
+			out.insert(out.end(), bytes, bytes + size);
+		});
+	};
+
+	uint8_t in[100];
+	for(int i = 0; i < 100; i++) {
+		in[i] = i;
+	}
+
+	auto position = producer.write_position();
+	EXPECT_EQ(producer.write(in, 40), 40u);
+	// Consumer never read, it may be idle
+	EXPECT_TRUE(producer.was_drained(position));
+	EXPECT_EQ(read_all(), 40);
+
+	// Wraps around the end, only what fits goes in
+	position = producer.write_position();
+	EXPECT_EQ(producer.write(in + 40, 60), 60u);
+	EXPECT_EQ(producer.write(in, 10), 4u);
+	EXPECT_FALSE(producer.wait_for_space());
+
+	EXPECT_EQ(read_all(), 64);
+	EXPECT_TRUE(consumer.take_waiting_producer());
+	EXPECT_FALSE(consumer.take_waiting_producer());
+	EXPECT_EQ(read_all(), 0);
+	EXPECT_TRUE(producer.was_drained(position + 64));
+
+	ASSERT_EQ(out.size(), 104u);
+	for(int i = 0; i < 100; i++) {
+		EXPECT_EQ(out[i], i);
+	}
+}
+
+struct Delegate {
+	std::function<void(ShmTransport<Delegate> &, Buffer &&)> did_recv_bytes;
+	std::function<void(ShmTransport<Delegate> &)> did_dial;
+	std::function<void(ShmTransport<Delegate> &, uint16_t)> did_close;
+	size_t sent = 0;
+
+	void did_send_bytes(ShmTransport<Delegate> &, Buffer &&) {
+		sent++;
+	}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(ShmTransport<Delegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+TEST(ShmTransport, LargeSendsArriveInOrder) {
+	// Larger than the ring, so the sender waits for space over and over
+	size_t const count = 64;
+	size_t const size = 1000000;
+
+	Delegate sd, cd;
+	int closed = 0;
+
+	size_t received = 0;
+	bool in_order = true;
+
+	cd.did_dial = [&](ShmTransport<Delegate> &transport) {
+		for(size_t i = 0; i < count; i++) {
+			Buffer bytes(size);
+			std::memset(bytes.data(), i, size);
+			EXPECT_EQ(transport.send(std::move(bytes)), 0);
+		}
+	};
+	cd.did_recv_bytes = [](ShmTransport<Delegate> &, Buffer &&) {};
+
+	sd.did_recv_bytes = [&](ShmTransport<Delegate> &transport, Buffer &&bytes) {
+		for(size_t i = 0; i < bytes.size(); i++) {
+			in_order = in_order && bytes.data()[i] == (uint8_t)((received + i) / size);
+		}
+		received += bytes.size();
+		if(received == count * size) {
+			transport.close();
+		}
+	};
+	sd.did_close = [&](ShmTransport<Delegate> &, uint16_t) {
+		closed++;
+		if(closed == 2) {
+			uv_stop(uv_default_loop());
+		}
+	};
+	cd.did_close = sd.did_close;
+
+	{
+		ShmTransportFactory<Delegate, Delegate> s, c;
+		ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8050)), 0);
+		ASSERT_EQ(s.listen(sd), 0);
+		ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(0)), 0);
+		ASSERT_EQ(c.dial(SocketAddress::loopback_ipv4(8050), cd), 0);
+
+		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	}
+
+	// Finish closing the factory sockets
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(closed, 2);
+	EXPECT_EQ(cd.sent, count);
+	EXPECT_EQ(received, count * size);
+	EXPECT_TRUE(in_order);
+}
+
+TEST(ShmTransport, PingPong) {
+	Delegate sd, cd;
+	uint32_t pongs = 0;
+	std::vector<uint8_t> pending;
+
+	auto ping = [](ShmTransport<Delegate> &transport, uint32_t i) {
+		Buffer bytes(4);
+		bytes.write_uint32_le_unsafe(0, i);
+		EXPECT_EQ(transport.send(std::move(bytes)), 0);
+	};
+
+	cd.did_dial = [&](ShmTransport<Delegate> &transport) {
+		ping(transport, 0);
+	};
+	cd.did_recv_bytes = [&](ShmTransport<Delegate> &transport, Buffer &&bytes) {
+		pending.insert(pending.end(), bytes.data(), bytes.data() + bytes.size());
+		if(pending.size() < 4) {
+			return;
+		}
+		EXPECT_EQ(pending.size(), 4u);
+		EXPECT_EQ(WeakBuffer(pending.data(), 4).read_uint32_le_unsafe(0), pongs);
+		pending.clear();
+
+		if(++pongs == 1000) {
+			transport.close();
+			return;
+		}
+		ping(transport, pongs);
+	};
+	sd.did_recv_bytes = [&](ShmTransport<Delegate> &transport, Buffer &&bytes) {
+		transport.send(std::move(bytes));
+	};
+	sd.did_close = [&](ShmTransport<Delegate> &, uint16_t) {
+		uv_stop(uv_default_loop());
+	};
+	cd.did_close = [](ShmTransport<Delegate> &, uint16_t) {};
+
+	{
+		ShmTransportFactory<Delegate, Delegate> s, c;
+		ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8051)), 0);
+		ASSERT_EQ(s.listen(sd), 0);
+		ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(0)), 0);
+		ASSERT_EQ(c.dial(SocketAddress::loopback_ipv4(8051), cd), 0);
+
+		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+		EXPECT_EQ(s.get_transport(c.addr), nullptr);
+	}
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(pongs, 1000u);
+}
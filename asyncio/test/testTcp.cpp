@@ -0,0 +1,347 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/tcp/TcpTransportFactory.hpp"
+
+#include <functional>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+struct Delegate {
+	std::function<void(TcpTransport<Delegate> &, Buffer &&)> did_recv_bytes;
+	std::function<void(TcpTransport<Delegate> &, Buffer &&)> did_send_bytes;
+	std::function<void(TcpTransport<Delegate> &)> did_dial;
+	std::function<void(TcpTransport<Delegate> &, uint16_t)> did_close;
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TcpTransport<Delegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+// Parses reads in place
+struct ViewDelegate {
+	std::function<void(TcpTransport<ViewDelegate> &, WeakBuffer)> did_recv_bytes_view;
+	std::function<void(TcpTransport<ViewDelegate> &)> did_dial;
+	std::function<void(TcpTransport<ViewDelegate> &, uint16_t)> did_close;
+
+	void did_send_bytes(TcpTransport<ViewDelegate> &, Buffer &&) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TcpTransport<ViewDelegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+// Runs the loop until both ends have closed, server closes once it has everything
+template<typename DelegateType>
+static void run(uint16_t port, DelegateType &sd, DelegateType &cd, int &closed) {
+	{
+		TcpTransportFactory<DelegateType, DelegateType> s, c;
+		s.bind(SocketAddress::loopback_ipv4(port));
+		s.listen(sd);
+		c.bind(SocketAddress::loopback_ipv4(0));
+		c.dial(SocketAddress::loopback_ipv4(port), cd);
+
+		auto *prepare = new uv_prepare_t();
+		uv_prepare_init(uv_default_loop(), prepare);
+		prepare->data = &closed;
+		uv_prepare_start(prepare, [](uv_prepare_t *handle) {
+			if(*(int *)handle->data == 2) {
+				uv_close((uv_handle_t *)handle, [](uv_handle_t *handle) {
+					delete (uv_prepare_t *)handle;
+				});
+				uv_stop(uv_default_loop());
+			}
+		});
+
+		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	}
+
+	// Finish closing the factory sockets
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+}
+
+TEST(TcpTransport, CoalescedSendsArriveInOrder) {
+	size_t const count = 10000;
+
+	Delegate sd, cd;
+	int closed = 0;
+
+	size_t sent = 0;
+	std::vector<uint8_t> received;
+
+	cd.did_dial = [&](TcpTransport<Delegate> &transport) {
+		for(size_t i = 0; i < count; i++) {
+			EXPECT_EQ(transport.send(Buffer({(uint8_t)i, (uint8_t)(i >> 8), (uint8_t)(i >> 16), 0xff}, 4)), 0);
+		}
+	};
+	cd.did_send_bytes = [&](TcpTransport<Delegate> &, Buffer &&bytes) {
+		// Delegate gets each buffer back untouched, in order
+		EXPECT_EQ(bytes.size(), 4u);
+		EXPECT_EQ(bytes.data()[0], (uint8_t)sent);
+		sent++;
+	};
+	cd.did_recv_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	cd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	sd.did_recv_bytes = [&](TcpTransport<Delegate> &transport, Buffer &&bytes) {
+		received.insert(received.end(), bytes.data(), bytes.data() + bytes.size());
+		if(received.size() == count * 4) {
+			transport.close();
+		}
+	};
+	sd.did_send_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	sd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	run(8020, sd, cd, closed);
+
+	EXPECT_EQ(sent, count);
+	ASSERT_EQ(received.size(), count * 4);
+	for(size_t i = 0; i < count; i++) {
+		EXPECT_EQ(received[i * 4], (uint8_t)i);
+		EXPECT_EQ(received[i * 4 + 1], (uint8_t)(i >> 8));
+		EXPECT_EQ(received[i * 4 + 3], 0xff);
+	}
+}
+
+TEST(TcpTransport, LargeSendsArriveInOrder) {
+	size_t const count = 64;
+	size_t const size = 1000000;
+
+	Delegate sd, cd;
+	int closed = 0;
+
+	size_t sent = 0;
+	size_t received = 0;
+	bool in_order = true;
+
+	cd.did_dial = [&](TcpTransport<Delegate> &transport) {
+		for(size_t i = 0; i < count; i++) {
+			Buffer bytes(size);
+			std::memset(bytes.data(), i, size);
+			EXPECT_EQ(transport.send(std::move(bytes)), 0);
+		}
+	};
+	cd.did_send_bytes = [&](TcpTransport<Delegate> &, Buffer &&bytes) {
+		EXPECT_EQ(bytes.size(), size);
+		sent++;
+	};
+	cd.did_recv_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	cd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	sd.did_recv_bytes = [&](TcpTransport<Delegate> &transport, Buffer &&bytes) {
+		for(size_t i = 0; i < bytes.size(); i++) {
+			in_order = in_order && bytes.data()[i] == (uint8_t)((received + i) / size);
+		}
+		received += bytes.size();
+		if(received == count * size) {
+			transport.close();
+		}
+	};
+	sd.did_send_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	sd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	run(8021, sd, cd, closed);
+
+	EXPECT_EQ(sent, count);
+	EXPECT_EQ(received, count * size);
+	EXPECT_TRUE(in_order);
+}
+
+TEST(TcpTransport, ViewDelegateParsesInPlace) {
+	size_t const count = 10000;
+
+	ViewDelegate sd, cd;
+	int closed = 0;
+
+	std::vector<uint8_t> received;
+	uint8_t const* last_base = nullptr;
+	bool reused = false;
+
+	cd.did_dial = [&](TcpTransport<ViewDelegate> &transport) {
+		for(size_t i = 0; i < count; i++) {
+			Buffer bytes(100);
+			std::memset(bytes.data(), i, 100);
+			transport.send(std::move(bytes));
+		}
+	};
+	cd.did_recv_bytes_view = [](TcpTransport<ViewDelegate> &, WeakBuffer) {};
+	cd.did_close = [&](TcpTransport<ViewDelegate> &, uint16_t) {
+		closed++;
+	};
+
+	sd.did_recv_bytes_view = [&](TcpTransport<ViewDelegate> &transport, WeakBuffer bytes) {
+		// Every read lands in the same memory
+		reused = reused || bytes.data() == last_base;
+		last_base = bytes.data();
+
+		received.insert(received.end(), bytes.data(), bytes.data() + bytes.size());
+		if(received.size() == count * 100) {
+			transport.close();
+		}
+	};
+	sd.did_close = [&](TcpTransport<ViewDelegate> &, uint16_t) {
+		closed++;
+	};
+
+	run(8022, sd, cd, closed);
+
+	EXPECT_TRUE(reused);
+	ASSERT_EQ(received.size(), count * 100);
+	for(size_t i = 0; i < count * 100; i += 100) {
+		EXPECT_EQ(received[i], (uint8_t)(i / 100));
+	}
+}
+
+TEST(TcpTransport, ZeroCopySendsCompleteInOrder) {
+	size_t const count = 32;
+	size_t const size = 1000000;
+
+	Delegate sd, cd;
+	int closed = 0;
+
+	size_t sent = 0;
+	size_t received = 0;
+	bool in_order = true;
+
+	cd.did_dial = [&](TcpTransport<Delegate> &transport) {
+		ASSERT_EQ(transport.enable_zerocopy(), 0);
+		for(size_t i = 0; i < count; i++) {
+			Buffer bytes(size);
+			std::memset(bytes.data(), i, size);
+			transport.send(std::move(bytes));
+		}
+	};
+	cd.did_send_bytes = [&](TcpTransport<Delegate> &, Buffer &&bytes) {
+		EXPECT_EQ(bytes.size(), size);
+		sent++;
+	};
+	cd.did_recv_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	cd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	sd.did_recv_bytes = [&](TcpTransport<Delegate> &transport, Buffer &&bytes) {
+		for(size_t i = 0; i < bytes.size(); i++) {
+			in_order = in_order && bytes.data()[i] == (uint8_t)((received + i) / size);
+		}
+		received += bytes.size();
+		if(received == count * size) {
+			transport.close();
+		}
+	};
+	sd.did_send_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	sd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	run(8023, sd, cd, closed);
+
+	EXPECT_EQ(sent, count);
+	EXPECT_EQ(received, count * size);
+	EXPECT_TRUE(in_order);
+}
+
+TEST(TcpTransport, ZeroCopyBuffersOutliveClose) {
+	size_t const count = 8;
+	size_t const size = 1000000;
+
+	Delegate sd, cd;
+	int closed = 0;
+
+	size_t received = 0;
+	bool in_order = true;
+
+	uv_timer_t timer;
+	uv_timer_init(uv_default_loop(), &timer);
+
+	cd.did_dial = [&](TcpTransport<Delegate> &transport) {
+		ASSERT_EQ(transport.enable_zerocopy(), 0);
+		for(size_t i = 0; i < count; i++) {
+			Buffer bytes(size);
+			std::memset(bytes.data(), i, size);
+			transport.send(std::move(bytes));
+		}
+
+		// Close once the sends are flushed, likely before the kernel is done with all of them
+		timer.data = &transport;
+		uv_timer_start(&timer, [](uv_timer_t *handle) {
+			((TcpTransport<Delegate> *)handle->data)->close();
+			uv_close((uv_handle_t *)handle, nullptr);
+		}, 5, 0);
+	};
+	cd.did_send_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	cd.did_recv_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	cd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	// Whatever made it out before the close is intact
+	sd.did_recv_bytes = [&](TcpTransport<Delegate> &, Buffer &&bytes) {
+		for(size_t i = 0; i < bytes.size(); i++) {
+			in_order = in_order && bytes.data()[i] == (uint8_t)((received + i) / size);
+		}
+		received += bytes.size();
+	};
+	sd.did_send_bytes = [](TcpTransport<Delegate> &, Buffer &&) {};
+	sd.did_close = [&](TcpTransport<Delegate> &, uint16_t) {
+		closed++;
+	};
+
+	run(8024, sd, cd, closed);
+
+	EXPECT_GT(received, 0u);
+	EXPECT_LE(received, count * size);
+	EXPECT_TRUE(in_order);
+}
+
+TEST(TcpTransport, ZeroCopyDrainResetsAfterTimeout) {
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_GE(listener, 0);
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(8025);
+	int on = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	ASSERT_EQ(bind(listener, (sockaddr *)&addr, sizeof(addr)), 0);
+	ASSERT_EQ(listen(listener, 1), 0);
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	ASSERT_EQ(connect(fd, (sockaddr *)&addr, sizeof(addr)), 0);
+	int peer = accept(listener, nullptr, nullptr);
+	ASSERT_GE(peer, 0);
+
+	// A send which never completes, like one the peer never acks
+	std::vector<Buffer> buffers;
+	buffers.emplace_back(1000);
+	TcpZeroCopyDrain::start(uv_default_loop(), fd, std::move(buffers), 0, 1, 20);
+
+	// Returns once the drain gave up and freed itself
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	// Connection was reset, a graceful close would still let the peer send
+	char byte;
+	EXPECT_EQ(recv(peer, &byte, 1, 0), 0);
+	EXPECT_EQ(send(peer, &byte, 1, MSG_NOSIGNAL), -1);
+
+	close(peer);
+	close(listener);
+}
@@ -2,6 +2,7 @@
 #include "marlin/asyncio/udp/UdpTransportFactory.hpp"
 
 #include <functional>
+#include <vector>
 
 using namespace marlin::core;
 using namespace marlin::asyncio;
@@ -149,3 +150,291 @@ TEST(UdpTransportFactory, CanDial) {
 	EXPECT_TRUE(did_call_f_delegate);
 	EXPECT_TRUE(did_call_t_delegate);
 }
+
+static void connected_roundtrip(bool polled) {
+	UdpTransportFactory<ListenDelegate, TransportDelegate> a, b;
+	EXPECT_EQ(a.enable_connected_sockets(), 0);
+	ASSERT_EQ(a.bind(SocketAddress::loopback_ipv4(8010)), 0);
+	ASSERT_EQ(b.bind(SocketAddress::loopback_ipv4(8011)), 0);
+	if(polled) {
+		ASSERT_EQ(a.enable_timestamps(), 0);
+	}
+
+	int a_recvd = 0;
+	int b_recvd = 0;
+
+	TransportDelegate atd;
+	atd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	atd.did_dial = [] (UdpTransport<TransportDelegate> &t) {
+		t.send(Buffer({'1'}, 1));
+	};
+	atd.did_recv_packet = [&] (UdpTransport<TransportDelegate> &t, Buffer &&packet) {
+		EXPECT_TRUE(t.is_connected());
+		EXPECT_EQ(packet.data()[0], '2');
+		if(polled) {
+			EXPECT_GT(t.last_recv_time_us, 0);
+		}
+		a_recvd++;
+		uv_stop(uv_default_loop());
+	};
+
+	TransportDelegate btd;
+	btd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	btd.did_recv_packet = [&] (UdpTransport<TransportDelegate> &t, Buffer &&packet) {
+		b_recvd++;
+		EXPECT_EQ(t.dst_addr, SocketAddress::loopback_ipv4(8010));
+		EXPECT_EQ(packet.data()[0], '1');
+
+		if(b_recvd == 1) {
+			// Promote the peer on a, second ping goes out of the connected socket with the same source
+			EXPECT_EQ(a.connect_transport(SocketAddress::loopback_ipv4(8011)), 0);
+			a.get_transport(SocketAddress::loopback_ipv4(8011))->send(Buffer({'1'}, 1));
+		} else {
+			t.send(Buffer({'2'}, 1));
+		}
+	};
+
+	ListenDelegate ald;
+	ald.should_accept = [] (SocketAddress const &) { return false; };
+	ald.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&atd);
+	};
+
+	ListenDelegate bld;
+	bld.should_accept = [] (SocketAddress const &) { return true; };
+	bld.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&btd);
+	};
+
+	EXPECT_EQ(b.listen(bld), 0);
+	EXPECT_EQ(a.dial(SocketAddress::loopback_ipv4(8011), ald), 1);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(b_recvd, 2);
+	EXPECT_EQ(a_recvd, 1);
+	EXPECT_EQ(b.connect_transport(SocketAddress::loopback_ipv4(8010)), UV_EINVAL);
+}
+
+TEST(UdpTransportFactory, ConnectedSocket) {
+	connected_roundtrip(false);
+}
+
+TEST(UdpTransportFactory, ConnectedSocketPolled) {
+	connected_roundtrip(true);
+}
+
+TEST(UdpTransportFactory, PingPongEcn) {
+	UdpTransportFactory<ListenDelegate, TransportDelegate> a, b;
+	ASSERT_EQ(a.bind(SocketAddress::loopback_ipv4(8012)), 0);
+	ASSERT_EQ(b.bind(SocketAddress::loopback_ipv4(8013)), 0);
+	ASSERT_EQ(a.enable_ecn(), 0);
+	ASSERT_EQ(b.enable_ecn(), 0);
+
+	int rounds = 0;
+	uint64_t ect_count = 0;
+
+	TransportDelegate atd;
+	atd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	atd.did_dial = [] (UdpTransport<TransportDelegate> &t) {
+		t.send(Buffer({0, 0, 0, 0}, 4));
+	};
+	atd.did_recv_packet = [&] (UdpTransport<TransportDelegate> &t, Buffer &&packet) {
+		EXPECT_EQ(packet.read_uint32_le_unsafe(0), (uint32_t)rounds);
+		rounds++;
+		if(rounds == 1000) {
+			ect_count = t.ecn_ect_count;
+			uv_stop(uv_default_loop());
+			return;
+		}
+		packet.write_uint32_le_unsafe(0, rounds);
+		t.send(std::move(packet));
+	};
+
+	TransportDelegate btd;
+	btd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	btd.did_recv_packet = [] (UdpTransport<TransportDelegate> &t, Buffer &&packet) {
+		t.send(std::move(packet));
+	};
+
+	ListenDelegate ald;
+	ald.should_accept = [] (SocketAddress const &) { return false; };
+	ald.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&atd);
+	};
+
+	ListenDelegate bld;
+	bld.should_accept = [] (SocketAddress const &) { return true; };
+	bld.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&btd);
+	};
+
+	EXPECT_EQ(b.listen(bld), 0);
+	EXPECT_EQ(a.dial(SocketAddress::loopback_ipv4(8013), ald), 1);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(rounds, 1000);
+	EXPECT_EQ(ect_count, 1000u);
+}
+
+TEST(UdpTransportFactory, BusyPoll) {
+	UdpTransportFactory<ListenDelegate, TransportDelegate> a, b;
+	ASSERT_EQ(a.bind(SocketAddress::loopback_ipv4(8014)), 0);
+	ASSERT_EQ(b.bind(SocketAddress::loopback_ipv4(8015)), 0);
+	ASSERT_EQ(a.enable_busy_poll(), 0);
+	ASSERT_EQ(b.enable_busy_poll(), 0);
+
+	int rounds = 0;
+
+	TransportDelegate atd;
+	atd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	atd.did_dial = [] (UdpTransport<TransportDelegate> &t) {
+		t.send(Buffer({0}, 1));
+	};
+	atd.did_recv_packet = [&] (UdpTransport<TransportDelegate> &t, Buffer &&packet) {
+		if(++rounds == 100) {
+			uv_stop(uv_default_loop());
+			return;
+		}
+		t.send(std::move(packet));
+	};
+
+	TransportDelegate btd;
+	btd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	btd.did_recv_packet = [] (UdpTransport<TransportDelegate> &t, Buffer &&packet) {
+		t.send(std::move(packet));
+	};
+
+	ListenDelegate ald;
+	ald.should_accept = [] (SocketAddress const &) { return false; };
+	ald.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&atd);
+	};
+
+	ListenDelegate bld;
+	bld.should_accept = [] (SocketAddress const &) { return true; };
+	bld.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&btd);
+	};
+
+	EXPECT_EQ(b.listen(bld), 0);
+	EXPECT_EQ(a.dial(SocketAddress::loopback_ipv4(8015), ald), 1);
+
+	// Short spin budget, the loop has to block and resume spinning in between
+	EventLoop::run_busy_poll(10);
+
+	EXPECT_EQ(rounds, 100);
+}
+
+TEST(UdpTransportFactory, FilterDropsDeniedRanges) {
+	UdpTransportFactory<ListenDelegate, TransportDelegate> a, b;
+	ASSERT_EQ(a.bind(SocketAddress::loopback_ipv4(8016)), 0);
+	ASSERT_EQ(b.bind(SocketAddress::loopback_ipv4(8017)), 0);
+	b.filter().deny(CidrBlock::from_string("127.0.0.0/8"));
+
+	int accepted = 0;
+	std::vector<uint8_t> received;
+
+	TransportDelegate atd;
+	atd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	atd.did_dial = [] (UdpTransport<TransportDelegate> &t) {
+		t.send(Buffer({'0'}, 1));
+	};
+
+	TransportDelegate btd;
+	btd.did_recv_packet = [&] (UdpTransport<TransportDelegate> &, Buffer &&packet) {
+		received.push_back(packet.data()[0]);
+		uv_stop(uv_default_loop());
+	};
+
+	ListenDelegate ald;
+	ald.should_accept = [] (SocketAddress const &) { return false; };
+	ald.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&atd);
+	};
+
+	ListenDelegate bld;
+	bld.should_accept = [&] (SocketAddress const &) {
+		accepted++;
+		return true;
+	};
+	bld.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&btd);
+	};
+
+	EXPECT_EQ(b.listen(bld), 0);
+	EXPECT_EQ(a.dial(SocketAddress::loopback_ipv4(8017), ald), 1);
+
+	// Give the first packet time to arrive and get dropped, then let the sender in and send again
+	std::function<void()> allow = [&]() {
+		b.filter().allow(CidrBlock::from_string("127.0.0.1/32"));
+		a.get_transport(SocketAddress::loopback_ipv4(8017))->send(Buffer({'1'}, 1));
+	};
+
+	uv_timer_t timer;
+	uv_timer_init(uv_default_loop(), &timer);
+	timer.data = &allow;
+	uv_timer_start(&timer, [](uv_timer_t *handle) {
+		(*(std::function<void()> *)handle->data)();
+	}, 50, 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	uv_close((uv_handle_t *)&timer, nullptr);
+	uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+
+	EXPECT_EQ(accepted, 1);
+	ASSERT_EQ(received.size(), 1u);
+	EXPECT_EQ(received[0], '1');
+}
+
+TEST(UdpTransportFactory, LargeDatagram) {
+	UdpTransportFactory<ListenDelegate, TransportDelegate> a, b;
+	ASSERT_EQ(a.bind(SocketAddress::loopback_ipv4(8018)), 0);
+	ASSERT_EQ(b.bind(SocketAddress::loopback_ipv4(8019)), 0);
+
+	// Largest payload of a datagram over IPv4
+	size_t const size = 65507;
+	size_t received = 0;
+	bool intact = true;
+
+	TransportDelegate atd;
+	atd.did_send_packet = [] (UdpTransport<TransportDelegate> &, Buffer &&) {};
+	atd.did_dial = [&] (UdpTransport<TransportDelegate> &t) {
+		Buffer packet(size);
+		for(size_t i = 0; i < size; i++) {
+			packet.data()[i] = i % 251;
+		}
+		t.send(std::move(packet));
+	};
+
+	TransportDelegate btd;
+	btd.did_recv_packet = [&] (UdpTransport<TransportDelegate> &, Buffer &&packet) {
+		received = packet.size();
+		for(size_t i = 0; i < packet.size(); i++) {
+			intact = intact && packet.data()[i] == i % 251;
+		}
+		uv_stop(uv_default_loop());
+	};
+
+	ListenDelegate ald;
+	ald.should_accept = [] (SocketAddress const &) { return false; };
+	ald.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&atd);
+	};
+
+	ListenDelegate bld;
+	bld.should_accept = [] (SocketAddress const &) { return true; };
+	bld.did_create_transport = [&] (UdpTransport<TransportDelegate> &t) {
+		t.setup(&btd);
+	};
+
+	EXPECT_EQ(b.listen(bld), 0);
+	EXPECT_EQ(a.dial(SocketAddress::loopback_ipv4(8019), ald), 1);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(received, size);
+	EXPECT_TRUE(intact);
+}
@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+#include "marlin/asyncio/unix/UnixTransportFactory.hpp"
+#include "marlin/asyncio/unix/UnixDatagramTransportFactory.hpp"
+
+#include <functional>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+
+TEST(UnixSocket, NamesMapBackToAddresses) {
+	auto addr = SocketAddress::from_string("10.1.2.3:8040");
+
+	sockaddr_un name;
+	auto len = unix_socket_name(name, "stream", addr);
+	auto parsed = unix_socket_address(name, len, "stream");
+	ASSERT_TRUE(parsed.has_value());
+	EXPECT_EQ(*parsed, addr);
+
+	// Dialing sockets map to the address they dial from
+	len = unix_socket_name(name, "stream", addr, "#7");
+	parsed = unix_socket_address(name, len, "stream");
+	ASSERT_TRUE(parsed.has_value());
+	EXPECT_EQ(*parsed, addr);
+
+	auto addr6 = SocketAddress::from_string("[2001:db8::1]:8040");
+	len = unix_socket_name(name, "stream", addr6);
+	parsed = unix_socket_address(name, len, "stream");
+	ASSERT_TRUE(parsed.has_value());
+	EXPECT_EQ(*parsed, addr6);
+
+	EXPECT_FALSE(unix_socket_address(name, len, "dgram").has_value());
+	EXPECT_FALSE(unix_socket_address(name, offsetof(sockaddr_un, sun_path), "stream").has_value());
+}
+
+TEST(UnixSocket, EphemeralPortsAreUnique) {
+	int a = unix_socket_open(SOCK_DGRAM), b = unix_socket_open(SOCK_DGRAM);
+	ASSERT_GE(a, 0);
+	ASSERT_GE(b, 0);
+
+	auto addr_a = SocketAddress::loopback_ipv4(0), addr_b = SocketAddress::loopback_ipv4(0);
+	EXPECT_EQ(unix_socket_bind(a, "test", addr_a), 0);
+	EXPECT_EQ(unix_socket_bind(b, "test", addr_b), 0);
+
+	EXPECT_GE(addr_a.get_port(), DEFAULT_UNIX_EPHEMERAL_PORT_START);
+	EXPECT_GE(addr_b.get_port(), DEFAULT_UNIX_EPHEMERAL_PORT_START);
+	EXPECT_FALSE(addr_a == addr_b);
+
+	close(a);
+	close(b);
+}
+
+struct Delegate {
+	std::function<void(UnixTransport<Delegate> &, Buffer &&)> did_recv_bytes;
+	std::function<void(UnixTransport<Delegate> &)> did_dial;
+	std::function<void(UnixTransport<Delegate> &, uint16_t)> did_close;
+	SocketAddress accepted;
+
+	void did_send_bytes(UnixTransport<Delegate> &, Buffer &&) {}
+
+	bool should_accept(SocketAddress const &addr) {
+		accepted = addr;
+		return true;
+	}
+
+	void did_create_transport(UnixTransport<Delegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+TEST(UnixTransport, LargeSendsArriveInOrder) {
+	size_t const count = 64;
+	size_t const size = 1000000;
+
+	Delegate sd, cd;
+	int closed = 0;
+
+	size_t received = 0;
+	bool in_order = true;
+
+	cd.did_dial = [&](UnixTransport<Delegate> &transport) {
+		for(size_t i = 0; i < count; i++) {
+			Buffer bytes(size);
+			std::memset(bytes.data(), i, size);
+			EXPECT_EQ(transport.send(std::move(bytes)), 0);
+		}
+	};
+	cd.did_recv_bytes = [](UnixTransport<Delegate> &, Buffer &&) {};
+
+	sd.did_recv_bytes = [&](UnixTransport<Delegate> &transport, Buffer &&bytes) {
+		for(size_t i = 0; i < bytes.size(); i++) {
+			in_order = in_order && bytes.data()[i] == (uint8_t)((received + i) / size);
+		}
+		received += bytes.size();
+		if(received == count * size) {
+			transport.close();
+		}
+	};
+	sd.did_close = [&](UnixTransport<Delegate> &, uint16_t) {
+		closed++;
+		if(closed == 2) {
+			uv_stop(uv_default_loop());
+		}
+	};
+	cd.did_close = sd.did_close;
+
+	{
+		UnixTransportFactory<Delegate, Delegate> s, c;
+		ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8040)), 0);
+		ASSERT_EQ(s.listen(sd), 0);
+		ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(0)), 0);
+		ASSERT_EQ(c.dial(SocketAddress::loopback_ipv4(8040), cd), 0);
+
+		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+		// Server sees the address the client is bound to, like a tcp peer address
+		EXPECT_EQ(sd.accepted, c.addr);
+	}
+
+	// Finish closing the factory sockets
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(closed, 2);
+	EXPECT_EQ(received, count * size);
+	EXPECT_TRUE(in_order);
+}
+
+TEST(UnixTransport, DialFailsWithoutListener) {
+	Delegate d;
+	UnixTransportFactory<Delegate, Delegate> c;
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(0)), 0);
+	EXPECT_LT(c.dial(SocketAddress::loopback_ipv4(8041), d), 0);
+}
+
+struct DatagramDelegate {
+	std::function<void(UnixDatagramTransport<DatagramDelegate> &, Buffer &&)> did_recv_packet;
+	std::function<void(UnixDatagramTransport<DatagramDelegate> &)> did_dial;
+
+	void did_send_packet(UnixDatagramTransport<DatagramDelegate> &, Buffer &&) {}
+	void did_close(UnixDatagramTransport<DatagramDelegate> &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(UnixDatagramTransport<DatagramDelegate> &transport) {
+		transport.setup(this);
+	}
+};
+
+TEST(UnixDatagramTransport, PingPong) {
+	DatagramDelegate sd, cd;
+	uint32_t pongs = 0;
+
+	auto ping = [](UnixDatagramTransport<DatagramDelegate> &transport, uint32_t i) {
+		Buffer packet(4);
+		packet.write_uint32_le_unsafe(0, i);
+		EXPECT_EQ(transport.send(std::move(packet)), 0);
+	};
+
+	cd.did_dial = [&](UnixDatagramTransport<DatagramDelegate> &transport) {
+		ping(transport, 0);
+	};
+	cd.did_recv_packet = [&](UnixDatagramTransport<DatagramDelegate> &transport, Buffer &&packet) {
+		EXPECT_EQ(packet.read_uint32_le_unsafe(0), pongs);
+		EXPECT_GT(transport.last_recv_time_us, 0u);
+		if(++pongs == 1000) {
+			uv_stop(uv_default_loop());
+			return;
+		}
+		ping(transport, pongs);
+	};
+	sd.did_recv_packet = [&](UnixDatagramTransport<DatagramDelegate> &transport, Buffer &&packet) {
+		transport.send(std::move(packet));
+	};
+
+	{
+		UnixDatagramTransportFactory<DatagramDelegate, DatagramDelegate> s, c;
+		ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8042)), 0);
+		ASSERT_EQ(s.listen(sd), 0);
+		ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(0)), 0);
+		ASSERT_EQ(c.dial(SocketAddress::loopback_ipv4(8042), cd), 1);
+
+		uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+		EXPECT_NE(s.get_transport(c.addr), nullptr);
+	}
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+	EXPECT_EQ(pongs, 1000u);
+}
@@ -45,6 +45,7 @@ private:
 	using LISTPROTO = LISTPROTOWrapper<BaseMessageType>;
 	using DISCPEER = DISCPEERWrapper<BaseMessageType>;
 	using LISTPEER = LISTPEERWrapper<BaseMessageType>;
+	using LISTPEER6 = LISTPEER6Wrapper<BaseMessageType>;
 	using HEARTBEAT = HEARTBEATWrapper<BaseMessageType>;
 
 	BaseTransportFactory f;
@@ -57,6 +58,7 @@ private:
 
 	void send_DISCPEER(BaseTransport &transport);
 	void did_recv_LISTPEER(BaseTransport &transport, LISTPEER &&packet);
+	void did_recv_LISTPEER6(BaseTransport &transport, LISTPEER6 &&packet);
 
 	void send_HEARTBEAT(BaseTransport &transport);
 
@@ -186,13 +188,13 @@ void DISCOVERYCLIENT::did_recv_LISTPROTO(
 }
 
 /*!
-	sends peer discovery message
+	sends peer discovery message, advertising support for IPv6 peers
 */
 template<DISCOVERYCLIENT_TEMPLATE>
 void DISCOVERYCLIENT::send_DISCPEER(
 	BaseTransport &transport
 ) {
-	transport.send(DISCPEER());
+	transport.send(DISCPEER(BEACON_FEATURE_IPV6_PEERS));
 }
 
 /*!
@@ -218,6 +220,29 @@ void DISCOVERYCLIENT::did_recv_LISTPEER(
 	}
 }
 
+/*!
+	\li Callback on receipt of list peers with IPv6 addresses
+	\li Tries to connect to each of the peers via dial
+*/
+template<DISCOVERYCLIENT_TEMPLATE>
+void DISCOVERYCLIENT::did_recv_LISTPEER6(
+	BaseTransport &transport [[maybe_unused]],
+	LISTPEER6 &&packet
+) {
+	SPDLOG_DEBUG("LISTPEER6 <<< {}", transport.dst_addr.to_string());
+
+	if(!packet.validate()) {
+		return;
+	}
+
+	for(auto iter = packet.peers_begin(); iter != packet.peers_end(); ++iter) {
+		auto [peer_addr, key] = *iter;
+		node_key_map[peer_addr] = key;
+
+		f.dial(peer_addr, *this);
+	}
+}
+
 /*!
 	sends heartbeat message to refresh/create entry at the discovery server to keep the node discoverable
 */
@@ -296,6 +321,7 @@ void DISCOVERYCLIENT::did_dial(
 	\li 2			:	ERROR - DISCPEER, meant for server
 	\li 3			:	LISTPEER
 	\li 4			:	ERROR- HEARTBEAT, meant for server
+	\li 5			:	LISTPEER6
 */
 template<DISCOVERYCLIENT_TEMPLATE>
 void DISCOVERYCLIENT::did_recv_packet(
@@ -323,6 +349,9 @@ void DISCOVERYCLIENT::did_recv_packet(
 		// HEARTBEAT
 		case 4: SPDLOG_ERROR("Unexpected HEARTBEAT from {}", transport.dst_addr.to_string());
 		break;
+		// PEERLIST6
+		case 5: did_recv_LISTPEER6(transport, std::move(packet));
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN <<< {}", transport.dst_addr.to_string());
 		break;
@@ -355,6 +384,9 @@ void DISCOVERYCLIENT::did_send_packet(
 		// HEARTBEAT
 		case 4: SPDLOG_TRACE("HEARTBEAT >>> {}", transport.dst_addr.to_string());
 		break;
+		// LISTPEER6
+		case 5: SPDLOG_TRACE("LISTPEER6 >>> {}", transport.dst_addr.to_string());
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN >>> {}", transport.dst_addr.to_string());
 		break;
@@ -46,6 +46,7 @@ private:
 	using LISTPROTO = LISTPROTOWrapper<BaseMessageType>;
 	using DISCPEER = DISCPEERWrapper<BaseMessageType>;
 	using LISTPEER = LISTPEERWrapper<BaseMessageType>;
+	using LISTPEER6 = LISTPEER6Wrapper<BaseMessageType>;
 	using HEARTBEAT = HEARTBEATWrapper<BaseMessageType>;
 
 	BaseTransportFactory f;
@@ -54,8 +55,8 @@ private:
 	void did_recv_DISCPROTO(BaseTransport &transport);
 	void send_LISTPROTO(BaseTransport &transport);
 
-	void did_recv_DISCPEER(BaseTransport &transport);
-	void send_LISTPEER(BaseTransport &transport);
+	void did_recv_DISCPEER(BaseTransport &transport, DISCPEER &&packet);
+	void send_LISTPEER(BaseTransport &transport, bool with_ipv6);
 
 	void did_recv_HEARTBEAT(BaseTransport &transport, HEARTBEAT &&bytes);
 
@@ -107,37 +108,54 @@ void DiscoveryServer<DiscoveryServerDelegate>::send_LISTPROTO(
 
 /*!
 	\li Callback on receipt of disc peer
-	\li Sends back the list of peers
+	\li Sends back the list of peers, IPv6 peers only if the client supports them
 */
 template<typename DiscoveryServerDelegate>
 void DiscoveryServer<DiscoveryServerDelegate>::did_recv_DISCPEER(
-	BaseTransport &transport
+	BaseTransport &transport,
+	DISCPEER &&packet
 ) {
 	SPDLOG_DEBUG("DISCPEER <<< {}", transport.dst_addr.to_string());
 
-	send_LISTPEER(transport);
+	send_LISTPEER(transport, packet.features() & BEACON_FEATURE_IPV6_PEERS);
 }
 
 
 /*!
-	sends the list of peers on this node
+	\li sends the list of peers on this node
+	\li IPv4 peers go in LISTPEER which every client understands, IPv6 peers in LISTPEER6
 */
 template<typename DiscoveryServerDelegate>
 void DiscoveryServer<DiscoveryServerDelegate>::send_LISTPEER(
-	BaseTransport &transport
+	BaseTransport &transport,
+	bool with_ipv6
 ) {
-	// Filter out the dst transport
-	auto filter = [&](auto x) { return x.first != &transport; };
-	auto f_begin = boost::make_filter_iterator(filter, peers.begin(), peers.end());
-	auto f_end = boost::make_filter_iterator(filter, peers.end(), peers.end());
-
-	// Extract data into pair<addr, key> format
-	auto transformation = [](auto x) { return std::make_pair(x.first->dst_addr, x.second.second); };
-	auto t_begin = boost::make_transform_iterator(f_begin, transformation);
-	auto t_end = boost::make_transform_iterator(f_end, transformation);
-
-	while(t_begin != t_end) {
-		transport.send(LISTPEER(150).set_peers(t_begin, t_end));
+	// Peers of one family other than the dst transport, in pair<addr, key> format
+	auto list = [&](bool ipv6) {
+		auto filter = [&](auto x) { return x.first != &transport && x.first->dst_addr.is_ipv6() == ipv6; };
+		auto f_begin = boost::make_filter_iterator(filter, peers.begin(), peers.end());
+		auto f_end = boost::make_filter_iterator(filter, peers.end(), peers.end());
+
+		auto transformation = [](auto x) { return std::make_pair(x.first->dst_addr, x.second.second); };
+		return std::make_pair(
+			boost::make_transform_iterator(f_begin, transformation),
+			boost::make_transform_iterator(f_end, transformation)
+		);
+	};
+
+	// Packets stay within 1202 bytes
+	auto [v4_begin, v4_end] = list(false);
+	while(v4_begin != v4_end) {
+		transport.send(LISTPEER(30).set_peers(v4_begin, v4_end));
+	}
+
+	if(!with_ipv6) {
+		return;
+	}
+
+	auto [v6_begin, v6_end] = list(true);
+	while(v6_begin != v6_end) {
+		transport.send(LISTPEER6(23).set_peers(v6_begin, v6_end));
 	}
 }
 
@@ -223,6 +241,7 @@ void DiscoveryServer<DiscoveryServerDelegate>::did_dial(
 	\li 2			:	DISCPEER
 	\li 3			:	ERROR - LISTPEER, meant for client
 	\li 4			:	HEARTBEAT
+	\li 5			:	ERROR - LISTPEER6, meant for client
 */
 template<typename DiscoveryServerDelegate>
 void DiscoveryServer<DiscoveryServerDelegate>::did_recv_packet(
@@ -242,7 +261,7 @@ void DiscoveryServer<DiscoveryServerDelegate>::did_recv_packet(
 		case 1: SPDLOG_ERROR("Unexpected LISTPROTO from {}", transport.dst_addr.to_string());
 		break;
 		// DISCOVER
-		case 2: did_recv_DISCPEER(transport);
+		case 2: did_recv_DISCPEER(transport, std::move(packet));
 		break;
 		// PEERLIST
 		case 3: SPDLOG_ERROR("Unexpected LISTPEER from {}", transport.dst_addr.to_string());
@@ -250,6 +269,9 @@ void DiscoveryServer<DiscoveryServerDelegate>::did_recv_packet(
 		// HEARTBEAT
 		case 4: did_recv_HEARTBEAT(transport, std::move(packet));
 		break;
+		// PEERLIST6
+		case 5: SPDLOG_ERROR("Unexpected LISTPEER6 from {}", transport.dst_addr.to_string());
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN <<< {}", transport.dst_addr.to_string());
 		break;
@@ -282,6 +304,9 @@ void DiscoveryServer<DiscoveryServerDelegate>::did_send_packet(
 		// HEARTBEAT
 		case 4: SPDLOG_TRACE("HEARTBEAT >>> {}", transport.dst_addr.to_string());
 		break;
+		// LISTPEER6
+		case 5: SPDLOG_TRACE("LISTPEER6 >>> {}", transport.dst_addr.to_string());
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN >>> {}", transport.dst_addr.to_string());
 		break;
@@ -3,6 +3,8 @@
 
 #include <marlin/core/Buffer.hpp>
 
+/// Client accepts IPv6 peers in LISTPEER6
+#define BEACON_FEATURE_IPV6_PEERS 0x01
 
 namespace marlin {
 namespace beacon {
@@ -160,11 +162,14 @@ struct LISTPROTOWrapper {
 /*!
 \verbatim
 
-0               1               2
-0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0
-+++++++++++++++++++++++++++++++++
-|      0x00     |      0x02     |
-+++++++++++++++++++++++++++++++++
+0               1               2               3
+0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0
++++++++++++++++++++++++++++++++++++++++++++++++++
+|      0x00     |      0x02     |   Features    |
++++++++++++++++++++++++++++++++++++++++++++++++++
+
+Features are optional, clients from before them send only the first two bytes
+and old servers ignore the rest.
 
 \endverbatim
 */
@@ -176,8 +181,19 @@ struct DISCPEERWrapper {
 		return std::move(base);
 	}
 
-	DISCPEERWrapper() : base(2) {
-		base.set_payload({0, 2});
+	DISCPEERWrapper(uint8_t features = 0) : base(features == 0 ? 2 : 3) {
+		if(features == 0) {
+			base.set_payload({0, 2});
+		} else {
+			base.set_payload({0, 2, features});
+		}
+	}
+
+	DISCPEERWrapper(BaseMessageType&& base) : base(std::move(base)) {}
+
+	/// Features advertised by the client, none if absent
+	uint8_t features() const {
+		return base.payload_buffer().read_uint8(2).value_or(0);
 	}
 };
 
@@ -210,6 +226,8 @@ struct DISCPEERWrapper {
 |            Port (N)           |
 +++++++++++++++++++++++++++++++++
 
+Only carries IPv4 peers, IPv6 peers go in LISTPEER6 to clients which support it.
+
 \endverbatim
 */
 template<typename BaseMessageType>
@@ -220,7 +238,8 @@ struct LISTPEERWrapper {
 		return std::move(base);
 	}
 
-	LISTPEERWrapper(size_t num_peer = 0) : base(2+8*num_peer) {
+	/// Room for num_peer peers
+	LISTPEERWrapper(size_t num_peer = 0) : base(2+(8+crypto_box_PUBLICKEYBYTES)*num_peer) {
 		base.set_payload({0, 3});
 	}
 
@@ -352,6 +371,135 @@ struct HEARTBEATWrapper {
 	}
 };
 
+/*!
+\verbatim
+
+0               1               2               3
+0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7 0 1 2 3 4 5 6 7
++++++++++++++++++++++++++++++++++
+|      0x00     |      0x05     |
+---------------------------------
+|           AF_INET6            |
+-----------------------------------------------------------------
+|                        IPv6 Address (1)                       |
+-----------------------------------------------------------------
+|            Port (1)           |
+-----------------------------------------------------------------
+|                       Static Key (1)                          |
+-----------------------------------------------------------------
+|                              ...                              |
+-----------------------------------------------------------------
+|           AF_INET6            |
+-----------------------------------------------------------------
+|                        IPv6 Address (N)                       |
+-----------------------------------------------------------------
+|            Port (N)           |
+-----------------------------------------------------------------
+|                       Static Key (N)                          |
++++++++++++++++++++++++++++++++++
+
+Same layout as LISTPEER with 20 byte IPv6 addresses, AF_INET6 is 10 on the wire.
+Only sent to clients advertising BEACON_FEATURE_IPV6_PEERS in DISCPEER.
+
+\endverbatim
+*/
+template<typename BaseMessageType>
+struct LISTPEER6Wrapper {
+	BaseMessageType base;
+
+	operator BaseMessageType() && {
+		return std::move(base);
+	}
+
+	/// Room for num_peer peers
+	LISTPEER6Wrapper(size_t num_peer = 0) : base(2+(20+crypto_box_PUBLICKEYBYTES)*num_peer) {
+		base.set_payload({0, 5});
+	}
+
+	LISTPEER6Wrapper(BaseMessageType&& base) : base(std::move(base)) {}
+
+	template<typename It>
+	LISTPEER6Wrapper& set_peers(It& begin, It end) & {
+		size_t idx = 2;
+		while(begin != end && idx + 20 + crypto_box_PUBLICKEYBYTES <= base.payload_buffer().size()) {
+			begin->first.serialize(base.payload()+idx, 20);
+			base.payload_buffer().write_unsafe(idx+20, begin->second.data(), crypto_box_PUBLICKEYBYTES);
+			idx += 20 + crypto_box_PUBLICKEYBYTES;
+
+			++begin;
+		}
+		base.truncate_unsafe(base.payload_buffer().size() - idx);
+
+		return *this;
+	}
+
+	template<typename It>
+	LISTPEER6Wrapper&& set_peers(It& begin, It end) && {
+		return std::move(set_peers(begin, end));
+	}
+
+	[[nodiscard]] bool validate() const {
+		auto const &buf = base.payload_buffer();
+		if(buf.size() < 2 || (buf.size() - 2) % (20 + crypto_box_PUBLICKEYBYTES) != 0) {
+			return false;
+		}
+
+		// Every address has to be IPv6
+		for(size_t offset = 2; offset < buf.size(); offset += 20 + crypto_box_PUBLICKEYBYTES) {
+			if(core::SocketAddress::serialized_size(buf.data()+offset, 20) != 20) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	struct iterator {
+	private:
+		core::WeakBuffer buf;
+		size_t offset = 0;
+	public:
+		// For iterator_traits
+		using difference_type = int32_t;
+		using value_type = std::tuple<core::SocketAddress, std::array<uint8_t, 32>>;
+		using pointer = value_type const*;
+		using reference = value_type const&;
+		using iterator_category = std::input_iterator_tag;
+
+		iterator(core::WeakBuffer buf, size_t offset = 0) : buf(buf), offset(offset) {}
+
+		value_type operator*() const {
+			auto peer_addr = core::SocketAddress::deserialize(buf.data()+offset, 20);
+			std::array<uint8_t, 32> key;
+			buf.read_unsafe(offset+20, key.data(), crypto_box_PUBLICKEYBYTES);
+
+			return std::make_tuple(peer_addr, key);
+		}
+
+		iterator& operator++() {
+			offset += 20 + crypto_box_PUBLICKEYBYTES;
+
+			return *this;
+		}
+
+		bool operator==(iterator const& other) const {
+			return offset == other.offset;
+		}
+
+		bool operator!=(iterator const& other) const {
+			return !(*this == other);
+		}
+	};
+
+	iterator peers_begin() const {
+		return iterator(base.payload_buffer(), 2);
+	}
+
+	iterator peers_end() const {
+		// Relies on validation ensuring every peer is complete
+		return iterator(base.payload_buffer(), base.payload_buffer().size());
+	}
+};
+
 } // namespace beacon
 } // namespace marlin
 
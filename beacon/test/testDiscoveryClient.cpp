@@ -39,6 +39,75 @@ struct Delegate {
 	};
 };
 
+TEST(DiscoveryClientTest, ListsIPv4PeersInOldFormat) {
+	std::vector<std::pair<SocketAddress, std::array<uint8_t, 32>>> peers;
+	for(auto addr : {"192.168.0.1:8000", "192.168.0.2:8002"}) {
+		std::array<uint8_t, 32> key;
+		key.fill(peers.size());
+		peers.emplace_back(SocketAddress::from_string(addr), key);
+	}
+
+	auto begin = peers.begin();
+	LISTPEERWrapper<BaseMessage> packet(LISTPEERWrapper<BaseMessage>(30).set_peers(begin, peers.end()));
+	EXPECT_EQ(begin, peers.end());
+	// Old clients expect 40 bytes per peer with an 8 byte address
+	EXPECT_EQ(packet.base.payload_buffer().size(), 2u + 40 + 40);
+	EXPECT_EQ(packet.base.payload_buffer().read_uint8_unsafe(1), 3);
+	uint8_t addr[8];
+	peers[1].first.serialize(addr, 8);
+	EXPECT_EQ(std::memcmp(packet.base.payload_buffer().data()+42, addr, 8), 0);
+	ASSERT_TRUE(packet.validate());
+
+	size_t idx = 0;
+	for(auto iter = packet.peers_begin(); iter != packet.peers_end(); ++iter, ++idx) {
+		auto [addr, key] = *iter;
+		ASSERT_LT(idx, peers.size());
+		EXPECT_EQ(addr, peers[idx].first);
+		EXPECT_EQ(key, peers[idx].second);
+	}
+	EXPECT_EQ(idx, peers.size());
+}
+
+TEST(DiscoveryClientTest, ListsIPv6PeersSeparately) {
+	std::vector<std::pair<SocketAddress, std::array<uint8_t, 32>>> peers;
+	for(auto addr : {"[2001:db8::1]:8000", "[2001:db8::2]:8001", "[2001:db8::3]:8002"}) {
+		std::array<uint8_t, 32> key;
+		key.fill(peers.size());
+		peers.emplace_back(SocketAddress::from_string(addr), key);
+	}
+
+	// Only fits the requested number of peers
+	auto begin = peers.begin();
+	LISTPEER6Wrapper<BaseMessage> packet(LISTPEER6Wrapper<BaseMessage>(2).set_peers(begin, peers.end()));
+	EXPECT_EQ(begin, peers.begin() + 2);
+	EXPECT_EQ(packet.base.payload_buffer().size(), 2u + 52 + 52);
+	EXPECT_EQ(packet.base.payload_buffer().read_uint8_unsafe(1), 5);
+	ASSERT_TRUE(packet.validate());
+
+	size_t idx = 0;
+	for(auto iter = packet.peers_begin(); iter != packet.peers_end(); ++iter, ++idx) {
+		auto [addr, key] = *iter;
+		ASSERT_LT(idx, 2u);
+		EXPECT_EQ(addr, peers[idx].first);
+		EXPECT_EQ(key, peers[idx].second);
+	}
+	EXPECT_EQ(idx, 2u);
+
+	// Truncated peers are rejected
+	packet.base.truncate_unsafe(1);
+	EXPECT_FALSE(packet.validate());
+}
+
+TEST(DiscoveryClientTest, AdvertisesFeaturesInDiscpeer) {
+	DISCPEERWrapper<BaseMessage> old_packet;
+	EXPECT_EQ(old_packet.base.payload_buffer().size(), 2u);
+	EXPECT_EQ(old_packet.features(), 0);
+
+	DISCPEERWrapper<BaseMessage> packet(BEACON_FEATURE_IPV6_PEERS);
+	EXPECT_EQ(packet.base.payload_buffer().size(), 3u);
+	EXPECT_EQ(packet.features(), BEACON_FEATURE_IPV6_PEERS);
+}
+
 TEST(DiscoveryClientTest, Constructible) {
 	uint8_t static_sk[crypto_box_SECRETKEYBYTES];
 	uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
@@ -134,9 +203,10 @@ TEST_F(DiscoveryClientProtocolTest, DiscoversPeers) {
 		EXPECT_EQ(addr.to_string(), "192.168.0.1:8002");
 
 		// Check packet
-		EXPECT_EQ(packet.size(), 2);  // Size
+		EXPECT_EQ(packet.size(), 3);  // Size
 		EXPECT_EQ(packet.read_uint8(0), 0);  // Version
 		EXPECT_EQ(packet.read_uint8(1), 2);  // DISCPEER
+		EXPECT_EQ(packet.read_uint8(2), BEACON_FEATURE_IPV6_PEERS);  // Features
 
 		if(simulator.current_tick() > 100000) {
 			client.close();
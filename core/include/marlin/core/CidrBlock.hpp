@@ -18,12 +18,15 @@ public:
 	/// Copy from another CidrBlock
 	CidrBlock(const CidrBlock &addr);
 
-	/// Build from block string
+	/// Build from block string, either a.b.c.d/len or IPv6/len
 	static CidrBlock from_string(std::string blockString);
 	/// Return the block in standard notation
 	std::string to_string() const;
 
-	/// Returns true if the block contains addr
+	/// Prefix length over IPv4 mapped addresses, IPv4 blocks are 96 bits longer
+	uint8_t mapped_prefix_length() const;
+
+	/// Returns true if the block contains addr, IPv4 blocks also contain the IPv4 mapped IPv6 addresses
 	bool does_contain_address(const SocketAddress &addr) const;
 };
 
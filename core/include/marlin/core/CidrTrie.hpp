@@ -0,0 +1,287 @@
+/*! \file CidrTrie.hpp
+*/
+
+#ifndef MARLIN_CORE_CIDRTRIE_HPP
+#define MARLIN_CORE_CIDRTRIE_HPP
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "marlin/core/CidrBlock.hpp"
+
+namespace marlin {
+namespace core {
+
+/// Path compressed binary trie over CIDR blocks with longest prefix match lookup
+///
+/// IPv4 and IPv6 blocks share one trie over IPv4 mapped addresses, so a lookup walks at most
+/// one node per stored prefix on the path and compares 128 bit keys with a couple of word operations.
+/// Nodes live in one vector and link by index to keep lookups cache friendly.
+template<typename ValueType>
+class CidrTrie {
+	struct Key {
+		uint64_t hi;
+		uint64_t lo;
+	};
+
+	struct Node {
+		Key key;
+		uint8_t length;
+		bool has_value;
+		ValueType value;
+		/// Index of the child continuing with a 0 or 1 bit after length, -1 if none
+		int32_t child[2];
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int32_t> free_nodes;
+	int32_t root = -1;
+	size_t count = 0;
+
+	static Key key_of(SocketAddress const &addr) {
+		PackedAddress packed(addr);
+		Key key = {0, 0};
+		for(int i = 0; i < 8; i++) {
+			key.hi = (key.hi << 8) | packed.bytes[i];
+			key.lo = (key.lo << 8) | packed.bytes[8 + i];
+		}
+		return key;
+	}
+
+	/// Keep the first length bits, clear the rest
+	static Key mask(Key key, uint8_t length) {
+		if(length == 0) {
+			return {0, 0};
+		}
+		if(length <= 64) {
+			return {key.hi & (~0ULL << (64 - length)), 0};
+		}
+		return {key.hi, key.lo & (~0ULL << (128 - length))};
+	}
+
+	/// Bit at the given index, counting from the most significant bit
+	static int bit(Key const &key, uint8_t index) {
+		if(index < 64) {
+			return (key.hi >> (63 - index)) & 1;
+		}
+		return (key.lo >> (127 - index)) & 1;
+	}
+
+	/// Number of leading bits the keys have in common
+	static uint8_t common_length(Key const &a, Key const &b) {
+		if(a.hi != b.hi) {
+			return __builtin_clzll(a.hi ^ b.hi);
+		}
+		if(a.lo != b.lo) {
+			return 64 + __builtin_clzll(a.lo ^ b.lo);
+		}
+		return 128;
+	}
+
+	int32_t create(Key const &key, uint8_t length) {
+		Node node = {key, length, false, ValueType(), {-1, -1}};
+		if(!free_nodes.empty()) {
+			auto idx = free_nodes.back();
+			free_nodes.pop_back();
+			nodes[idx] = std::move(node);
+			return idx;
+		}
+
+		nodes.push_back(std::move(node));
+		return nodes.size() - 1;
+	}
+
+	/// Slot pointing at idx, either the root or a child of parent
+	int32_t &link(int32_t parent, int32_t idx) {
+		if(parent == -1) {
+			return root;
+		}
+		return nodes[parent].child[nodes[parent].child[0] == idx ? 0 : 1];
+	}
+
+	/// Removes a node without a value if it has less than two children, splicing in the remaining child
+	void compact(int32_t parent, int32_t idx) {
+		auto &node = nodes[idx];
+		if(node.has_value || (node.child[0] != -1 && node.child[1] != -1)) {
+			return;
+		}
+
+		link(parent, idx) = node.child[0] != -1 ? node.child[0] : node.child[1];
+		free_nodes.push_back(idx);
+	}
+public:
+	/// Add a block or replace its value, returns true if the block is new
+	bool insert(CidrBlock const &block, ValueType value) {
+		uint8_t length = block.mapped_prefix_length();
+		Key key = mask(key_of(block), length);
+
+		int32_t parent = -1;
+		int32_t idx = root;
+		while(idx != -1) {
+			auto common = common_length(nodes[idx].key, key);
+			common = std::min(common, std::min(nodes[idx].length, length));
+
+			if(common == nodes[idx].length && common == length) {
+				// Same block
+				bool created = !nodes[idx].has_value;
+				nodes[idx].has_value = true;
+				nodes[idx].value = std::move(value);
+				count += created;
+				return created;
+			}
+
+			if(common == nodes[idx].length) {
+				// Node is a prefix of the block, keep walking
+				parent = idx;
+				idx = nodes[idx].child[bit(key, common)];
+				continue;
+			}
+
+			// Block diverges within the node prefix, or is a prefix of it
+			auto split = create(mask(key, common), common);
+			nodes[split].child[bit(nodes[idx].key, common)] = idx;
+			if(common == length) {
+				nodes[split].has_value = true;
+				nodes[split].value = std::move(value);
+			} else {
+				auto leaf = create(key, length);
+				nodes[leaf].has_value = true;
+				nodes[leaf].value = std::move(value);
+				nodes[split].child[bit(key, common)] = leaf;
+			}
+			link(parent, idx) = split;
+			count++;
+			return true;
+		}
+
+		auto leaf = create(key, length);
+		nodes[leaf].has_value = true;
+		nodes[leaf].value = std::move(value);
+		if(parent == -1) {
+			root = leaf;
+		} else {
+			nodes[parent].child[bit(key, nodes[parent].length)] = leaf;
+		}
+		count++;
+		return true;
+	}
+
+	/// Remove a block, returns true if it was present
+	bool erase(CidrBlock const &block) {
+		uint8_t length = block.mapped_prefix_length();
+		Key key = mask(key_of(block), length);
+
+		int32_t grandparent = -1;
+		int32_t parent = -1;
+		int32_t idx = root;
+		while(idx != -1) {
+			auto &node = nodes[idx];
+			if(node.length > length || common_length(node.key, key) < node.length) {
+				return false;
+			}
+			if(node.length == length) {
+				break;
+			}
+			grandparent = parent;
+			parent = idx;
+			idx = node.child[bit(key, node.length)];
+		}
+		if(idx == -1 || !nodes[idx].has_value) {
+			return false;
+		}
+
+		nodes[idx].has_value = false;
+		nodes[idx].value = ValueType();
+		count--;
+
+		compact(parent, idx);
+		if(parent != -1) {
+			compact(grandparent, parent);
+		}
+		return true;
+	}
+
+	/// Value of the longest block containing addr, nullptr if no block does
+	ValueType const *longest_match(SocketAddress const &addr) const {
+		Key key = key_of(addr);
+
+		ValueType const *best = nullptr;
+		int32_t idx = root;
+		while(idx != -1) {
+			auto &node = nodes[idx];
+			if(common_length(node.key, key) < node.length) {
+				break;
+			}
+			if(node.has_value) {
+				best = &node.value;
+			}
+			if(node.length == 128) {
+				break;
+			}
+			idx = node.child[bit(key, node.length)];
+		}
+
+		return best;
+	}
+
+	/// Number of blocks
+	size_t size() const {
+		return count;
+	}
+
+	/// Remove all blocks
+	void clear() {
+		nodes.clear();
+		free_nodes.clear();
+		root = -1;
+		count = 0;
+	}
+};
+
+/// Allow and deny rules over CIDR blocks, the longest block containing an address decides
+///
+/// Addresses no rule covers are allowed, so an empty filter allows everything.
+class CidrFilter {
+	CidrTrie<bool> rules;
+public:
+	/// Allow addresses in the block, overriding deny rules of shorter blocks
+	void allow(CidrBlock const &block) {
+		rules.insert(block, true);
+	}
+
+	/// Deny addresses in the block, overriding allow rules of shorter blocks
+	void deny(CidrBlock const &block) {
+		rules.insert(block, false);
+	}
+
+	/// Remove the rule for the block, returns true if there was one
+	bool remove(CidrBlock const &block) {
+		return rules.erase(block);
+	}
+
+	/// Remove all rules
+	void clear() {
+		rules.clear();
+	}
+
+	/// Number of rules
+	size_t size() const {
+		return rules.size();
+	}
+
+	/// Returns true if addr may be accepted
+	bool is_allowed(SocketAddress const &addr) const {
+		if(rules.size() == 0) {
+			return true;
+		}
+
+		auto *rule = rules.longest_match(addr);
+		return rule == nullptr || *rule;
+	}
+};
+
+} // namespace core
+} // namespace marlin
+
+#endif // MARLIN_CORE_CIDRTRIE_HPP
@@ -2,6 +2,7 @@
 #define MARLIN_CORE_SOCKETADDRESS_HPP
 
 #include <stdint.h>
+#include <cstring>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <string>
@@ -42,9 +43,9 @@ public:
 	/// Copy assign from a sockaddr_in6
 	SocketAddress &operator=(const sockaddr_in6 &addr);
 
-	/// Build from address string
+	/// Build from address string, either a.b.c.d:port or [IPv6]:port
 	static SocketAddress from_string(std::string addrString);
-	/// Return the address and port in standard notation
+	/// Return the address and port in standard notation, IPv6 addresses are bracketed
 	std::string to_string() const;
 
 	/// Return the address
@@ -57,6 +58,11 @@ public:
 
 	/// Loopback IPv4 address
 	static SocketAddress loopback_ipv4(const uint16_t port);
+	/// Loopback IPv6 address
+	static SocketAddress loopback_ipv6(const uint16_t port);
+
+	/// Returns true for IPv6 addresses, everything else is treated as IPv4
+	bool is_ipv6() const;
 
 	/// Equality operator
 	bool operator==(const SocketAddress &other) const;
@@ -64,12 +70,60 @@ public:
 	/// Comparison operator
 	bool operator<(const SocketAddress &other) const;
 
-	/// Serialize into bytes
+	/// Serialize into bytes, 8 bytes for IPv4 and 20 bytes for IPv6,
+	/// returns the number of bytes written or 0 if they don't fit
 	size_t serialize(uint8_t* bytes, size_t size) const;
+	/// Number of bytes serialize writes
+	size_t serialized_size() const;
+	/// Number of bytes of the serialized address at the start of bytes,
+	/// returns 0 if the family is unknown or the address is truncated
+	static size_t serialized_size(uint8_t const* bytes, size_t const size);
 	/// Deserialize from bytes
 	static SocketAddress deserialize(uint8_t const* bytes, size_t const size);
 };
 
+/// Packed address and port, IPv4 addresses are stored IPv4 mapped so both families share one key space
+struct PackedAddress {
+	/// 16 address bytes followed by 2 port bytes, all in network order
+	uint8_t bytes[18];
+
+	PackedAddress() = default;
+
+	/// Pack the address and port of a socket address
+	explicit PackedAddress(SocketAddress const &addr) {
+		std::memset(bytes, 0, sizeof(bytes));
+		if(addr.is_ipv6()) {
+			auto const &in6 = reinterpret_cast<sockaddr_in6 const &>(addr);
+			std::memcpy(bytes, &in6.sin6_addr, 16);
+			std::memcpy(bytes + 16, &in6.sin6_port, 2);
+		} else {
+			auto const &in = reinterpret_cast<sockaddr_in const &>(addr);
+			bytes[10] = 0xff;
+			bytes[11] = 0xff;
+			std::memcpy(bytes + 12, &in.sin_addr, 4);
+			std::memcpy(bytes + 16, &in.sin_port, 2);
+		}
+	}
+
+	bool operator==(PackedAddress const &other) const {
+		return std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+	}
+
+	/// 64 bit hash mixing every byte of the address and port
+	uint64_t hash() const {
+		uint64_t hi, lo;
+		uint16_t port;
+		std::memcpy(&hi, bytes, 8);
+		std::memcpy(&lo, bytes + 8, 8);
+		std::memcpy(&port, bytes + 16, 2);
+
+		uint64_t h = (hi ^ 0x9e3779b97f4a7c15ULL) * 0xbf58476d1ce4e5b9ULL;
+		h = ((h ^ (h >> 31)) ^ lo) * 0x94d049bb133111ebULL;
+		h = ((h ^ (h >> 29)) ^ port) * 0xbf58476d1ce4e5b9ULL;
+		return h ^ (h >> 32);
+	}
+};
+
 } // namespace core
 } // namespace marlin
 
@@ -81,7 +135,7 @@ namespace std {
 		/// Hash function for SocketAddress so it can be used as a key
 		size_t operator()(const marlin::core::SocketAddress &addr) const
 		{
-			return std::hash<uint32_t>()(reinterpret_cast<const sockaddr_in *>(&addr)->sin_addr.s_addr) ^ std::hash<uint16_t>()(reinterpret_cast<const sockaddr_in *>(&addr)->sin_port);
+			return marlin::core::PackedAddress(addr).hash();
 		}
 	};
 }
@@ -4,36 +4,107 @@
 #ifndef MARLIN_CORE_TRANSPORTMANAGER_HPP
 #define MARLIN_CORE_TRANSPORTMANAGER_HPP
 
-#include <unordered_map>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <utility>
+#include <vector>
 #include "marlin/core/SocketAddress.hpp"
 
 namespace marlin {
 namespace core {
 
+/// Number of transports allocated together in one slab
+#define DEFAULT_TRANSPORT_MANAGER_SLAB_SIZE 64
+/// Slots in the table when the first transport is added, must be a power of two
+#define DEFAULT_TRANSPORT_MANAGER_MIN_CAPACITY 16
+
 /// Template Class which acts as a helper to store and retreive transport instances of template type against a query address
+///
+/// Open addressing table with linear probing over packed keys, transports live in slabs
+/// so their addresses stay stable while the table grows and other transports come and go
 template<typename TransportType>
 class TransportManager {
-	std::unordered_map<
-		SocketAddress,
-		TransportType
-	> transport_map;
+	struct Slot {
+		/// nullptr if the slot is empty
+		TransportType *transport;
+		PackedAddress key;
+	};
+
+	using Storage = std::aligned_storage_t<sizeof(TransportType), alignof(TransportType)>;
+
+	std::unique_ptr<Slot[]> slots;
+	/// Always a power of two, or zero before the first insert
+	size_t capacity = 0;
+	size_t count = 0;
+
+	std::vector<std::unique_ptr<Storage[]>> slabs;
+	/// Slots handed out from the last slab
+	size_t slab_used = DEFAULT_TRANSPORT_MANAGER_SLAB_SIZE;
+	/// Storage of erased transports, reused before carving from the last slab
+	std::vector<Storage *> free_list;
 
 	// Prevent copy, causes subtle bugs with objects holding onto different instances because of implicit copy somewhere
 	TransportManager(TransportManager const&) = delete;
+
+	/// Index of the slot holding key, or of the empty slot ending its probe sequence
+	size_t find(PackedAddress const &key) const {
+		size_t mask = capacity - 1;
+		size_t idx = key.hash() & mask;
+		while(slots[idx].transport != nullptr && !(slots[idx].key == key)) {
+			idx = (idx + 1) & mask;
+		}
+		return idx;
+	}
+
+	/// Rehash into a table with the given number of slots
+	void resize(size_t new_capacity) {
+		auto old_slots = std::move(slots);
+		auto old_capacity = capacity;
+
+		slots.reset(new Slot[new_capacity]());
+		capacity = new_capacity;
+		for(size_t i = 0; i < old_capacity; i++) {
+			if(old_slots[i].transport != nullptr) {
+				slots[find(old_slots[i].key)] = old_slots[i];
+			}
+		}
+	}
+
+	Storage *allocate() {
+		if(!free_list.empty()) {
+			auto *storage = free_list.back();
+			free_list.pop_back();
+			return storage;
+		}
+
+		if(slab_used == DEFAULT_TRANSPORT_MANAGER_SLAB_SIZE) {
+			slabs.emplace_back(new Storage[DEFAULT_TRANSPORT_MANAGER_SLAB_SIZE]);
+			slab_used = 0;
+		}
+		return &slabs.back()[slab_used++];
+	}
 public:
 	/// Default constructor
 	TransportManager() = default;
 
+	/// Destroys transports still in the table
+	~TransportManager() {
+		for(size_t i = 0; i < capacity; i++) {
+			if(slots[i].transport != nullptr) {
+				slots[i].transport->~TransportType();
+			}
+		}
+	}
+
 	/// Get transport with a given destination address,
 	/// returns nullptr if no transport is found
 	TransportType *get(SocketAddress const &addr) {
-		auto iter = transport_map.find(addr);
-		if(iter == transport_map.end()) {
+		if(count == 0) {
 			return nullptr;
 		}
 
-		return &iter->second;
+		return slots[find(PackedAddress(addr))].transport;
 	}
 
 	/// Get transport with a given destination address,
@@ -43,16 +114,64 @@ public:
 		SocketAddress const &addr,
 		Args&&... args
 	) {
-		auto res = transport_map.try_emplace(
-			addr,
-			std::forward<Args>(args)...
-		);
-		return std::make_pair(&res.first->second, res.second);
+		PackedAddress key(addr);
+		if(count > 0) {
+			auto *transport = slots[find(key)].transport;
+			if(transport != nullptr) {
+				return std::make_pair(transport, false);
+			}
+		}
+
+		// Constructed before probing for a slot, the constructor may use the manager
+		auto *storage = allocate();
+		auto *transport = new (storage) TransportType(std::forward<Args>(args)...);
+
+		// Keep the load factor under 3/4
+		if((count + 1) * 4 > capacity * 3) {
+			resize(capacity == 0 ? DEFAULT_TRANSPORT_MANAGER_MIN_CAPACITY : capacity * 2);
+		}
+		auto idx = find(key);
+		slots[idx].transport = transport;
+		slots[idx].key = key;
+		count++;
+
+		return std::make_pair(transport, true);
 	}
 
 	/// Remove transport with the given destination address
 	void erase(SocketAddress const &addr) {
-		transport_map.erase(addr);
+		if(count == 0) {
+			return;
+		}
+
+		// Packed before destroying anything, addr usually belongs to the transport being erased
+		size_t mask = capacity - 1;
+		size_t idx = find(PackedAddress(addr));
+		auto *transport = slots[idx].transport;
+		if(transport == nullptr) {
+			return;
+		}
+
+		// Backward shift deletion, pull later entries of the probe sequence into the hole
+		size_t hole = idx;
+		for(size_t next = (hole + 1) & mask; slots[next].transport != nullptr; next = (next + 1) & mask) {
+			size_t home = slots[next].key.hash() & mask;
+			if(((next - home) & mask) >= ((next - hole) & mask)) {
+				slots[hole] = slots[next];
+				hole = next;
+			}
+		}
+		slots[hole].transport = nullptr;
+		count--;
+
+		// Table is consistent again, so the destructor may use the manager
+		transport->~TransportType();
+		free_list.push_back(reinterpret_cast<Storage *>(transport));
+	}
+
+	/// Number of transports
+	size_t size() const {
+		return count;
 	}
 };
 
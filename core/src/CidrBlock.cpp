@@ -12,45 +12,53 @@ CidrBlock::CidrBlock() : SocketAddress() {}
 CidrBlock::CidrBlock(const CidrBlock &addr) : SocketAddress(addr) {}
 
 CidrBlock CidrBlock::from_string(std::string blockString) {
-	// TODO: Add support for other formats
 	CidrBlock addr;
-	inet_pton(AF_INET, blockString.substr(0,blockString.find("/")).c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr);
-	reinterpret_cast<sockaddr_in *>(&addr)->sin_port = htons(std::stoi(blockString.substr(blockString.find("/")+1)));
-	reinterpret_cast<sockaddr_in *>(&addr)->sin_family = AF_INET;
+
+	// IPv6 blocks are written without brackets, a.b.c.d/len or IPv6/len
+	auto slash = blockString.find("/");
+	auto ip = blockString.substr(0, slash);
+	if(ip.find(":") != std::string::npos) {
+		auto *in6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		in6->sin6_family = AF_INET6;
+		inet_pton(AF_INET6, ip.c_str(), &in6->sin6_addr);
+	} else {
+		inet_pton(AF_INET, ip.c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr);
+	}
+	addr.set_port(std::stoi(blockString.substr(slash+1)));
+
 	return addr;
 }
 
 std::string CidrBlock::to_string() const {
-	// TODO: Add support for other formats
-	char buf[100];
-	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, 100);
-
 	std::stringstream blockString;
-	blockString<<buf<<"/"<<ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
+	blockString<<ip_string()<<"/"<<get_port();
 
 	return blockString.str();
 }
 
+uint8_t CidrBlock::mapped_prefix_length() const {
+	// IPv4 blocks cover the IPv4 mapped range
+	uint16_t prefix_length = is_ipv6() ? get_port() : get_port() + 96;
+	return prefix_length > 128 ? 128 : prefix_length;
+}
+
 bool CidrBlock::does_contain_address(const SocketAddress &addr) const {
-	char *_prefix = (char *)&(reinterpret_cast<const sockaddr_in *>(this)->sin_addr);
-	uint16_t _prefix_length = ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
-
-	char *_addr = (char *)&(reinterpret_cast<const sockaddr_in *>(&addr)->sin_addr);
-
-	for (int i=0; i<4 && _prefix_length>0; i++) {
-		if (_prefix_length >= 8) {
-			if (_addr[i] != _prefix[i]) {
-				return false;
-			}
-		} else {
-			if ((_addr[i]>>(8-_prefix_length)) != (_prefix[i]>>(8-_prefix_length))) {
-				return false;
-			}
-		}
-		_prefix_length -= 8;
+	// Compared as IPv4 mapped addresses, so IPv4 blocks match IPv4 mapped IPv6 addresses too
+	PackedAddress prefix(*this), packed(addr);
+	uint8_t prefix_length = mapped_prefix_length();
+
+	size_t full = prefix_length / 8;
+	if(std::memcmp(prefix.bytes, packed.bytes, full) != 0) {
+		return false;
+	}
+
+	uint8_t rest = prefix_length % 8;
+	if(rest == 0) {
+		return true;
 	}
 
-	return true;
+	uint8_t mask = 0xff << (8 - rest);
+	return (prefix.bytes[full] & mask) == (packed.bytes[full] & mask);
 }
 
 } // namespace core
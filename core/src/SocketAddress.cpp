@@ -30,36 +30,54 @@ SocketAddress &SocketAddress::operator=(const sockaddr_storage &addr) {
 	return *this;
 }
 
+// Copies only as much as the family needs, addr usually points into a smaller struct
 SocketAddress::SocketAddress(const sockaddr &addr) {
-	memcpy(this, &addr, sizeof(SocketAddress));
+	*this = addr;
 }
 
 SocketAddress &SocketAddress::operator=(const sockaddr &addr) {
-	memcpy(this, &addr, sizeof(SocketAddress));
+	memset(this, 0, sizeof(SocketAddress));
+	if(addr.sa_family == AF_INET6) {
+		memcpy(this, &addr, sizeof(sockaddr_in6));
+	} else {
+		memcpy(this, &addr, sizeof(sockaddr_in));
+	}
 	return *this;
 }
 
 SocketAddress::SocketAddress(const sockaddr_in &addr) {
-	memcpy(this, &addr, sizeof(SocketAddress));
+	*this = addr;
 }
 
 SocketAddress &SocketAddress::operator=(const sockaddr_in &addr) {
-	memcpy(this, &addr, sizeof(SocketAddress));
+	memset(this, 0, sizeof(SocketAddress));
+	memcpy(this, &addr, sizeof(sockaddr_in));
 	return *this;
 }
 
 SocketAddress::SocketAddress(const sockaddr_in6 &addr) {
-	memcpy(this, &addr, sizeof(SocketAddress));
+	*this = addr;
 }
 
 SocketAddress &SocketAddress::operator=(const sockaddr_in6 &addr) {
-	memcpy(this, &addr, sizeof(SocketAddress));
+	memset(this, 0, sizeof(SocketAddress));
+	memcpy(this, &addr, sizeof(sockaddr_in6));
 	return *this;
 }
 
 SocketAddress SocketAddress::from_string(std::string addrString) {
-	// TODO: Add support for other formats
 	SocketAddress addr;
+
+	// [IPv6]:port
+	if(addrString.size() > 0 && addrString[0] == '[') {
+		auto end = addrString.find("]");
+		auto *in6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		in6->sin6_family = AF_INET6;
+		inet_pton(AF_INET6, addrString.substr(1, end - 1).c_str(), &in6->sin6_addr);
+		in6->sin6_port = htons(std::stoi(addrString.substr(addrString.find(":", end)+1)));
+		return addr;
+	}
+
 	inet_pton(AF_INET, addrString.substr(0,addrString.find(":")).c_str(), &reinterpret_cast<sockaddr_in *>(&addr)->sin_addr);
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_port = htons(std::stoi(addrString.substr(addrString.find(":")+1)));
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_family = AF_INET;
@@ -67,36 +85,54 @@ SocketAddress SocketAddress::from_string(std::string addrString) {
 }
 
 std::string SocketAddress::to_string() const {
-	// TODO: Add support for other formats
-	char buf[100];
-	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, 100);
-
 	std::stringstream addrString;
-	addrString<<buf<<":"<<ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
+	if(is_ipv6()) {
+		addrString<<"["<<ip_string()<<"]:"<<get_port();
+	} else {
+		addrString<<ip_string()<<":"<<get_port();
+	}
 
 	return addrString.str();
 }
 
 std::string SocketAddress::ip_string() const {
-	// TODO: Add support for other formats
-	char buf[100];
-	inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, 100);
+	char buf[INET6_ADDRSTRLEN];
+	if(is_ipv6()) {
+		inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 *>(this)->sin6_addr, buf, sizeof(buf));
+	} else {
+		inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in *>(this)->sin_addr, buf, sizeof(buf));
+	}
 
 	return std::string(buf);
 }
 
+bool SocketAddress::is_ipv6() const {
+	return ss_family == AF_INET6;
+}
+
 uint16_t SocketAddress::get_port() const {
+	if(is_ipv6()) {
+		return ntohs(reinterpret_cast<const sockaddr_in6 *>(this)->sin6_port);
+	}
 	return ntohs(reinterpret_cast<const sockaddr_in *>(this)->sin_port);
 }
 
 void SocketAddress::set_port(uint16_t const port) {
-	reinterpret_cast<sockaddr_in *>(this)->sin_port = ntohs(port);
+	if(is_ipv6()) {
+		reinterpret_cast<sockaddr_in6 *>(this)->sin6_port = htons(port);
+		return;
+	}
+	reinterpret_cast<sockaddr_in *>(this)->sin_port = htons(port);
 }
 
 SocketAddress SocketAddress::loopback_ipv4(const uint16_t port) {
 	return from_string(std::string("127.0.0.1:").append(std::to_string(port)));
 }
 
+SocketAddress SocketAddress::loopback_ipv6(const uint16_t port) {
+	return from_string(std::string("[::1]:").append(std::to_string(port)));
+}
+
 // TODO - Temporary hack - previously used to memcmp bytes directly which wasn't working
 // Possibly because struct isn't zeroed out entirely so "unused" bytes have random data
 bool SocketAddress::operator==(const SocketAddress &other) const {
@@ -109,17 +145,33 @@ bool SocketAddress::operator<(const SocketAddress &other) const {
 	return this->to_string() < other.to_string();
 }
 
+// Families on the wire, AF_INET6 differs between platforms
+#define SERIALIZED_FAMILY_IPV4 2
+#define SERIALIZED_FAMILY_IPV6 10
+
 size_t SocketAddress::serialize(uint8_t* bytes, size_t size) const {
-	if(size < 8) {
+	if(size < serialized_size()) {
 		return 0;
 	}
 
-	uint16_t family = reinterpret_cast<const sockaddr_in *>(this)->sin_family;
+	if(is_ipv6()) {
+		auto *in6 = reinterpret_cast<const sockaddr_in6 *>(this);
+		uint16_t port = in6->sin6_port;
+
+		bytes[0] = 0;
+		bytes[1] = SERIALIZED_FAMILY_IPV6;
+		std::memcpy(bytes+2, &in6->sin6_addr, 16);
+		bytes[18] = port >> 8;
+		bytes[19] = port & 0xff;
+
+		return 20;
+	}
+
 	uint8_t *start = (uint8_t *)&(reinterpret_cast<const sockaddr_in *>(this)->sin_addr);
 	uint16_t port = reinterpret_cast<const sockaddr_in *>(this)->sin_port;
 
-	bytes[0] = static_cast<uint8_t>(family >> 8);
-	bytes[1] = static_cast<uint8_t>(family & 0xff);
+	bytes[0] = 0;
+	bytes[1] = SERIALIZED_FAMILY_IPV4;
 	std::memcpy(bytes+2, start, 4);
 	bytes[6] = port >> 8;
 	bytes[7] = port & 0xff;
@@ -127,15 +179,37 @@ size_t SocketAddress::serialize(uint8_t* bytes, size_t size) const {
 	return 8;
 }
 
+size_t SocketAddress::serialized_size() const {
+	return is_ipv6() ? 20 : 8;
+}
+
+size_t SocketAddress::serialized_size(uint8_t const* bytes, size_t const size) {
+	if(size < 2) {
+		return 0;
+	}
+
+	uint16_t family = ((uint16_t)bytes[0] << 8) + (uint16_t)bytes[1];
+	size_t needed = family == SERIALIZED_FAMILY_IPV4 ? 8 : family == SERIALIZED_FAMILY_IPV6 ? 20 : 0;
+
+	return size < needed ? 0 : needed;
+}
+
 SocketAddress SocketAddress::deserialize(uint8_t const* bytes, size_t const size) {
 	SocketAddress addr;
 
-	if(size < 8) {
+	auto needed = serialized_size(bytes, size);
+	if(needed == 20) {
+		auto *in6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		in6->sin6_family = AF_INET6;
+		memcpy(&in6->sin6_addr, &(bytes[2]), 16);
+		in6->sin6_port = ((uint16_t)bytes[18] << 8) + (uint16_t)bytes[19];
+		return addr;
+	}
+
+	if(needed != 8) {
 		return addr;
 	}
 
-	reinterpret_cast<sockaddr_in *>(&addr)->sin_family =
-		((uint16_t)bytes[0] << 8) + (uint16_t)bytes[1];
 	memcpy(&(reinterpret_cast<sockaddr_in *>(&addr)->sin_addr), &(bytes[2]), 4);
 	reinterpret_cast<sockaddr_in *>(&addr)->sin_port =
 		((uint16_t)bytes[6] << 8) + (uint16_t)bytes[7];
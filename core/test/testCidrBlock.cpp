@@ -0,0 +1,37 @@
+#include "gtest/gtest.h"
+#include "marlin/core/CidrBlock.hpp"
+
+
+using namespace marlin::core;
+
+TEST(CidrBlockTest, StringConvertible) {
+	EXPECT_EQ(CidrBlock::from_string("192.168.0.0/16").to_string(), "192.168.0.0/16");
+	EXPECT_EQ(CidrBlock::from_string("2001:db8::/32").to_string(), "2001:db8::/32");
+}
+
+TEST(CidrBlockTest, ContainsIpv4Addresses) {
+	auto block = CidrBlock::from_string("192.168.0.0/17");
+
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("192.168.0.1:8000")));
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("192.168.127.255:8000")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("192.168.128.0:8000")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("10.168.0.1:8000")));
+
+	// Also covers the IPv4 mapped range, but nothing else in IPv6
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("[::ffff:192.168.0.1]:8000")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("[2001:db8::1]:8000")));
+	EXPECT_TRUE(CidrBlock::from_string("0.0.0.0/0").does_contain_address(SocketAddress::from_string("1.2.3.4:1")));
+}
+
+TEST(CidrBlockTest, ContainsIpv6Addresses) {
+	auto block = CidrBlock::from_string("2001:db8:8000::/33");
+
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("[2001:db8:8000::1]:8000")));
+	EXPECT_TRUE(block.does_contain_address(SocketAddress::from_string("[2001:db8:ffff::1]:8000")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("[2001:db8:7fff::1]:8000")));
+	EXPECT_FALSE(block.does_contain_address(SocketAddress::from_string("192.168.0.1:8000")));
+
+	EXPECT_TRUE(CidrBlock::from_string("::/0").does_contain_address(SocketAddress::from_string("192.168.0.1:8000")));
+	EXPECT_TRUE(CidrBlock::from_string("2001:db8::1/128").does_contain_address(SocketAddress::from_string("[2001:db8::1]:1")));
+	EXPECT_FALSE(CidrBlock::from_string("2001:db8::1/128").does_contain_address(SocketAddress::from_string("[2001:db8::2]:1")));
+}
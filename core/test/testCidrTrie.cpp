@@ -0,0 +1,111 @@
+#include "gtest/gtest.h"
+#include "marlin/core/CidrTrie.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+
+using namespace marlin::core;
+
+TEST(CidrTrieTest, LongestPrefixWins) {
+	CidrTrie<int> trie;
+	EXPECT_EQ(trie.longest_match(SocketAddress::from_string("10.1.2.3:80")), nullptr);
+
+	EXPECT_TRUE(trie.insert(CidrBlock::from_string("10.0.0.0/8"), 8));
+	EXPECT_TRUE(trie.insert(CidrBlock::from_string("10.1.0.0/16"), 16));
+	EXPECT_TRUE(trie.insert(CidrBlock::from_string("10.1.2.0/24"), 24));
+	EXPECT_TRUE(trie.insert(CidrBlock::from_string("2001:db8::/32"), 32));
+	EXPECT_FALSE(trie.insert(CidrBlock::from_string("10.1.0.0/16"), 17));
+	EXPECT_EQ(trie.size(), 4u);
+
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("10.1.2.3:80")), 24);
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("10.1.3.3:80")), 17);
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("10.2.3.3:80")), 8);
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("[::ffff:10.1.2.3]:80")), 24);
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("[2001:db8:1::1]:80")), 32);
+	EXPECT_EQ(trie.longest_match(SocketAddress::from_string("11.1.2.3:80")), nullptr);
+	EXPECT_EQ(trie.longest_match(SocketAddress::from_string("[2001:db9::1]:80")), nullptr);
+
+	EXPECT_TRUE(trie.erase(CidrBlock::from_string("10.1.0.0/16")));
+	EXPECT_FALSE(trie.erase(CidrBlock::from_string("10.1.0.0/16")));
+	EXPECT_FALSE(trie.erase(CidrBlock::from_string("10.1.0.0/15")));
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("10.1.3.3:80")), 8);
+	EXPECT_EQ(*trie.longest_match(SocketAddress::from_string("10.1.2.3:80")), 24);
+	EXPECT_EQ(trie.size(), 3u);
+}
+
+TEST(CidrTrieTest, MatchesLinearScan) {
+	std::mt19937 rng(42);
+	auto random_ipv4 = [&]() {
+		return std::to_string(rng() % 4) + "." + std::to_string(rng() % 4) + "." + std::to_string(rng() % 256) + "." + std::to_string(rng() % 256);
+	};
+
+	CidrTrie<size_t> trie;
+	std::vector<CidrBlock> blocks;
+	for(size_t i = 0; i < 2000; i++) {
+		auto block = CidrBlock::from_string(random_ipv4() + "/" + std::to_string(rng() % 33));
+		// Inserting a block again replaces its value, keep the index of the first one
+		size_t idx = blocks.size();
+		for(size_t j = 0; j < blocks.size(); j++) {
+			if(blocks[j].mapped_prefix_length() == block.mapped_prefix_length() && blocks[j].does_contain_address(block)) {
+				idx = j;
+			}
+		}
+		EXPECT_EQ(trie.insert(block, idx), idx == blocks.size());
+		if(idx == blocks.size()) {
+			blocks.push_back(block);
+		}
+	}
+
+	// Drop every third block to exercise node removal
+	std::vector<bool> erased(blocks.size(), false);
+	for(size_t i = 0; i < blocks.size(); i += 3) {
+		EXPECT_TRUE(trie.erase(blocks[i]));
+		erased[i] = true;
+	}
+
+	for(size_t i = 0; i < 5000; i++) {
+		auto addr = SocketAddress::from_string(random_ipv4() + ":1");
+
+		// Linear scan for the longest containing block
+		bool found = false;
+		size_t best = 0;
+		for(size_t j = 0; j < blocks.size(); j++) {
+			if(erased[j] || !blocks[j].does_contain_address(addr)) {
+				continue;
+			}
+			if(!found || blocks[j].mapped_prefix_length() > blocks[best].mapped_prefix_length()) {
+				found = true;
+				best = j;
+			}
+		}
+
+		auto *match = trie.longest_match(addr);
+		if(!found) {
+			EXPECT_EQ(match, nullptr);
+		} else {
+			ASSERT_NE(match, nullptr);
+			EXPECT_EQ(*match, best);
+		}
+	}
+}
+
+TEST(CidrFilterTest, LongestRuleDecides) {
+	CidrFilter filter;
+	EXPECT_TRUE(filter.is_allowed(SocketAddress::from_string("10.1.2.3:80")));
+
+	filter.deny(CidrBlock::from_string("10.0.0.0/8"));
+	filter.allow(CidrBlock::from_string("10.1.0.0/16"));
+	filter.deny(CidrBlock::from_string("2001:db8::/32"));
+
+	EXPECT_FALSE(filter.is_allowed(SocketAddress::from_string("10.2.2.3:80")));
+	EXPECT_TRUE(filter.is_allowed(SocketAddress::from_string("10.1.2.3:80")));
+	EXPECT_TRUE(filter.is_allowed(SocketAddress::from_string("11.1.2.3:80")));
+	EXPECT_FALSE(filter.is_allowed(SocketAddress::from_string("[2001:db8::1]:80")));
+	EXPECT_TRUE(filter.is_allowed(SocketAddress::from_string("[2001:db9::1]:80")));
+
+	EXPECT_TRUE(filter.remove(CidrBlock::from_string("10.1.0.0/16")));
+	EXPECT_FALSE(filter.is_allowed(SocketAddress::from_string("10.1.2.3:80")));
+	EXPECT_EQ(filter.size(), 2u);
+}
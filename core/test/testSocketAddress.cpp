@@ -51,3 +51,43 @@ TEST(SocketAddressTest, LoopbackConstructible) {
 
 	EXPECT_EQ(addr, SocketAddress::from_string("127.0.0.1:8000"));
 }
+
+TEST(SocketAddressTest, Ipv6StringConvertible) {
+	auto addr = SocketAddress::from_string("[2001:db8::1]:8000");
+
+	EXPECT_TRUE(addr.is_ipv6());
+	EXPECT_EQ(addr.to_string(), "[2001:db8::1]:8000");
+	EXPECT_EQ(addr.ip_string(), "2001:db8::1");
+	EXPECT_EQ(addr.get_port(), 8000);
+	EXPECT_EQ(SocketAddress::loopback_ipv6(8000).to_string(), "[::1]:8000");
+}
+
+TEST(SocketAddressTest, Serializable) {
+	uint8_t bytes[20];
+
+	auto addr = SocketAddress::from_string("192.168.0.1:8000");
+	EXPECT_EQ(addr.serialize(bytes, 20), 8u);
+	EXPECT_EQ(SocketAddress::serialized_size(bytes, 20), 8u);
+	EXPECT_EQ(SocketAddress::deserialize(bytes, 8), addr);
+
+	auto addr6 = SocketAddress::from_string("[2001:db8::1]:8000");
+	EXPECT_EQ(addr6.serialize(bytes, 8), 0u);
+	EXPECT_EQ(addr6.serialize(bytes, 20), 20u);
+	EXPECT_EQ(SocketAddress::serialized_size(bytes, 19), 0u);
+	EXPECT_EQ(SocketAddress::serialized_size(bytes, 20), 20u);
+	EXPECT_EQ(SocketAddress::deserialize(bytes, 20), addr6);
+}
+
+TEST(SocketAddressTest, HashCoversIpv6) {
+	std::hash<SocketAddress> hash;
+
+	// Differ only in the first bytes, which the IPv4 fields don't overlap
+	EXPECT_NE(
+		hash(SocketAddress::from_string("[2001:db8::1]:8000")),
+		hash(SocketAddress::from_string("[2001:db9::1]:8000"))
+	);
+	EXPECT_EQ(
+		hash(SocketAddress::from_string("[::ffff:192.168.0.1]:8000")),
+		hash(SocketAddress::from_string("192.168.0.1:8000"))
+	);
+}
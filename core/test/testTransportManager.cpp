@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+#include "marlin/core/TransportManager.hpp"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace marlin::core;
+
+struct Transport {
+	static int alive;
+	SocketAddress dst_addr;
+	int id;
+
+	Transport(SocketAddress const &dst_addr, int id) : dst_addr(dst_addr), id(id) {
+		alive++;
+	}
+	Transport(Transport const&) = delete;
+	~Transport() {
+		alive--;
+	}
+};
+int Transport::alive = 0;
+
+static SocketAddress ipv6(std::string const &ip, uint16_t port) {
+	sockaddr_storage storage;
+	std::memset(&storage, 0, sizeof(storage));
+	auto &in6 = reinterpret_cast<sockaddr_in6 &>(storage);
+	in6.sin6_family = AF_INET6;
+	in6.sin6_port = htons(port);
+	inet_pton(AF_INET6, ip.c_str(), &in6.sin6_addr);
+	return SocketAddress(storage);
+}
+
+TEST(TransportManagerTest, GetOrCreate) {
+	TransportManager<Transport> tm;
+	auto addr = SocketAddress::from_string("192.168.0.1:8000");
+
+	EXPECT_EQ(tm.get(addr), nullptr);
+
+	auto [transport, created] = tm.get_or_create(addr, addr, 1);
+	EXPECT_TRUE(created);
+	EXPECT_EQ(transport->id, 1);
+
+	auto [existing, created_again] = tm.get_or_create(addr, addr, 2);
+	EXPECT_FALSE(created_again);
+	EXPECT_EQ(existing, transport);
+	EXPECT_EQ(existing->id, 1);
+
+	EXPECT_EQ(tm.get(addr), transport);
+	EXPECT_EQ(tm.get(SocketAddress::from_string("192.168.0.1:8001")), nullptr);
+	EXPECT_EQ(tm.size(), 1u);
+}
+
+TEST(TransportManagerTest, DistinguishesIpv6Peers) {
+	TransportManager<Transport> tm;
+
+	// Same low bytes and port, only differ in the upper part of the address
+	auto a = ipv6("2001:db8::1", 8000);
+	auto b = ipv6("2001:db9::1", 8000);
+	auto c = ipv6("::ffff:192.168.0.1", 8000);
+
+	EXPECT_TRUE(tm.get_or_create(a, a, 1).second);
+	EXPECT_TRUE(tm.get_or_create(b, b, 2).second);
+	EXPECT_EQ(tm.get(a)->id, 1);
+	EXPECT_EQ(tm.get(b)->id, 2);
+
+	// IPv4 mapped addresses share the key of the plain IPv4 address
+	auto v4 = SocketAddress::from_string("192.168.0.1:8000");
+	EXPECT_TRUE(tm.get_or_create(v4, v4, 3).second);
+	EXPECT_EQ(tm.get(c)->id, 3);
+	EXPECT_NE(PackedAddress(a).hash(), PackedAddress(b).hash());
+}
+
+TEST(TransportManagerTest, TransportsStayPutWhileTableChanges) {
+	Transport::alive = 0;
+	{
+		TransportManager<Transport> tm;
+		std::vector<Transport *> transports;
+
+		for(int i = 0; i < 1000; i++) {
+			auto addr = SocketAddress::from_string("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256) + ":" + std::to_string(1000 + i));
+			transports.push_back(tm.get_or_create(addr, addr, i).first);
+		}
+		EXPECT_EQ(tm.size(), 1000u);
+		EXPECT_EQ(Transport::alive, 1000);
+
+		// Erase every other transport, passing the address stored in the transport itself
+		for(int i = 0; i < 1000; i += 2) {
+			tm.erase(transports[i]->dst_addr);
+		}
+		EXPECT_EQ(tm.size(), 500u);
+		EXPECT_EQ(Transport::alive, 500);
+
+		for(int i = 1; i < 1000; i += 2) {
+			auto *transport = tm.get(transports[i]->dst_addr);
+			EXPECT_EQ(transport, transports[i]);
+			EXPECT_EQ(transport->id, i);
+		}
+		for(int i = 0; i < 1000; i += 2) {
+			auto addr = SocketAddress::from_string("10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256) + ":" + std::to_string(1000 + i));
+			EXPECT_EQ(tm.get(addr), nullptr);
+		}
+
+		// Erasing something missing is a no op
+		tm.erase(SocketAddress::from_string("10.1.0.0:1"));
+		EXPECT_EQ(tm.size(), 500u);
+	}
+	// Remaining transports are destroyed with the manager
+	EXPECT_EQ(Transport::alive, 0);
+}
@@ -2,6 +2,7 @@
 #define MARLIN_LPF_LPFTRANSPORT_HPP
 
 #include <list>
+#include <vector>
 #include <unordered_set>
 #include <spdlog/spdlog.h>
 
@@ -22,6 +23,14 @@ struct IsTransportEncrypted {
 	constexpr static bool value = false;
 };
 
+template<typename DelegateType, typename TransportType, typename = void>
+struct HasDidDrain : std::false_type {};
+
+template<typename DelegateType, typename TransportType>
+struct HasDidDrain<DelegateType, TransportType, std::void_t<decltype(
+	std::declval<DelegateType&>().did_drain(std::declval<TransportType&>())
+)>> : std::true_type {};
+
 template<
 	typename DelegateType,
 	template<typename> class StreamTransportType,
@@ -48,11 +57,14 @@ public:
 	// Delegate
 	void did_dial(BaseTransport &transport);
 	int did_recv_bytes(BaseTransport &transport, core::Buffer &&bytes, uint16_t stream_id = 0);
+	int did_recv_bytes_chain(BaseTransport &transport, std::vector<core::Buffer> &&chain, uint16_t stream_id = 0);
+	int did_recv_bytes_view(BaseTransport &transport, core::WeakBuffer bytes);
 	void did_send_bytes(BaseTransport &transport, core::Buffer &&bytes);
 	void did_close(BaseTransport& transport, uint16_t reason);
 	void did_recv_flush_stream(BaseTransport &transport, uint16_t id, uint64_t offset, uint64_t old_offset);
 	void did_recv_skip_stream(BaseTransport &transport, uint16_t id);
 	void did_recv_flush_conf(BaseTransport &transport, uint16_t id);
+	void did_drain(BaseTransport &transport);
 
 	core::SocketAddress src_addr;
 	core::SocketAddress dst_addr;
@@ -94,6 +106,7 @@ public:
 
 	uint8_t const* get_static_pk();
 	uint8_t const* get_remote_static_pk();
+	void set_integrity_only(bool enabled);
 };
 
 
@@ -184,6 +197,86 @@ int LpfTransport<
 	return 0;
 }
 
+// Reads from base transports without streams, parsed in place
+template<
+	typename DelegateType,
+	template<typename> class StreamTransportType,
+	bool should_cut_through,
+	int prefix_length
+>
+int LpfTransport<
+	DelegateType,
+	StreamTransportType,
+	should_cut_through,
+	prefix_length
+>::did_recv_bytes_view(
+	BaseTransport &,
+	core::WeakBuffer bytes
+) {
+	auto &stfbuf = stf_buffers[0];
+
+	int res = stfbuf.did_recv_bytes(*this, std::move(bytes));
+
+	if(res < 0) {
+		if(res == -1) close();
+		return -1;
+	}
+
+	return 0;
+}
+
+template<
+	typename DelegateType,
+	template<typename> class StreamTransportType,
+	bool should_cut_through,
+	int prefix_length
+>
+int LpfTransport<
+	DelegateType,
+	StreamTransportType,
+	should_cut_through,
+	prefix_length
+>::did_recv_bytes_chain(
+	BaseTransport &,
+	std::vector<core::Buffer> &&chain,
+	uint16_t stream_id
+) {
+	if constexpr (should_cut_through) {
+		if(should_cut_through && stream_id >= 10 && stream_id < 20) {
+			auto &rbuf = cut_through_buffers[stream_id];
+
+			if(rbuf.id == 0) { // New buf
+				rbuf.id = stream_id;
+			}
+
+			for(auto &bytes : chain) {
+				int res = rbuf.did_recv_bytes(*this, std::move(bytes));
+
+				if(res < 0) {
+					if(res == -1) close();
+					return -1;
+				}
+			}
+
+			return 0;
+		}
+	}
+
+	auto &stfbuf = stf_buffers[stream_id];
+	if(stfbuf.id == 0) { // New buf
+		stfbuf.id = stream_id;
+	}
+
+	int res = stfbuf.did_recv_bytes_chain(*this, std::move(chain));
+
+	if(res < 0) {
+		if(res == -1) close();
+		return -1;
+	}
+
+	return 0;
+}
+
 template<
 	typename DelegateType,
 	template<typename> class StreamTransportType,
@@ -267,6 +360,23 @@ void LpfTransport<
 	cut_through_send_end(id);
 }
 
+template<
+	typename DelegateType,
+	template<typename> class StreamTransportType,
+	bool should_cut_through,
+	int prefix_length
+>
+void LpfTransport<
+	DelegateType,
+	StreamTransportType,
+	should_cut_through,
+	prefix_length
+>::did_drain(BaseTransport &) {
+	if constexpr (HasDidDrain<DelegateType, Self>::value) {
+		delegate->did_drain(*this);
+	}
+}
+
 template<
 	typename DelegateType,
 	template<typename> class StreamTransportType,
@@ -353,6 +463,9 @@ int LpfTransport<
 	auto res = cut_through_send_bytes(id, std::move(message));
 
 	if(res < 0) {
+		// Peer drops the announced message, the id can be reused
+		cut_through_send_flush(id);
+		cut_through_send_end(id);
 		return res;
 	}
 
@@ -428,6 +541,18 @@ uint16_t LpfTransport<
 	}
 
 	auto id = cut_through_reserve_ids.front();
+
+	// Header and body have to fit together, a header without its body stalls the peer
+	if(transport.check_send_buffer(8 + length, id) < 0) {
+		return 0;
+	}
+
+	core::Buffer m(8);
+	m.write_uint64_be_unsafe(0, length);
+	auto res = transport.send(std::move(m), id);
+
+	if(res < 0) return 0;
+
 	cut_through_reserve_ids.pop_front();
 	cut_through_used_ids.insert(id);
 
@@ -438,12 +563,6 @@ uint16_t LpfTransport<
 		id
 	);
 
-	core::Buffer m(8);
-	m.write_uint64_be_unsafe(0, length);
-	auto res = transport.send(std::move(m), id);
-
-	if(res < 0) return 0;
-
 	return id;
 }
 
@@ -632,6 +751,21 @@ uint8_t const* LpfTransport<
 	return transport.get_remote_static_pk();
 }
 
+template<
+	typename DelegateType,
+	template<typename> class StreamTransportType,
+	bool should_cut_through,
+	int prefix_length
+>
+void LpfTransport<
+	DelegateType,
+	StreamTransportType,
+	should_cut_through,
+	prefix_length
+>::set_integrity_only(bool enabled) {
+	transport.set_integrity_only(enabled);
+}
+
 } // namespace lpf
 } // namespace marlin
 
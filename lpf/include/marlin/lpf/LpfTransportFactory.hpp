@@ -2,6 +2,7 @@
 #define MARLIN_LPF_LPFTRANSPORTFACTORY_HPP
 
 #include "LpfTransport.hpp"
+#include <marlin/core/CidrTrie.hpp>
 
 
 namespace marlin {
@@ -55,6 +56,8 @@ public:
 	SelfTransport *get_transport(
 		core::SocketAddress const &addr
 	);
+	/// Allow and deny rules over address ranges of incoming connections, kept by the datagram transport factory
+	core::CidrFilter &filter();
 };
 
 
@@ -201,6 +204,26 @@ LpfTransportFactory<
 	return transport_manager.get(addr);
 }
 
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class StreamTransportFactory,
+	template<typename> class StreamTransport,
+	bool should_cut_through,
+	int prefix_length
+>
+core::CidrFilter &
+LpfTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	StreamTransportFactory,
+	StreamTransport,
+	should_cut_through,
+	prefix_length
+>::filter() {
+	return f.filter();
+}
+
 } // namespace lpf
 } // namespace marlin
 
@@ -2,6 +2,9 @@
 #define MARLIN_LPF_STFB_HPP
 
 #include <marlin/core/Buffer.hpp>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 
 namespace marlin {
 namespace lpf {
@@ -10,6 +13,18 @@ class StoreThenForwardBuffer {
 	uint8_t *buf = nullptr;
 	uint64_t length = 0;
 	uint64_t size = 0;
+	/// Has the length prefix of the current message been read
+	bool has_length = false;
+
+	template<typename Delegate>
+	int forward(Delegate &delegate, core::Buffer &&message) {
+		// Prepare to process length
+		has_length = false;
+		size = 0;
+		length = 0;
+
+		return delegate.did_recv_stf_message(id, std::move(message)) < 0 ? -2 : 0;
+	}
 
 public:
 	~StoreThenForwardBuffer() {
@@ -18,59 +33,103 @@ public:
 
 	uint16_t id = 0;
 
-	template<typename Delegate>
+	/// Accepts owned buffers or views valid only during the call, views are always copied out.
+	/// Messages within a single owned buffer are forwarded without copying where possible,
+	/// only messages spanning buffers get assembled into a new one.
+	template<typename Delegate, typename BufferType>
 	int did_recv_bytes(
 		Delegate &delegate,
-		core::Buffer &&bytes
+		BufferType &&bytes
 	) {
-		if(bytes.size() == 0) return 0;
-
-		if(buf == nullptr) { // Read length
-			if(bytes.size() + size < 8) { // Partial length
-				for(size_t i = 0; i < bytes.size(); i++) {
+		while(bytes.size() > 0 || (has_length && length == 0)) {
+			if(!has_length) { // Read length, might span buffers
+				uint64_t n = std::min<uint64_t>(8 - size, bytes.size());
+				for(uint64_t i = 0; i < n; i++) {
 					length = (length << 8) | bytes.data()[i];
 				}
-				size += bytes.size();
-			} else { // Full length
-				for(size_t i = 0; i < 8 - size; i++) {
-					length = (length << 8) | bytes.data()[i];
+				bytes.cover_unsafe(n);
+				size += n;
+
+				if(size < 8) { // Partial length
+					return 0;
 				}
-				bytes.cover_unsafe(8 - size);
 
 				if(length > 5000000) { // Abort on big message, DoS prevention
 					SPDLOG_ERROR("Message too big: {}", length);
 					return -1;
 				}
 
-				// Prepare to process message
-				buf = new uint8_t[length];
+				has_length = true;
 				size = 0;
-
-				// Process remaining bytes
-				return did_recv_bytes(delegate, std::move(bytes));
+				continue;
 			}
-		} else { // Read message
-			if(bytes.size() + size < length) { // Partial message
-				bytes.read_unsafe(0, buf + size, bytes.size());
-				size += bytes.size();
-			} else { // Full message
-				bytes.read_unsafe(0, buf + size, length - size);
-				bytes.cover_unsafe(length - size);
-
-				auto *tbuf = buf;
-				buf = nullptr;
-				auto res = delegate.did_recv_stf_message(id, core::Buffer(tbuf, length));
+
+			if(buf == nullptr && bytes.size() >= length) { // Whole message in this buffer
+				if constexpr (std::is_same_v<std::decay_t<BufferType>, core::Buffer>) {
+					if(bytes.size() == length) {
+						// Message is exactly the remaining bytes, forward as is
+						return forward(delegate, std::move(bytes));
+					} else if(bytes.size() - length < length) {
+						// Cheaper to copy out the bytes following the message and forward the rest as is
+						core::Buffer rest(bytes.size() - length);
+						bytes.read_unsafe(length, rest.data(), rest.size());
+						bytes.truncate_unsafe(rest.size());
+
+						auto res = forward(delegate, std::move(bytes));
+						if(res < 0) {
+							return res;
+						}
+
+						return did_recv_bytes(delegate, std::move(rest));
+					}
+				}
+
+				core::Buffer message(length);
+				bytes.read_unsafe(0, message.data(), length);
+				bytes.cover_unsafe(length);
+
+				auto res = forward(delegate, std::move(message));
 				if(res < 0) {
-					return -2;
+					return res;
 				}
+				continue;
+			}
 
-				// Prepare to process length
-				buf = nullptr;
-				size = 0;
-				length = 0;
+			// Message spans buffers, assemble
+			if(buf == nullptr) {
+				buf = new uint8_t[length];
+			}
+
+			uint64_t n = std::min<uint64_t>(length - size, bytes.size());
+			bytes.read_unsafe(0, buf + size, n);
+			bytes.cover_unsafe(n);
+			size += n;
 
-				// Process remaining bytes
-				return did_recv_bytes(delegate, std::move(bytes));
+			if(size < length) { // Partial message
+				return 0;
+			}
+
+			auto *tbuf = buf;
+			buf = nullptr;
+			auto res = forward(delegate, core::Buffer(tbuf, length));
+			if(res < 0) {
+				return res;
+			}
+		}
+
+		return 0;
+	}
+
+	/// Parses a chain of contiguous buffers, same as passing them in one by one
+	template<typename Delegate>
+	int did_recv_bytes_chain(
+		Delegate &delegate,
+		std::vector<core::Buffer> &&chain
+	) {
+		for(auto &bytes : chain) {
+			auto res = did_recv_bytes(delegate, std::move(bytes));
+			if(res < 0) {
+				return res;
 			}
 		}
 
@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include <spdlog/spdlog.h>
+#include <marlin/lpf/StoreThenForwardBuffer.hpp>
+
+#include <cstring>
+
+
+using namespace marlin::core;
+using namespace marlin::lpf;
+
+struct Delegate {
+	std::vector<Buffer> messages;
+
+	int did_recv_stf_message(uint16_t, Buffer &&message) {
+		messages.push_back(std::move(message));
+		return 0;
+	}
+};
+
+/// Length prefixed messages of the given sizes, message i is filled with i + 1
+static Buffer frame(std::vector<uint64_t> const& sizes) {
+	size_t total = 0;
+	for(auto size : sizes) {
+		total += 8 + size;
+	}
+
+	Buffer buf(total);
+	size_t pos = 0;
+	for(size_t i = 0; i < sizes.size(); i++) {
+		buf.write_uint64_be_unsafe(pos, sizes[i]);
+		std::memset(buf.data() + pos + 8, i + 1, sizes[i]);
+		pos += 8 + sizes[i];
+	}
+
+	return buf;
+}
+
+/// Split a buffer into slices of at most the given size
+static std::vector<Buffer> slice(Buffer const& buf, size_t size) {
+	std::vector<Buffer> chain;
+	for(size_t pos = 0; pos < buf.size(); pos += size) {
+		auto n = std::min(size, buf.size() - pos);
+		Buffer bytes(n);
+		buf.read_unsafe(pos, bytes.data(), n);
+		chain.push_back(std::move(bytes));
+	}
+
+	return chain;
+}
+
+static void expect_messages(Delegate const& delegate, std::vector<uint64_t> const& sizes) {
+	ASSERT_EQ(delegate.messages.size(), sizes.size());
+	for(size_t i = 0; i < sizes.size(); i++) {
+		ASSERT_EQ(delegate.messages[i].size(), sizes[i]);
+		for(size_t j = 0; j < sizes[i]; j++) {
+			ASSERT_EQ(delegate.messages[i].data()[j], i + 1);
+		}
+	}
+}
+
+TEST(StoreThenForwardBufferTest, ParsesMessagesAcrossChain) {
+	std::vector<uint64_t> sizes = {100, 3000, 0, 5, 1400};
+	auto buf = frame(sizes);
+
+	// Slice sizes which split both length prefixes and bodies
+	for(size_t size : {1, 3, 8, 13, 1350, 5000}) {
+		StoreThenForwardBuffer stfb;
+		Delegate delegate;
+		EXPECT_EQ(stfb.did_recv_bytes_chain(delegate, slice(buf, size)), 0);
+		expect_messages(delegate, sizes);
+	}
+}
+
+TEST(StoreThenForwardBufferTest, ForwardsWholeMessagesWithoutCopying) {
+	StoreThenForwardBuffer stfb;
+	Delegate delegate;
+
+	// Second message ends the buffer, first one is larger than what follows it
+	auto buf = frame({1000, 10});
+	auto *data = buf.data();
+	EXPECT_EQ(stfb.did_recv_bytes(delegate, std::move(buf)), 0);
+	expect_messages(delegate, {1000, 10});
+	EXPECT_EQ(delegate.messages[0].data(), data + 8);
+
+	// Message exactly fills the buffer following its length prefix
+	std::vector<Buffer> chain;
+	chain.push_back(Buffer(8));
+	chain[0].write_uint64_be_unsafe(0, 1000);
+	chain.push_back(Buffer(1000));
+	std::memset(chain[1].data(), 1, 1000);
+	auto *body = chain[1].data();
+
+	Delegate other;
+	EXPECT_EQ(stfb.did_recv_bytes_chain(other, std::move(chain)), 0);
+	expect_messages(other, {1000});
+	EXPECT_EQ(other.messages[0].data(), body);
+}
+
+TEST(StoreThenForwardBufferTest, RejectsBigMessages) {
+	StoreThenForwardBuffer stfb;
+	Delegate delegate;
+
+	EXPECT_EQ(stfb.did_recv_bytes(delegate, frame({5000001})), -1);
+	EXPECT_EQ(delegate.messages.size(), 0u);
+}
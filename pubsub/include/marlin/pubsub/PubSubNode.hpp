@@ -258,6 +258,8 @@ public:
 
 	void subscribe(core::SocketAddress const &addr, uint8_t const *remote_static_pk);
 	void unsubscribe(core::SocketAddress const &addr);
+
+	core::CidrFilter &filter();
 private:
 	template<
 		typename ...AttesterArgs,
@@ -609,6 +611,9 @@ int PUBSUBNODETYPE::did_recv_MESSAGE(
 	BaseTransport &transport,
 	core::Buffer &&bytes
 ) {
+	thread_local auto &site = asyncio::LoopStats::loop().site("pubsub.message");
+	asyncio::ProfileScope profile(site);
+
 	// Bounds check on header
 	if(bytes.size() < 10) {
 		transport.close();
@@ -659,7 +664,13 @@ int PUBSUBNODETYPE::did_recv_MESSAGE(
 			return -1;
 		}
 
-		if(!attester.verify(message_id, channel, bytes.data(), bytes.size(), header)) {
+		bool verified;
+		{
+			thread_local auto &site = asyncio::LoopStats::loop().site("pubsub.attestation");
+			asyncio::ProfileScope profile(site);
+			verified = attester.verify(message_id, channel, bytes.data(), bytes.size(), header);
+		}
+		if(!verified) {
 			SPDLOG_ERROR("Attestation verification failed");
 			transport.close();
 			return -1;
@@ -1104,6 +1115,9 @@ void PUBSUBNODETYPE::subscribe(core::SocketAddress const &addr, uint8_t const *r
 	if (blacklist_addr.find(addr) != blacklist_addr.end())
 		return;
 
+	if (!f.filter().is_allowed(addr))
+		return;
+
 	auto *transport = f.get_transport(addr);
 
 	if(transport == nullptr) {
@@ -1137,6 +1151,17 @@ void PUBSUBNODETYPE::unsubscribe(core::SocketAddress const &addr) {
 	);
 }
 
+//! allow and deny rules over address ranges of peers
+/*!
+	\li kept by the underlying udp transport factory, packets from denied ranges are dropped before any transport is created
+	\li publishers in denied ranges are not subscribed to
+	\li peers already connected stay connected
+*/
+template<PUBSUBNODE_TEMPLATE>
+core::CidrFilter &PUBSUBNODETYPE::filter() {
+	return f.filter();
+}
+
 template<PUBSUBNODE_TEMPLATE>
 bool PUBSUBNODETYPE::add_sol_conn(core::SocketAddress const &addr) {
 
@@ -1357,7 +1382,13 @@ int PUBSUBNODETYPE::cut_through_recv_bytes(
 			spdlog::to_hex(header.witness_data, header.witness_data + header.witness_size)
 		);
 
-		if(!attester.verify(message_id, channel, bytes.data() + offset, bytes.size() - offset, header)) {
+		bool verified;
+		{
+			thread_local auto &site = asyncio::LoopStats::loop().site("pubsub.attestation");
+			asyncio::ProfileScope profile(site);
+			verified = attester.verify(message_id, channel, bytes.data() + offset, bytes.size() - offset, header);
+		}
+		if(!verified) {
 			SPDLOG_ERROR("Attestation verification failed");
 			transport.close();
 			return -1;
@@ -40,7 +40,7 @@ private:
 public:
 	// Delegate
 	void did_dial(BaseTransport &transport);
-	void did_recv_bytes(BaseTransport &transport, core::Buffer &&bytes);
+	void did_recv_bytes_view(BaseTransport &transport, core::WeakBuffer bytes);
 	void did_send_bytes(BaseTransport &transport, core::Buffer &&bytes);
 	void did_close(BaseTransport &transport, uint16_t reason);
 
@@ -72,9 +72,9 @@ void RlpxTransport<DelegateType>::did_dial(
 }
 
 template<typename DelegateType>
-void RlpxTransport<DelegateType>::did_recv_bytes(
+void RlpxTransport<DelegateType>::did_recv_bytes_view(
 	BaseTransport &,
-	core::Buffer &&bytes
+	core::WeakBuffer bytes
 ) {
 	if(bytes_remaining > bytes.size()) { // Partial message
 		SPDLOG_DEBUG("Partial: {}, {}, {}", buf_size, bytes.size(), bytes_remaining);
@@ -236,7 +236,7 @@ void RlpxTransport<DelegateType>::did_recv_bytes(
 		}
 
 		if(bytes.size() > 0) {
-			did_recv_bytes(transport, std::move(bytes));
+			did_recv_bytes_view(transport, bytes);
 		}
 	}
 }
@@ -3,11 +3,22 @@
 
 #include "marlin/core/SocketAddress.hpp"
 
+#include <random>
+
 namespace marlin {
 namespace simulator {
 
 class NetworkConditioner {
 public:
+	/// Probability of dropping a packet
+	double drop_rate = 0;
+	/// One way latency in ticks
+	uint64_t latency = 1;
+	/// Max random extra latency in ticks, reorders packets if set
+	uint64_t jitter = 0;
+	/// Random source for drops and jitter, seeded for reproducible runs
+	std::mt19937_64 rng = std::mt19937_64(0);
+
 	bool should_drop(
 		uint64_t in_tick,
 		core::SocketAddress const& src,
@@ -32,7 +43,11 @@ bool NetworkConditioner::should_drop(
 	core::SocketAddress const&,
 	uint64_t
 ) {
-	return false;
+	if(drop_rate <= 0) {
+		return false;
+	}
+
+	return std::uniform_real_distribution<double>(0, 1)(rng) < drop_rate;
 }
 
 uint64_t NetworkConditioner::get_out_tick(
@@ -41,7 +56,11 @@ uint64_t NetworkConditioner::get_out_tick(
 	core::SocketAddress const&,
 	uint64_t
 ) {
-	return in_tick + 1;
+	if(jitter == 0) {
+		return in_tick + latency;
+	}
+
+	return in_tick + latency + std::uniform_int_distribution<uint64_t>(0, jitter)(rng);
 }
 
 } // namespace simulator
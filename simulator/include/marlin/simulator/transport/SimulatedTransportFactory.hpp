@@ -4,6 +4,7 @@
 #include "marlin/simulator/transport/SimulatedTransport.hpp"
 
 #include <marlin/core/Buffer.hpp>
+#include <marlin/core/CidrTrie.hpp>
 #include <marlin/core/SocketAddress.hpp>
 #include <marlin/core/TransportManager.hpp>
 
@@ -42,6 +43,7 @@ private:
 
 	ListenDelegateType* delegate;
 	bool is_listening = false;
+	core::CidrFilter address_filter;
 	std::pair<TransportType*, int> dial_impl(core::SocketAddress const& addr, ListenDelegateType& delegate);
 public:
 	core::SocketAddress addr;
@@ -61,6 +63,7 @@ public:
 	int dial(core::SocketAddress const& addr, ListenDelegateType& delegate, MetadataType&& metadata);
 
 	TransportType* get_transport(core::SocketAddress const& addr);
+	core::CidrFilter& filter();
 
 	void did_recv(
 		NetworkInterfaceType& interface,
@@ -267,6 +270,21 @@ SimulatedTransport<
 	return transport_manager.get(addr);
 }
 
+template<
+	typename EventManager,
+	typename NetworkInterfaceType,
+	typename ListenDelegateType,
+	typename TransportDelegateType
+>
+core::CidrFilter& SimulatedTransportFactory<
+	EventManager,
+	NetworkInterfaceType,
+	ListenDelegateType,
+	TransportDelegateType
+>::filter() {
+	return address_filter;
+}
+
 template<
 	typename EventManager,
 	typename NetworkInterfaceType,
@@ -291,7 +309,7 @@ void SimulatedTransportFactory<
 	auto* transport = this->transport_manager.get(addr);
 	if(transport == nullptr) {
 		// Create new transport if permitted
-		if(delegate->should_accept(addr)) {
+		if(address_filter.is_allowed(addr) && delegate->should_accept(addr)) {
 			transport = this->transport_manager.get_or_create(
 				addr,
 				this->addr,
@@ -0,0 +1,212 @@
+#ifndef MARLIN_STREAM_BENCH_STREAMBENCH_HPP
+#define MARLIN_STREAM_BENCH_STREAMBENCH_HPP
+
+#include <marlin/stream/StreamTransport.hpp>
+#include <spdlog/spdlog.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace marlin {
+namespace stream {
+namespace bench {
+
+/// Number of operator new calls so far, counted in allocations.cpp
+uint64_t allocation_count();
+
+/// Fixed workload driven through a stream connection
+struct Scenario {
+	char const* name;
+	/// Bytes per message
+	size_t message_size;
+	/// Messages per stream
+	size_t message_count;
+	/// Parallel streams
+	uint16_t streams;
+	/// Messages outstanding per stream, next one is sent when the oldest completes
+	size_t window;
+	/// Probability of dropping a packet, simulator only
+	double drop_rate;
+	/// One way latency in ms, simulator only
+	uint64_t latency;
+};
+
+/// Scenarios run by default, lossy ones only apply to the simulator
+inline std::vector<Scenario> const& default_scenarios() {
+	static std::vector<Scenario> scenarios = {
+		{"bulk",          1000000,   100, 1,   4, 0,    1},
+		{"small",             100, 50000, 1, 100, 0,    1},
+		{"parallel",        65536,   100, 8,   4, 0,    1},
+		{"bulk-lossy",    1000000,    50, 1,   4, 0.01, 10},
+		{"small-lossy",       100, 20000, 1, 100, 0.01, 10},
+	};
+	return scenarios;
+}
+
+/// Process CPU time in microseconds, user and system
+inline uint64_t cpu_time_us() {
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull +
+		usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/// Delegate for both ends of a connection which runs one scenario and reports results.
+/// The dialling end sends, the listening end measures message completion.
+template<template<typename> class DatagramTransport>
+struct BenchDelegate {
+	using TransportType = StreamTransport<BenchDelegate, DatagramTransport>;
+
+	Scenario scenario;
+	uint8_t const* static_sk;
+	/// Called once all messages are received
+	std::function<void()> on_done;
+
+	TransportType* sender = nullptr;
+
+	struct PendingMessage {
+		uint64_t end_offset;
+		uint64_t sent_time_us;
+	};
+	struct StreamState {
+		std::deque<PendingMessage> pending;
+		size_t sent = 0;
+		uint64_t queued_offset = 0;
+		uint64_t recv_offset = 0;
+	};
+	std::vector<StreamState> states;
+
+	size_t completed = 0;
+	std::vector<uint64_t> completion_times_us;
+	uint64_t start_time_us = 0;
+	uint64_t end_time_us = 0;
+	uint64_t start_cpu_us = 0;
+	uint64_t end_cpu_us = 0;
+	uint64_t start_allocations = 0;
+	uint64_t end_allocations = 0;
+
+	BenchDelegate(Scenario const& scenario, uint8_t const* static_sk) :
+		scenario(scenario), static_sk(static_sk), states(scenario.streams) {
+		completion_times_us.reserve(scenario.message_count * scenario.streams);
+	}
+
+	uint64_t total_bytes() const {
+		return scenario.message_size * scenario.message_count * scenario.streams;
+	}
+
+	void send_message(uint16_t stream_id) {
+		auto &state = states[stream_id];
+		if(state.sent == scenario.message_count) {
+			return;
+		}
+
+		core::Buffer message(scenario.message_size);
+		std::memset(message.data(), 0, scenario.message_size);
+		if(sender->send(std::move(message), stream_id) < 0) {
+			SPDLOG_ERROR("Bench: send failed on stream {}", stream_id);
+			return;
+		}
+
+		state.sent++;
+		state.queued_offset += scenario.message_size;
+		state.pending.push_back({state.queued_offset, asyncio::EventLoop::now_us()});
+	}
+
+	void did_dial(TransportType &transport) {
+		sender = &transport;
+
+		start_time_us = asyncio::EventLoop::now_us();
+		start_cpu_us = cpu_time_us();
+		start_allocations = allocation_count();
+
+		for(uint16_t stream_id = 0; stream_id < scenario.streams; stream_id++) {
+			for(size_t i = 0; i < scenario.window; i++) {
+				send_message(stream_id);
+			}
+		}
+	}
+
+	int did_recv_bytes(
+		TransportType &,
+		core::Buffer &&bytes,
+		uint16_t stream_id
+	) {
+		if(stream_id >= states.size()) {
+			return 0;
+		}
+
+		auto &state = states[stream_id];
+		state.recv_offset += bytes.size();
+
+		auto now = asyncio::EventLoop::now_us();
+		while(state.pending.size() > 0 && state.pending.front().end_offset <= state.recv_offset) {
+			completion_times_us.push_back(now - state.pending.front().sent_time_us);
+			state.pending.pop_front();
+			completed++;
+
+			send_message(stream_id);
+		}
+
+		if(completed == scenario.message_count * scenario.streams) {
+			end_time_us = now;
+			end_cpu_us = cpu_time_us();
+			end_allocations = allocation_count();
+
+			report();
+			if(on_done) {
+				on_done();
+			}
+		}
+
+		return 0;
+	}
+
+	void report() {
+		std::sort(completion_times_us.begin(), completion_times_us.end());
+		auto percentile = [&](double p) {
+			return completion_times_us[(completion_times_us.size() - 1) * p];
+		};
+
+		auto bytes = total_bytes();
+		auto elapsed_us = end_time_us > start_time_us ? end_time_us - start_time_us : 1;
+
+		SPDLOG_INFO(
+			"{:<12} goodput {:>9.2f} MB/s, completion p50 {:>9} us, p99 {:>9} us, cpu {:>7.2f} ns/B, allocs {:>7.3f} /KB",
+			scenario.name,
+			(double)bytes / elapsed_us,
+			percentile(0.5),
+			percentile(0.99),
+			(end_cpu_us - start_cpu_us) * 1000.0 / bytes,
+			(end_allocations - start_allocations) * 1000.0 / bytes
+		);
+	}
+
+	void did_send_bytes(TransportType &, core::Buffer &&) {}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(core::SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this, static_sk);
+	}
+
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+} // namespace bench
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_BENCH_STREAMBENCH_HPP
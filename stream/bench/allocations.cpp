@@ -0,0 +1,48 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Counts operator new calls for allocations per byte in benchmarks
+
+static std::atomic<uint64_t> allocations(0);
+
+namespace marlin {
+namespace stream {
+namespace bench {
+
+uint64_t allocation_count() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+} // namespace bench
+} // namespace stream
+} // namespace marlin
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if(auto *ptr = std::malloc(size == 0 ? 1 : size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
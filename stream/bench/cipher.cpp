@@ -0,0 +1,91 @@
+#include <marlin/stream/protocol/Cipher.hpp>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <vector>
+
+using namespace marlin::stream;
+
+#define ITERATIONS 200000
+
+static char const* suite_name(CipherSuite suite) {
+	switch(suite) {
+		case CipherSuite::AES256GCM: return "AES-256-GCM";
+		case CipherSuite::CHACHA20POLY1305: return "ChaCha20-Poly1305";
+		case CipherSuite::POLY1305: return "Poly1305 (no enc)";
+	}
+	return "Unknown";
+}
+
+// Seal and open packets of the given size in place, like StreamTransport does
+static void bench(CipherSuite suite, size_t size) {
+	uint8_t key[STREAM_CIPHER_KEYBYTES];
+	uint8_t nonce[STREAM_CIPHER_NPUBBYTES];
+	uint8_t ad[28];
+	randombytes_buf(key, sizeof(key));
+	randombytes_buf(nonce, sizeof(nonce));
+	randombytes_buf(ad, sizeof(ad));
+
+	StreamCipher tx, rx;
+	tx.init(suite, key);
+	rx.init(suite, key);
+
+	std::vector<uint8_t> packet(size + STREAM_CIPHER_ABYTES);
+	randombytes_buf(packet.data(), size);
+
+	uint64_t seal_ns = 0;
+	uint64_t open_ns = 0;
+	int failures = 0;
+
+	for(int i = 0; i < ITERATIONS; i++) {
+		auto start = std::chrono::steady_clock::now();
+		tx.encrypt(packet.data(), packet.data(), size, ad, sizeof(ad), nonce);
+		auto mid = std::chrono::steady_clock::now();
+		failures += rx.decrypt(packet.data(), packet.data(), packet.size(), ad, sizeof(ad), nonce) < 0;
+		auto end = std::chrono::steady_clock::now();
+
+		seal_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(mid - start).count();
+		open_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count();
+		sodium_increment(nonce, sizeof(nonce));
+	}
+
+	SPDLOG_INFO(
+		"{:<18} {:>5} bytes: seal {:>7.1f} ns/packet, open {:>7.1f} ns/packet, {:>7.1f} MB/s sealed{}",
+		suite_name(suite),
+		size,
+		(double)seal_ns / ITERATIONS,
+		(double)open_ns / ITERATIONS,
+		(double)size * ITERATIONS * 1000 / seal_ns,
+		failures > 0 ? " (open failures!)" : ""
+	);
+}
+
+int main() {
+	if(sodium_init() < 0) {
+		SPDLOG_ERROR("Failed to initialize libsodium");
+		return -1;
+	}
+
+	// Integrity only suite is opt in but always available
+	uint8_t supported = supported_cipher_suites() | static_cast<uint8_t>(CipherSuite::POLY1305);
+	SPDLOG_INFO(
+		"CPU: AES-NI: {}, PCLMUL: {}, AVX: {}, supported suites: {:#04x}",
+		sodium_runtime_has_aesni(),
+		sodium_runtime_has_pclmul(),
+		sodium_runtime_has_avx(),
+		supported
+	);
+
+	for(auto suite : {CipherSuite::AES256GCM, CipherSuite::CHACHA20POLY1305, CipherSuite::POLY1305}) {
+		if((supported & static_cast<uint8_t>(suite)) == 0) {
+			SPDLOG_INFO("{}: not supported on this CPU", suite_name(suite));
+			continue;
+		}
+
+		for(size_t size : {64, 256, 1350}) {
+			bench(suite, size);
+		}
+	}
+
+	return 0;
+}
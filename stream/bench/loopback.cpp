@@ -0,0 +1,61 @@
+#include <marlin/asyncio/udp/UdpTransportFactory.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+
+#include "StreamBench.hpp"
+
+#include <memory>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+using namespace marlin::stream::bench;
+
+using Delegate = BenchDelegate<UdpTransport>;
+using FactoryType = StreamTransportFactory<
+	Delegate,
+	Delegate,
+	UdpTransportFactory,
+	UdpTransport
+>;
+
+// Runs every lossless scenario, or the one named on the command line, over UDP on loopback.
+// Both ends share one event loop and thread, so CPU and allocations cover both.
+int main(int argc, char** argv) {
+	uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+	uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+	crypto_box_keypair(static_pk, static_sk);
+
+	// Connections are kept around since transports do not outlive their factories
+	std::vector<std::unique_ptr<Delegate>> delegates;
+	std::vector<std::unique_ptr<FactoryType>> factories;
+
+	uint16_t port = 8000;
+	for(auto &scenario : default_scenarios()) {
+		if(argc > 1 && std::strcmp(argv[1], scenario.name) != 0) {
+			continue;
+		}
+		if(scenario.drop_rate > 0) {
+			SPDLOG_INFO("{}: needs the simulator, skipping", scenario.name);
+			continue;
+		}
+
+		auto &d = *delegates.emplace_back(new Delegate(scenario, static_sk));
+		auto &s = *factories.emplace_back(new FactoryType());
+		auto &c = *factories.emplace_back(new FactoryType());
+
+		// Loop keeps running for idle sockets, stop once the scenario completes
+		d.on_done = []() {
+			uv_stop(uv_default_loop());
+		};
+
+		s.bind(SocketAddress::loopback_ipv4(port));
+		s.listen(d);
+		c.bind(SocketAddress::loopback_ipv4(0));
+		c.dial(SocketAddress::loopback_ipv4(port), d, static_pk);
+		port++;
+
+		EventLoop::run();
+	}
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+#define MARLIN_ASYNCIO_SIMULATOR
+
+#include <marlin/simulator/core/Simulator.hpp>
+#include <marlin/simulator/transport/SimulatedTransportFactory.hpp>
+#include <marlin/simulator/network/Network.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+
+#include "StreamBench.hpp"
+
+#include <memory>
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::simulator;
+using namespace marlin::stream;
+using namespace marlin::stream::bench;
+
+using NetworkType = Network<NetworkConditioner>;
+using NetworkInterfaceType = NetworkInterface<NetworkType>;
+
+template<typename Delegate>
+using SimTransportType = SimulatedTransport<
+	Simulator,
+	NetworkInterfaceType,
+	Delegate
+>;
+template<typename ListenDelegate, typename TransportDelegate>
+using SimTransportFactoryType = SimulatedTransportFactory<
+	Simulator,
+	NetworkInterfaceType,
+	ListenDelegate,
+	TransportDelegate
+>;
+
+using Delegate = BenchDelegate<SimTransportType>;
+using FactoryType = StreamTransportFactory<
+	Delegate,
+	Delegate,
+	SimTransportFactoryType,
+	SimTransportType
+>;
+
+// Runs every scenario, or the one named on the command line, on the simulator.
+// Times are simulated, CPU and allocations are real and cover both ends.
+int main(int argc, char** argv) {
+	Simulator& simulator = Simulator::default_instance;
+	NetworkConditioner nc;
+	NetworkType network(nc);
+
+	auto& i1 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.1:0"));
+	auto& i2 = network.get_or_create_interface(SocketAddress::from_string("192.168.0.2:0"));
+
+	uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+	uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+	crypto_box_keypair(static_pk, static_sk);
+
+	// Connections are kept around since transports do not outlive their factories
+	std::vector<std::unique_ptr<Delegate>> delegates;
+	std::vector<std::unique_ptr<FactoryType>> factories;
+
+	uint16_t port = 8000;
+	for(auto &scenario : default_scenarios()) {
+		if(argc > 1 && std::strcmp(argv[1], scenario.name) != 0) {
+			continue;
+		}
+
+		nc.drop_rate = scenario.drop_rate;
+		nc.latency = scenario.latency;
+
+		auto &d = *delegates.emplace_back(new Delegate(scenario, static_sk));
+		auto &s = *factories.emplace_back(new FactoryType(i1, simulator));
+		auto &c = *factories.emplace_back(new FactoryType(i2, simulator));
+
+		auto addr = SocketAddress::from_string("192.168.0.1:" + std::to_string(port));
+		s.bind(addr);
+		s.listen(d);
+		c.bind(SocketAddress::from_string("192.168.0.2:" + std::to_string(port)));
+		c.dial(addr, d, static_pk);
+		port++;
+
+		EventLoop::run();
+
+		if(d.completed != scenario.message_count * scenario.streams) {
+			SPDLOG_ERROR("{}: only {} messages completed", scenario.name, d.completed);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,36 @@
+#include <marlin/stream/protocol/Trace.hpp>
+#include <spdlog/spdlog.h>
+
+#include <fstream>
+#include <iostream>
+
+using namespace marlin::stream;
+
+// Convert a binary trace dump from TraceRing::dump to qlog JSON
+int main(int argc, char** argv) {
+	if(argc < 2) {
+		SPDLOG_ERROR("Usage: {} <trace dump> [qlog output]", argv[0]);
+		return -1;
+	}
+
+	std::vector<TraceRecord> records;
+	if(TraceRing::load(argv[1], records) < 0) {
+		SPDLOG_ERROR("Failed to load trace dump: {}", argv[1]);
+		return -1;
+	}
+
+	if(argc < 3) {
+		TraceRing::write_qlog(std::cout, records);
+		return 0;
+	}
+
+	std::ofstream out(argv[2]);
+	TraceRing::write_qlog(out, records);
+	if(!out) {
+		SPDLOG_ERROR("Failed to write qlog: {}", argv[2]);
+		return -1;
+	}
+
+	SPDLOG_INFO("Wrote {} events to {}", records.size(), argv[2]);
+	return 0;
+}
@@ -2,6 +2,8 @@
 #define MARLIN_STREAM_MESSAGES_HPP
 
 #include <marlin/core/Buffer.hpp>
+#include "protocol/CompactHeader.hpp"
+#include "protocol/Cipher.hpp"
 
 
 namespace marlin {
@@ -196,6 +198,9 @@ struct ACKWrapper {
 	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
 	MARLIN_MESSAGES_UINT16_FIELD(size, 10);
 	MARLIN_MESSAGES_UINT64_FIELD(packet_number, 12);
+	MARLIN_MESSAGES_UINT64_FIELD(ecn_ect, 20);
+	MARLIN_MESSAGES_UINT64_FIELD(ecn_ce, 28);
+	MARLIN_MESSAGES_UINT32_FIELD(ack_delay, 36);
 
 private:
 	struct range {
@@ -219,16 +224,16 @@ private:
 		}
 	};
 public:
-	MARLIN_MESSAGES_ARRAY_FIELD(range, 20, 20 + 8*size());
+	MARLIN_MESSAGES_ARRAY_FIELD(range, 40, 40 + 8*size());
 
 	/// Construct an ACK message to hold a given number of ack ranges
-	ACKWrapper(size_t num_ranges) : base(20 + 8*num_ranges) {
+	ACKWrapper(size_t num_ranges) : base(40 + 8*num_ranges) {
 		base.set_payload({0, 2});
 	}
 
 	/// Validate the ACK message
 	[[nodiscard]] bool validate() const {
-		if(base.payload_buffer().size() < 20 || base.payload_buffer().size() != 20 + size()*8) {
+		if(base.payload_buffer().size() < 40 || base.payload_buffer().size() != 40 + (size_t)size()*8) {
 			return false;
 		}
 		return true;
@@ -252,6 +257,43 @@ struct DIALWrapper {
 	[[nodiscard]] bool validate(size_t payload_size) const {
 		return base.payload_buffer().size() >= 10 + payload_size;
 	}
+
+	/// Does the sender append feature flags to a payload of the given size
+	bool has_features(size_t payload_size) const {
+		return base.payload_buffer().size() > 10 + payload_size;
+	}
+
+	/// Get the feature flags following a payload of the given size, 0 if absent
+	uint8_t features(size_t payload_size) const {
+		return base.payload_buffer().read_uint8(10 + payload_size).value_or(0);
+	}
+
+	/// Set the feature flags following a payload of the given size
+	SelfType& set_features(size_t payload_size, uint8_t features) & {
+		base.payload_buffer().write_uint8_unsafe(10 + payload_size, features);
+		return *this;
+	}
+
+	/// Set the feature flags following a payload of the given size
+	SelfType&& set_features(size_t payload_size, uint8_t features) && {
+		return std::move(set_features(payload_size, features));
+	}
+
+	/// Get the mask of supported cipher suites following the feature flags, legacy suites if absent
+	uint8_t cipher_suites(size_t payload_size) const {
+		return base.payload_buffer().read_uint8(11 + payload_size).value_or(STREAM_CIPHER_SUITES_LEGACY);
+	}
+
+	/// Set the mask of supported cipher suites following the feature flags
+	SelfType& set_cipher_suites(size_t payload_size, uint8_t suites) & {
+		base.payload_buffer().write_uint8_unsafe(11 + payload_size, suites);
+		return *this;
+	}
+
+	/// Set the mask of supported cipher suites following the feature flags
+	SelfType&& set_cipher_suites(size_t payload_size, uint8_t suites) && {
+		return std::move(set_cipher_suites(payload_size, suites));
+	}
 };
 
 /// DIALCONF message template
@@ -271,6 +313,43 @@ struct DIALCONFWrapper {
 	[[nodiscard]] bool validate(size_t payload_size) const {
 		return base.payload_buffer().size() >= 10 + payload_size;
 	}
+
+	/// Does the sender append feature flags to a payload of the given size
+	bool has_features(size_t payload_size) const {
+		return base.payload_buffer().size() > 10 + payload_size;
+	}
+
+	/// Get the feature flags following a payload of the given size, 0 if absent
+	uint8_t features(size_t payload_size) const {
+		return base.payload_buffer().read_uint8(10 + payload_size).value_or(0);
+	}
+
+	/// Set the feature flags following a payload of the given size
+	SelfType& set_features(size_t payload_size, uint8_t features) & {
+		base.payload_buffer().write_uint8_unsafe(10 + payload_size, features);
+		return *this;
+	}
+
+	/// Set the feature flags following a payload of the given size
+	SelfType&& set_features(size_t payload_size, uint8_t features) && {
+		return std::move(set_features(payload_size, features));
+	}
+
+	/// Get the mask of supported cipher suites following the feature flags, legacy suites if absent
+	uint8_t cipher_suites(size_t payload_size) const {
+		return base.payload_buffer().read_uint8(11 + payload_size).value_or(STREAM_CIPHER_SUITES_LEGACY);
+	}
+
+	/// Set the mask of supported cipher suites following the feature flags
+	SelfType& set_cipher_suites(size_t payload_size, uint8_t suites) & {
+		base.payload_buffer().write_uint8_unsafe(11 + payload_size, suites);
+		return *this;
+	}
+
+	/// Set the mask of supported cipher suites following the feature flags
+	SelfType&& set_cipher_suites(size_t payload_size, uint8_t suites) && {
+		return std::move(set_cipher_suites(payload_size, suites));
+	}
 };
 
 /// CONF message template
@@ -405,6 +484,64 @@ struct CLOSECONFWrapper {
 	}
 };
 
+/// FEC message template
+template<typename BaseMessageType>
+struct FECWrapper {
+	MARLIN_MESSAGES_BASE(FECWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	MARLIN_MESSAGES_UINT64_FIELD(packet_number, 10);
+	MARLIN_MESSAGES_UINT16_FIELD(count, 18);
+	MARLIN_MESSAGES_PAYLOAD_FIELD(20);
+
+	/// Construct a FEC message to hold a repair symbol of the given payload size
+	FECWrapper(size_t payload_size) : base(20 + payload_size) {
+		base.set_payload({0, 13});
+	}
+
+	/// Validate the FEC message
+	[[nodiscard]] bool validate(size_t payload_size) const {
+		return base.payload_buffer().size() >= 20 + payload_size;
+	}
+};
+
+/// DATAGRAM message template
+template<typename BaseMessageType>
+struct DATAGRAMWrapper {
+	MARLIN_MESSAGES_BASE(DATAGRAMWrapper);
+	MARLIN_MESSAGES_UINT32_FIELD(src_conn_id, 6, 2);
+	MARLIN_MESSAGES_UINT32_FIELD(dst_conn_id, 2, 6);
+	/// Separate from DATA packet numbers, only used to detect replays
+	MARLIN_MESSAGES_UINT64_FIELD(packet_number, 10);
+	MARLIN_MESSAGES_PAYLOAD_FIELD(18);
+
+	/// Construct a DATAGRAM message to hold the given payload size
+	DATAGRAMWrapper(size_t payload_size) : base(18 + payload_size) {
+		base.set_payload({0, 14});
+	}
+
+	/// Validate the DATAGRAM message
+	[[nodiscard]] bool validate(size_t payload_size) const {
+		return base.payload_buffer().size() >= 18 + payload_size;
+	}
+};
+
+/// Compact DATA message template, see CompactDataHeader for the layout
+template<typename BaseMessageType>
+struct SDATAWrapper {
+	MARLIN_MESSAGES_BASE(SDATAWrapper);
+
+	/// Construct a compact DATA message with the given header and payload size
+	SDATAWrapper(CompactDataHeader const& header, size_t payload_size) : base(header.size() + payload_size) {
+		header.encode(base.payload_buffer(), 15);
+	}
+
+	/// Decode the header, recovering the packet number around the expected one
+	std::optional<CompactDataHeader> header(uint64_t expected) const {
+		return CompactDataHeader::decode(base.payload_buffer(), expected);
+	}
+};
+
 #undef MARLIN_MESSAGES_UINT16_FIELD
 #undef MARLIN_MESSAGES_UINT32_FIELD
 #undef MARLIN_MESSAGES_UINT64_FIELD
@@ -5,8 +5,10 @@
 #include <spdlog/fmt/bin_to_hex.h>
 #include <unordered_set>
 #include <unordered_map>
+#include <limits>
 #include <random>
 #include <utility>
+#include <type_traits>
 
 #include <sodium.h>
 
@@ -19,6 +21,11 @@
 #include "protocol/SendStream.hpp"
 #include "protocol/RecvStream.hpp"
 #include "protocol/AckRanges.hpp"
+#include "protocol/Fec.hpp"
+#include "protocol/Cipher.hpp"
+#include "protocol/Trace.hpp"
+#include "protocol/SendBudget.hpp"
+#include "protocol/ReplayWindow.hpp"
 #include "Messages.hpp"
 
 namespace marlin {
@@ -30,6 +37,66 @@ namespace stream {
 #define DEFAULT_PACING_LIMIT 20000
 /// Bytes that can be sent in a single packet to prevent fragmentation, accounts for header overheads
 #define DEFAULT_FRAGMENT_SIZE 1350
+/// Bytes that can be sent in a single datagram, DATAGRAM has a smaller header than DATA
+#define DEFAULT_MAX_DATAGRAM_SIZE 1362
+/// Bytes that can be queued for sending on a single connection across all streams
+#define DEFAULT_SEND_BUFFER_LIMIT 40000000
+/// Max bytes queued but not acked on a single stream
+#define DEFAULT_STREAM_QUEUE_LIMIT 20000000
+/// Feature flag advertised in DIAL/DIALCONF if compact DATA messages can be received
+#define STREAM_FEATURE_COMPACT_DATA 0x01
+/// Feature flag advertised in DIAL/DIALCONF if FEC repair packets will be sent, see set_fec_window
+#define STREAM_FEATURE_FEC 0x02
+
+/// Detects if the delegate wants to receive unreliable datagrams
+template<typename DelegateType, typename TransportType, typename = void>
+struct HasDidRecvDatagram : std::false_type {};
+
+template<typename DelegateType, typename TransportType>
+struct HasDidRecvDatagram<DelegateType, TransportType, std::void_t<decltype(
+	std::declval<DelegateType&>().did_recv_datagram(std::declval<TransportType&>(), std::declval<core::Buffer&&>())
+)>> : std::true_type {};
+
+/// Detects if the base transport reports ECN counts of received packets
+template<typename TransportType, typename = void>
+struct HasEcnCounts : std::false_type {};
+
+template<typename TransportType>
+struct HasEcnCounts<TransportType, std::void_t<
+	decltype(std::declval<TransportType&>().ecn_ect_count),
+	decltype(std::declval<TransportType&>().ecn_ce_count)
+>> : std::true_type {};
+
+/// Detects if the datagram transport records receive times of packets
+template<typename TransportType, typename = void>
+struct HasRecvTime : std::false_type {};
+
+template<typename TransportType>
+struct HasRecvTime<TransportType, std::void_t<
+	decltype(std::declval<TransportType&>().last_recv_time_us)
+>> : std::true_type {};
+
+/// Detects if the delegate wants to be notified when send buffer space frees up
+template<typename DelegateType, typename TransportType, typename = void>
+struct HasDidDrain : std::false_type {};
+
+template<typename DelegateType, typename TransportType>
+struct HasDidDrain<DelegateType, TransportType, std::void_t<decltype(
+	std::declval<DelegateType&>().did_drain(std::declval<TransportType&>())
+)>> : std::true_type {};
+
+/// Detects if the delegate wants in order data delivered as chains of contiguous slices
+template<typename DelegateType, typename TransportType, typename = void>
+struct HasDidRecvBytesChain : std::false_type {};
+
+template<typename DelegateType, typename TransportType>
+struct HasDidRecvBytesChain<DelegateType, TransportType, std::void_t<decltype(
+	std::declval<DelegateType&>().did_recv_bytes_chain(
+		std::declval<TransportType&>(),
+		std::declval<std::vector<core::Buffer>&&>(),
+		uint16_t()
+	)
+)>> : std::true_type {};
 
 /// @brief Transport class which provides stream semantics.
 ///
@@ -42,6 +109,8 @@ namespace stream {
 /// \li Transport layer encryption (disabled by default)
 /// \li Stream multiplexing
 /// \li No head-of-line blocking
+/// \li Forward error correction (disabled by default)
+/// \li Unreliable datagrams
 template<typename DelegateType, template<typename> class DatagramTransport>
 class StreamTransport {
 private:
@@ -76,6 +145,12 @@ private:
 	using CLOSE = CLOSEWrapper<BaseMessageType>;
 	/// CLOSECONF message type
 	using CLOSECONF = CLOSECONFWrapper<BaseMessageType>;
+	/// FEC message type
+	using FEC = FECWrapper<BaseMessageType>;
+	/// DATAGRAM message type
+	using DATAGRAM = DATAGRAMWrapper<BaseMessageType>;
+	/// Compact DATA message type
+	using SDATA = SDATAWrapper<BaseMessageType>;
 
 	/// Base transport instance
 	BaseTransport &transport;
@@ -121,6 +196,20 @@ private:
 	/// Helper function to get a recv stream of given stream id, creating one if needed
 	RecvStream &get_or_create_recv_stream(uint16_t const stream_id);
 
+	// Send buffer budget
+	/// Bytes queued for sending on this connection which have not been acked yet
+	uint64_t queued_bytes = 0;
+	/// Max bytes that can be queued for sending on this connection
+	uint64_t send_buffer_limit = DEFAULT_SEND_BUFFER_LIMIT;
+	/// Account for queued data which has been acked or dropped
+	void release_send_buffer(uint64_t size);
+	/// Notify the delegate if this transport was blocked and its budgets are below their low watermarks
+	void try_drain();
+	/// SendBudget callback retrying a blocked transport
+	static void drain_cb(void *transport);
+	/// Notify this and any other blocked transport which can accept data again
+	void check_drain();
+
 	// Packets
 	/// Packet number of last sent packet.
 	/// Strictly increasing, retransmitted packets have different packet number than the original
@@ -134,8 +223,10 @@ private:
 	std::map<uint64_t, SentPacketInfo> lost_packets;
 
 	// RTT estimate
-	/// RTT estimate of connection
+	/// RTT estimate of connection in milliseconds, sampled with microsecond resolution
 	double rtt = -1;
+	/// Smallest unadjusted RTT sample in microseconds, bounds how much of the peer's ack delay gets subtracted
+	uint64_t min_rtt_us = UINT64_MAX;
 
 	// Congestion control
 	uint64_t bytes_in_flight = 0;
@@ -146,6 +237,32 @@ private:
 	uint64_t congestion_start = 0;
 	uint64_t largest_acked = 0;
 	uint64_t largest_sent_time = 0;
+	/// Time the largest packet number was received, peer subtracts the difference from its RTT sample
+	uint64_t largest_recv_time_us = 0;
+	/// Did the peer advertise support for compact DATA messages
+	bool peer_compact_data = false;
+
+	/// Largest CE count reported by the peer, increases signal congestion without loss
+	uint64_t largest_ecn_ce = 0;
+	/// Multiplicative decrease of the congestion window with CUBIC fast convergence, starts a new congestion epoch
+	void on_congestion_event(TraceLossTrigger trigger);
+
+	// Datagrams
+	/// Packet number of last sent datagram
+	uint64_t last_sent_datagram = 0;
+	/// Packet numbers of received datagrams, drops replays
+	ReplayWindow datagram_replay_window;
+
+	// Unacked messages
+	/// Bytes of datagrams and FEC repair packets counted in bytes_in_flight.
+	/// They are never acked, so they are released on the next ACK, loss epoch or once an RTT has passed.
+	uint64_t unacked_bytes_in_flight = 0;
+	/// Time in milliseconds the oldest unreleased message was sent
+	uint64_t unacked_sent_time = 0;
+	/// Count a sent message which is never acked against the congestion window
+	void charge_unacked(uint64_t size);
+	/// Stop counting unacked messages against the congestion window, all of them or only if sent over an RTT ago
+	void release_unacked(bool stale_only = false);
 
 	// Send
 	/// List of stream ids with data ready to be sent
@@ -173,6 +290,9 @@ private:
 	bool is_pacing_timer_active = false;
 	/// Pacing timer callback to send a new batch of packets
 	void pacing_timer_cb();
+	/// Send lost and new data until the pacing limit or congestion window is hit.
+	/// 0 if idle, -1 if pacing limited, -2 if congestion window limited.
+	int send_burst(uint64_t initial_bytes_in_flight);
 
 	// TLP (Tail Loss Probe)
 	/// Timer to detect no acks for a long time
@@ -192,6 +312,34 @@ private:
 	/// Timer callback for sending an ack
 	void ack_timer_cb();
 
+	// FEC
+	/// Builds repair symbols over sent DATA packets
+	FecEncoder fec_encoder;
+	/// Recovers lost DATA packets from received repair symbols
+	FecDecoder fec_decoder;
+
+	// Trace
+	/// Ring to record events into, nullptr if tracing is off
+	TraceRing* trace = nullptr;
+	/// Record an event for this connection if tracing is on
+	void trace_event(TraceEvent event, uint64_t a, uint64_t b, uint64_t c);
+
+	// Recv chains
+	/// Hand in order data to the application, either directly or through the stream chain
+	int did_read_bytes(RecvStream &stream, core::Buffer &&bytes);
+	/// Deliver the data made readable by the current packet as a single chain
+	int flush_recv_chain(RecvStream &stream);
+
+	/// Process DATA which was either received or recovered
+	void did_recv_fragment(
+		uint64_t packet_number,
+		uint16_t stream_id,
+		uint64_t offset,
+		uint16_t length,
+		bool is_fin,
+		core::Buffer &&p
+	);
+
 	// Protocol
 	void send_DIAL();
 	void did_recv_DIAL(DIAL &&packet);
@@ -212,6 +360,7 @@ private:
 		uint16_t length
 	);
 	void did_recv_DATA(DATA &&packet);
+	void did_recv_SDATA(SDATA &&packet);
 
 	void send_ACK();
 	void did_recv_ACK(ACK &&packet);
@@ -231,6 +380,15 @@ private:
 	void send_CLOSECONF(uint32_t src_conn_id, uint32_t dst_conn_id);
 	void did_recv_CLOSECONF(CLOSECONF &&packet);
 
+	void send_FEC();
+	void did_recv_FEC(FEC &&packet);
+
+	void send_DATAGRAM(core::Buffer &&bytes);
+	void did_recv_DATAGRAM(DATAGRAM &&packet);
+
+	/// Receive time of the packet being processed in microseconds
+	uint64_t recv_time_us();
+
 public:
 	/// Delegate calls from base transport
 	void did_dial(BaseTransport &transport);
@@ -257,11 +415,21 @@ public:
 		core::TransportManager<Self> &transport_manager,
 		uint8_t const* remote_static_pk
 	);
+	/// Destructor
+	~StreamTransport();
 
 	/// Setup function that can be called to set the delegate and the private key
 	void setup(DelegateType *delegate, uint8_t const* static_sk);
-	/// Queues the given buffer for transmission
+	/// Queues the given buffer for transmission.
+	/// Returns -1 if the stream, connection or loop send buffer is full,
+	/// the optional did_drain delegate callback fires once the connection can accept data again.
 	int send(core::Buffer &&bytes, uint16_t stream_id = 0);
+	/// Checks if size bytes can be queued on the stream without sending anything.
+	/// Returns 0 if they fit, -1 like send otherwise, did_drain then fires once they might.
+	int check_send_buffer(uint64_t size, uint16_t stream_id = 0);
+	/// Sends the given buffer as a single unreliable datagram, never retransmitted.
+	/// Delivered to the peer through the optional did_recv_datagram delegate callback.
+	int send_datagram(core::Buffer &&bytes);
 
 	/// Close reason
 	uint16_t close_reason = 0;
@@ -274,6 +442,20 @@ public:
 	bool is_active();
 	/// Get the RTT estimate of the connection
 	double get_rtt();
+	/// Get the smallest RTT sample of the connection in microseconds, before ack delay adjustment
+	uint64_t get_min_rtt_us();
+
+	/// Get the bytes queued for sending which have not been acked yet
+	uint64_t get_queued_bytes();
+	/// Set the max bytes that can be queued for sending on this connection
+	void set_send_buffer_limit(uint64_t limit);
+	/// Set the max bytes that can be queued for sending across all stream transports on the loop of this thread
+	static void set_global_send_buffer_limit(uint64_t limit);
+
+	/// Send one XOR repair packet for every `window` DATA packets, 0 disables FEC.
+	/// The peer can recover a single lost packet per window without waiting for retransmission.
+	/// Set before the handshake, e.g. in did_create_transport, so the peer can recover from the first window.
+	void set_fec_window(uint8_t window);
 
 	/// Timer callback for SKIPSTREAM timeout
 	void skip_timer_cb(RecvStream& stream);
@@ -302,15 +484,40 @@ private:
 	uint8_t rx[crypto_kx_SESSIONKEYBYTES];
 	uint8_t tx[crypto_kx_SESSIONKEYBYTES];
 
-	uint8_t nonce[crypto_aead_aes256gcm_NPUBBYTES];
+	uint8_t nonce[STREAM_CIPHER_NPUBBYTES];
+	/// Nonces of compact DATA messages are derived from these and the packet number
+	uint8_t tx_iv[STREAM_CIPHER_NPUBBYTES];
+	uint8_t rx_iv[STREAM_CIPHER_NPUBBYTES];
+
+	void derive_ivs();
+
+	StreamCipher rx_cipher;
+	StreamCipher tx_cipher;
+
+	/// Offer the integrity only suite in the handshake
+	bool integrity_only = false;
 
-	alignas(16) crypto_aead_aes256gcm_state rx_ctx;
-	alignas(16) crypto_aead_aes256gcm_state tx_ctx;
+	uint8_t local_cipher_suites();
+	/// Feature flags advertised in DIAL/DIALCONF
+	uint8_t local_features();
+	bool setup_ciphers(uint8_t remote_suites);
+	/// Mix the feature flags and cipher suites of both sides into the session keys.
+	/// They travel outside the sealed handshake payload, so a peer seeing tampered values ends up with different keys.
+	/// Absent values are bound too, so stripping them off both handshake messages does not go unnoticed.
+	void bind_negotiation(bool remote_has_features, uint8_t remote_features, uint8_t remote_suites);
 public:
 	/// Get the public key of self
 	uint8_t const* get_static_pk();
 	/// Get the public key of the destination
 	uint8_t const* get_remote_static_pk();
+	/// Get the cipher suite negotiated with the destination
+	CipherSuite get_cipher_suite();
+	/// Authenticate packets without encrypting them if the destination opts in as well.
+	/// Meant for trusted links, must be called before the handshake, e.g. in did_create_transport.
+	void set_integrity_only(bool enabled);
+	/// Record sent/acked/lost packets, congestion control and pacing decisions into the given ring, nullptr to stop.
+	/// See TraceRing::loop() for a ring shared by all connections.
+	void set_trace(TraceRing* ring);
 };
 
 
@@ -330,6 +537,9 @@ void StreamTransport<DelegateType, DatagramTransport>::reset() {
 		stream.state_timer.stop();
 	}
 	send_streams.clear();
+
+	release_send_buffer(queued_bytes);
+	SendBudget::loop().unblock(this);
 	for(auto& [_, stream] : recv_streams) {
 		stream.state_timer.stop();
 	}
@@ -340,6 +550,7 @@ void StreamTransport<DelegateType, DatagramTransport>::reset() {
 	lost_packets.clear();
 
 	rtt = -1;
+	min_rtt_us = UINT64_MAX;
 
 	bytes_in_flight = 0;
 	k = 0;
@@ -349,6 +560,14 @@ void StreamTransport<DelegateType, DatagramTransport>::reset() {
 	congestion_start = 0;
 	largest_acked = 0;
 	largest_sent_time = 0;
+	largest_recv_time_us = 0;
+	peer_compact_data = false;
+	largest_ecn_ce = 0;
+
+	last_sent_datagram = 0;
+	datagram_replay_window = ReplayWindow();
+	unacked_bytes_in_flight = 0;
+	unacked_sent_time = 0;
 
 	send_queue_ids.clear();
 	send_queue.clear();
@@ -362,6 +581,13 @@ void StreamTransport<DelegateType, DatagramTransport>::reset() {
 	ack_ranges = AckRanges();
 	ack_timer.stop();
 	ack_timer_active = false;
+
+
+	// Other transports might be able to use the released budget
+	check_drain();
+
+	fec_encoder.clear();
+	fec_decoder = FecDecoder();
 }
 
 // Impl
@@ -529,13 +755,33 @@ int StreamTransport<DelegateType, DatagramTransport>::send_new_data(
 
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::pacing_timer_cb() {
+	thread_local auto &site = asyncio::LoopStats::loop().site("stream.pacing");
+	asyncio::ProfileScope profile(site);
+
 	this->is_pacing_timer_active = false;
 
 	auto initial_bytes_in_flight = this->bytes_in_flight;
+	auto res = this->send_burst(initial_bytes_in_flight);
+
+	trace_event(
+		TraceEvent::PacingBurst,
+		static_cast<uint64_t>(res == 0 ? TracePacingResult::Idle :
+			res == -1 ? TracePacingResult::PacingLimited : TracePacingResult::CongestionLimited),
+		this->bytes_in_flight - initial_bytes_in_flight,
+		this->bytes_in_flight
+	);
+}
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+int StreamTransport<DelegateType, DatagramTransport>::send_burst(
+	uint64_t initial_bytes_in_flight
+) {
 	auto res = this->send_lost_data(initial_bytes_in_flight);
+	if(res == -2) { // Congestion window exhausted, flush partial repair window
+		this->send_FEC();
+	}
 	if(res < 0) {
-		return;
+		return res;
 	}
 
 	// New packets
@@ -554,11 +800,17 @@ void StreamTransport<DelegateType, DatagramTransport>::pacing_timer_cb() {
 			// Pacing limit hit, reschedule timer
 			this->is_pacing_timer_active = true;
 			pacing_timer.template start<Self, &Self::pacing_timer_cb>(1, 0);
-			return;
+			return -1;
 		} else { // Congestion window exhausted, break
-			return;
+			this->send_FEC();
+			return -2;
 		}
 	}
+
+	// Idle, flush partial repair window
+	this->send_FEC();
+
+	return 0;
 }
 
 //---------------- Pacing functions end ----------------//
@@ -586,6 +838,13 @@ void StreamTransport<DelegateType, DatagramTransport>::tlp_timer_cb() {
 		sent_iter->second.stream->bytes_in_flight -= sent_iter->second.length;
 		this->lost_packets[sent_iter->first] = sent_iter->second;
 
+		trace_event(
+			TraceEvent::PacketLost,
+			sent_iter->first,
+			sent_iter->second.length,
+			static_cast<uint64_t>(TraceLossTrigger::Timer)
+		);
+
 		sent_iter++;
 	}
 
@@ -603,28 +862,13 @@ void StreamTransport<DelegateType, DatagramTransport>::tlp_timer_cb() {
 				this->dst_addr.to_string(),
 				this->congestion_window
 			);
-			this->congestion_start = asyncio::EventLoop::now();
-
-			if(this->congestion_window < this->w_max) {
-				// Fast convergence
-				this->w_max = this->congestion_window;
-				this->congestion_window *= 0.6;
-			} else {
-				this->w_max = this->congestion_window;
-				this->congestion_window *= 0.75;
-			}
-
-			if(this->congestion_window < 10000) {
-				this->congestion_window = 10000;
-			}
-
-			this->ssthresh = this->congestion_window;
-
-			this->k = std::cbrt(this->w_max / 16)*1000;
+			this->on_congestion_event(TraceLossTrigger::Timer);
 		}
 
 		// Pop lost packets from sent
 		this->sent_packets.erase(this->sent_packets.cbegin(), sent_iter);
+
+		trace_event(TraceEvent::CongestionUpdated, this->congestion_window, this->ssthresh, this->bytes_in_flight);
 	}
 
 	// New packets
@@ -659,6 +903,81 @@ void StreamTransport<DelegateType, DatagramTransport>::ack_timer_cb() {
 
 //---------------- Protocol functions begin ----------------//
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::derive_ivs() {
+	constexpr char label[] = "marlin stream iv";
+	uint8_t out[crypto_generichash_BYTES_MIN];
+
+	// Peer derives the same IV for its rx direction from its rx key
+	crypto_generichash(out, sizeof(out), (uint8_t const*)label, sizeof(label) - 1, tx, sizeof(tx));
+	std::memcpy(tx_iv, out, STREAM_CIPHER_NPUBBYTES);
+	crypto_generichash(out, sizeof(out), (uint8_t const*)label, sizeof(label) - 1, rx, sizeof(rx));
+	std::memcpy(rx_iv, out, STREAM_CIPHER_NPUBBYTES);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+uint8_t StreamTransport<DelegateType, DatagramTransport>::local_cipher_suites() {
+	auto suites = supported_cipher_suites();
+	if(integrity_only) {
+		suites |= static_cast<uint8_t>(CipherSuite::POLY1305);
+	}
+
+	return suites;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+uint8_t StreamTransport<DelegateType, DatagramTransport>::local_features() {
+	return STREAM_FEATURE_COMPACT_DATA | (fec_encoder.window > 0 ? STREAM_FEATURE_FEC : 0);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+bool StreamTransport<DelegateType, DatagramTransport>::setup_ciphers(uint8_t remote_suites) {
+	auto suite = select_cipher_suite(local_cipher_suites(), remote_suites);
+	if(!suite.has_value()) {
+		if constexpr (is_encrypted) {
+			return false;
+		}
+		// Unused, but keep the state valid
+		suite = CipherSuite::CHACHA20POLY1305;
+	}
+
+	randombytes_buf(nonce, STREAM_CIPHER_NPUBBYTES);
+	rx_cipher.init(suite.value(), rx);
+	tx_cipher.init(suite.value(), tx);
+	derive_ivs();
+
+	return true;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::bind_negotiation(
+	bool remote_has_features,
+	uint8_t remote_features,
+	uint8_t remote_suites
+) {
+	constexpr char label[] = "marlin stream features";
+	// Presence marker first so absent values never hash like values which were sent as zero
+	uint8_t local[3] = {1, local_features(), local_cipher_suites()};
+	uint8_t remote[3] = {1, remote_features, remote_suites};
+	if(!remote_has_features) {
+		remote[0] = remote[1] = remote[2] = 0;
+	}
+
+	// Both sides hash the values in the same order, the side deriving server keys goes first.
+	// Covering the suites keeps an attacker from stripping them down to a weaker common suite.
+	bool is_server = std::memcmp(ephemeral_pk, remote_ephemeral_pk, crypto_kx_PUBLICKEYBYTES) > 0;
+	uint8_t transcript[sizeof(label) - 1 + 6];
+	std::memcpy(transcript, label, sizeof(label) - 1);
+	std::memcpy(transcript + sizeof(label) - 1, is_server ? local : remote, 3);
+	std::memcpy(transcript + sizeof(label) + 2, is_server ? remote : local, 3);
+
+	uint8_t out[crypto_kx_SESSIONKEYBYTES];
+	crypto_generichash(out, sizeof(out), transcript, sizeof(transcript), rx, sizeof(rx));
+	std::memcpy(rx, out, sizeof(rx));
+	crypto_generichash(out, sizeof(out), transcript, sizeof(transcript), tx, sizeof(tx));
+	std::memcpy(tx, out, sizeof(tx));
+}
+
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_DIAL() {
 	SPDLOG_DEBUG(
@@ -677,10 +996,12 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DIAL() {
 	crypto_box_seal(buf, buf, pt_len, remote_static_pk);
 
 	transport.send(
-		DIAL(ct_len)
+		DIAL(ct_len + 2)
 		.set_src_conn_id(this->src_conn_id)
 		.set_dst_conn_id(this->dst_conn_id)
 		.set_payload(buf, ct_len)
+		.set_features(ct_len, local_features())
+		.set_cipher_suites(ct_len, local_cipher_suites())
 	);
 }
 
@@ -740,12 +1061,28 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIAL(
 			return;
 		}
 
-		randombytes_buf(nonce, crypto_aead_aes256gcm_NPUBBYTES);
-		crypto_aead_aes256gcm_beforenm(&rx_ctx, rx);
-		crypto_aead_aes256gcm_beforenm(&tx_ctx, tx);
+		bind_negotiation(
+			packet.has_features(ct_len),
+			packet.features(ct_len),
+			packet.cipher_suites(ct_len)
+		);
+
+		if(!setup_ciphers(packet.cipher_suites(ct_len))) {
+			SPDLOG_ERROR(
+				"Stream transport {{ Src: {}, Dst: {} }}: DIAL: No common cipher suite",
+				src_addr.to_string(),
+				dst_addr.to_string()
+			);
+			return;
+		}
 
 		this->dst_conn_id = packet.dst_conn_id();
 		this->src_conn_id = (uint32_t)std::random_device()();
+		peer_compact_data = packet.features(ct_len) & STREAM_FEATURE_COMPACT_DATA;
+		if(packet.features(ct_len) & STREAM_FEATURE_FEC) {
+			// Cache from the first DATA so the first window can be recovered too
+			fec_decoder.enable();
+		}
 
 		send_DIALCONF();
 
@@ -790,11 +1127,27 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIAL(
 			return;
 		}
 
-		randombytes_buf(nonce, crypto_aead_aes256gcm_NPUBBYTES);
-		crypto_aead_aes256gcm_beforenm(&rx_ctx, rx);
-		crypto_aead_aes256gcm_beforenm(&tx_ctx, tx);
+		bind_negotiation(
+			packet.has_features(ct_len),
+			packet.features(ct_len),
+			packet.cipher_suites(ct_len)
+		);
+
+		if(!setup_ciphers(packet.cipher_suites(ct_len))) {
+			SPDLOG_ERROR(
+				"Stream transport {{ Src: {}, Dst: {} }}: DIAL: No common cipher suite",
+				src_addr.to_string(),
+				dst_addr.to_string()
+			);
+			return;
+		}
 
 		this->dst_conn_id = packet.dst_conn_id();
+		peer_compact_data = packet.features(ct_len) & STREAM_FEATURE_COMPACT_DATA;
+		if(packet.features(ct_len) & STREAM_FEATURE_FEC) {
+			// Cache from the first DATA so the first window can be recovered too
+			fec_decoder.enable();
+		}
 
 		state_timer.stop();
 		state_timer_interval = 0;
@@ -832,10 +1185,12 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DIALCONF() {
 	crypto_box_seal(buf, ephemeral_pk, pt_len, remote_static_pk);
 
 	transport.send(
-		DIALCONF(ct_len)
+		DIALCONF(ct_len + 2)
 		.set_src_conn_id(this->src_conn_id)
 		.set_dst_conn_id(this->dst_conn_id)
 		.set_payload(buf, ct_len)
+		.set_features(ct_len, local_features())
+		.set_cipher_suites(ct_len, local_cipher_suites())
 	);
 }
 
@@ -888,14 +1243,30 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DIALCONF(
 			return;
 		}
 
-		randombytes_buf(nonce, crypto_aead_aes256gcm_NPUBBYTES);
-		crypto_aead_aes256gcm_beforenm(&rx_ctx, rx);
-		crypto_aead_aes256gcm_beforenm(&tx_ctx, tx);
+		bind_negotiation(
+			packet.has_features(ct_len),
+			packet.features(ct_len),
+			packet.cipher_suites(ct_len)
+		);
+
+		if(!setup_ciphers(packet.cipher_suites(ct_len))) {
+			SPDLOG_ERROR(
+				"Stream transport {{ Src: {}, Dst: {} }}: DIALCONF: No common cipher suite",
+				src_addr.to_string(),
+				dst_addr.to_string()
+			);
+			return;
+		}
 
 		state_timer.stop();
 		state_timer_interval = 0;
 
 		this->dst_conn_id = packet.dst_conn_id();
+		peer_compact_data = packet.features(ct_len) & STREAM_FEATURE_COMPACT_DATA;
+		if(packet.features(ct_len) & STREAM_FEATURE_FEC) {
+			// Cache from the first DATA so the first window can be recovered too
+			fec_decoder.enable();
+		}
 
 		send_CONF();
 
@@ -1100,6 +1471,16 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_RST(
 		);
 		reset();
 		transport.close();
+	} else if(src_conn_id == 0 && dst_conn_id == this->dst_conn_id && peer_compact_data) {
+		// Peer could not match a compact header, which only carries our dst, see did_recv_SDATA.
+		// The dst travels in the clear so this proves nothing, fall back to full headers instead of
+		// tearing down. A stale peer rejects those with a RST carrying both ids.
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: RST: Falling back to full DATA headers",
+			src_addr.to_string(),
+			dst_addr.to_string()
+		);
+		peer_compact_data = false;
 	} else if (conn_state == ConnectionState::Listen) {
 		// Remove idle connection, usually happens if multiple RST are sent
 		reset();
@@ -1119,33 +1500,65 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DATA(
 	bool is_fin = (stream.done_queueing &&
 		data_item.stream_offset + offset + length >= stream.queue_offset);
 
-	auto packet = DATA(12 + length + crypto_aead_aes256gcm_ABYTES, is_fin)
-					.set_src_conn_id(src_conn_id)
-					.set_dst_conn_id(dst_conn_id)
-					.set_packet_number(this->last_sent_packet)
-					.set_stream_id(stream.stream_id)
-					.set_offset(data_item.stream_offset + offset)
-					.set_length(length)
-					.payload_buffer();
-
-	// Figure out better way
-	packet.uncover_unsafe(30);
-	packet.write_unsafe(30, data_item.data.data()+offset, length);
-	packet.write_unsafe(30 + length + crypto_aead_aes256gcm_ABYTES, nonce, 12);
+	// Compact header if the peer supports it, packet number is truncated relative to the largest acked
+	CompactDataHeader header {
+		dst_conn_id,
+		is_fin,
+		this->last_sent_packet,
+		packet_number_length(this->last_sent_packet, largest_acked),
+		stream.stream_id,
+		data_item.stream_offset + offset
+	};
+	size_t header_size = peer_compact_data ? header.size() : 30;
+
+	core::Buffer packet = peer_compact_data ?
+		BaseMessageType(SDATA(header, length + STREAM_CIPHER_ABYTES)).payload_buffer() :
+		DATA(12 + length + STREAM_CIPHER_ABYTES, is_fin)
+			.set_src_conn_id(src_conn_id)
+			.set_dst_conn_id(dst_conn_id)
+			.set_packet_number(this->last_sent_packet)
+			.set_stream_id(stream.stream_id)
+			.set_offset(data_item.stream_offset + offset)
+			.set_length(length)
+			.payload_buffer();
+
+	if(!peer_compact_data) {
+		packet.uncover_unsafe(30);
+		packet.write_unsafe(30 + length + STREAM_CIPHER_ABYTES, nonce, 12);
+	}
+
+	if(fec_encoder.window > 0) {
+		fec_encoder.add(
+			this->last_sent_packet,
+			stream.stream_id,
+			data_item.stream_offset + offset,
+			length,
+			is_fin,
+			data_item.data.data()+offset
+		);
+	}
 
 	if constexpr (is_encrypted) {
-		crypto_aead_aes256gcm_encrypt_afternm(
-			packet.data() + 18,
-			nullptr,
-			packet.data() + 18,
-			12 + length,
-			packet.data() + 2,
-			16,
-			nullptr,
-			nonce,
-			&tx_ctx
+		// Compact DATA does not carry the nonce, peer derives it from the packet number
+		uint8_t compact_nonce[STREAM_CIPHER_NPUBBYTES];
+		if(peer_compact_data) {
+			compact_data_nonce(compact_nonce, tx_iv, this->last_sent_packet);
+		}
+
+		// Encrypt straight from the data item, header is authenticated but not encrypted
+		tx_cipher.encrypt(
+			packet.data() + header_size,
+			data_item.data.data() + offset,
+			length,
+			peer_compact_data ? packet.data() : packet.data() + 2,
+			peer_compact_data ? header_size : 28,
+			peer_compact_data ? compact_nonce : nonce
 		);
-		sodium_increment(nonce, 12);
+		if(!peer_compact_data) {
+			sodium_increment(nonce, 12);
+		}
+	} else {
+		packet.write_unsafe(header_size, data_item.data.data()+offset, length);
 	}
 
 	this->sent_packets.emplace(
@@ -1156,22 +1569,28 @@ void StreamTransport<DelegateType, DatagramTransport>::send_DATA(
 			&stream,
 			&data_item,
 			offset,
-			length
+			length,
+			asyncio::EventLoop::now_us()
 		)
 	);
+	trace_event(TraceEvent::PacketSent, this->last_sent_packet, length, stream.stream_id);
 
 	transport.send(std::move(packet));
 
 	if(is_fin && stream.state != SendStream::State::Acked) {
 		stream.state = SendStream::State::Sent;
 	}
+
+	if(fec_encoder.is_full()) {
+		send_FEC();
+	}
 }
 
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 	DATA &&packet
 ) {
-	if(!packet.validate(12 + crypto_aead_aes256gcm_ABYTES)) {
+	if(!packet.validate(12 + STREAM_CIPHER_ABYTES)) {
 		return;
 	}
 
@@ -1192,16 +1611,13 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 	}
 
 	if constexpr (is_encrypted) {
-		auto res = crypto_aead_aes256gcm_decrypt_afternm(
-			packet.payload() - 12,
-			nullptr,
-			nullptr,
-			packet.payload() - 12,
-			packet.payload_buffer().size(),
+		auto res = rx_cipher.decrypt(
+			packet.payload(),
+			packet.payload(),
+			packet.payload_buffer().size() - 12,
 			packet.payload() - 28,
-			16,
-			packet.payload() + packet.payload_buffer().size() - 12,
-			&rx_ctx
+			28,
+			packet.payload() + packet.payload_buffer().size() - 12
 		);
 
 		if(res < 0) {
@@ -1232,8 +1648,115 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 	auto offset = packet.offset();
 	auto length = packet.length();
 	auto packet_number = packet.packet_number();
+	auto stream_id = packet.stream_id();
+	auto is_fin = packet.is_fin_set();
+
+	auto p = std::move(packet).payload_buffer();
+	p.truncate_unsafe(STREAM_CIPHER_ABYTES + 12);
+
+	// Check if length matches packet
+	// FIXME: Why even have length? Can just set from the packet
+	if(p.size() != length) {
+		return;
+	}
+
+	fec_decoder.add(packet_number, stream_id, offset, length, is_fin, p.data());
+
+	did_recv_fragment(packet_number, stream_id, offset, length, is_fin, std::move(p));
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_SDATA(
+	SDATA &&packet
+) {
+	// Recover the packet number around the next one we expect
+	uint64_t expected = ack_ranges.ranges.size() == 0 ? 0 : ack_ranges.largest + 1;
+	auto header = packet.header(expected);
+	if(!header.has_value()) {
+		return;
+	}
+
+	size_t header_size = header->size();
+	if(packet.base.payload_buffer().size() < header_size + STREAM_CIPHER_ABYTES) {
+		return;
+	}
+
+	if(header->conn_id != this->src_conn_id) { // Wrong connection id, send RST
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: SDATA: Connection id mismatch: {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			header->conn_id,
+			this->src_conn_id
+		);
+		// Src of the peer is not on the wire, leave it empty
+		send_RST(header->conn_id, 0);
+		return;
+	}
+
+	if constexpr (is_encrypted) {
+		uint8_t compact_nonce[STREAM_CIPHER_NPUBBYTES];
+		compact_data_nonce(compact_nonce, rx_iv, header->packet_number);
+
+		auto buf = packet.base.payload_buffer();
+		auto res = rx_cipher.decrypt(
+			buf.data() + header_size,
+			buf.data() + header_size,
+			buf.size() - header_size,
+			buf.data(),
+			header_size,
+			compact_nonce
+		);
+
+		// Could also be a packet number decoded from a stale packet, drop and let it get retransmitted
+		if(res < 0) {
+			SPDLOG_ERROR(
+				"Stream transport {{ Src: {}, Dst: {} }}: SDATA: Decryption failure: {}, {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				this->src_conn_id,
+				this->dst_conn_id
+			);
+			return;
+		}
+	}
+
+	SPDLOG_TRACE("SDATA <<< {}: {}", dst_addr.to_string(), header->offset);
+
+	if(conn_state == ConnectionState::DialRcvd) {
+		conn_state = ConnectionState::Established;
+
+		if(dialled) {
+			delegate->did_dial(*this);
+		}
+	} else if(conn_state != ConnectionState::Established) {
+		return;
+	}
+
+	auto p = std::move(packet.base).payload_buffer();
+	p.cover_unsafe(header_size);
+	p.truncate_unsafe(STREAM_CIPHER_ABYTES);
+
+	if(p.size() > std::numeric_limits<uint16_t>::max()) {
+		return;
+	}
+	uint16_t length = p.size();
+
+	fec_decoder.add(header->packet_number, header->stream_id, header->offset, length, header->is_fin, p.data());
+
+	did_recv_fragment(header->packet_number, header->stream_id, header->offset, length, header->is_fin, std::move(p));
+}
 
-	auto &stream = get_or_create_recv_stream(packet.stream_id());
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_fragment(
+	uint64_t packet_number,
+	uint16_t stream_id,
+	uint64_t offset,
+	uint16_t length,
+	bool is_fin,
+	core::Buffer &&p
+) {
+	auto &stream = get_or_create_recv_stream(stream_id);
 
 	// Short circuit once stream has been received fully.
 	if(stream.state == RecvStream::State::AllRecv ||
@@ -1247,22 +1770,16 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 	}
 
 	// Set stream size if fin bit set
-	if(packet.is_fin_set() && stream.state == RecvStream::State::Recv) {
+	if(is_fin && stream.state == RecvStream::State::Recv) {
 		stream.size = offset + length;
 		stream.state = RecvStream::State::SizeKnown;
 	}
 
-	auto p = std::move(packet).payload_buffer();
-	p.truncate_unsafe(crypto_aead_aes256gcm_ABYTES + 12);
-
-	// Check if length matches packet
-	// FIXME: Why even have length? Can just set from the packet
-	if(p.size() != length) {
-		return;
-	}
-
 	// Add to ack range
 	ack_ranges.add_packet_number(packet_number);
+	if(packet_number == ack_ranges.largest) {
+		largest_recv_time_us = recv_time_us();
+	}
 
 	// Start ack delay timer if not already active
 	if(!ack_timer_active) {
@@ -1281,7 +1798,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 		p.cover_unsafe(stream.read_offset - offset);
 
 		// Read bytes and update offset
-		auto res = delegate->did_recv_bytes(*this, std::move(p), stream.stream_id);
+		auto res = did_read_bytes(stream, std::move(p));
 		if(res < 0) {
 			return;
 		}
@@ -1305,7 +1822,7 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 
 				// Read bytes and update offset
 				SPDLOG_DEBUG("Out of order: {}, {}, {:spn}", offset, length, spdlog::to_hex(iter->second.packet.data(), iter->second.packet.data() + iter->second.packet.size()));
-				auto res = delegate->did_recv_bytes(*this, std::move(iter->second).packet, stream.stream_id);
+				auto res = did_read_bytes(stream, std::move(iter->second).packet);
 				if(res < 0) {
 					return;
 				}
@@ -1317,6 +1834,12 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 			iter = stream.recv_packets.erase(iter);
 		}
 
+		// Usually a single slice, more if this packet filled a gap
+		res = flush_recv_chain(stream);
+		if(res < 0) {
+			return;
+		}
+
 		// Check all data read
 		if(stream.check_read()) {
 			stream.state = RecvStream::State::Read;
@@ -1340,15 +1863,67 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATA(
 	}
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+int StreamTransport<DelegateType, DatagramTransport>::did_read_bytes(
+	RecvStream &stream,
+	core::Buffer &&bytes
+) {
+	if constexpr (HasDidRecvBytesChain<DelegateType, Self>::value) {
+		// Delivered by flush_recv_chain once the packet has been processed
+		stream.recv_chain.push_back(std::move(bytes));
+
+		return 0;
+	} else {
+		return delegate->did_recv_bytes(*this, std::move(bytes), stream.stream_id);
+	}
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+int StreamTransport<DelegateType, DatagramTransport>::flush_recv_chain(
+	RecvStream &stream [[maybe_unused]]
+) {
+	if constexpr (HasDidRecvBytesChain<DelegateType, Self>::value) {
+		if(stream.recv_chain.size() == 0) {
+			return 0;
+		}
+
+		auto chain = std::move(stream.recv_chain);
+		stream.recv_chain.clear();
+
+		return delegate->did_recv_bytes_chain(*this, std::move(chain), stream.stream_id);
+	}
+
+	return 0;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+uint64_t StreamTransport<DelegateType, DatagramTransport>::recv_time_us() {
+	if constexpr (HasRecvTime<BaseTransport>::value) {
+		return transport.last_recv_time_us;
+	} else {
+		return asyncio::EventLoop::now_us();
+	}
+}
+
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::send_ACK() {
-	size_t size = ack_ranges.ranges.size() > 171 ? 171 : ack_ranges.ranges.size();
+	size_t size = ack_ranges.ranges.size() > 168 ? 168 : ack_ranges.ranges.size();
+
+	uint64_t ecn_ect = 0;
+	uint64_t ecn_ce = 0;
+	if constexpr (HasEcnCounts<BaseTransport>::value) {
+		ecn_ect = transport.ecn_ect_count;
+		ecn_ce = transport.ecn_ce_count;
+	}
 
 	transport.send(
 		ACK(size)
 		.set_src_conn_id(src_conn_id)
 		.set_dst_conn_id(dst_conn_id)
 		.set_packet_number(ack_ranges.largest)
+		.set_ecn_ect(ecn_ect)
+		.set_ecn_ce(ecn_ce)
+		.set_ack_delay(std::min<uint64_t>(asyncio::EventLoop::now_us() - largest_recv_time_us, UINT32_MAX))
 		.set_size(size)
 		.set_ranges(ack_ranges.ranges.begin(), ack_ranges.ranges.end())
 	);
@@ -1382,7 +1957,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		return;
 	}
 
-	auto now = asyncio::EventLoop::now();
+	// Datagrams and repair packets sent before this ACK have either arrived or been lost by now
+	release_unacked();
 
 	uint64_t largest = packet.packet_number();
 
@@ -1394,11 +1970,38 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		largest_acked = largest;
 		largest_sent_time = sent_packet.sent_time;
 
-		// Update RTT estimate
+		// Update RTT estimate in microseconds, excluding the time the peer held on to the ack
+		uint64_t recv_time = recv_time_us();
+		uint64_t sample_us = recv_time > sent_packet.sent_time_us ? recv_time - sent_packet.sent_time_us : 0;
+		min_rtt_us = std::min(min_rtt_us, sample_us);
+		// RFC 9002 5.3, never adjust a sample below the minimum RTT
+		if(sample_us >= min_rtt_us + packet.ack_delay()) {
+			sample_us -= packet.ack_delay();
+		}
+
 		if(rtt < 0) {
-			rtt = now - sent_packet.sent_time;
+			rtt = sample_us / 1000.0;
 		} else {
-			rtt = 0.875 * rtt + 0.125 * (now - sent_packet.sent_time);
+			rtt = 0.875 * rtt + 0.125 * (sample_us / 1000.0);
+		}
+		trace_event(TraceEvent::RttUpdated, sample_us, rtt * 1000, packet.ack_delay());
+	}
+
+	// ECN, CE marks mean queues are building up along the path
+	auto ecn_ce = packet.ecn_ce();
+	if(ecn_ce > largest_ecn_ce) {
+		largest_ecn_ce = ecn_ce;
+
+		if(largest_sent_time > congestion_start) {
+			// New congestion event
+			SPDLOG_DEBUG(
+				"Stream transport {{ Src: {}, Dst: {} }}: ECN congestion event: {}, {}",
+				transport.src_addr.to_string(),
+				transport.dst_addr.to_string(),
+				congestion_window,
+				ecn_ce
+			);
+			on_congestion_event(TraceLossTrigger::Ecn);
 		}
 	}
 
@@ -1473,6 +2076,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 						break;
 					}
 
+					release_send_buffer(iter->data.size());
+
 					delegate->did_send_bytes(
 						*this,
 						std::move(iter->data)
@@ -1490,6 +2095,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 			stream.bytes_in_flight -= sent_packet.length;
 			bytes_in_flight -= sent_packet.length;
 
+			trace_event(TraceEvent::PacketAcked, low_iter->first, sent_packet.length, stream.stream_id);
+
 			SPDLOG_TRACE("Times: {}, {}", sent_packet.sent_time, congestion_start);
 
 			// Congestion control
@@ -1524,6 +2131,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 				// Remove stream
 				send_streams.erase(stream.stream_id);
 
+				check_drain();
+
 				return;
 			}
 		}
@@ -1531,6 +2140,8 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 		high = low;
 	}
 
+	check_drain();
+
 	auto sent_iter = sent_packets.begin();
 
 	// Determine lost packets
@@ -1553,6 +2164,13 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 			sent_iter->second.stream->bytes_in_flight -= sent_iter->second.length;
 			lost_packets[sent_iter->first] = sent_iter->second;
 
+			trace_event(
+				TraceEvent::PacketLost,
+				sent_iter->first,
+				sent_iter->second.length,
+				static_cast<uint64_t>(TraceLossTrigger::TimeThreshold)
+			);
+
 			sent_iter++;
 		} else {
 			break;
@@ -1575,28 +2193,15 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_ACK(
 				congestion_window,
 				last_iter->first
 			);
-			congestion_start = now;
-
-			if(congestion_window < w_max) {
-				// Fast convergence
-				w_max = congestion_window;
-				congestion_window *= 0.6;
-			} else {
-				w_max = congestion_window;
-				congestion_window *= 0.75;
-			}
-
-			if(congestion_window < 10000) {
-				congestion_window = 10000;
-			}
-			ssthresh = congestion_window;
-			k = std::cbrt(w_max / 16)*1000;
+			on_congestion_event(TraceLossTrigger::TimeThreshold);
 		}
 
 		// Pop lost packets from sent
 		sent_packets.erase(sent_packets.begin(), sent_iter);
 	}
 
+	trace_event(TraceEvent::CongestionUpdated, congestion_window, ssthresh, bytes_in_flight);
+
 	// New packets
 	send_pending_data();
 
@@ -1886,25 +2491,249 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_CLOSECONF(
 	transport.close();
 }
 
-//---------------- Protocol functions end ----------------//
-
-
-//---------------- Delegate functions begin ----------------//
-
-//! Callback function when trying to establish a connection with a peer. Sends a DIAL packet to initiate the handshake
 template<typename DelegateType, template<typename> class DatagramTransport>
-void StreamTransport<DelegateType, DatagramTransport>::did_dial(
-	BaseTransport &
-) {
-	if(conn_state != ConnectionState::Listen) {
+void StreamTransport<DelegateType, DatagramTransport>::send_FEC() {
+	if(fec_encoder.count == 0) {
 		return;
 	}
 
-	// Begin handshake
-	dialled = true;
+	auto size = fec_encoder.symbol.size();
 
-	state_timer_interval = 1000;
-	state_timer.template start<Self, &Self::dial_timer_cb>(state_timer_interval, 0);
+	auto packet = FEC(size + STREAM_CIPHER_ABYTES + 12)
+					.set_src_conn_id(src_conn_id)
+					.set_dst_conn_id(dst_conn_id)
+					.set_packet_number(fec_encoder.base)
+					.set_count(fec_encoder.count)
+					.set_payload(fec_encoder.symbol.data(), size)
+					.payload_buffer();
+
+	packet.uncover_unsafe(20);
+	packet.write_unsafe(20 + size + STREAM_CIPHER_ABYTES, nonce, 12);
+
+	if constexpr (is_encrypted) {
+		tx_cipher.encrypt(
+			packet.data() + 20,
+			packet.data() + 20,
+			size,
+			packet.data() + 2,
+			18,
+			nonce
+		);
+		sodium_increment(nonce, 12);
+	}
+
+	fec_encoder.clear();
+
+	// Repair packets take up the network like DATA does
+	charge_unacked(packet.size());
+	transport.send(std::move(packet));
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_FEC(
+	FEC &&packet
+) {
+	if(!packet.validate(FEC_HEADER_SIZE + STREAM_CIPHER_ABYTES + 12)) {
+		return;
+	}
+
+	auto src_conn_id = packet.src_conn_id();
+	auto dst_conn_id = packet.dst_conn_id();
+	if(src_conn_id != this->src_conn_id || dst_conn_id != this->dst_conn_id) { // Wrong connection id, send RST
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: FEC: Connection id mismatch: {}, {}, {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			src_conn_id,
+			this->src_conn_id,
+			dst_conn_id,
+			this->dst_conn_id
+		);
+		send_RST(src_conn_id, dst_conn_id);
+		return;
+	}
+
+	if constexpr (is_encrypted) {
+		auto res = rx_cipher.decrypt(
+			packet.payload(),
+			packet.payload(),
+			packet.payload_buffer().size() - 12,
+			packet.payload() - 18,
+			18,
+			packet.payload() + packet.payload_buffer().size() - 12
+		);
+
+		if(res < 0) {
+			SPDLOG_ERROR(
+				"Stream transport {{ Src: {}, Dst: {} }}: FEC: Decryption failure: {}, {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				this->src_conn_id,
+				this->dst_conn_id
+			);
+			send_RST(src_conn_id, dst_conn_id);
+			return;
+		}
+	}
+
+	if(conn_state != ConnectionState::Established) {
+		return;
+	}
+
+	// Peer enabled FEC after the handshake, start caching so later windows can be recovered
+	if(!fec_decoder.is_enabled()) {
+		fec_decoder.enable();
+		return;
+	}
+
+	auto base = packet.packet_number();
+	auto count = packet.count();
+
+	auto p = std::move(packet).payload_buffer();
+	p.truncate_unsafe(STREAM_CIPHER_ABYTES + 12);
+
+	auto fragment = fec_decoder.recover(base, count, p);
+	if(!fragment.has_value()) {
+		return;
+	}
+
+	SPDLOG_DEBUG(
+		"Stream transport {{ Src: {}, Dst: {} }}: FEC: Recovered packet: {}",
+		src_addr.to_string(),
+		dst_addr.to_string(),
+		fragment->packet_number
+	);
+
+	did_recv_fragment(
+		fragment->packet_number,
+		fragment->stream_id,
+		fragment->offset,
+		fragment->length,
+		fragment->is_fin,
+		std::move(fragment->data)
+	);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::send_DATAGRAM(
+	core::Buffer &&bytes
+) {
+	auto size = bytes.size();
+
+	auto packet = DATAGRAM(size + STREAM_CIPHER_ABYTES + 12)
+					.set_src_conn_id(src_conn_id)
+					.set_dst_conn_id(dst_conn_id)
+					.set_packet_number(++last_sent_datagram)
+					.set_payload(bytes.data(), size)
+					.payload_buffer();
+
+	packet.uncover_unsafe(18);
+	packet.write_unsafe(18 + size + STREAM_CIPHER_ABYTES, nonce, 12);
+
+	if constexpr (is_encrypted) {
+		// Packet number is part of the AD so it cannot be rewritten to get past the replay window
+		tx_cipher.encrypt(
+			packet.data() + 18,
+			packet.data() + 18,
+			size,
+			packet.data() + 2,
+			16,
+			nonce
+		);
+		sodium_increment(nonce, 12);
+	}
+
+	transport.send(std::move(packet));
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_recv_DATAGRAM(
+	DATAGRAM &&packet
+) {
+	if(!packet.validate(STREAM_CIPHER_ABYTES + 12)) {
+		return;
+	}
+
+	auto src_conn_id = packet.src_conn_id();
+	auto dst_conn_id = packet.dst_conn_id();
+	if(src_conn_id != this->src_conn_id || dst_conn_id != this->dst_conn_id) { // Wrong connection id, send RST
+		SPDLOG_ERROR(
+			"Stream transport {{ Src: {}, Dst: {} }}: DATAGRAM: Connection id mismatch: {}, {}, {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			src_conn_id,
+			this->src_conn_id,
+			dst_conn_id,
+			this->dst_conn_id
+		);
+		send_RST(src_conn_id, dst_conn_id);
+		return;
+	}
+
+	if constexpr (is_encrypted) {
+		auto res = rx_cipher.decrypt(
+			packet.payload(),
+			packet.payload(),
+			packet.payload_buffer().size() - 12,
+			packet.payload() - 16,
+			16,
+			packet.payload() + packet.payload_buffer().size() - 12
+		);
+
+		if(res < 0) {
+			SPDLOG_ERROR(
+				"Stream transport {{ Src: {}, Dst: {} }}: DATAGRAM: Decryption failure: {}, {}",
+				src_addr.to_string(),
+				dst_addr.to_string(),
+				this->src_conn_id,
+				this->dst_conn_id
+			);
+			send_RST(src_conn_id, dst_conn_id);
+			return;
+		}
+	}
+
+	if(conn_state != ConnectionState::Established) {
+		return;
+	}
+
+	if(!datagram_replay_window.accept(packet.packet_number())) {
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: DATAGRAM: Replayed: {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			packet.packet_number()
+		);
+		return;
+	}
+
+	auto p = std::move(packet).payload_buffer();
+	p.truncate_unsafe(STREAM_CIPHER_ABYTES + 12);
+
+	if constexpr (HasDidRecvDatagram<DelegateType, Self>::value) {
+		delegate->did_recv_datagram(*this, std::move(p));
+	}
+}
+
+//---------------- Protocol functions end ----------------//
+
+
+//---------------- Delegate functions begin ----------------//
+
+//! Callback function when trying to establish a connection with a peer. Sends a DIAL packet to initiate the handshake
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::did_dial(
+	BaseTransport &
+) {
+	if(conn_state != ConnectionState::Listen) {
+		return;
+	}
+
+	// Begin handshake
+	dialled = true;
+
+	state_timer_interval = 1000;
+	state_timer.template start<Self, &Self::dial_timer_cb>(state_timer_interval, 0);
 
 	src_conn_id = (uint32_t)std::random_device()();
 	send_DIAL();
@@ -1973,6 +2802,15 @@ void StreamTransport<DelegateType, DatagramTransport>::did_recv_packet(
 		// FLUSHCONF
 		case 9: did_recv_FLUSHCONF(std::move(packet));
 		break;
+		// FEC
+		case 13: did_recv_FEC(std::move(packet));
+		break;
+		// DATAGRAM
+		case 14: did_recv_DATAGRAM(std::move(packet));
+		break;
+		// SDATA
+		case 15: did_recv_SDATA(std::move(packet));
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN <<< {}", dst_addr.to_string());
 		break;
@@ -2020,6 +2858,15 @@ void StreamTransport<DelegateType, DatagramTransport>::did_send_packet(
 		// FLUSHCONF
 		case 9: SPDLOG_TRACE("FLUSHCONF >>> {}", dst_addr.to_string());
 		break;
+		// FEC
+		case 13: SPDLOG_TRACE("FEC >>> {}", dst_addr.to_string());
+		break;
+		// DATAGRAM
+		case 14: SPDLOG_TRACE("DATAGRAM >>> {}", dst_addr.to_string());
+		break;
+		// SDATA
+		case 15: SPDLOG_TRACE("SDATA >>> {}", dst_addr.to_string());
+		break;
 		// UNKNOWN
 		default: SPDLOG_TRACE("UNKNOWN >>> {}", dst_addr.to_string());
 		break;
@@ -2054,6 +2901,13 @@ StreamTransport<DelegateType, DatagramTransport>::StreamTransport(
 }
 
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+StreamTransport<DelegateType, DatagramTransport>::~StreamTransport() {
+	auto &budget = SendBudget::loop();
+	budget.queued_bytes -= queued_bytes;
+	budget.unblock(this);
+}
+
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::setup(
 	DelegateType *delegate,
@@ -2084,13 +2938,15 @@ int StreamTransport<DelegateType, DatagramTransport>::send(
 		stream.state = SendStream::State::Send;
 	}
 
-	// Abort if data queue is too big
-	if(stream.queue_offset - stream.acked_offset > 20000000) {
-		SPDLOG_ERROR("Data queue overflow");
+	auto size = bytes.size();
+
+	// Abort if data queue or send buffer budget is exhausted, delegate is notified once it drains
+	if(check_send_buffer(size, stream_id) < 0) {
 		return -1;
 	}
 
-	auto size = bytes.size();
+	queued_bytes += size;
+	SendBudget::loop().queued_bytes += size;
 
 	// Check idle stream
 	bool idle = stream.next_item_iterator == stream.data_queue.end();
@@ -2119,6 +2975,64 @@ int StreamTransport<DelegateType, DatagramTransport>::send(
 	return 0;
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+int StreamTransport<DelegateType, DatagramTransport>::check_send_buffer(
+	uint64_t size,
+	uint16_t stream_id
+) {
+	auto &budget = SendBudget::loop();
+
+	auto iter = send_streams.find(stream_id);
+	if(iter != send_streams.end() &&
+		iter->second.queue_offset - iter->second.acked_offset + size > DEFAULT_STREAM_QUEUE_LIMIT) {
+		SPDLOG_ERROR("Data queue overflow");
+		budget.block(this, drain_cb);
+		return -1;
+	}
+
+	if(queued_bytes + size > send_buffer_limit || !budget.fits(size)) {
+		SPDLOG_DEBUG(
+			"Stream transport {{ Src: {}, Dst: {} }}: Send buffer full: {}, {}",
+			src_addr.to_string(),
+			dst_addr.to_string(),
+			queued_bytes,
+			budget.queued_bytes
+		);
+		budget.block(this, drain_cb);
+		return -1;
+	}
+
+	return 0;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+int StreamTransport<DelegateType, DatagramTransport>::send_datagram(
+	core::Buffer &&bytes
+) {
+	if (conn_state != ConnectionState::Established) {
+		return -2;
+	}
+
+	// Datagrams are never fragmented
+	if(bytes.size() > DEFAULT_MAX_DATAGRAM_SIZE) {
+		return -1;
+	}
+
+	// Nothing might be acking earlier datagrams, assume they left the network after an RTT
+	release_unacked(true);
+
+	// Dropped instead of competing with stream data when the window is full
+	if(bytes_in_flight + bytes.size() > congestion_window) {
+		return -3;
+	}
+
+	charge_unacked(bytes.size());
+
+	send_DATAGRAM(std::move(bytes));
+
+	return 0;
+}
+
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::close(uint16_t reason) {
 	// Preserve conn ids so retries work
@@ -2170,6 +3084,79 @@ double StreamTransport<DelegateType, DatagramTransport>::get_rtt() {
 	return rtt;
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+uint64_t StreamTransport<DelegateType, DatagramTransport>::get_min_rtt_us() {
+	return min_rtt_us;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+uint64_t StreamTransport<DelegateType, DatagramTransport>::get_queued_bytes() {
+	return queued_bytes;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::set_send_buffer_limit(uint64_t limit) {
+	send_buffer_limit = limit;
+	check_drain();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::set_global_send_buffer_limit(uint64_t limit) {
+	SendBudget::loop().limit = limit;
+	SendBudget::loop().drain();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::release_send_buffer(uint64_t size) {
+	queued_bytes -= size;
+	SendBudget::loop().queued_bytes -= size;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::try_drain() {
+	auto &budget = SendBudget::loop();
+	if(!budget.is_blocked(this)) {
+		return;
+	}
+
+	// Wait for half the budget to free up to avoid flapping
+	if(queued_bytes > send_buffer_limit / 2 || !budget.is_low()) {
+		return;
+	}
+	for(auto &[_, stream] : send_streams) {
+		if(stream.queue_offset - stream.acked_offset > DEFAULT_STREAM_QUEUE_LIMIT / 2) {
+			return;
+		}
+	}
+
+	budget.unblock(this);
+
+	if constexpr (HasDidDrain<DelegateType, Self>::value) {
+		delegate->did_drain(*this);
+	}
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::drain_cb(void *transport) {
+	static_cast<Self *>(transport)->try_drain();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::check_drain() {
+	try_drain();
+	SendBudget::loop().drain();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::set_fec_window(uint8_t window) {
+	if(window > FEC_MAX_WINDOW) {
+		window = FEC_MAX_WINDOW;
+	}
+
+	send_FEC();
+	fec_encoder.window = window;
+}
+
 template<typename DelegateType, template<typename> class DatagramTransport>
 void StreamTransport<DelegateType, DatagramTransport>::skip_timer_cb(RecvStream& stream) {
 	if(stream.state_timer_interval >= 64000) { // Abort on too many retries
@@ -2273,6 +3260,9 @@ void StreamTransport<DelegateType, DatagramTransport>::flush_stream(
 		lost_iter = lost_packets.erase(lost_iter);
 	}
 
+	for(auto &data_item : stream.data_queue) {
+		release_send_buffer(data_item.data.size());
+	}
 	stream.data_queue.clear();
 	stream.queue_offset = stream.sent_offset;
 	stream.next_item_iterator = stream.data_queue.end();
@@ -2284,6 +3274,8 @@ void StreamTransport<DelegateType, DatagramTransport>::flush_stream(
 
 	stream.state_timer_interval = 1000;
 	stream.state_timer.template start<Self, SendStream, &Self::flush_timer_cb>(stream.state_timer_interval, 0);
+
+	check_drain();
 }
 
 template<typename DelegateType, template<typename> class DatagramTransport>
@@ -2296,6 +3288,79 @@ uint8_t const* StreamTransport<DelegateType, DatagramTransport>::get_remote_stat
 	return remote_static_pk;
 }
 
+template<typename DelegateType, template<typename> class DatagramTransport>
+CipherSuite StreamTransport<DelegateType, DatagramTransport>::get_cipher_suite() {
+	return tx_cipher.get_suite();
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::set_integrity_only(bool enabled) {
+	integrity_only = enabled;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::set_trace(TraceRing* ring) {
+	trace = ring;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::on_congestion_event(
+	TraceLossTrigger trigger
+) {
+	congestion_start = asyncio::EventLoop::now();
+	release_unacked();
+
+	if(congestion_window < w_max) {
+		// Fast convergence
+		w_max = congestion_window;
+		congestion_window *= 0.6;
+	} else {
+		w_max = congestion_window;
+		congestion_window *= 0.75;
+	}
+
+	if(congestion_window < 10000) {
+		congestion_window = 10000;
+	}
+	ssthresh = congestion_window;
+	k = std::cbrt(w_max / 16)*1000;
+
+	trace_event(TraceEvent::CongestionEvent, static_cast<uint64_t>(trigger), congestion_window, w_max);
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::charge_unacked(uint64_t size) {
+	if(unacked_bytes_in_flight == 0) {
+		unacked_sent_time = asyncio::EventLoop::now();
+	}
+	unacked_bytes_in_flight += size;
+	bytes_in_flight += size;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::release_unacked(bool stale_only) {
+	if(stale_only && asyncio::EventLoop::now() - unacked_sent_time <= (rtt < 0 ? DEFAULT_TLP_INTERVAL : rtt)) {
+		return;
+	}
+
+	bytes_in_flight -= unacked_bytes_in_flight;
+	unacked_bytes_in_flight = 0;
+}
+
+template<typename DelegateType, template<typename> class DatagramTransport>
+void StreamTransport<DelegateType, DatagramTransport>::trace_event(
+	TraceEvent event,
+	uint64_t a,
+	uint64_t b,
+	uint64_t c
+) {
+	if(trace == nullptr) {
+		return;
+	}
+
+	trace->record(asyncio::EventLoop::now_us(), src_conn_id, event, a, b, c);
+}
+
 } // namespace stream
 } // namespace marlin
 
@@ -2,6 +2,7 @@
 #define MARLIN_STREAM_STREAMTRANSPORTFACTORY_HPP
 
 #include "StreamTransport.hpp"
+#include <marlin/core/CidrTrie.hpp>
 
 namespace marlin {
 namespace stream {
@@ -57,16 +58,28 @@ public:
 	/// Own address
 	core::SocketAddress addr;
 
+	/// Allow established connections to get their own connected datagram socket, must be called before bind
+	int enable_connected_sockets();
 	/// Bind to the given interface and port
 	int bind(core::SocketAddress const &addr);
+	/// Enable ECN on the underlying datagram socket, must be called after bind
+	int enable_ecn();
+	/// Enable kernel receive timestamps on the underlying datagram socket for RTT samples, must be called after bind
+	int enable_timestamps();
+	/// Get the file descriptor of the underlying datagram socket, must be called after bind
+	int get_fd(uv_os_fd_t &fd);
 	/// Listen for incoming connections and data
 	int listen(ListenDelegate &delegate);
 	/// Dial the given destination address
 	int dial(core::SocketAddress const &addr, ListenDelegate &delegate, uint8_t const* key);
+	/// Move the connection to the given destination address to its own connected datagram socket
+	int connect_transport(core::SocketAddress const &addr);
 	/// Get the transport corresponding to the given destination address
 	StreamTransport<TransportDelegate, DatagramTransport> *get_transport(
 		core::SocketAddress const &addr
 	);
+	/// Allow and deny rules over address ranges of incoming connections, kept by the base transport factory
+	core::CidrFilter &filter();
 };
 
 
@@ -99,7 +112,8 @@ bool StreamTransportFactory<
 	DatagramTransportFactory,
 	DatagramTransport
 >::should_accept(core::SocketAddress const &addr) {
-	return delegate->should_accept(addr);
+	// Also covers datagram transports created before a deny rule was added
+	return f.filter().is_allowed(addr) && delegate->should_accept(addr);
 }
 
 template<
@@ -150,6 +164,81 @@ int StreamTransportFactory<
 	return f.bind(addr);
 }
 
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+int StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::enable_connected_sockets() {
+	return f.enable_connected_sockets();
+}
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+int StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::connect_transport(core::SocketAddress const &addr) {
+	return f.connect_transport(addr);
+}
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+int StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::enable_ecn() {
+	return f.enable_ecn();
+}
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+int StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::enable_timestamps() {
+	return f.enable_timestamps();
+}
+
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+int StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::get_fd(uv_os_fd_t &fd) {
+	return f.get_fd(fd);
+}
+
 template<
 	typename ListenDelegate,
 	typename TransportDelegate,
@@ -200,6 +289,22 @@ StreamTransportFactory<
 	return transport_manager.get(addr);
 }
 
+template<
+	typename ListenDelegate,
+	typename TransportDelegate,
+	template<typename, typename> class DatagramTransportFactory,
+	template<typename> class DatagramTransport
+>
+core::CidrFilter &
+StreamTransportFactory<
+	ListenDelegate,
+	TransportDelegate,
+	DatagramTransportFactory,
+	DatagramTransport
+>::filter() {
+	return f.filter();
+}
+
 } // namespace stream
 } // namespace marlin
 
@@ -0,0 +1,194 @@
+#ifndef MARLIN_STREAM_CIPHER_HPP
+#define MARLIN_STREAM_CIPHER_HPP
+
+#include <sodium.h>
+
+#include <cstring>
+#include <optional>
+
+namespace marlin {
+namespace stream {
+
+/// Bytes of authentication tag appended by every cipher suite
+#define STREAM_CIPHER_ABYTES 16u
+/// Bytes of nonce used by every cipher suite
+#define STREAM_CIPHER_NPUBBYTES 12u
+/// Bytes of key used by every cipher suite
+#define STREAM_CIPHER_KEYBYTES 32u
+
+static_assert(crypto_aead_aes256gcm_ABYTES == STREAM_CIPHER_ABYTES);
+static_assert(crypto_aead_aes256gcm_NPUBBYTES == STREAM_CIPHER_NPUBBYTES);
+static_assert(crypto_aead_aes256gcm_KEYBYTES == STREAM_CIPHER_KEYBYTES);
+static_assert(crypto_aead_chacha20poly1305_ietf_ABYTES == STREAM_CIPHER_ABYTES);
+static_assert(crypto_aead_chacha20poly1305_ietf_NPUBBYTES == STREAM_CIPHER_NPUBBYTES);
+static_assert(crypto_aead_chacha20poly1305_ietf_KEYBYTES == STREAM_CIPHER_KEYBYTES);
+
+/// AEAD cipher suites, values are bits of the mask advertised in the handshake
+enum class CipherSuite : uint8_t {
+	/// AES-256-GCM, only offered with hardware AES support
+	AES256GCM = 0x01,
+	/// ChaCha20-Poly1305 (IETF), fast in software and always offered
+	CHACHA20POLY1305 = 0x02,
+	/// Poly1305 MAC without encryption, payload is sent in the clear.
+	/// Only offered if opted into for the peer, e.g. for trusted links inside a private network.
+	POLY1305 = 0x04,
+};
+
+/// Suites assumed for peers which do not advertise any
+#define STREAM_CIPHER_SUITES_LEGACY 0x01
+
+/// Mask of cipher suites which are fast on this CPU
+inline uint8_t supported_cipher_suites() {
+	uint8_t suites = static_cast<uint8_t>(CipherSuite::CHACHA20POLY1305);
+
+	// Checks for AES-NI and PCLMUL, libsodium refuses AES-GCM without them
+	if(crypto_aead_aes256gcm_is_available()) {
+		suites |= static_cast<uint8_t>(CipherSuite::AES256GCM);
+	}
+
+	return suites;
+}
+
+/// Pick the cipher suite to use given both masks.
+/// Uses a fixed order of preference so both sides agree without another round trip.
+inline std::optional<CipherSuite> select_cipher_suite(uint8_t local, uint8_t remote) {
+	uint8_t common = local & remote;
+
+	// Opt in on both sides, so preferred when present
+	if(common & static_cast<uint8_t>(CipherSuite::POLY1305)) {
+		return CipherSuite::POLY1305;
+	} else if(common & static_cast<uint8_t>(CipherSuite::AES256GCM)) {
+		return CipherSuite::AES256GCM;
+	} else if(common & static_cast<uint8_t>(CipherSuite::CHACHA20POLY1305)) {
+		return CipherSuite::CHACHA20POLY1305;
+	}
+
+	return std::nullopt;
+}
+
+/// Seals and opens packets in one direction with the negotiated cipher suite
+class StreamCipher {
+private:
+	CipherSuite suite = CipherSuite::AES256GCM;
+
+	alignas(16) crypto_aead_aes256gcm_state aes_ctx;
+	uint8_t key[STREAM_CIPHER_KEYBYTES];
+
+	/// Poly1305 over the AD and message laid out as in ChaCha20-Poly1305, one time key from the ChaCha20 keystream
+	void mac(
+		uint8_t* tag,
+		uint8_t const* m,
+		uint64_t mlen,
+		uint8_t const* ad,
+		uint64_t adlen,
+		uint8_t const* nonce
+	) const {
+		static uint8_t const pad[16] = {};
+		uint8_t otk[crypto_onetimeauth_poly1305_KEYBYTES];
+		crypto_stream_chacha20_ietf(otk, sizeof(otk), nonce, key);
+
+		crypto_onetimeauth_poly1305_state state;
+		crypto_onetimeauth_poly1305_init(&state, otk);
+		crypto_onetimeauth_poly1305_update(&state, ad, adlen);
+		crypto_onetimeauth_poly1305_update(&state, pad, (16 - adlen % 16) % 16);
+		crypto_onetimeauth_poly1305_update(&state, m, mlen);
+		crypto_onetimeauth_poly1305_update(&state, pad, (16 - mlen % 16) % 16);
+
+		uint8_t lengths[16];
+		for(int i = 0; i < 8; i++) {
+			lengths[i] = adlen >> (8 * i);
+			lengths[8 + i] = mlen >> (8 * i);
+		}
+		crypto_onetimeauth_poly1305_update(&state, lengths, sizeof(lengths));
+		crypto_onetimeauth_poly1305_final(&state, tag);
+
+		sodium_memzero(otk, sizeof(otk));
+	}
+
+	/// Clear key material of the previous suite
+	void wipe() {
+		sodium_memzero(&aes_ctx, sizeof(aes_ctx));
+		sodium_memzero(key, sizeof(key));
+	}
+
+public:
+	~StreamCipher() {
+		wipe();
+	}
+
+	/// Get the cipher suite in use
+	CipherSuite get_suite() const {
+		return suite;
+	}
+
+	/// Set the cipher suite and key, key expansion is done upfront where supported
+	void init(CipherSuite suite, uint8_t const* key) {
+		wipe();
+		this->suite = suite;
+		if(suite == CipherSuite::AES256GCM) {
+			crypto_aead_aes256gcm_beforenm(&aes_ctx, key);
+		} else {
+			std::memcpy(this->key, key, STREAM_CIPHER_KEYBYTES);
+		}
+	}
+
+	/// Encrypt mlen bytes of m into c followed by the tag, c and m can be the same.
+	/// The integrity only suite copies m as is.
+	int encrypt(
+		uint8_t* c,
+		uint8_t const* m,
+		uint64_t mlen,
+		uint8_t const* ad,
+		uint64_t adlen,
+		uint8_t const* nonce
+	) const {
+		if(suite == CipherSuite::AES256GCM) {
+			return crypto_aead_aes256gcm_encrypt_afternm(c, nullptr, m, mlen, ad, adlen, nullptr, nonce, &aes_ctx);
+		} else if(suite == CipherSuite::POLY1305) {
+			if(c != m) {
+				std::memmove(c, m, mlen);
+			}
+			mac(c + mlen, c, mlen, ad, adlen, nonce);
+			return 0;
+		}
+
+		return crypto_aead_chacha20poly1305_ietf_encrypt(c, nullptr, m, mlen, ad, adlen, nullptr, nonce, key);
+	}
+
+	/// Verify and decrypt clen bytes of c including the tag into m, negative on failure
+	int decrypt(
+		uint8_t* m,
+		uint8_t const* c,
+		uint64_t clen,
+		uint8_t const* ad,
+		uint64_t adlen,
+		uint8_t const* nonce
+	) const {
+		if(suite == CipherSuite::AES256GCM) {
+			return crypto_aead_aes256gcm_decrypt_afternm(m, nullptr, nullptr, c, clen, ad, adlen, nonce, &aes_ctx);
+		} else if(suite == CipherSuite::POLY1305) {
+			if(clen < STREAM_CIPHER_ABYTES) {
+				return -1;
+			}
+
+			uint64_t mlen = clen - STREAM_CIPHER_ABYTES;
+			uint8_t tag[STREAM_CIPHER_ABYTES];
+			mac(tag, c, mlen, ad, adlen, nonce);
+			if(crypto_verify_16(tag, c + mlen) != 0) {
+				return -1;
+			}
+
+			if(m != c) {
+				std::memmove(m, c, mlen);
+			}
+			return 0;
+		}
+
+		return crypto_aead_chacha20poly1305_ietf_decrypt(m, nullptr, nullptr, c, clen, ad, adlen, nonce, key);
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_CIPHER_HPP
@@ -0,0 +1,208 @@
+#ifndef MARLIN_STREAM_COMPACTHEADER_HPP
+#define MARLIN_STREAM_COMPACTHEADER_HPP
+
+#include <marlin/core/WeakBuffer.hpp>
+
+#include <optional>
+
+namespace marlin {
+namespace stream {
+
+/// Largest value representable as a varint
+#define VARINT_MAX 0x3fffffffffffffffull
+
+/// Number of bytes needed to encode the given value as a varint
+inline size_t varint_size(uint64_t value) {
+	if(value < (1ull << 6)) {
+		return 1;
+	} else if(value < (1ull << 14)) {
+		return 2;
+	} else if(value < (1ull << 30)) {
+		return 4;
+	}
+
+	return 8;
+}
+
+/// Write a varint at the given offset, returns the number of bytes written.
+/// The two most significant bits of the first byte encode the size as in QUIC.
+inline size_t write_varint_unsafe(core::WeakBuffer buf, size_t offset, uint64_t value) {
+	switch(varint_size(value)) {
+	case 1:
+		buf.write_uint8_unsafe(offset, value);
+		return 1;
+	case 2:
+		buf.write_uint16_be_unsafe(offset, value | (1ull << 14));
+		return 2;
+	case 4:
+		buf.write_uint32_be_unsafe(offset, value | (2ull << 30));
+		return 4;
+	default:
+		buf.write_uint64_be_unsafe(offset, (value & VARINT_MAX) | (3ull << 62));
+		return 8;
+	}
+}
+
+/// Read a varint at the given offset, returns the number of bytes read or 0 if truncated
+inline size_t read_varint(core::WeakBuffer const& buf, size_t offset, uint64_t &value) {
+	auto first = buf.read_uint8(offset);
+	if(first == std::nullopt) {
+		return 0;
+	}
+
+	switch(first.value() >> 6) {
+	case 0:
+		value = first.value();
+		return 1;
+	case 1: {
+		auto res = buf.read_uint16_be(offset);
+		if(res == std::nullopt) return 0;
+		value = res.value() & 0x3fff;
+		return 2;
+	}
+	case 2: {
+		auto res = buf.read_uint32_be(offset);
+		if(res == std::nullopt) return 0;
+		value = res.value() & 0x3fffffff;
+		return 4;
+	}
+	default: {
+		auto res = buf.read_uint64_be(offset);
+		if(res == std::nullopt) return 0;
+		value = res.value() & VARINT_MAX;
+		return 8;
+	}
+	}
+}
+
+/// Number of bytes of the packet number to send given the largest acked packet number.
+/// Leaves room for twice the number of unacked packets so the receiver can recover it unambiguously.
+inline uint8_t packet_number_length(uint64_t packet_number, uint64_t largest_acked) {
+	uint64_t unacked = packet_number - largest_acked + 1;
+
+	if(unacked < (1ull << 7)) {
+		return 1;
+	} else if(unacked < (1ull << 15)) {
+		return 2;
+	} else if(unacked < (1ull << 31)) {
+		return 4;
+	}
+
+	return 8;
+}
+
+/// Recover a full packet number from its truncated form, picks the candidate closest to the expected packet number
+inline uint64_t decode_packet_number(uint64_t truncated, uint8_t length, uint64_t expected) {
+	if(length >= 8) {
+		return truncated;
+	}
+
+	uint64_t window = 1ull << (length * 8);
+	uint64_t half_window = window / 2;
+	uint64_t candidate = (expected & ~(window - 1)) | truncated;
+
+	if(candidate + half_window <= expected && candidate + window > candidate) {
+		return candidate + window;
+	} else if(candidate > expected + half_window && candidate >= window) {
+		return candidate - window;
+	}
+
+	return candidate;
+}
+
+/// Derive the 12 byte nonce of a compact DATA message by XORing the packet number into a per direction IV
+inline void compact_data_nonce(uint8_t* nonce, uint8_t const* iv, uint64_t packet_number) {
+	for(uint8_t i = 0; i < 12; i++) {
+		nonce[i] = iv[i];
+	}
+	for(uint8_t i = 0; i < 8; i++) {
+		nonce[i] ^= packet_number >> (8 * i);
+	}
+}
+
+/// Header of a compact DATA message.
+///
+/// Layout: version, type, connection id of the receiver, flags (fin, packet number length),
+/// truncated packet number, varint stream id, varint offset. Length is implied by the packet size.
+struct CompactDataHeader {
+	/// Connection id of the receiver
+	uint32_t conn_id;
+	/// Was the FIN bit set
+	bool is_fin;
+	/// Packet number, full after decoding
+	uint64_t packet_number;
+	/// Number of bytes of the packet number on the wire
+	uint8_t packet_number_length;
+	/// Stream id
+	uint16_t stream_id;
+	/// Offset of data in stream
+	uint64_t offset;
+
+	/// Encoded size of the header
+	size_t size() const {
+		return 7 + packet_number_length + varint_size(stream_id) + varint_size(offset);
+	}
+
+	/// Encode the header at the start of the given buffer, which should be at least size() bytes
+	void encode(core::WeakBuffer buf, uint8_t type) const {
+		uint8_t length_bits = packet_number_length == 1 ? 0 :
+			packet_number_length == 2 ? 1 :
+			packet_number_length == 4 ? 2 : 3;
+
+		buf.write_uint8_unsafe(0, 0);
+		buf.write_uint8_unsafe(1, type);
+		buf.write_uint32_le_unsafe(2, conn_id);
+		buf.write_uint8_unsafe(6, static_cast<uint8_t>(is_fin) | (length_bits << 1));
+
+		size_t pos = 7;
+		for(uint8_t i = 0; i < packet_number_length; i++) {
+			buf.write_uint8_unsafe(pos++, packet_number >> (8 * i));
+		}
+		pos += write_varint_unsafe(buf, pos, stream_id);
+		write_varint_unsafe(buf, pos, offset);
+	}
+
+	/// Decode the header from the start of the given buffer, recovering the packet number around the expected one
+	static std::optional<CompactDataHeader> decode(core::WeakBuffer const& buf, uint64_t expected) {
+		if(buf.size() < 7) {
+			return std::nullopt;
+		}
+
+		CompactDataHeader header;
+		header.conn_id = buf.read_uint32_le_unsafe(2);
+
+		uint8_t flags = buf.read_uint8_unsafe(6);
+		header.is_fin = (flags & 1) == 1;
+		header.packet_number_length = 1 << ((flags >> 1) & 3);
+
+		size_t pos = 7;
+		if(buf.size() < pos + header.packet_number_length) {
+			return std::nullopt;
+		}
+		uint64_t truncated = 0;
+		for(uint8_t i = 0; i < header.packet_number_length; i++) {
+			truncated |= uint64_t(buf.read_uint8_unsafe(pos++)) << (8 * i);
+		}
+		header.packet_number = decode_packet_number(truncated, header.packet_number_length, expected);
+
+		uint64_t stream_id = 0;
+		auto res = read_varint(buf, pos, stream_id);
+		if(res == 0 || stream_id > UINT16_MAX) {
+			return std::nullopt;
+		}
+		header.stream_id = stream_id;
+		pos += res;
+
+		res = read_varint(buf, pos, header.offset);
+		if(res == 0) {
+			return std::nullopt;
+		}
+
+		return header;
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_COMPACTHEADER_HPP
@@ -0,0 +1,215 @@
+#ifndef MARLIN_STREAM_FEC_HPP
+#define MARLIN_STREAM_FEC_HPP
+
+#include <marlin/core/Buffer.hpp>
+
+#include <vector>
+#include <optional>
+
+namespace marlin {
+namespace stream {
+
+/// Bytes of fragment metadata protected along with the data: stream id, offset, length and fin
+#define FEC_HEADER_SIZE 13u
+/// Max number of fragments a single repair packet can cover
+#define FEC_MAX_WINDOW 32
+/// Number of recently received fragments kept around for recovery
+#define FEC_CACHE_SIZE 64
+
+/// A DATA fragment rebuilt from a repair packet
+struct FecFragment {
+	/// Packet number the fragment was originally sent with
+	uint64_t packet_number;
+	/// Stream id
+	uint16_t stream_id;
+	/// Offset of data in stream
+	uint64_t offset;
+	/// Length of data
+	uint16_t length;
+	/// Was the FIN bit set
+	bool is_fin;
+	/// Recovered data
+	core::Buffer data;
+};
+
+/// XOR the protected representation of a fragment into the given symbol, growing it if needed
+inline void fec_xor_fragment(
+	std::vector<uint8_t> &symbol,
+	uint16_t stream_id,
+	uint64_t offset,
+	uint16_t length,
+	bool is_fin,
+	uint8_t const* data
+) {
+	if(symbol.size() < FEC_HEADER_SIZE + length) {
+		symbol.resize(FEC_HEADER_SIZE + length, 0);
+	}
+
+	core::WeakBuffer header(symbol.data(), FEC_HEADER_SIZE);
+	header.write_uint16_le_unsafe(0, header.read_uint16_le_unsafe(0) ^ stream_id);
+	header.write_uint64_le_unsafe(2, header.read_uint64_le_unsafe(2) ^ offset);
+	header.write_uint16_le_unsafe(10, header.read_uint16_le_unsafe(10) ^ length);
+	header.write_uint8_unsafe(12, header.read_uint8_unsafe(12) ^ static_cast<uint8_t>(is_fin));
+
+	for(uint16_t i = 0; i < length; i++) {
+		symbol[FEC_HEADER_SIZE + i] ^= data[i];
+	}
+}
+
+/// Accumulates XOR repair symbols over consecutive sent fragments
+class FecEncoder {
+public:
+	/// Number of fragments covered by each repair packet, 0 if disabled
+	uint8_t window = 0;
+	/// Packet number of the first fragment in the current window
+	uint64_t base = 0;
+	/// Number of fragments in the current window
+	uint8_t count = 0;
+	/// XOR of all fragments in the current window
+	std::vector<uint8_t> symbol;
+
+	/// Add a sent fragment to the current window
+	void add(
+		uint64_t packet_number,
+		uint16_t stream_id,
+		uint64_t offset,
+		uint16_t length,
+		bool is_fin,
+		uint8_t const* data
+	) {
+		if(count == 0) {
+			base = packet_number;
+		}
+
+		fec_xor_fragment(symbol, stream_id, offset, length, is_fin, data);
+		count++;
+	}
+
+	/// Is the current window complete?
+	bool is_full() const {
+		return window > 0 && count >= window;
+	}
+
+	/// Start a new window, retains memory for reuse
+	void clear() {
+		count = 0;
+		symbol.clear();
+	}
+};
+
+/// Caches recently received fragments and rebuilds a single missing fragment per repair packet
+class FecDecoder {
+private:
+	struct CacheEntry {
+		uint64_t packet_number = 0;
+		bool valid = false;
+		std::vector<uint8_t> symbol;
+	};
+
+	/// Ring of received fragments indexed by packet number, empty if disabled
+	std::vector<CacheEntry> cache;
+
+public:
+	/// Is the decoder caching received fragments?
+	bool is_enabled() const {
+		return cache.size() > 0;
+	}
+
+	/// Start caching received fragments
+	void enable() {
+		cache.resize(FEC_CACHE_SIZE);
+	}
+
+	/// Cache a received fragment
+	void add(
+		uint64_t packet_number,
+		uint16_t stream_id,
+		uint64_t offset,
+		uint16_t length,
+		bool is_fin,
+		uint8_t const* data
+	) {
+		if(!is_enabled()) {
+			return;
+		}
+
+		auto &entry = cache[packet_number % FEC_CACHE_SIZE];
+		entry.packet_number = packet_number;
+		entry.valid = true;
+		entry.symbol.assign(FEC_HEADER_SIZE + length, 0);
+		fec_xor_fragment(entry.symbol, stream_id, offset, length, is_fin, data);
+	}
+
+	/// Rebuild the fragment missing from the window [base, base + count) using its repair symbol.
+	/// Nothing can be recovered if no fragment or more than one fragment is missing.
+	std::optional<FecFragment> recover(
+		uint64_t base,
+		uint16_t count,
+		core::WeakBuffer const& repair
+	) {
+		if(!is_enabled() || count == 0 || count > FEC_MAX_WINDOW || repair.size() < FEC_HEADER_SIZE) {
+			return std::nullopt;
+		}
+
+		std::optional<uint64_t> missing;
+		for(uint64_t packet_number = base; packet_number < base + count; packet_number++) {
+			auto &entry = cache[packet_number % FEC_CACHE_SIZE];
+			if(entry.valid && entry.packet_number == packet_number) {
+				continue;
+			}
+
+			if(missing.has_value()) {
+				return std::nullopt;
+			}
+			missing = packet_number;
+		}
+
+		if(!missing.has_value()) {
+			return std::nullopt;
+		}
+
+		std::vector<uint8_t> symbol(repair.data(), repair.data() + repair.size());
+		for(uint64_t packet_number = base; packet_number < base + count; packet_number++) {
+			if(packet_number == missing.value()) {
+				continue;
+			}
+
+			auto &entry = cache[packet_number % FEC_CACHE_SIZE];
+			if(entry.symbol.size() > symbol.size()) {
+				return std::nullopt;
+			}
+			for(size_t i = 0; i < entry.symbol.size(); i++) {
+				symbol[i] ^= entry.symbol[i];
+			}
+		}
+
+		core::WeakBuffer header(symbol.data(), FEC_HEADER_SIZE);
+		uint16_t length = header.read_uint16_le_unsafe(10);
+		if(FEC_HEADER_SIZE + length > symbol.size()) {
+			return std::nullopt;
+		}
+
+		FecFragment fragment {
+			missing.value(),
+			header.read_uint16_le_unsafe(0),
+			header.read_uint64_le_unsafe(2),
+			length,
+			header.read_uint8_unsafe(12) == 1,
+			core::Buffer(length)
+		};
+		fragment.data.write_unsafe(0, symbol.data() + FEC_HEADER_SIZE, length);
+
+		// Recovered fragment is as good as received
+		auto &entry = cache[missing.value() % FEC_CACHE_SIZE];
+		entry.packet_number = missing.value();
+		entry.valid = true;
+		entry.symbol.assign(symbol.begin(), symbol.begin() + FEC_HEADER_SIZE + length);
+
+		return fragment;
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_FEC_HPP
@@ -5,6 +5,7 @@
 
 #include <ctime>
 #include <memory>
+#include <vector>
 
 namespace marlin {
 namespace stream {
@@ -127,6 +128,9 @@ struct RecvStream {
 		return this->read_offset == this->size;
 	}
 
+	/// In order data made readable by the packet being processed, delivered to the application as a single chain
+	std::vector<core::Buffer> recv_chain;
+
 	/// Timer interval for the state timer
 	uint64_t state_timer_interval = 1000;
 	/// Timer to retry SKIPSTREAM
@@ -0,0 +1,49 @@
+#ifndef MARLIN_STREAM_REPLAY_WINDOW_HPP
+#define MARLIN_STREAM_REPLAY_WINDOW_HPP
+
+#include <stdint.h>
+
+namespace marlin {
+namespace stream {
+
+/// Sliding window over packet numbers of messages which are never retransmitted.
+/// Rejects duplicates as well as packets too old to tell apart from one.
+class ReplayWindow {
+public:
+	/// Packet numbers this far behind the largest one are rejected
+	static constexpr uint64_t size = 64;
+
+	/// Largest packet number accepted, 0 before the first since packet numbers start at 1
+	uint64_t largest = 0;
+	/// Bit i is set if packet number largest - i was accepted
+	uint64_t seen = 0;
+
+	/// Mark a packet number as seen, false if it is a replay or too old.
+	/// Only call once the packet has been authenticated, forged packet numbers would advance the window.
+	bool accept(uint64_t num) {
+		if(num == 0) {
+			return false;
+		}
+
+		if(num > largest) {
+			uint64_t shift = num - largest;
+			seen = shift >= size ? 0 : seen << shift;
+			seen |= 1;
+			largest = num;
+			return true;
+		}
+
+		uint64_t age = largest - num;
+		if(age >= size || (seen & (1ull << age)) != 0) {
+			return false;
+		}
+
+		seen |= 1ull << age;
+		return true;
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_REPLAY_WINDOW_HPP
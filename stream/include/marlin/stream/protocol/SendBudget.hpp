@@ -0,0 +1,80 @@
+#ifndef MARLIN_STREAM_SENDBUDGET_HPP
+#define MARLIN_STREAM_SENDBUDGET_HPP
+
+#include <stdint.h>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace marlin {
+namespace stream {
+
+/// Send buffer budget shared by every stream transport on the loop, whatever its delegate and datagram types
+///
+/// Transports which got refused because of a full budget register here along with a callback to retry them,
+/// so whichever transport frees up space can let the others know.
+class SendBudget {
+public:
+	/// Retries a blocked transport, type erased so all transport types share one budget
+	using DrainCallback = void (*)(void *transport);
+private:
+	std::unordered_map<void *, DrainCallback> blocked;
+public:
+	/// Bytes queued for sending across all transports on the loop which have not been acked yet
+	uint64_t queued_bytes = 0;
+	/// Max bytes that can be queued for sending across all transports on the loop
+	uint64_t limit = std::numeric_limits<uint64_t>::max();
+
+	/// Budget of the loop running on this thread
+	static SendBudget &loop() {
+		thread_local SendBudget budget;
+		return budget;
+	}
+
+	/// Would size more bytes fit
+	bool fits(uint64_t size) const {
+		return queued_bytes + size <= limit;
+	}
+
+	/// Is usage below the low watermark, half the limit to avoid flapping
+	bool is_low() const {
+		return queued_bytes <= limit / 2;
+	}
+
+	/// Remember a refused transport until drain retries it
+	void block(void *transport, DrainCallback callback) {
+		blocked.emplace(transport, callback);
+	}
+
+	/// Forget a transport, returns true if it was blocked
+	bool unblock(void *transport) {
+		return blocked.erase(transport) > 0;
+	}
+
+	bool is_blocked(void *transport) const {
+		return blocked.find(transport) != blocked.end();
+	}
+
+	/// Retry every blocked transport while usage is below the low watermark
+	void drain() {
+		if(blocked.size() == 0 || !is_low()) {
+			return;
+		}
+
+		// Copy since callbacks might send and block again
+		std::vector<std::pair<void *, DrainCallback>> transports(blocked.begin(), blocked.end());
+		for(auto [transport, callback] : transports) {
+			// Skip transports which got unblocked or destroyed by earlier callbacks
+			if(!is_blocked(transport)) {
+				continue;
+			}
+			callback(transport);
+		}
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_SENDBUDGET_HPP
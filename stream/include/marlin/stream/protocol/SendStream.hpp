@@ -36,6 +36,8 @@ struct SendStream;
 struct SentPacketInfo {
 	/// Time it was sent (relative to arbitrary epoch)
 	uint64_t sent_time;
+	/// Time it was sent in microseconds, used for RTT samples
+	uint64_t sent_time_us;
 	/// Stream it was sent on
 	SendStream *stream;
 	/// Data item whose data was sent
@@ -51,9 +53,11 @@ struct SentPacketInfo {
 		SendStream *stream,
 		DataItem *data_item,
 		uint64_t offset,
-		uint64_t length
+		uint64_t length,
+		uint64_t sent_time_us = 0
 	) {
 		this->sent_time = sent_time;
+		this->sent_time_us = sent_time_us;
 		this->stream = stream;
 		this->data_item = data_item;
 		this->offset = offset;
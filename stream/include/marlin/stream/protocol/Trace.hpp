@@ -0,0 +1,287 @@
+#ifndef MARLIN_STREAM_TRACE_HPP
+#define MARLIN_STREAM_TRACE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace marlin {
+namespace stream {
+
+/// Default number of records kept in a trace ring, about 2.5MB
+#define DEFAULT_TRACE_CAPACITY 65536
+/// Magic at the start of a binary trace dump
+#define STREAM_TRACE_MAGIC 0x5254534du
+/// Version of the binary trace dump
+#define STREAM_TRACE_VERSION 1u
+
+/// Events recorded in a connection trace, the meaning of the a, b, c fields is noted for each
+enum class TraceEvent : uint8_t {
+	/// DATA packet sent: packet number, length, stream id
+	PacketSent = 0,
+	/// DATA packet acked: packet number, length, stream id
+	PacketAcked = 1,
+	/// DATA packet declared lost: packet number, length, TraceLossTrigger
+	PacketLost = 2,
+	/// Congestion controller state after an update: congestion window, ssthresh, bytes in flight
+	CongestionUpdated = 3,
+	/// RTT sample: latest sample in us, smoothed RTT in us, ack delay in us
+	RttUpdated = 4,
+	/// New congestion event: TraceLossTrigger, congestion window, w_max
+	CongestionEvent = 5,
+	/// End of a pacing burst: TracePacingResult, bytes sent in the burst, bytes in flight
+	PacingBurst = 6,
+};
+
+/// Reason for losses and congestion events
+enum class TraceLossTrigger : uint8_t {
+	/// Sent too long before the largest acked packet
+	TimeThreshold = 0,
+	/// Tail loss probe timer fired
+	Timer = 1,
+	/// Peer reported CE marks
+	Ecn = 2,
+};
+
+/// Why a pacing burst stopped
+enum class TracePacingResult : uint8_t {
+	/// Nothing more to send
+	Idle = 0,
+	/// Pacing limit hit, rescheduled
+	PacingLimited = 1,
+	/// Congestion window exhausted
+	CongestionLimited = 2,
+};
+
+/// Fixed size binary trace record, written as is to dumps
+struct TraceRecord {
+	/// Event loop time in microseconds
+	uint64_t time_us;
+	/// Source connection id of the connection
+	uint32_t conn_id;
+	/// TraceEvent
+	uint8_t event;
+	uint8_t reserved[3];
+	uint64_t a;
+	uint64_t b;
+	uint64_t c;
+};
+
+static_assert(sizeof(TraceRecord) == 40);
+
+/// Ring buffer of binary trace records, oldest records are overwritten once full.
+/// Recording is a handful of stores so it can stay enabled against real traffic,
+/// conversion to qlog happens offline from a dump.
+class TraceRing {
+private:
+	std::unique_ptr<TraceRecord[]> records;
+	size_t mask;
+	uint64_t head = 0;
+
+public:
+	/// Capacity is rounded up to a power of two
+	TraceRing(size_t capacity = DEFAULT_TRACE_CAPACITY) {
+		size_t size = 1;
+		while(size < capacity) {
+			size <<= 1;
+		}
+
+		records.reset(new TraceRecord[size]);
+		mask = size - 1;
+	}
+
+	/// Shared ring for all connections on the event loop running on this thread
+	static TraceRing& loop() {
+		thread_local TraceRing ring;
+		return ring;
+	}
+
+	/// Append a record
+	void record(uint64_t time_us, uint32_t conn_id, TraceEvent event, uint64_t a, uint64_t b, uint64_t c) {
+		auto &record = records[head & mask];
+		record.time_us = time_us;
+		record.conn_id = conn_id;
+		record.event = static_cast<uint8_t>(event);
+		std::memset(record.reserved, 0, sizeof(record.reserved));
+		record.a = a;
+		record.b = b;
+		record.c = c;
+		head++;
+	}
+
+	/// Max number of records held
+	size_t capacity() const {
+		return mask + 1;
+	}
+
+	/// Number of records held
+	size_t size() const {
+		return head > mask ? mask + 1 : head;
+	}
+
+	/// Number of records overwritten since the last clear
+	uint64_t dropped() const {
+		return head - size();
+	}
+
+	/// Drop all records
+	void clear() {
+		head = 0;
+	}
+
+	/// Copy out records held, oldest first
+	std::vector<TraceRecord> snapshot() const {
+		std::vector<TraceRecord> out;
+		out.reserve(size());
+		for(uint64_t i = head - size(); i < head; i++) {
+			out.push_back(records[i & mask]);
+		}
+		return out;
+	}
+
+	/// Write records held to a binary dump, negative on error
+	int dump(char const* path) const {
+		auto records = snapshot();
+
+		auto *file = std::fopen(path, "wb");
+		if(file == nullptr) {
+			return -1;
+		}
+
+		uint32_t header[4] = {STREAM_TRACE_MAGIC, STREAM_TRACE_VERSION, sizeof(TraceRecord), 0};
+		uint64_t count = records.size();
+		bool ok = std::fwrite(header, sizeof(header), 1, file) == 1 &&
+			std::fwrite(&count, sizeof(count), 1, file) == 1 &&
+			std::fwrite(records.data(), sizeof(TraceRecord), count, file) == count;
+
+		return std::fclose(file) == 0 && ok ? 0 : -1;
+	}
+
+	/// Read records from a binary dump, negative on error
+	static int load(char const* path, std::vector<TraceRecord> &records) {
+		auto *file = std::fopen(path, "rb");
+		if(file == nullptr) {
+			return -1;
+		}
+
+		uint32_t header[4];
+		uint64_t count;
+		if(std::fread(header, sizeof(header), 1, file) != 1 ||
+			header[0] != STREAM_TRACE_MAGIC ||
+			header[1] != STREAM_TRACE_VERSION ||
+			header[2] != sizeof(TraceRecord) ||
+			std::fread(&count, sizeof(count), 1, file) != 1
+		) {
+			std::fclose(file);
+			return -1;
+		}
+
+		// Bound the count by the rest of the file before allocating for it
+		long start = std::ftell(file);
+		if(start < 0 || std::fseek(file, 0, SEEK_END) != 0) {
+			std::fclose(file);
+			return -1;
+		}
+		long end = std::ftell(file);
+		if(end < start || count > uint64_t(end - start) / sizeof(TraceRecord) || std::fseek(file, start, SEEK_SET) != 0) {
+			std::fclose(file);
+			return -1;
+		}
+
+		records.resize(count);
+		bool ok = std::fread(records.data(), sizeof(TraceRecord), count, file) == count;
+		std::fclose(file);
+
+		return ok ? 0 : -1;
+	}
+
+	/// Write records as qlog JSON with one trace per connection, times relative to the first record in ms
+	static void write_qlog(std::ostream &os, std::vector<TraceRecord> const& records) {
+		static char const* const triggers[] = {"time_threshold", "pto_expired", "ecn"};
+		static char const* const pacing_results[] = {"idle", "pacing_limited", "congestion_limited"};
+
+		std::map<uint32_t, std::vector<TraceRecord const*>> connections;
+		for(auto &record : records) {
+			connections[record.conn_id].push_back(&record);
+		}
+		uint64_t start_us = records.size() > 0 ? records.front().time_us : 0;
+
+		// Times in ms with us resolution
+		auto flags = os.flags();
+		auto precision = os.precision();
+		os << std::fixed << std::setprecision(3);
+
+		os << "{\"qlog_version\":\"0.3\",\"qlog_format\":\"JSON\",\"title\":\"marlin stream trace\",\"traces\":[";
+		for(auto iter = connections.begin(); iter != connections.end(); iter++) {
+			os << (iter == connections.begin() ? "" : ",");
+			os << "{\"vantage_point\":{\"type\":\"network\"},\"common_fields\":{\"group_id\":\"" << iter->first
+				<< "\",\"time_format\":\"relative\",\"reference_time\":" << start_us / 1000.0 << "},\"events\":[";
+
+			bool first = true;
+			for(auto *record : iter->second) {
+				os << (first ? "" : ",") << "{\"time\":" << (record->time_us - start_us) / 1000.0 << ",";
+				first = false;
+
+				switch(static_cast<TraceEvent>(record->event)) {
+				case TraceEvent::PacketSent:
+					os << "\"name\":\"transport:packet_sent\",\"data\":{\"header\":{\"packet_type\":\"1RTT\",\"packet_number\":"
+						<< record->a << "},\"raw\":{\"length\":" << record->b << "},\"frames\":[{\"frame_type\":\"stream\",\"stream_id\":"
+						<< record->c << ",\"length\":" << record->b << "}]}";
+					break;
+				case TraceEvent::PacketAcked:
+					os << "\"name\":\"recovery:packet_acked\",\"data\":{\"header\":{\"packet_type\":\"1RTT\",\"packet_number\":"
+						<< record->a << "},\"raw\":{\"length\":" << record->b << "}}";
+					break;
+				case TraceEvent::PacketLost:
+					os << "\"name\":\"recovery:packet_lost\",\"data\":{\"header\":{\"packet_type\":\"1RTT\",\"packet_number\":"
+						<< record->a << "},\"raw\":{\"length\":" << record->b << "},\"trigger\":\""
+						<< triggers[record->c < 3 ? record->c : 0] << "\"}";
+					break;
+				case TraceEvent::CongestionUpdated:
+					os << "\"name\":\"recovery:metrics_updated\",\"data\":{\"congestion_window\":" << record->a;
+					// ssthresh starts out unbounded
+					if(record->b != UINT64_MAX) {
+						os << ",\"ssthresh\":" << record->b;
+					}
+					os << ",\"bytes_in_flight\":" << record->c << "}";
+					break;
+				case TraceEvent::RttUpdated:
+					os << "\"name\":\"recovery:metrics_updated\",\"data\":{\"latest_rtt\":" << record->a / 1000.0
+						<< ",\"smoothed_rtt\":" << record->b / 1000.0 << ",\"ack_delay\":" << record->c / 1000.0 << "}";
+					break;
+				case TraceEvent::CongestionEvent:
+					os << "\"name\":\"recovery:congestion_state_updated\",\"data\":{\"new\":\"recovery\",\"trigger\":\""
+						<< triggers[record->a < 3 ? record->a : 0] << "\",\"congestion_window\":" << record->b
+						<< ",\"w_max\":" << record->c << "}";
+					break;
+				case TraceEvent::PacingBurst:
+					os << "\"name\":\"stream:pacing_burst\",\"data\":{\"result\":\""
+						<< pacing_results[record->a < 3 ? record->a : 0] << "\",\"bytes_sent\":" << record->b
+						<< ",\"bytes_in_flight\":" << record->c << "}";
+					break;
+				default:
+					os << "\"name\":\"stream:unknown\",\"data\":{\"event\":" << (uint32_t)record->event << "}";
+					break;
+				}
+
+				os << "}";
+			}
+
+			os << "]}";
+		}
+		os << "]}";
+
+		os.flags(flags);
+		os.precision(precision);
+	}
+};
+
+} // namespace stream
+} // namespace marlin
+
+#endif // MARLIN_STREAM_TRACE_HPP
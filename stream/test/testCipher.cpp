@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include <marlin/stream/protocol/Cipher.hpp>
+
+#include <cstring>
+#include <vector>
+
+
+using namespace marlin::stream;
+
+static uint8_t key[STREAM_CIPHER_KEYBYTES] = {1, 2, 3};
+static uint8_t nonce[STREAM_CIPHER_NPUBBYTES] = {4, 5, 6};
+static uint8_t ad[8] = {7, 8, 9};
+static uint8_t message[37] = "The quick brown fox jumps over a dog";
+
+static std::vector<CipherSuite> suites() {
+	std::vector<CipherSuite> suites = {CipherSuite::CHACHA20POLY1305, CipherSuite::POLY1305};
+	// CPU features are detected on init
+	if(sodium_init() >= 0 && (supported_cipher_suites() & static_cast<uint8_t>(CipherSuite::AES256GCM))) {
+		suites.push_back(CipherSuite::AES256GCM);
+	}
+	return suites;
+}
+
+TEST(CipherTest, SelectSuite) {
+	uint8_t aes = static_cast<uint8_t>(CipherSuite::AES256GCM);
+	uint8_t chacha = static_cast<uint8_t>(CipherSuite::CHACHA20POLY1305);
+	uint8_t poly = static_cast<uint8_t>(CipherSuite::POLY1305);
+
+	EXPECT_EQ(select_cipher_suite(aes | chacha, aes | chacha), CipherSuite::AES256GCM);
+	EXPECT_EQ(select_cipher_suite(chacha, aes | chacha), CipherSuite::CHACHA20POLY1305);
+	EXPECT_EQ(select_cipher_suite(aes | chacha | poly, aes | chacha), CipherSuite::AES256GCM);
+	EXPECT_EQ(select_cipher_suite(aes | chacha | poly, chacha | poly), CipherSuite::POLY1305);
+	EXPECT_EQ(select_cipher_suite(chacha, STREAM_CIPHER_SUITES_LEGACY), std::nullopt);
+}
+
+TEST(CipherTest, SupportedSuites) {
+	EXPECT_TRUE(supported_cipher_suites() & static_cast<uint8_t>(CipherSuite::CHACHA20POLY1305));
+	EXPECT_FALSE(supported_cipher_suites() & static_cast<uint8_t>(CipherSuite::POLY1305));
+}
+
+TEST(CipherTest, RoundTrip) {
+	for(auto suite : suites()) {
+		StreamCipher tx, rx;
+		tx.init(suite, key);
+		rx.init(suite, key);
+
+		uint8_t packet[sizeof(message) + STREAM_CIPHER_ABYTES];
+		ASSERT_EQ(tx.encrypt(packet, message, sizeof(message), ad, sizeof(ad), nonce), 0);
+		if(suite == CipherSuite::POLY1305) {
+			EXPECT_EQ(std::memcmp(packet, message, sizeof(message)), 0);
+		} else {
+			EXPECT_NE(std::memcmp(packet, message, sizeof(message)), 0);
+		}
+
+		ASSERT_EQ(rx.decrypt(packet, packet, sizeof(packet), ad, sizeof(ad), nonce), 0);
+		EXPECT_EQ(std::memcmp(packet, message, sizeof(message)), 0);
+	}
+}
+
+TEST(CipherTest, RejectTampering) {
+	for(auto suite : suites()) {
+		StreamCipher tx, rx;
+		tx.init(suite, key);
+		rx.init(suite, key);
+
+		uint8_t packet[sizeof(message) + STREAM_CIPHER_ABYTES];
+		tx.encrypt(packet, message, sizeof(message), ad, sizeof(ad), nonce);
+
+		uint8_t tampered[sizeof(packet)];
+		std::memcpy(tampered, packet, sizeof(packet));
+		tampered[3] ^= 1;
+		EXPECT_LT(rx.decrypt(tampered, tampered, sizeof(tampered), ad, sizeof(ad), nonce), 0);
+
+		uint8_t tampered_ad[sizeof(ad)];
+		std::memcpy(tampered_ad, ad, sizeof(ad));
+		tampered_ad[0] ^= 1;
+		std::memcpy(tampered, packet, sizeof(packet));
+		EXPECT_LT(rx.decrypt(tampered, tampered, sizeof(tampered), tampered_ad, sizeof(ad), nonce), 0);
+
+		uint8_t other_nonce[STREAM_CIPHER_NPUBBYTES] = {4, 5, 7};
+		EXPECT_LT(rx.decrypt(tampered, tampered, sizeof(tampered), ad, sizeof(ad), other_nonce), 0);
+	}
+}
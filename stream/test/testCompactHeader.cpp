@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+#include <marlin/stream/protocol/CompactHeader.hpp>
+
+#include <cstring>
+
+
+using namespace marlin::stream;
+
+TEST(CompactHeaderTest, VarintRoundTrip) {
+	uint64_t values[] = {0, 63, 64, 16383, 16384, (1ull << 30) - 1, 1ull << 30, VARINT_MAX};
+	size_t sizes[] = {1, 1, 2, 2, 4, 4, 8, 8};
+
+	uint8_t storage[8];
+	marlin::core::WeakBuffer buf(storage, 8);
+
+	for(size_t i = 0; i < 8; i++) {
+		EXPECT_EQ(varint_size(values[i]), sizes[i]);
+		EXPECT_EQ(write_varint_unsafe(buf, 0, values[i]), sizes[i]);
+
+		uint64_t value = 0;
+		EXPECT_EQ(read_varint(buf, 0, value), sizes[i]);
+		EXPECT_EQ(value, values[i]);
+	}
+}
+
+TEST(CompactHeaderTest, VarintTruncated) {
+	uint8_t storage[8];
+	marlin::core::WeakBuffer buf(storage, 8);
+	write_varint_unsafe(buf, 0, 1ull << 30);
+
+	uint64_t value = 0;
+	EXPECT_EQ(read_varint(marlin::core::WeakBuffer(storage, 4), 0, value), 0);
+}
+
+TEST(CompactHeaderTest, PacketNumberLength) {
+	EXPECT_EQ(packet_number_length(10, 0), 1);
+	EXPECT_EQ(packet_number_length(1000, 900), 1);
+	EXPECT_EQ(packet_number_length(1000, 500), 2);
+	EXPECT_EQ(packet_number_length(100000, 0), 4);
+	EXPECT_EQ(packet_number_length(1ull << 40, 0), 8);
+}
+
+TEST(CompactHeaderTest, DecodePacketNumber) {
+	// Examples from RFC 9000 Appendix A.3 with a 2 byte encoding
+	EXPECT_EQ(decode_packet_number(0x9b32, 2, 0xa82f30eb), 0xa82f9b32);
+
+	// Wraps forward and backward around the expected packet number
+	EXPECT_EQ(decode_packet_number(0x02, 1, 0x1fe), 0x202);
+	EXPECT_EQ(decode_packet_number(0xfe, 1, 0x202), 0x1fe);
+	EXPECT_EQ(decode_packet_number(0xfe, 1, 0x01), 0xfe);
+}
+
+TEST(CompactHeaderTest, HeaderRoundTrip) {
+	CompactDataHeader header {
+		0xdeadbeef,
+		true,
+		0x12345,
+		packet_number_length(0x12345, 0x12300),
+		3,
+		1000000
+	};
+
+	uint8_t storage[64];
+	marlin::core::WeakBuffer buf(storage, 64);
+	header.encode(buf, 15);
+
+	EXPECT_EQ(header.packet_number_length, 1);
+	EXPECT_EQ(header.size(), 7 + 1 + 1 + 4);
+	EXPECT_EQ(storage[0], 0);
+	EXPECT_EQ(storage[1], 15);
+
+	auto decoded = CompactDataHeader::decode(marlin::core::WeakBuffer(storage, header.size()), 0x12310);
+	ASSERT_TRUE(decoded.has_value());
+	EXPECT_EQ(decoded->conn_id, 0xdeadbeef);
+	EXPECT_TRUE(decoded->is_fin);
+	EXPECT_EQ(decoded->packet_number, 0x12345);
+	EXPECT_EQ(decoded->packet_number_length, 1);
+	EXPECT_EQ(decoded->stream_id, 3);
+	EXPECT_EQ(decoded->offset, 1000000);
+
+	EXPECT_FALSE(CompactDataHeader::decode(marlin::core::WeakBuffer(storage, header.size() - 1), 0x12310).has_value());
+}
+
+TEST(CompactHeaderTest, Nonce) {
+	uint8_t iv[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+	uint8_t nonce[12];
+
+	compact_data_nonce(nonce, iv, 0);
+	EXPECT_EQ(std::memcmp(nonce, iv, 12), 0);
+
+	compact_data_nonce(nonce, iv, 0x0100000000000003);
+	EXPECT_EQ(nonce[0], 1 ^ 3);
+	EXPECT_EQ(nonce[7], 8 ^ 1);
+	EXPECT_EQ(nonce[8], 9);
+}
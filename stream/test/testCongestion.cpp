@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include <marlin/asyncio/udp/UdpTransportFactory.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+
+struct Delegate;
+
+using TransportType = StreamTransport<Delegate, UdpTransport>;
+
+uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+
+struct Delegate {
+	TraceRing *trace = nullptr;
+	size_t recvd = 0;
+	size_t target = 0;
+
+	int did_recv_bytes(TransportType &, Buffer &&packet, uint16_t) {
+		recvd += packet.size();
+		if(recvd >= target) {
+			uv_stop(uv_default_loop());
+		}
+		return 0;
+	}
+
+	void did_send_bytes(TransportType &, Buffer &&) {}
+
+	void did_dial(TransportType &transport) {
+		auto buf = Buffer(target);
+		std::memset(buf.data(), 0, target);
+		transport.send(std::move(buf));
+	}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this, static_sk);
+		if(trace != nullptr) {
+			transport.set_trace(trace);
+		}
+	}
+
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+/// Mark everything sent from the factory socket as CE, like a congested router would
+template<typename FactoryType>
+static void mark_ce(FactoryType &factory) {
+	uv_os_fd_t fd;
+	ASSERT_EQ(factory.get_fd(fd), 0);
+
+	int tos = 3;
+	ASSERT_EQ(setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)), 0);
+}
+
+TEST(CongestionTest, EcnCeShrinksWindow) {
+	crypto_box_keypair(static_pk, static_sk);
+
+	StreamTransportFactory<Delegate, Delegate, UdpTransportFactory, UdpTransport> s, c;
+	ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8060)), 0);
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(8061)), 0);
+	ASSERT_EQ(s.enable_ecn(), 0);
+	ASSERT_EQ(c.enable_ecn(), 0);
+	mark_ce(c);
+
+	TraceRing ring(1 << 12);
+	Delegate sd, cd;
+	sd.target = 100000;
+	cd.target = 100000;
+	cd.trace = &ring;
+
+	ASSERT_EQ(s.listen(sd), 0);
+	ASSERT_GE(c.dial(SocketAddress::loopback_ipv4(8060), cd, static_pk), 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	EXPECT_GE(sd.recvd, sd.target);
+
+	// Sender saw the receiver report CE marks and backed off without any loss
+	size_t events = 0;
+	for(auto &record : ring.snapshot()) {
+		if(record.event != static_cast<uint8_t>(TraceEvent::CongestionEvent)) {
+			continue;
+		}
+		EXPECT_EQ(record.a, static_cast<uint64_t>(TraceLossTrigger::Ecn));
+		if(events == 0) {
+			// Window after the first event is below the window it was cut from, later ones may sit at the floor
+			EXPECT_LT(record.b, record.c);
+		}
+		events++;
+	}
+	EXPECT_GT(events, 0u);
+}
@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+#include <marlin/asyncio/udp/UdpTransportFactory.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+
+struct Delegate;
+
+using TransportType = StreamTransport<Delegate, UdpTransport>;
+
+uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+
+struct Delegate {
+	std::function<void(TransportType &)> did_dial_fn;
+	std::function<void(TransportType &, Buffer &&)> did_recv_datagram_fn;
+
+	int did_recv_bytes(TransportType &, Buffer &&, uint16_t) {
+		return 0;
+	}
+
+	void did_recv_datagram(TransportType &transport, Buffer &&packet) {
+		if(did_recv_datagram_fn) {
+			did_recv_datagram_fn(transport, std::move(packet));
+		}
+	}
+
+	void did_send_bytes(TransportType &, Buffer &&) {}
+
+	void did_dial(TransportType &transport) {
+		if(did_dial_fn) {
+			did_dial_fn(transport);
+		}
+	}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this, static_sk);
+	}
+
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+static Buffer filled(size_t size, uint8_t value) {
+	Buffer buf(size);
+	std::memset(buf.data(), value, size);
+	return buf;
+}
+
+TEST(DatagramTest, ReplayWindowRejectsDuplicatesAndOld) {
+	ReplayWindow window;
+	EXPECT_FALSE(window.accept(0));
+	EXPECT_TRUE(window.accept(1));
+	EXPECT_FALSE(window.accept(1));
+	EXPECT_TRUE(window.accept(3));
+	EXPECT_TRUE(window.accept(2));
+	EXPECT_FALSE(window.accept(2));
+
+	EXPECT_TRUE(window.accept(3 + ReplayWindow::size));
+	EXPECT_FALSE(window.accept(3));
+	EXPECT_TRUE(window.accept(4));
+	EXPECT_FALSE(window.accept(4));
+}
+
+TEST(DatagramTest, SendsAndReceives) {
+	crypto_box_keypair(static_pk, static_sk);
+
+	StreamTransportFactory<Delegate, Delegate, UdpTransportFactory, UdpTransport> s, c;
+	ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8080)), 0);
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(8081)), 0);
+
+	Delegate sd, cd;
+	int recvd = 0;
+	cd.did_dial_fn = [&](TransportType &transport) {
+		EXPECT_EQ(transport.send_datagram(filled(DEFAULT_MAX_DATAGRAM_SIZE + 1, 1)), -1);
+		EXPECT_EQ(transport.send_datagram(filled(DEFAULT_MAX_DATAGRAM_SIZE, 2)), 0);
+	};
+	sd.did_recv_datagram_fn = [&](TransportType &, Buffer &&packet) {
+		recvd++;
+		EXPECT_EQ(packet.size(), DEFAULT_MAX_DATAGRAM_SIZE);
+		EXPECT_EQ(packet.data()[0], 2);
+		EXPECT_EQ(packet.data()[DEFAULT_MAX_DATAGRAM_SIZE - 1], 2);
+		uv_stop(uv_default_loop());
+	};
+
+	ASSERT_EQ(s.listen(sd), 0);
+	ASSERT_GE(c.dial(SocketAddress::loopback_ipv4(8080), cd, static_pk), 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	EXPECT_EQ(recvd, 1);
+}
+
+TEST(DatagramTest, RefusesWhenWindowIsFull) {
+	StreamTransportFactory<Delegate, Delegate, UdpTransportFactory, UdpTransport> s, c;
+	ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8082)), 0);
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(8083)), 0);
+
+	Delegate sd, cd;
+	int sent = 0;
+	int recvd = 0;
+	cd.did_dial_fn = [&](TransportType &transport) {
+		// Datagrams count against the congestion window until released
+		while(transport.send_datagram(filled(DEFAULT_MAX_DATAGRAM_SIZE, 0)) == 0) {
+			sent++;
+		}
+		EXPECT_GT(sent, 0);
+		EXPECT_EQ(transport.send_datagram(filled(DEFAULT_MAX_DATAGRAM_SIZE, 0)), -3);
+	};
+	sd.did_recv_datagram_fn = [&](TransportType &, Buffer &&) {
+		if(++recvd == sent) {
+			uv_stop(uv_default_loop());
+		}
+	};
+
+	ASSERT_EQ(s.listen(sd), 0);
+	ASSERT_GE(c.dial(SocketAddress::loopback_ipv4(8082), cd, static_pk), 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	EXPECT_EQ(recvd, sent);
+}
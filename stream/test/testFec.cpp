@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+#include <marlin/stream/protocol/Fec.hpp>
+
+#include <cstring>
+
+
+using namespace marlin::stream;
+
+static uint8_t fragments[4][8] = {
+	{1, 2, 3, 4, 5, 6, 7, 8},
+	{9, 10, 11, 12, 13},
+	{14, 15, 16, 17, 18, 19, 20, 21},
+	{22, 23, 24},
+};
+static uint16_t lengths[4] = {8, 5, 8, 3};
+
+static FecEncoder encode() {
+	FecEncoder encoder;
+	encoder.window = 4;
+
+	for(uint64_t i = 0; i < 4; i++) {
+		encoder.add(100 + i, 3, i*8, lengths[i], i == 3, fragments[i]);
+	}
+
+	return encoder;
+}
+
+TEST(FecTest, Encoder) {
+	auto encoder = encode();
+
+	EXPECT_TRUE(encoder.is_full());
+	EXPECT_EQ(encoder.base, 100);
+	EXPECT_EQ(encoder.count, 4);
+	EXPECT_EQ(encoder.symbol.size(), FEC_HEADER_SIZE + 8);
+
+	encoder.clear();
+
+	EXPECT_FALSE(encoder.is_full());
+	EXPECT_EQ(encoder.count, 0);
+	EXPECT_EQ(encoder.symbol.size(), 0);
+}
+
+TEST(FecTest, RecoverSingleLoss) {
+	auto encoder = encode();
+
+	FecDecoder decoder;
+	decoder.enable();
+	for(uint64_t i = 0; i < 4; i++) {
+		if(i == 1) continue;
+		decoder.add(100 + i, 3, i*8, lengths[i], i == 3, fragments[i]);
+	}
+
+	auto fragment = decoder.recover(
+		encoder.base,
+		encoder.count,
+		marlin::core::WeakBuffer(encoder.symbol.data(), encoder.symbol.size())
+	);
+
+	ASSERT_TRUE(fragment.has_value());
+	EXPECT_EQ(fragment->packet_number, 101);
+	EXPECT_EQ(fragment->stream_id, 3);
+	EXPECT_EQ(fragment->offset, 8);
+	EXPECT_EQ(fragment->length, 5);
+	EXPECT_FALSE(fragment->is_fin);
+	ASSERT_EQ(fragment->data.size(), 5);
+	EXPECT_EQ(std::memcmp(fragment->data.data(), fragments[1], 5), 0);
+}
+
+TEST(FecTest, RecoverFin) {
+	auto encoder = encode();
+
+	FecDecoder decoder;
+	decoder.enable();
+	for(uint64_t i = 0; i < 3; i++) {
+		decoder.add(100 + i, 3, i*8, lengths[i], false, fragments[i]);
+	}
+
+	auto fragment = decoder.recover(
+		encoder.base,
+		encoder.count,
+		marlin::core::WeakBuffer(encoder.symbol.data(), encoder.symbol.size())
+	);
+
+	ASSERT_TRUE(fragment.has_value());
+	EXPECT_EQ(fragment->packet_number, 103);
+	EXPECT_EQ(fragment->offset, 24);
+	EXPECT_EQ(fragment->length, 3);
+	EXPECT_TRUE(fragment->is_fin);
+	EXPECT_EQ(std::memcmp(fragment->data.data(), fragments[3], 3), 0);
+}
+
+TEST(FecTest, NoRecoverMultipleLoss) {
+	auto encoder = encode();
+
+	FecDecoder decoder;
+	decoder.enable();
+	decoder.add(100, 3, 0, lengths[0], false, fragments[0]);
+	decoder.add(102, 3, 16, lengths[2], false, fragments[2]);
+
+	auto fragment = decoder.recover(
+		encoder.base,
+		encoder.count,
+		marlin::core::WeakBuffer(encoder.symbol.data(), encoder.symbol.size())
+	);
+
+	EXPECT_FALSE(fragment.has_value());
+}
+
+TEST(FecTest, NoRecoverNoLoss) {
+	auto encoder = encode();
+
+	FecDecoder decoder;
+	decoder.enable();
+	for(uint64_t i = 0; i < 4; i++) {
+		decoder.add(100 + i, 3, i*8, lengths[i], i == 3, fragments[i]);
+	}
+
+	auto fragment = decoder.recover(
+		encoder.base,
+		encoder.count,
+		marlin::core::WeakBuffer(encoder.symbol.data(), encoder.symbol.size())
+	);
+
+	EXPECT_FALSE(fragment.has_value());
+}
+
+TEST(FecTest, Disabled) {
+	auto encoder = encode();
+
+	FecDecoder decoder;
+	for(uint64_t i = 0; i < 3; i++) {
+		decoder.add(100 + i, 3, i*8, lengths[i], false, fragments[i]);
+	}
+
+	EXPECT_FALSE(decoder.is_enabled());
+	auto fragment = decoder.recover(
+		encoder.base,
+		encoder.count,
+		marlin::core::WeakBuffer(encoder.symbol.data(), encoder.symbol.size())
+	);
+
+	EXPECT_FALSE(fragment.has_value());
+}
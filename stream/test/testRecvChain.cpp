@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include <marlin/asyncio/udp/UdpTransportFactory.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+
+struct Delegate;
+
+using TransportType = StreamTransport<Delegate, UdpTransport>;
+
+uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+
+#define TRANSFER_SIZE 200000
+
+struct Delegate {
+	std::function<void(TransportType &)> did_dial_fn;
+	size_t recvd = 0;
+	size_t chains = 0;
+	bool in_order = true;
+
+	int did_recv_bytes(TransportType &, Buffer &&, uint16_t) {
+		ADD_FAILURE() << "Chain delegates get chains only";
+		return 0;
+	}
+
+	int did_recv_bytes_chain(TransportType &, std::vector<Buffer> &&chain, uint16_t) {
+		chains++;
+		EXPECT_GT(chain.size(), 0u);
+		for(auto &bytes : chain) {
+			for(size_t i = 0; i < bytes.size(); i++) {
+				in_order = in_order && bytes.data()[i] == (uint8_t)(recvd + i);
+			}
+			recvd += bytes.size();
+		}
+
+		if(recvd == TRANSFER_SIZE) {
+			uv_stop(uv_default_loop());
+		}
+		return 0;
+	}
+
+	void did_send_bytes(TransportType &, Buffer &&) {}
+
+	void did_dial(TransportType &transport) {
+		if(did_dial_fn) {
+			did_dial_fn(transport);
+		}
+	}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this, static_sk);
+	}
+
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+TEST(RecvChainTest, DeliversInOrderChains) {
+	crypto_box_keypair(static_pk, static_sk);
+
+	StreamTransportFactory<Delegate, Delegate, UdpTransportFactory, UdpTransport> s, c;
+	ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8085)), 0);
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(8086)), 0);
+
+	Delegate sd, cd;
+	cd.did_dial_fn = [&](TransportType &transport) {
+		Buffer bytes(TRANSFER_SIZE);
+		for(size_t i = 0; i < TRANSFER_SIZE; i++) {
+			bytes.data()[i] = i;
+		}
+		EXPECT_EQ(transport.send(std::move(bytes)), 0);
+	};
+
+	ASSERT_EQ(s.listen(sd), 0);
+	ASSERT_GE(c.dial(SocketAddress::loopback_ipv4(8085), cd, static_pk), 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	EXPECT_EQ(sd.recvd, TRANSFER_SIZE);
+	EXPECT_TRUE(sd.in_order);
+	// Delivered as packets get read, not batched up to the end
+	EXPECT_GT(sd.chains, 1u);
+}
@@ -0,0 +1,166 @@
+#include "gtest/gtest.h"
+#include <marlin/core/messages/BaseMessage.hpp>
+#include <marlin/stream/StreamTransport.hpp>
+
+#include <deque>
+
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+
+/// Datagram transport which queues sent packets for the test to deliver, with receive times set by the test
+template<typename DelegateType>
+struct FakeTransport {
+	using MessageType = BaseMessage;
+
+	SocketAddress src_addr;
+	SocketAddress dst_addr;
+	DelegateType *delegate = nullptr;
+	uint64_t last_recv_time_us = 0;
+
+	/// Packets along with the time they were sent
+	std::deque<std::pair<Buffer, uint64_t>> sent;
+
+	FakeTransport(SocketAddress const& src_addr, SocketAddress const& dst_addr) : src_addr(src_addr), dst_addr(dst_addr) {}
+
+	void setup(DelegateType *delegate) {
+		this->delegate = delegate;
+	}
+
+	int send(Buffer &&packet) {
+		sent.emplace_back(std::move(packet), EventLoop::now_us());
+		return 0;
+	}
+
+	int send(MessageType &&packet) {
+		return send(std::move(packet).payload_buffer());
+	}
+
+	void close(uint16_t = 0) {}
+
+	/// Deliver the oldest sent packet to the other end, received at the given time
+	void deliver(FakeTransport &to, uint64_t recv_time_us) {
+		auto packet = std::move(sent.front().first);
+		sent.pop_front();
+		to.last_recv_time_us = recv_time_us;
+		to.delegate->did_recv_packet(to, BaseMessage(std::move(packet)));
+	}
+};
+
+struct Delegate;
+
+using TransportType = StreamTransport<Delegate, FakeTransport>;
+
+struct Delegate {
+	int did_recv_bytes(TransportType &, Buffer &&, uint16_t) {
+		return 0;
+	}
+
+	void did_send_bytes(TransportType &, Buffer &&) {}
+	void did_dial(TransportType &) {}
+	void did_close(TransportType &, uint16_t) {}
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+/// Run the loop until the transport has sent something
+static void wait_for_send(FakeTransport<TransportType> &transport) {
+	while(transport.sent.size() == 0) {
+		uv_run(uv_default_loop(), UV_RUN_NOWAIT);
+	}
+}
+
+TEST(RttTest, SubtractsAckDelayAboveMinRtt) {
+	uint8_t c_sk[crypto_box_SECRETKEYBYTES], c_pk[crypto_box_PUBLICKEYBYTES];
+	uint8_t s_sk[crypto_box_SECRETKEYBYTES], s_pk[crypto_box_PUBLICKEYBYTES];
+	crypto_box_keypair(c_pk, c_sk);
+	crypto_box_keypair(s_pk, s_sk);
+
+	auto c_addr = SocketAddress::loopback_ipv4(8100);
+	auto s_addr = SocketAddress::loopback_ipv4(8101);
+	FakeTransport<TransportType> cf(c_addr, s_addr), sf(s_addr, c_addr);
+	TransportManager<TransportType> cm, sm;
+	TransportType c(c_addr, s_addr, cf, cm, s_pk), s(s_addr, c_addr, sf, sm, nullptr);
+
+	Delegate d;
+	c.setup(&d, c_sk);
+	s.setup(&d, s_sk);
+
+	TraceRing ring(64);
+	c.set_trace(&ring);
+
+	// Handshake, times do not matter
+	c.did_dial(cf);
+	while(cf.sent.size() > 0 || sf.sent.size() > 0) {
+		if(cf.sent.size() > 0) {
+			cf.deliver(sf, EventLoop::now_us());
+		} else {
+			sf.deliver(cf, EventLoop::now_us());
+		}
+	}
+	ASSERT_TRUE(c.is_active());
+
+	// One packet per round, acked after the given RTT with the given ack delay
+	auto round = [&](uint64_t rtt_us, uint32_t ack_delay_us) {
+		Buffer bytes(100);
+		std::memset(bytes.data(), 0, bytes.size());
+		ASSERT_EQ(c.send(std::move(bytes)), 0);
+
+		wait_for_send(cf);
+		auto sent_time_us = cf.sent.front().second;
+		cf.deliver(sf, EventLoop::now_us());
+
+		wait_for_send(sf);
+		ACKWrapper<BaseMessage> ack(BaseMessage(std::move(sf.sent.front().first)));
+		sf.sent.pop_front();
+		ack.set_ack_delay(ack_delay_us);
+		sf.sent.emplace_front(std::move(ack).base.payload_buffer(), 0);
+		sf.deliver(cf, sent_time_us + rtt_us);
+	};
+
+	auto samples = [&]() {
+		std::vector<TraceRecord> out;
+		for(auto &record : ring.snapshot()) {
+			if(record.event == static_cast<uint8_t>(TraceEvent::RttUpdated)) {
+				out.push_back(record);
+			}
+		}
+		return out;
+	};
+
+	// First packet number is 0 and does not advance the largest acked
+	round(10000, 0);
+	ASSERT_EQ(samples().size(), 0u);
+
+	// Sample below min RTT + ack delay is taken as is and sets the min RTT
+	round(10000, 5000);
+	ASSERT_EQ(samples().size(), 1u);
+	EXPECT_NEAR(samples()[0].a, 10000, 200);
+	EXPECT_NEAR(c.get_min_rtt_us(), 10000, 200);
+	EXPECT_NEAR(c.get_rtt(), 10.0, 0.2);
+
+	// Ack delay is subtracted when the sample stays above the min RTT
+	round(50000, 20000);
+	ASSERT_EQ(samples().size(), 2u);
+	EXPECT_NEAR(samples()[1].a, 30000, 200);
+	EXPECT_EQ(samples()[1].c, 20000u);
+	EXPECT_NEAR(c.get_min_rtt_us(), 10000, 200);
+	EXPECT_NEAR(c.get_rtt(), 0.875 * 10 + 0.125 * 30, 0.2);
+
+	// Ack delay which would take the sample below the min RTT is ignored
+	round(12000, 10000);
+	ASSERT_EQ(samples().size(), 3u);
+	EXPECT_NEAR(samples()[2].a, 12000, 200);
+	EXPECT_NEAR(c.get_min_rtt_us(), 10000, 200);
+
+	// Smaller sample lowers the min RTT
+	round(8000, 1000);
+	ASSERT_EQ(samples().size(), 4u);
+	EXPECT_NEAR(samples()[3].a, 8000, 200);
+	EXPECT_NEAR(c.get_min_rtt_us(), 8000, 200);
+
+	c.close();
+	s.close();
+}
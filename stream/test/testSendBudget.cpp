@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+#include <marlin/asyncio/udp/UdpTransportFactory.hpp>
+#include <marlin/stream/StreamTransportFactory.hpp>
+
+
+using namespace marlin::core;
+using namespace marlin::asyncio;
+using namespace marlin::stream;
+
+struct Delegate;
+
+using TransportType = StreamTransport<Delegate, UdpTransport>;
+
+uint8_t static_sk[crypto_box_SECRETKEYBYTES];
+uint8_t static_pk[crypto_box_PUBLICKEYBYTES];
+
+struct Delegate {
+	std::function<void(TransportType &)> did_dial_fn;
+	std::function<void(TransportType &)> did_drain_fn;
+	size_t recvd = 0;
+
+	int did_recv_bytes(TransportType &, Buffer &&packet, uint16_t) {
+		recvd += packet.size();
+		return 0;
+	}
+
+	void did_send_bytes(TransportType &, Buffer &&) {}
+
+	void did_dial(TransportType &transport) {
+		if(did_dial_fn) {
+			did_dial_fn(transport);
+		}
+	}
+
+	void did_drain(TransportType &transport) {
+		if(did_drain_fn) {
+			did_drain_fn(transport);
+		}
+	}
+
+	void did_close(TransportType &, uint16_t) {}
+
+	bool should_accept(SocketAddress const &) {
+		return true;
+	}
+
+	void did_create_transport(TransportType &transport) {
+		transport.setup(this, static_sk);
+	}
+
+	void did_recv_flush_stream(TransportType &, uint16_t, uint64_t, uint64_t) {}
+	void did_recv_skip_stream(TransportType &, uint16_t) {}
+	void did_recv_flush_conf(TransportType &, uint16_t) {}
+};
+
+/// Transports of other delegate types share the budget of the loop
+struct OtherDelegate {};
+
+static Buffer zeroes(size_t size) {
+	Buffer buf(size);
+	std::memset(buf.data(), 0, size);
+	return buf;
+}
+
+TEST(SendBudgetTest, RefusesOverBudgetAndDrains) {
+	crypto_box_keypair(static_pk, static_sk);
+
+	StreamTransportFactory<Delegate, Delegate, UdpTransportFactory, UdpTransport> s, c;
+	ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8070)), 0);
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(8071)), 0);
+
+	Delegate sd, cd;
+	int drains = 0;
+	cd.did_dial_fn = [&](TransportType &transport) {
+		transport.set_send_buffer_limit(10000);
+		EXPECT_EQ(transport.send(zeroes(8000)), 0);
+		EXPECT_EQ(transport.send(zeroes(4000)), -1);
+		EXPECT_EQ(transport.get_queued_bytes(), 8000u);
+	};
+	cd.did_drain_fn = [&](TransportType &transport) {
+		drains++;
+		EXPECT_LE(transport.get_queued_bytes(), 5000u);
+		EXPECT_EQ(transport.send(zeroes(4000)), 0);
+		uv_stop(uv_default_loop());
+	};
+
+	ASSERT_EQ(s.listen(sd), 0);
+	ASSERT_GE(c.dial(SocketAddress::loopback_ipv4(8070), cd, static_pk), 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	EXPECT_EQ(drains, 1);
+}
+
+TEST(SendBudgetTest, LoopBudgetIsSharedAcrossTransportTypes) {
+	StreamTransportFactory<Delegate, Delegate, UdpTransportFactory, UdpTransport> s, c;
+	ASSERT_EQ(s.bind(SocketAddress::loopback_ipv4(8072)), 0);
+	ASSERT_EQ(c.bind(SocketAddress::loopback_ipv4(8073)), 0);
+
+	// Limit set through a different instantiation applies to this one
+	StreamTransport<OtherDelegate, UdpTransport>::set_global_send_buffer_limit(10000);
+
+	Delegate sd, cd;
+	int drains = 0;
+	cd.did_dial_fn = [&](TransportType &transport) {
+		EXPECT_EQ(transport.send(zeroes(8000)), 0);
+		EXPECT_EQ(transport.send(zeroes(4000)), -1);
+		EXPECT_EQ(SendBudget::loop().queued_bytes, 8000u);
+	};
+	cd.did_drain_fn = [&](TransportType &) {
+		drains++;
+		EXPECT_LE(SendBudget::loop().queued_bytes, 5000u);
+		uv_stop(uv_default_loop());
+	};
+
+	ASSERT_EQ(s.listen(sd), 0);
+	ASSERT_GE(c.dial(SocketAddress::loopback_ipv4(8072), cd, static_pk), 0);
+
+	uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+	EXPECT_EQ(drains, 1);
+
+	TransportType::set_global_send_buffer_limit(std::numeric_limits<uint64_t>::max());
+}
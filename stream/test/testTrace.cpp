@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+#include <marlin/stream/protocol/Trace.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unistd.h>
+
+
+using namespace marlin::stream;
+
+TEST(TraceTest, Wraps) {
+	TraceRing ring(3);
+	EXPECT_EQ(ring.capacity(), 4);
+
+	for(uint64_t i = 0; i < 6; i++) {
+		ring.record(i, 1, TraceEvent::PacketSent, i, 1350, 0);
+	}
+	EXPECT_EQ(ring.size(), 4);
+	EXPECT_EQ(ring.dropped(), 2);
+
+	// Oldest first
+	auto records = ring.snapshot();
+	ASSERT_EQ(records.size(), 4);
+	for(uint64_t i = 0; i < 4; i++) {
+		EXPECT_EQ(records[i].a, i + 2);
+	}
+
+	ring.clear();
+	EXPECT_EQ(ring.size(), 0);
+}
+
+TEST(TraceTest, DumpRoundTrip) {
+	TraceRing ring(16);
+	ring.record(100, 7, TraceEvent::PacketSent, 1, 1350, 2);
+	ring.record(200, 7, TraceEvent::CongestionUpdated, 15000, UINT64_MAX, 1350);
+
+	char path[] = "/tmp/marlin_trace_XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	ASSERT_EQ(ring.dump(path), 0);
+
+	std::vector<TraceRecord> records;
+	ASSERT_EQ(TraceRing::load(path, records), 0);
+	std::remove(path);
+
+	ASSERT_EQ(records.size(), 2);
+	EXPECT_EQ(records[1].time_us, 200);
+	EXPECT_EQ(records[1].conn_id, 7);
+	EXPECT_EQ(records[1].event, static_cast<uint8_t>(TraceEvent::CongestionUpdated));
+	EXPECT_EQ(records[1].a, 15000);
+	EXPECT_EQ(records[1].b, UINT64_MAX);
+
+	EXPECT_LT(TraceRing::load("/nonexistent/trace", records), 0);
+}
+
+TEST(TraceTest, LoadRejectsCountPastEndOfFile) {
+	TraceRing ring(16);
+	ring.record(100, 7, TraceEvent::PacketSent, 1, 1350, 2);
+
+	char path[] = "/tmp/marlin_trace_XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_GE(fd, 0);
+	close(fd);
+	ASSERT_EQ(ring.dump(path), 0);
+
+	// Claim far more records than the file holds, right after the 16 byte header
+	auto *file = std::fopen(path, "r+b");
+	ASSERT_NE(file, nullptr);
+	uint64_t count = UINT64_MAX / sizeof(TraceRecord);
+	ASSERT_EQ(std::fseek(file, 16, SEEK_SET), 0);
+	ASSERT_EQ(std::fwrite(&count, sizeof(count), 1, file), 1u);
+	std::fclose(file);
+
+	std::vector<TraceRecord> records;
+	EXPECT_LT(TraceRing::load(path, records), 0);
+	EXPECT_EQ(records.size(), 0u);
+	std::remove(path);
+}
+
+TEST(TraceTest, Qlog) {
+	TraceRing ring(16);
+	ring.record(1000, 1, TraceEvent::PacketSent, 5, 1350, 0);
+	ring.record(1500, 2, TraceEvent::RttUpdated, 2500, 3000, 100);
+	ring.record(2250, 1, TraceEvent::PacketLost, 5, 1350, static_cast<uint64_t>(TraceLossTrigger::Timer));
+
+	std::ostringstream os;
+	TraceRing::write_qlog(os, ring.snapshot());
+	auto qlog = os.str();
+
+	EXPECT_EQ(qlog.find("{\"qlog_version\":\"0.3\""), 0);
+	EXPECT_NE(qlog.find("\"group_id\":\"1\""), std::string::npos);
+	EXPECT_NE(qlog.find("\"group_id\":\"2\""), std::string::npos);
+	EXPECT_NE(qlog.find("\"name\":\"transport:packet_sent\""), std::string::npos);
+	EXPECT_NE(qlog.find("{\"time\":1.250,\"name\":\"recovery:packet_lost\""), std::string::npos);
+	EXPECT_NE(qlog.find("\"trigger\":\"pto_expired\""), std::string::npos);
+	EXPECT_NE(qlog.find("\"smoothed_rtt\":3.000"), std::string::npos);
+}